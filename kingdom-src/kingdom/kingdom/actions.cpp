@@ -47,6 +47,7 @@
 #include "loadscreen.hpp"
 
 #include "gui/dialogs/title_screen.hpp"
+#include "simulate.hpp"
 
 #include <boost/foreach.hpp>
 #include <boost/bind.hpp>
@@ -1111,11 +1112,13 @@ void unit_die(unit_map& units, unit& die, void* a_info_p, int die_activity, int
 	team& die_team = teams[die.side() - 1];
 	artifical* cobj = units.city_from_cityno(die.cityno());
 
+	statistics::death(die_team, die.type_id());
 	if (a_info_p) {
 		a_info = reinterpret_cast<attack::unit_info*>(a_info_p);
 		attacker = &a_info->get_unit();
 
 		team& t = teams[attacker->side() - 1];
+		statistics::kill(t, die.type_id());
 		if (t.kill_income && !die.is_artifical() && !die.is_commoner()) {
 			t.spend_gold(-1 * die.cost());
 			unit_display::unit_income(*attacker, die.cost());
@@ -1358,6 +1361,7 @@ void attack::unit_die(unit_info& attacker, unit_info& center, unit& defender_u,
 std::pair<map_location, map_location> attack_unit(unit& attacker, unit& defender,
 	int attack_with, int defend_with, bool update_display, const config& duel, bool move, bool formation)
 {
+	simulate::tphase phase(simulate::COMBAT);
 	attack dummy(attacker, defender, attack_with, defend_with, update_display, duel, move, formation);
 	return dummy.perform();
 }
@@ -1535,6 +1539,7 @@ bool attack::perform_hit(bool attacker_turn)
 		drains_damage = std::min<int>(drains_damage, defender.get_unit().hitpoints() / 2);
 	}
 	bool defender_dies = defender.get_unit().hitpoints() <= attacker.damage_;
+	statistics::attack_hit((*resources::teams)[attacker.get_unit().side() - 1], (*resources::teams)[defender.get_unit().side() - 1], damage, attacker.cth_, hits);
 
 	if (!ran_results) {
 		log_scope2(log_engine, "setting random results");
@@ -3181,6 +3186,7 @@ namespace {
 
 void recalculate_fog(int side)
 {
+	simulate::tphase phase(simulate::FOG);
 	team &tm = (*resources::teams)[side - 1];
 
 	if (!tm.uses_fog())
@@ -3204,6 +3210,7 @@ void recalculate_fog(int side)
 
 bool clear_shroud(int side)
 {
+	simulate::tphase phase(simulate::FOG);
 	team &tm = (*resources::teams)[side - 1];
 	if (!tm.uses_shroud() && !tm.uses_fog())
 		return false;
@@ -4489,6 +4496,7 @@ void do_recruit(unit_map& units, hero_map& heros, std::vector<team>& teams, team
 	new_unit->set_attacks(new_unit->attacks_total());
 
 	current_team.spend_gold(cost);
+	statistics::recruit(current_team, *ut, cost);
 
 	new_unit->set_human(human);
 	city.troop_come_into(new_unit, -1);
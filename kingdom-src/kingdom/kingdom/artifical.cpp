@@ -2541,6 +2541,10 @@ void artifical::fallen(int a_side, unit* attacker)
 	// fallen maybe result to chnage road owner.
 	disp.invalidate_all();
 
+	// owner changed, shared routes from or through this city are stale.
+	controller.route_cache().invalidate_city(cityno_);
+	controller.route_cache().invalidate(loc_);
+
 	return;
 }
 
@@ -2578,6 +2582,8 @@ void artifical::fort_fallen(int a_side)
 	
 	decrease_level();
 	food_ /= 10;
+
+	resources::controller->route_cache().invalidate(loc_);
 }
 
 bool artifical::independence_vote(const artifical* aggressing) const
@@ -2624,6 +2630,7 @@ void artifical::independence(bool independenced, team& to_team, artifical* rpg_c
 	if (independenced) {
 		set_side(to_side);
 		select_mayor(&hero_invalid);
+		resources::controller->route_cache().invalidate_city(cityno_);
 	}
 	
 	// process troop
@@ -0,0 +1,174 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/**
+ * @file
+ * Command line packer of assets.pak: images, sounds and music of default
+ * binary paths of a data tree.
+ *
+ * A name is packed from the first binary path that has it, like
+ * get_binary_file_location() finds it.
+ */
+
+#include "global.hpp"
+
+#include "asset_pack.hpp"
+#include "filesystem.hpp"
+#include "rose_config.hpp"
+#include "sdl_utils.hpp"
+#include "serialization/string_utils.hpp"
+
+#include "SDL_image.h"
+#include "SDL_timer.h"
+#include <iostream>
+#include <map>
+
+namespace {
+
+// name of asset => file, and index of binary path that has it.
+typedef std::map<std::string, std::pair<std::string, uint32_t> > asset_map;
+
+void walk(asset_map& assets, const std::string& dir, const std::string& name, uint32_t root)
+{
+	std::vector<std::string> files, dirs;
+	get_files_in_dir(dir, &files, &dirs, FILE_NAME_ONLY, NO_FILTER, DONT_REORDER);
+
+	for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++ it) {
+		// binary path that is walked before has priority.
+		assets.insert(std::make_pair(name + *it, std::make_pair(dir + *it, root)));
+	}
+	for (std::vector<std::string>::const_iterator it = dirs.begin(); it != dirs.end(); ++ it) {
+		walk(assets, dir + *it + "/", name + *it + "/", root);
+	}
+}
+
+bool decodable(const std::string& file)
+{
+	const size_t pos = file.rfind('.');
+	if (pos == std::string::npos) {
+		return false;
+	}
+	const std::string ext = utils::lowercase(file.substr(pos + 1));
+	return ext == "png" || ext == "jpg" || ext == "jpeg" || ext == "bmp" || ext == "webp";
+}
+
+// pixels of neutral surface, rows without padding.
+bool decode(const std::string& file, std::string& pixels, int& w, int& h)
+{
+	surface surf = make_neutral_surface(IMG_Load(file.c_str()));
+	if (surf.null()) {
+		return false;
+	}
+	w = surf->w;
+	h = surf->h;
+	pixels.clear();
+	const_surface_lock lock(surf);
+	const char* src = reinterpret_cast<const char*>(lock.pixels());
+	for (int row = 0; row < h; row ++) {
+		pixels.append(src + row * surf->pitch, w * 4);
+	}
+	return true;
+}
+
+void usage(const char* program)
+{
+	std::cout << "usage: " << program << " [-hp] [-a app] [-d path] [-o file]\n"
+		<< "  -a, --app <id>             App of data tree, app-<id>/ is packed before data/core/ (default: kingdom).\n"
+		<< "  -d, --data <path>          Data tree that has data/ (default: current directory).\n"
+		<< "  -h, --help                 Shows this usage message.\n"
+		<< "  -o, --output <file>        Pack to write (default: <path>/" ASSET_PACK_FILE ").\n"
+		<< "  -p, --pixels               Packs images as decoded pixels. Loading doesn't decode, but pack is bigger.\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	std::string app = "kingdom";
+	std::string output;
+	bool pixels = false;
+
+	game_config::path = get_cwd();
+
+	for (int arg = 1; arg != argc; ++ arg) {
+		const std::string val(argv[arg]);
+		if (val.empty()) {
+			continue;
+		}
+
+		if ((val == "--app" || val == "-a") && arg + 1 != argc) {
+			app = argv[++ arg];
+		} else if ((val == "--data" || val == "-d") && arg + 1 != argc) {
+			game_config::path = normalize_path(argv[++ arg]);
+		} else if ((val == "--output" || val == "-o") && arg + 1 != argc) {
+			output = argv[++ arg];
+		} else if (val == "--pixels" || val == "-p") {
+			pixels = true;
+		} else if (val == "--help" || val == "-h") {
+			usage(argv[0]);
+			return 0;
+		} else {
+			std::cerr << "unknown option: " << val << "\n";
+			return 2;
+		}
+	}
+	if (output.empty()) {
+		output = game_config::path + "/" + ASSET_PACK_FILE;
+	}
+
+	// default binary paths of init_binary_paths(), by priority. User data directory isn't packed.
+	std::vector<std::string> roots;
+	roots.push_back("app-" + app + "/");
+	roots.push_back("data/core/");
+
+	const uint32_t start = SDL_GetTicks();
+	asset_map assets;
+	const char* types[] = {"images", "sounds", "music"};
+	for (size_t n = 0; n < sizeof(types) / sizeof(types[0]); n ++) {
+		const std::string type = types[n];
+		for (size_t root = 0; root < roots.size(); root ++) {
+			walk(assets, game_config::path + "/" + roots[root] + type + "/", type + "/", root);
+		}
+	}
+
+	asset_pack::twriter writer(output);
+	if (!writer.valid()) {
+		return 1;
+	}
+	int decoded = 0;
+	std::string data;
+	int w, h;
+	for (asset_map::const_iterator it = assets.begin(); it != assets.end(); ++ it) {
+		bool ok;
+		const std::string& file = it->second.first;
+		if (pixels && !it->first.compare(0, 7, "images/") && decodable(it->first) && decode(file, data, w, h)) {
+			ok = writer.add(it->first, it->second.second, data.data(), data.size(), asset_pack::PIXELS, w, h);
+			decoded ++;
+		} else {
+			data = read_file(file);
+			ok = writer.add(it->first, it->second.second, data.data(), data.size());
+		}
+		if (!ok) {
+			std::cerr << "can not write " << it->first << " to " << output << "\n";
+			return 1;
+		}
+	}
+	if (!writer.finish(roots)) {
+		return 1;
+	}
+
+	std::cout << assets.size() << " assets, " << decoded << " images as pixels, "
+		<< (file_size(output, false) / 1024) << " KB, " << (SDL_GetTicks() - start) << " ms\n";
+	return 0;
+}
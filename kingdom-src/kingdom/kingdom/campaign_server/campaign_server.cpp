@@ -31,9 +31,12 @@
 #include "addon/validation.hpp"
 #include "version.hpp"
 #include "server/input_stream.hpp"
+#include "sha1.hpp"
 #include "util.hpp"
 
 #include <csignal>
+#include <set>
+#include <sstream>
 
 #include <boost/iostreams/filter/gzip.hpp>
 
@@ -87,6 +90,39 @@ namespace {
 		return cfg;
 	}
 
+	std::string encode_base64(const std::string& data)
+	{
+		static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		std::string ret;
+		ret.reserve((data.size() + 2) / 3 * 4);
+		for (size_t i = 0; i < data.size(); i += 3) {
+			const size_t remain = data.size() - i;
+			unsigned int value = static_cast<unsigned char>(data[i]) << 16;
+			if (remain > 1) value |= static_cast<unsigned char>(data[i + 1]) << 8;
+			if (remain > 2) value |= static_cast<unsigned char>(data[i + 2]);
+			ret.push_back(table[(value >> 18) & 0x3f]);
+			ret.push_back(table[(value >> 12) & 0x3f]);
+			ret.push_back(remain > 1? table[(value >> 6) & 0x3f]: '=');
+			ret.push_back(remain > 2? table[value & 0x3f]: '=');
+		}
+		return ret;
+	}
+
+	/** campaign of index, with fields filters of request_campaign_list use. */
+	struct index_entry {
+		index_entry() :
+			name(),
+			timestamp(0),
+			has_timestamp(false),
+			languages()
+		{}
+
+		std::string name;
+		time_t timestamp;
+		bool has_timestamp;
+		std::set<std::string> languages;
+	};
+
 	class campaign_server
 	{
 		public:
@@ -105,6 +141,18 @@ namespace {
 			 */
 			void fire(const std::string& hook, const std::string& addon);
 			void convert_binary_to_gzip();
+
+			/**
+			 * Campaign list without private fields, and the list compressed as response
+			 * to request without filter. It is rebuilt only when an add-on changes.
+			 */
+			void rebuild_index();
+			/**
+			 * sha1 of add-on file and of every chunk_size_ bytes of it, chunks of resumable
+			 * download are verified by them. Computed once per upload.
+			 */
+			void update_hashes(config& campaign, bool force);
+			void send_chunk(const config& req, network::connection sock);
 			int load_config(); // return the server port
 			const config &campaigns() const { return cfg_.child("campaigns"); }
 			config &campaigns() { return cfg_.child("campaigns"); }
@@ -116,6 +164,12 @@ namespace {
 			input_stream* input_;
 			int compress_level_;
 
+			config index_;
+			std::vector<index_entry> index_entries_;
+			std::string compressed_index_;
+			time_t index_time_;
+			bool index_dirty_;
+			size_t chunk_size_;
 	};
 
 	void campaign_server::fire(const std::string& hook, const std::string& addon)
@@ -166,6 +220,10 @@ namespace {
 		/** Seems like compression level above 6 is waste of cpu cycle */
 		compress_level_ = cfg_["compress_level"].to_int(6);
 		cfg_["compress_level"] = compress_level_;
+		chunk_size_ = cfg_["chunk_size"].to_int(256 * 1024);
+		if (chunk_size_ < 1024) {
+			chunk_size_ = 1024;
+		}
 		return cfg_["port"].to_int(default_campaignd_port);
 	}
 
@@ -177,7 +235,13 @@ namespace {
 		server_manager_(load_config()),
 		hooks_(),
 		input_(0),
-		compress_level_(compress_level_) // Already set by load_config()
+		compress_level_(compress_level_), // Already set by load_config()
+		index_(),
+		index_entries_(),
+		compressed_index_(),
+		index_time_(0),
+		index_dirty_(true),
+		chunk_size_(chunk_size_) // Already set by load_config()
 	{
 #ifndef _MSC_VER
 		signal(SIGHUP, exit_sighup);
@@ -231,6 +295,100 @@ namespace {
 		copying["contents"] = contents;
 
 	}
+	void campaign_server::rebuild_index()
+	{
+		if (!index_dirty_) return;
+		index_dirty_ = false;
+		// clients ask for changes after this time, nothing is changed since index is built.
+		index_time_ = time(NULL);
+
+		index_.clear();
+		index_entries_.clear();
+		foreach (const config &i, campaigns().child_range("campaign"))
+		{
+			config &campaign = index_.add_child("campaign", i);
+			campaign["passphrase"] = t_string();
+			campaign["upload_ip"] = t_string();
+			campaign["email"] = t_string();
+			campaign.remove_attribute("chunk_hashes");
+
+			index_entry entry;
+			entry.name = i["name"].str();
+			const std::string tm = i["timestamp"];
+			entry.has_timestamp = !tm.empty();
+			entry.timestamp = lexical_cast_default<time_t>(tm, 0);
+			foreach (const config &j, i.child_range("translation")) {
+				entry.languages.insert(j["language"]);
+			}
+			index_entries_.push_back(entry);
+		}
+
+		config response;
+		config &campaign_list = response.add_child("campaigns", index_);
+		campaign_list["timestamp"] = lexical_cast<std::string>(index_time_);
+		std::ostringstream stream;
+		{
+			config_writer writer(stream, true, compress_level_);
+			writer.write(response);
+		}
+		compressed_index_ = stream.str();
+		LOG_CS << "campaign index rebuilt, " << index_entries_.size() << " add-ons, " << compressed_index_.size() / 1024 << "kb\n";
+	}
+
+	void campaign_server::update_hashes(config& campaign, bool force)
+	{
+		if (!force && !campaign["hash"].empty() && campaign["chunk_size"].to_int() == (int)chunk_size_) return;
+
+		const std::string contents = read_file(campaign["filename"]);
+		campaign["hash"] = sha1_hash(contents).display();
+		campaign["chunk_size"] = (int)chunk_size_;
+
+		std::stringstream chunk_hashes;
+		for (size_t offset = 0; offset < contents.size(); offset += chunk_size_) {
+			if (offset) chunk_hashes << ",";
+			chunk_hashes << sha1_hash(contents.substr(offset, chunk_size_)).display();
+		}
+		campaign["chunk_hashes"] = chunk_hashes.str();
+	}
+
+	void campaign_server::send_chunk(const config& req, network::connection sock)
+	{
+		config &campaign = campaigns().find_child("campaign", "name", req["name"]);
+		if (!campaign) {
+			network::send_data(construct_error("Add-on '" + req["name"].str() + "'not found."), sock);
+			return;
+		}
+		update_hashes(campaign, false);
+		if (campaign["hash"] != req["hash"]) {
+			// uploaded again since download started, client has to start over.
+			network::send_data(construct_error("Add-on '" + req["name"].str() + "' has changed, download it again."), sock);
+			return;
+		}
+
+		const size_t size = file_size(campaign["filename"]);
+		const size_t offset = req["offset"].to_int(-1);
+		if (offset >= size || offset % chunk_size_) {
+			network::send_data(construct_error("Invalid offset of add-on '" + req["name"].str() + "'."), sock);
+			return;
+		}
+
+		std::string data(std::min(chunk_size_, size - offset), '\0');
+		{
+			scoped_istream stream = istream_file(campaign["filename"]);
+			stream->seekg(offset);
+			stream->read(&data[0], data.size());
+		}
+
+		config response;
+		config &chunk = response.add_child("campaign_chunk");
+		chunk["name"] = campaign["name"];
+		chunk["offset"] = lexical_cast<std::string>(offset);
+		chunk["size"] = lexical_cast<std::string>(data.size());
+		chunk["hash"] = sha1_hash(data).display();
+		chunk["data"] = encode_base64(data);
+		network::send_data(response, sock);
+	}
+
 	/// @todo Check if this function has any purpose left
 	void campaign_server::convert_binary_to_gzip()
 	{
@@ -301,6 +459,8 @@ namespace {
 				if((increment%(60*10*50)) == 0) {
 					scoped_ostream cfgfile = ostream_file(file_);
 					write(*cfgfile, cfg_);
+					// refresh download counts in index.
+					index_dirty_ = true;
 				}
 
 				network::process_send_queue();
@@ -315,9 +475,16 @@ namespace {
 					if (const config &req = data.child("request_campaign_list"))
 					{
 						LOG_CS << "sending campaign list to " << network::ip_address(sock) << " using gzip";
+						rebuild_index();
+						if (req["name"].empty() && req["language"].empty() && req["before"].empty() && req["after"].empty()) {
+							network::send_raw_data(compressed_index_.c_str(), compressed_index_.size(), sock);
+							std::cerr << " size: " << (compressed_index_.size()/1024) << "kb, cached\n";
+							continue;
+						}
+
 						time_t epoch = time(NULL);
 						config campaign_list;
-						campaign_list["timestamp"] = lexical_cast<std::string>(epoch);
+						campaign_list["timestamp"] = lexical_cast<std::string>(index_time_);
 						if (req["times_relative_to"] != "now") {
 							epoch = 0;
 						}
@@ -337,31 +504,17 @@ namespace {
 						} catch(bad_lexical_cast) {}
 
 						std::string name = req["name"], lang = req["language"];
-						foreach (const config &i, campaigns().child_range("campaign"))
+						std::vector<index_entry>::const_iterator entry = index_entries_.begin();
+						foreach (const config &i, index_.child_range("campaign"))
 						{
-							if (!name.empty() && name != i["name"]) continue;
-							std::string tm = i["timestamp"];
-							if (before_flag && (tm.empty() || lexical_cast_default<time_t>(tm, 0) >= before)) continue;
-							if (after_flag && (tm.empty() || lexical_cast_default<time_t>(tm, 0) <= after)) continue;
-							if (!lang.empty()) {
-								bool found = false;
-								foreach (const config &j, i.child_range("translation")) {
-									if (j["language"] == lang) {
-										found = true;
-										break;
-									}
-								}
-								if (!found) continue;
-							}
+							const index_entry& e = *entry ++;
+							if (!name.empty() && name != e.name) continue;
+							if (before_flag && (!e.has_timestamp || e.timestamp >= before)) continue;
+							if (after_flag && (!e.has_timestamp || e.timestamp <= after)) continue;
+							if (!lang.empty() && !e.languages.count(lang)) continue;
 							campaign_list.add_child("campaign", i);
 						}
 
-						foreach (config &j, campaign_list.child_range("campaign")) {
-							j["passphrase"] = t_string();
-							j["upload_ip"] = t_string();
-							j["email"] = t_string();
-						}
-
 						config response;
 						response.add_child("campaigns",campaign_list);
 						std::cerr << " size: " << (network::send_data(response, sock)/1024) << "kb\n";
@@ -372,13 +525,41 @@ namespace {
 						config &campaign = campaigns().find_child("campaign", "name", req["name"]);
 						if (!campaign) {
 							network::send_data(construct_error("Add-on '" + req["name"].str() + "'not found."), sock);
+							continue;
+						}
+						update_hashes(campaign, false);
+						if (!req["hash"].empty() && req["hash"] == campaign["hash"]) {
+							// client has this version already.
+							std::cerr << " unchanged\n";
+							config response;
+							config &unchanged = response.add_child("campaign_unchanged");
+							unchanged["name"] = campaign["name"];
+							unchanged["hash"] = campaign["hash"];
+							network::send_data(response, sock);
+							continue;
+						}
+
+						const size_t size = file_size(campaign["filename"]);
+						std::cerr << " size: " << (size/1024) << "kb" << (req["chunked"].to_bool()? ", chunked\n": "\n");
+						if (req["chunked"].to_bool()) {
+							// client requests chunks by request_campaign_chunk, and can resume from any of them.
+							config response;
+							config &info = response.add_child("campaign_info");
+							info["name"] = campaign["name"];
+							info["size"] = lexical_cast<std::string>(size);
+							info["hash"] = campaign["hash"];
+							info["chunk_size"] = (int)chunk_size_;
+							info["chunk_hashes"] = campaign["chunk_hashes"];
+							network::send_data(response, sock);
 						} else {
-							std::cerr << " size: " << (file_size(campaign["filename"])/1024) << "kb\n";
 							network::send_file(campaign["filename"], sock);
-							int downloads = campaign["downloads"].to_int() + 1;
-							campaign["downloads"] = downloads;
 						}
-
+						int downloads = campaign["downloads"].to_int() + 1;
+						campaign["downloads"] = downloads;
+					}
+					else if (const config &req = data.child("request_campaign_chunk"))
+					{
+						send_chunk(req, sock);
 					}
 					else if (data.child("request_terms"))
 					{
@@ -463,6 +644,8 @@ namespace {
 
 								(*campaign)["size"] = lexical_cast<std::string>(
 										file_size(filename));
+								update_hashes(*campaign, true);
+								index_dirty_ = true;
 								scoped_ostream cfgfile = ostream_file(file_);
 								write(*cfgfile, cfg_);
 								network::send_data(construct_message(message), sock);
@@ -529,6 +712,8 @@ namespace {
 
 							(*campaign)["size"] = lexical_cast<std::string>(
 									file_size(filename));
+							update_hashes(*campaign, true);
+							index_dirty_ = true;
 							scoped_ostream cfgfile = ostream_file(file_);
 							write(*cfgfile, cfg_);
 							network::send_data(construct_message(message), sock);
@@ -566,6 +751,7 @@ namespace {
 								break;
 							}
 						}
+						index_dirty_ = true;
 						scoped_ostream cfgfile = ostream_file(file_);
 						write(*cfgfile, cfg_);
 						network::send_data(construct_message("Add-on deleted."), sock);
@@ -5,11 +5,13 @@
 #include "language.hpp"
 #include "loadscreen.hpp"
 #include "editor.hpp"
+#include "xwmlc/compiler.hpp"
 #include <set>
 #include <sys/stat.h>
 #include "wml_exception.hpp"
 #include "gettext.hpp"
 #include "serialization/parser.hpp"
+#include "serialization/preprocessor.hpp"
 #include "formula_string_utils.hpp"
 
 #include "win32x.h"
@@ -43,192 +45,19 @@ editor::editor() :
 {
 }
 
-// check location:
-//   1. heros_army of artifcal
-//   2. service_heros of artifcal
-//   3. wander_heros of artifcal
-//   4. heros_army of unit
 std::string editor::check_scenario_cfg(const config& scenario_cfg)
 {
-	std::set<std::string> holded_str;
-	std::set<int> holded_number;
-	std::set<std::string> officialed_str;
-	std::map<std::string, std::set<std::string> > officialed_map;
-	std::map<std::string, std::string> mayor_map;
-	int number;
-	std::vector<std::string> str_vec;
-	std::vector<std::string>::const_iterator tmp;
-	std::stringstream str;
-
-	BOOST_FOREACH (const config& side, scenario_cfg.child_range("side")) {
-		const std::string leader = side["leader"];
-		BOOST_FOREACH (const config& art, side.child_range("artifical")) {
-			officialed_str.clear();
-			const std::string cityno = art["cityno"].str();
-			mayor_map[cityno] = art["mayor"].str();
-
-			str_vec = utils::split(art["heros_army"]);
-			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
-				if (holded_str.count(*tmp)) {
-					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is conflicted!";
-					return str.str();
-				}
-				number = lexical_cast_default<int>(*tmp);
-				if (holded_number.count(number)) {
-					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is invalid!";
-					return str.str();
-				}
-				holded_str.insert(*tmp);
-				holded_number.insert(number);
-			}
-			str_vec = utils::split(art["service_heros"]);
-			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
-				if (holded_str.count(*tmp)) {
-					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is conflicted!";
-					return str.str();
-				}
-				number = lexical_cast_default<int>(*tmp);
-				if (holded_number.count(number)) {
-					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is invalid!";
-					return str.str();
-				}
-				holded_str.insert(*tmp);
-				holded_number.insert(number);
-				officialed_str.insert(*tmp);
-			}
-			str_vec = utils::split(art["wander_heros"]);
-			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
-				if (holded_str.count(*tmp)) {
-					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is conflicted!";
-					return str.str();
-				}
-				number = lexical_cast_default<int>(*tmp);
-				if (holded_number.count(number)) {
-					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is invalid!";
-					return str.str();
-				}
-				holded_str.insert(*tmp);
-				holded_number.insert(number);
-			}
-			officialed_map[cityno] = officialed_str;
-		}
-		BOOST_FOREACH (const config& u, side.child_range("unit")) {
-			const std::string cityno = u["cityno"].str();
-			std::map<std::string, std::set<std::string> >::iterator find_it = officialed_map.find(cityno);
-			if (cityno != "0" && find_it == officialed_map.end()) {
-				str << "." << scenario_cfg["id"].str() << ", heros_army=" << u["heros_army"].str() << " uses undefined cityno: " << cityno << "";
-				return str.str();
-			}
-			str_vec = utils::split(u["heros_army"]);
-			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
-				if (holded_str.count(*tmp)) {
-					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is conflicted!";
-					return str.str();
-				}
-				number = lexical_cast_default<int>(*tmp);
-				if (holded_number.count(number)) {
-					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is invalid!";
-					return str.str();
-				}
-				holded_str.insert(*tmp);
-				holded_number.insert(number);
-				if (find_it != officialed_map.end()) {
-					find_it->second.insert(*tmp);
-				}
-			}
-		}
-		for (std::map<std::string, std::set<std::string> >::const_iterator it = officialed_map.begin(); it != officialed_map.end(); ++ it) {
-			std::map<std::string, std::string>::const_iterator mayor_it = mayor_map.find(it->first);
-			if (mayor_it->second.empty()) {
-				continue;
-			}
-			if (mayor_it->second == leader) {
-				str << "." << scenario_cfg["id"].str() << ", in cityno=" << it->first << " mayor(" << mayor_it->second << ") cannot be leader!";
-				return str.str();
-			}
-			if (it->second.find(mayor_it->second) == it->second.end()) {
-				str << "." << scenario_cfg["id"].str() << ", in ciytno=" << it->first << " mayor(" << mayor_it->second << ") must be in offical hero!";
-				return str.str();
-			}
-		}
-	}
-	return "";
+	return tcompiler::check_scenario_cfg(scenario_cfg);
 }
 
-// check location:
-//   1. heros_army of artifcal
-//   2. service_heros of artifcal
-//   3. wander_heros of artifcal
 std::string editor::check_mplayer_bin(const config& mplayer_cfg)
 {
-	std::set<std::string> holded_str;
-	std::set<int> holded_number;
-	int number;
-	std::vector<std::string> str_vec;
-	std::vector<std::string>::const_iterator tmp;
-	std::stringstream str;
-
-	BOOST_FOREACH (const config& faction, mplayer_cfg.child_range("faction")) {
-		BOOST_FOREACH (const config& art, faction.child_range("artifical")) {
-			str_vec = utils::split(art["heros_army"]);
-			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
-				if (holded_str.count(*tmp)) {
-					str << "hero number: " << *tmp << " is conflicted!";
-					return str.str();
-				}
-				number = lexical_cast_default<int>(*tmp);
-				if (holded_number.count(number)) {
-					str << "hero number: " << *tmp << " is invalid!";
-					return str.str();
-				}
-				holded_str.insert(*tmp);
-				holded_number.insert(number);
-			}
-			str_vec = utils::split(art["service_heros"]);
-			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
-				if (holded_str.count(*tmp)) {
-					str << "hero number: " << *tmp << " is conflicted!";
-					return str.str();
-				}
-				number = lexical_cast_default<int>(*tmp);
-				if (holded_number.count(number)) {
-					str << "hero number: " << *tmp << " is invalid!";
-					return str.str();
-				}
-				holded_str.insert(*tmp);
-				holded_number.insert(number);
-			}
-			str_vec = utils::split(art["wander_heros"]);
-			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
-				if (holded_str.count(*tmp)) {
-					str << "hero number: " << *tmp << " is conflicted!";
-					return str.str();
-				}
-				number = lexical_cast_default<int>(*tmp);
-				if (holded_number.count(number)) {
-					str << "hero number: " << *tmp << " is invalid!";
-					return str.str();
-				}
-				holded_str.insert(*tmp);
-				holded_number.insert(number);
-			}
-		}
-	}
-	return "";
+	return tcompiler::check_mplayer_bin(mplayer_cfg);
 }
 
-// check location:
 std::string editor::check_data_bin(const config& data_cfg)
 {
-	std::stringstream str;
-
-	BOOST_FOREACH (const config& campaign, data_cfg.child_range("campaign")) {
-		if (!campaign.has_attribute("id")) {
-			str << "Compaign hasn't id!";
-			return str.str();
-		}
-	}
-	return "";
+	return tcompiler::check_data_bin(data_cfg);
 }
 
 bool editor::load_game_cfg(const editor::BIN_TYPE type, const char* name, bool write_file, uint32_t nfiles, uint32_t sum_size, uint32_t modified)
@@ -237,6 +66,11 @@ bool editor::load_game_cfg(const editor::BIN_TYPE type, const char* name, bool w
 
 	game_config::config_cache_transaction main_transaction;
 
+	// files of that nothing changed since last generation aren't preprocessed again.
+	if (preprocessor_cache().empty()) {
+		set_preprocessor_cache(get_cache_dir() + "/preprocessor");
+	}
+
 	try {
 		tmpcfg.clear();
 		game_config_.clear();
@@ -349,32 +183,6 @@ void editor::reload_extendable_cfg()
 	t_string::reset_translations();
 }
 
-std::vector<std::string> generate_tb_short_paths(const std::string& id, const config& cfg)
-{
-	std::stringstream ss;
-	std::vector<std::string> short_paths;
-
-	ss.str("");
-	ss << "data/core/terrain-graphics-" << id;
-	short_paths.push_back(ss.str());
-
-	binary_paths_manager paths_manager(cfg);
-	const std::vector<std::string>& paths = paths_manager.paths();
-	if (paths.empty()) {
-		ss.str("");
-		ss << "data/core/images/terrain-" << id;
-		short_paths.push_back(ss.str());
-	} else {
-		for (std::vector<std::string>::const_iterator it = paths.begin(); it != paths.end(); ++ it) {
-			ss.str("");
-			ss << *it << "/images/terrain-" << id;
-			short_paths.push_back(ss.str());
-		}
-	}
-
-	return short_paths;
-}
-
 // @path: c:\kingdom-res\data
 void editor::get_wml2bin_desc_from_wml(std::string& path)
 {
@@ -418,7 +226,7 @@ void editor::get_wml2bin_desc_from_wml(std::string& path)
 		int filter = SKIP_MEDIA_DIR;
 		if (type == editor::TB_DAT) {
 			const std::string& id = tbs[tb_index]["id"].str();
-			short_paths = generate_tb_short_paths(id, tbs[tb_index]);
+			short_paths = tcompiler::tb_short_paths(id, tbs[tb_index]);
 			filter = 0;
 
 			data_tree_checksum(short_paths, dir_checksum, filter);
@@ -72,6 +72,7 @@
 #include "playcampaign.hpp"
 #include "preferences_display.hpp"
 #include "replay.hpp"
+#include "keyframe.hpp"
 #include "savegame.hpp"
 #include "scripting/lua.hpp"
 #include "sound.hpp"
@@ -81,6 +82,8 @@
 #include "card.hpp"
 #include "formula_string_utils.hpp"
 #include "play_controller.hpp"
+#include "simulate.hpp"
+#include "task_graph.hpp"
 
 #include "editor/editor_main.hpp"
 
@@ -95,6 +98,7 @@
 #include <string>
 
 
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 
 // Minimum stack cookie to prevent stack overflow on AmigaOS4
@@ -235,6 +239,8 @@ public:
 	void start_siege_game(bool subcontinent);
 	void start_scenario_game(bool subcontinent);
 	void start_layout(const std::string& map_data);
+	bool simulate();
+	bool verify_replay();
 
 	bool session_xmited() const { return session_xmited_; }
 	void set_session_xmited(bool val) { session_xmited_ = val; }
@@ -243,7 +249,6 @@ private:
 	void load_config2(const config& cfg);
 	void load_game_cfg(const bool force);
 	void load_campaign_cfg();
-	void set_unit_data(config& gc);
 
 	void mark_completed_campaigns(std::vector<config>& campaigns);
 
@@ -532,6 +537,14 @@ void game_instance::level_to_gamestate(bool fog, bool shroud, const std::string&
 	if (!map_data.empty()) {
 		scenario["map_data"] = map_data;
 	}
+	if (simulate::enabled) {
+		// all sides are controlled by ai.
+		BOOST_FOREACH (config& side, scenario.child_range("side")) {
+			if (side["controller"] == "human") {
+				side["controller"] = "ai";
+			}
+		}
+	}
 	if (layout_mode) {
 		// switch controller: human and ai
 		int sides = scenario.child_count("side");
@@ -950,6 +963,107 @@ void game_instance::start_layout(const std::string& map_data)
 	launch_game(false);
 }
 
+bool game_instance::simulate()
+{
+	const config& campaign = game_config_.find_child("campaign", "id", simulate::campaign);
+	if (!campaign) {
+		std::cerr << "simulate, cannot find campaign: " << simulate::campaign << "\n";
+		return false;
+	}
+
+	state_ = game_state();
+	state_.classification().campaign_type = "scenario";
+	state_.classification().campaign = campaign["id"].str();
+	state_.classification().abbrev = campaign["abbrev"].str();
+	state_.classification().scenario = simulate::scenario.empty()? campaign["first_scenario"].str(): simulate::scenario;
+	state_.classification().mode = campaign["mode"].str();
+	state_.classification().campaign_define = campaign["define"].str();
+
+	const config& scenario = game_config_.find_child("scenario", "id", state_.classification().scenario);
+	if (!scenario) {
+		std::cerr << "simulate, cannot find scenario: " << state_.classification().scenario << "\n";
+		return false;
+	}
+
+	config player;
+	player["stratum"] = hero_stratum_leader;
+	BOOST_FOREACH (const config& side, scenario.child_range("side")) {
+		if (side["controller"] == "human") {
+			player["leader"] = side["leader"];
+			player["hero"] = side["leader"];
+			break;
+		}
+	}
+	state_.get_variables().add_child("player", player);
+
+	checked_card_.clear();
+	cache_.clear_defines();
+	cache_.add_define("EASY");
+
+	tent::human_leader_number = HEROS_INVALID_NUMBER;
+	tent::turns = simulate::turns;
+	level_to_gamestate(false, false);
+
+	// no rendering, no delay, no sound.
+	game_config::no_delay = true;
+	sound::close_sound();
+	update_locker lock_display(video_);
+
+	simulate::reset();
+	launch_game(false);
+	simulate::report();
+	return true;
+}
+
+bool game_instance::verify_replay()
+{
+	savegame::loadgame load(disp(), heros(), game_config(), state_);
+	try {
+		load.load_game(simulate::replay, true, false, heros_, &heros_start_);
+		group.reset();
+		cache_.clear_defines();
+		load.set_gamestate();
+
+	} catch (load_game_cancelled_exception&) {
+		std::cerr << "replay, cannot load: " << simulate::replay << "\n";
+		return false;
+	} catch (config::error& e) {
+		std::cerr << "replay, " << simulate::replay << " is corrupt: " << e.message << "\n";
+		return false;
+	} catch (io_exception& e) {
+		// derives from game::error, it must be caught before.
+		std::cerr << "replay, I/O error while reading " << simulate::replay << ": " << e.message << "\n";
+		return false;
+	} catch (game::error& e) {
+		std::cerr << "replay, " << simulate::replay << " is corrupt: " << e.message << "\n";
+		return false;
+	}
+	recorder = replay(state_.replay_data);
+	recorder.start_replay();
+	recorder.set_skip(false);
+	if (state_.snapshot["runtime"].to_bool()) {
+		statistics::clear_current_scenario();
+	}
+
+	// no rendering, no delay, no sound.
+	game_config::no_delay = true;
+	sound::close_sound();
+	update_locker lock_display(video_);
+
+	simulate::reset();
+	try {
+		::play_replay(disp(), state_, game_config(), heros_, heros_start_, cards_, video_);
+	} catch (replay::error& e) {
+		simulate::replay_error(e.message);
+	} catch (twml_exception& e) {
+		simulate::replay_error(e.dev_message);
+	} catch (game::error& e) {
+		simulate::replay_error(e.message);
+	}
+	simulate::report();
+	return simulate::replay_ok();
+}
+
 void game_instance::reload_changed_game_config()
 {
 	//force a reload of configuration information
@@ -1170,13 +1284,15 @@ void game_instance::show_preferences()
 	preferences::show_preferences_dialog(disp(), true);
 }
 
-void game_instance::set_unit_data(config& gc)
+static void fill_unit_tables(const config& cfg)
 {
-	loadscreen::start_stage("load unit types");
-	unit_types.set_config(gc);
+	unit_types.fill_tables(cfg.child("units"));
 }
 
-#define BASENAME_DATA		"data.bin"
+static void fill_unit_types(const config& cfg)
+{
+	unit_types.fill_types(cfg.child("units"));
+}
 
 typedef enum {
 	ppmt_data		= 0,
@@ -1238,20 +1354,31 @@ void game_instance::load_game_cfg(const bool force)
 		ppmap_type_t ppmt = decide_preprocmap_type(cache_.get_preproc_map());
 		config tmpcfg;
 		if (ppmt == ppmt_data) {
-			wml_config_from_file(game_config::path + "/xwml/" + BASENAME_DATA, game_config_);
+			loadscreen::start_stage("load unit types");
+			// animations stage changes what prewarm reads.
+			unit_types.stop_prewarm();
+
+			// stages read different children of data.bin, they run at the same time.
+			ttask_graph graph;
+			const int data = graph.add("data.bin", boost::bind(&base_instance::read_data_bin, boost::ref(game_config_)));
+			const int cards = graph.add("cards", boost::bind(&card_map::map_from_cfg, &cards_, boost::cref(game_config_)));
+			graph.after(cards, data);
+			const int tables = graph.add("unit tables", boost::bind(&fill_unit_tables, boost::cref(game_config_)));
+			graph.after(tables, data);
+			const int anims = graph.add("animations", boost::bind(&base_instance::fill_unit_anims, boost::cref(game_config_)));
+			graph.after(anims, data);
+			const int types = graph.add("unit types", boost::bind(&fill_unit_types, boost::cref(game_config_)));
+			graph.after(types, tables);
+			graph.after(types, anims);
+			const int terrains = graph.add("terrain types", boost::bind(&base_instance::fill_terrain_types, boost::cref(game_config_)));
+			graph.after(terrains, data);
+			std::cerr << "\nload game config, ";
+			graph.run(load_threads_, &std::cerr);
+
 			// once only duration one game running.
-			cards_.map_from_cfg(game_config_);
 			game_config_.clear_children("card");
 			game_config_.clear_children("card_anim");
-
-			set_unit_data(game_config_.child("units"));
 			game_config_.clear_children("units");
-		
-
-			const config::const_child_itors& terrains = game_config_.child_range("terrain_type");
-			BOOST_FOREACH (const config &t, terrains) {
-				gamemap::terrain_types.add_child("terrain_type", t);
-			}
 			game_config_.clear_children("terrain_type");
 
 			// save this to game_config_core_
@@ -1369,7 +1496,7 @@ void game_instance::launch_game(bool is_load_game)
 		const LEVEL_RESULT result = play_game(disp(), state_,game_config(), heros_, heros_start_, cards_);
 		// don't show The End for multiplayer scenario
 		// change this if MP campaigns are implemented
-		if (result == VICTORY && (state_.classification().campaign_type.empty() || state_.classification().campaign_type != "multiplayer")) {
+		if (result == VICTORY && !simulate::enabled && (state_.classification().campaign_type.empty() || state_.classification().campaign_type != "multiplayer")) {
 			preferences::add_completed_campaign(state_.classification().campaign);
 			// the_end(disp(), state_.classification().end_text, state_.classification().end_text_duration);
 			about::show_about(disp(),state_.classification().campaign);
@@ -1422,6 +1549,13 @@ editor::EXIT_STATUS game_instance::start_editor(const std::string& map_data)
 
 game_instance::~game_instance()
 {
+	// don't lose autosave that is being written, and tell if it is lost.
+	savegame::async_writer().wait();
+	try {
+		savegame::show_async_error(video_);
+	} catch (...) {
+		// dialog can't be shown while shutting down, it is logged by writer.
+	}
 	pathfind::release_pq();
 }
 
@@ -1486,7 +1620,16 @@ public:
  */
 static int do_gameloop(int argc, char** argv)
 {
-	srand((unsigned int)time(NULL));
+	if (!simulate::parse_cmdline(argc, argv)) {
+		return 1;
+	}
+	if (simulate::enabled) {
+		// headless, don't create window.
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+	}
+
+	// simulation must be reproducible, use fixed seed.
+	srand(simulate::enabled? 0: (unsigned int)time(NULL));
 
 	// setup userdata directory
 #if defined(__APPLE__) || defined(ANDROID)
@@ -1495,6 +1638,11 @@ static int do_gameloop(int argc, char** argv)
 	set_preferences_dir("kingdom");
 #endif
 
+	if (simulate::chat_messages) {
+		chat_logs::tstore::benchmark(std::cout, get_user_data_dir() + "/chat-benchmark", simulate::chat_messages);
+		return 0;
+	}
+
 	// modify some game_config variable
 	game_config::init("kingdom", "War of Kingdom", "#war-of-kingdom", false, true);
 	game_config::wesnoth_program_dir = directory_name(argv[0]);
@@ -1513,7 +1661,9 @@ static int do_gameloop(int argc, char** argv)
 	// server isn't running, disable transit.
 	// lobby->transit.set_host("localhost", 15000);
 
-	lobby->join();
+	if (!simulate::enabled) {
+		lobby->join();
+	}
 	lobby->set_nick2(group.leader().name());
 
 	bool res;
@@ -1570,6 +1720,17 @@ static int do_gameloop(int argc, char** argv)
 	loadscreen::start_stage("titlescreen");
 
 	game_config::checksum = calculate_res_checksum(game.disp(), game.game_config());
+
+	if (!simulate::round_trip.empty()) {
+		return savegame::round_trip(std::cout, simulate::round_trip)? 0: 1;
+	}
+
+	if (simulate::enabled) {
+		if (!simulate::replay.empty()) {
+			return game.verify_replay()? 0: 1;
+		}
+		return game.simulate()? 0: 1;
+	}
 	
 	try {
 		for (;;) {
@@ -1598,6 +1759,7 @@ static int do_gameloop(int argc, char** argv)
 			}
 
 			recorder.clear();
+			keyframes.clear();
 
 			loadscreen_manager.reset();
 
@@ -49,6 +49,7 @@
 #include "formula_string_utils.hpp"
 #include "artifical.hpp"
 #include "side_filter.hpp"
+#include "simulate.hpp"
 
 #include <boost/foreach.hpp>
 #include <boost/scoped_array.hpp>
@@ -1355,6 +1356,7 @@ void change_terrain(const map_location &loc, const t_translation::t_terrain &t,
 
 	game_map->set_terrain(loc, new_t);
 	screen_needs_rebuild = true;
+	resources::controller->route_cache().invalidate(loc);
 
 	BOOST_FOREACH (const t_translation::t_terrain &ut, game_map->underlying_union_terrain(loc)) {
 		preferences::encountered_terrains().insert(ut);
@@ -3081,6 +3083,7 @@ namespace game_events {
 
 	bool pump()
 	{
+		simulate::tphase phase(simulate::EVENTS);
 		assert(manager_running);
 		if(!events_init())
 			return false;
@@ -589,6 +589,16 @@ void set_autosavemax(int value)
 	preferences::set("auto_save_max", value);
 }
 
+int keyframe_interval()
+{
+	return lexical_cast_default<int>(preferences::get("keyframe_interval"), 5);
+}
+
+void set_keyframe_interval(int value)
+{
+	preferences::set("keyframe_interval", value);
+}
+
 // dependent on inapp-purchase
 
 std::pair<std::string, std::string> inapp_item_equation(int id)
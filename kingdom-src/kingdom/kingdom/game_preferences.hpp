@@ -150,6 +150,10 @@ namespace preferences {
 
 	const int INFINITE_AUTO_SAVES = 61;
 
+	// record a replay keyframe every this turns, 0: disable.
+	void set_keyframe_interval(int value);
+	int keyframe_interval();
+
 	// dependent on inapp-purchase
 	void set_inapp_purchased(int id, bool value);
 	bool inapp_purchased(int id);
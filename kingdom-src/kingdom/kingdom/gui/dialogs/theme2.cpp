@@ -100,6 +100,8 @@ void tgame_theme::app_pre_show()
 	hotkey::insert_hotkey(HOTKEY_ENDTURN, "endturn", _("End Turn"));
 	hotkey::insert_hotkey(HOTKEY_PLAY_REPLAY, "playreplay", _("Play"));
 	hotkey::insert_hotkey(HOTKEY_STOP_REPLAY, "stopreplay", _("Play"));
+	hotkey::insert_hotkey(HOTKEY_REPLAY_PREV_TURN, "replay-prev-turn", _("Prev Turn"));
+	hotkey::insert_hotkey(HOTKEY_REPLAY_NEXT_TURN, "replay-next-turn", _("Next Turn"));
 
 	// rpg
 	tbutton* widget = find_widget<tbutton>(window_, "rpg", true, true);
@@ -145,6 +147,15 @@ void tgame_theme::app_pre_show()
 		widget->set_surface(image::get_image("buttons/ctrl-pause.png"), widget->fix_width(), widget->fix_height());
 		click_generic_handler(*widget, null_str);
 	}
+	// seek replay
+	widget = find_widget<tbutton>(window_, "replay-prev-turn", false, false);
+	if (widget) {
+		click_generic_handler(*widget, null_str);
+	}
+	widget = find_widget<tbutton>(window_, "replay-next-turn", false, false);
+	if (widget) {
+		click_generic_handler(*widget, null_str);
+	}
 
 	widget = find_widget<tbutton>(window_, "tactic0", true, true);
 	click_generic_handler(*widget, null_str);
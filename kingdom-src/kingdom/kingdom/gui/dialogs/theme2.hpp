@@ -56,6 +56,8 @@ public:
 		HOTKEY_SWITCH_LIST, HOTKEY_ENDTURN,
 		HOTKEY_PLAY_REPLAY,
 		HOTKEY_STOP_REPLAY,
+		HOTKEY_REPLAY_PREV_TURN,
+		HOTKEY_REPLAY_NEXT_TURN,
 		HOTKEY_BUILD_M, HOTKEY_BUILD, HOTKEY_GUARD, HOTKEY_ABOLISH, HOTKEY_EXTRACT, HOTKEY_ADVANCE, HOTKEY_DEMOLISH,
 		HOTKEY_UNIT_DETAIL,
 		HOTKEY_PLAY_CARD,
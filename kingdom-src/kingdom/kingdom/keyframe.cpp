@@ -0,0 +1,161 @@
+#include "global.hpp"
+#include "keyframe.hpp"
+
+#include "game_preferences.hpp"
+#include "gamestatus.hpp"
+#include "hero.hpp"
+#include "unit.hpp"
+#include "serialization/parser.hpp"
+#include "rose_config.hpp"
+
+tkeyframes keyframes;
+
+tkeyframes::tkeyframes()
+	: frames_()
+{}
+
+bool tkeyframes::should_record(int turn) const
+{
+	const int interval = preferences::keyframe_interval();
+	if (interval <= 0 || turn <= 1) {
+		// replay can always restart from the first turn.
+		return false;
+	}
+	if ((turn - 1) % interval) {
+		return false;
+	}
+	return frames_.find(turn) == frames_.end();
+}
+
+void tkeyframes::record(int turn, int command, const config& cfg, const hero_map& heros)
+{
+	tkeyframe& frame = frames_[turn];
+	frame.turn = turn;
+	frame.command = command;
+
+	std::stringstream strstr;
+	::write(strstr, cfg);
+	frame.scenario = strstr.str();
+
+	const unit_segment2* top = (const unit_segment2*)game_config::savegame_cache;
+	frame.sides.assign(game_config::savegame_cache, game_config::savegame_cache + top->size_);
+
+	frame.heros.resize(heros.file_size());
+	heros.map_to_mem(&frame.heros[0]);
+
+	frame.members.resize(runtime_groups::size());
+	if (!frame.members.empty()) {
+		runtime_groups::to_mem(&frame.members[0]);
+	}
+}
+
+const tkeyframes::tkeyframe* tkeyframes::nearest(int turn) const
+{
+	std::map<int, tkeyframe>::const_iterator it = frames_.upper_bound(turn);
+	if (it == frames_.begin()) {
+		return NULL;
+	}
+	return &(-- it)->second;
+}
+
+void tkeyframes::restore(const tkeyframe& frame, config& snapshot, hero_map& heros, game_state& state) const
+{
+	config cfg;
+	::read(cfg, frame.scenario);
+
+	snapshot = cfg.child("snapshot");
+	state.set_variables(cfg.child("variables"));
+	state.rng().seed_random(snapshot["random_seed"].to_int(42), snapshot["random_calls"].to_int());
+
+	memcpy(game_config::savegame_cache, &frame.sides[0], frame.sides.size());
+
+	heros.map_from_mem(&frame.heros[0], frame.heros.size());
+	runtime_groups::from_mem(heros, frame.members.empty()? NULL: const_cast<uint8_t*>(&frame.members[0]), frame.members.size());
+}
+
+size_t tkeyframes::mem_size() const
+{
+	if (frames_.empty()) {
+		return 0;
+	}
+	size_t size = sizeof(uint32_t);
+	for (std::map<int, tkeyframe>::const_iterator it = frames_.begin(); it != frames_.end(); ++ it) {
+		const tkeyframe& frame = it->second;
+		size += 6 * sizeof(uint32_t) + frame.scenario.size() + frame.sides.size() + frame.heros.size() + frame.members.size();
+	}
+	return size;
+}
+
+void tkeyframes::to_mem(uint8_t* mem) const
+{
+	uint32_t u32 = frames_.size();
+	memcpy(mem, &u32, sizeof(u32));
+	mem += sizeof(u32);
+
+	for (std::map<int, tkeyframe>::const_iterator it = frames_.begin(); it != frames_.end(); ++ it) {
+		const tkeyframe& frame = it->second;
+		uint32_t fields[6];
+		fields[0] = frame.turn;
+		fields[1] = frame.command;
+		fields[2] = frame.scenario.size();
+		fields[3] = frame.sides.size();
+		fields[4] = frame.heros.size();
+		fields[5] = frame.members.size();
+		memcpy(mem, fields, sizeof(fields));
+		mem += sizeof(fields);
+
+		memcpy(mem, frame.scenario.c_str(), fields[2]);
+		mem += fields[2];
+		if (fields[3]) {
+			memcpy(mem, &frame.sides[0], fields[3]);
+			mem += fields[3];
+		}
+		if (fields[4]) {
+			memcpy(mem, &frame.heros[0], fields[4]);
+			mem += fields[4];
+		}
+		if (fields[5]) {
+			memcpy(mem, &frame.members[0], fields[5]);
+			mem += fields[5];
+		}
+	}
+}
+
+void tkeyframes::from_mem(const uint8_t* mem, int len)
+{
+	frames_.clear();
+	if (len < (int)sizeof(uint32_t)) {
+		return;
+	}
+
+	uint32_t count;
+	memcpy(&count, mem, sizeof(count));
+	mem += sizeof(count);
+	len -= sizeof(count);
+
+	for (uint32_t i = 0; i < count; i ++) {
+		uint32_t fields[6];
+		if (len < (int)sizeof(fields)) {
+			break;
+		}
+		memcpy(fields, mem, sizeof(fields));
+		mem += sizeof(fields);
+		len -= sizeof(fields);
+		if (len < (int)(fields[2] + fields[3] + fields[4] + fields[5])) {
+			break;
+		}
+
+		tkeyframe& frame = frames_[fields[0]];
+		frame.turn = fields[0];
+		frame.command = fields[1];
+		frame.scenario.assign((const char*)mem, fields[2]);
+		mem += fields[2];
+		frame.sides.assign(mem, mem + fields[3]);
+		mem += fields[3];
+		frame.heros.assign(mem, mem + fields[4]);
+		mem += fields[4];
+		frame.members.assign(mem, mem + fields[5]);
+		mem += fields[5];
+		len -= fields[2] + fields[3] + fields[4] + fields[5];
+	}
+}
@@ -0,0 +1,81 @@
+#ifndef KEYFRAME_HPP_INCLUDED
+#define KEYFRAME_HPP_INCLUDED
+
+#include "config.hpp"
+#include "SDL_types.h"
+
+#include <map>
+#include <vector>
+
+class hero_map;
+class game_state;
+
+/**
+ * Binary snapshots of full game state, recorded at begin of every
+ * preferences::keyframe_interval() turns.
+ *
+ * They are stored alongside the command pool(recorder) in the savegame. To seek
+ * to a turn, replay restores the nearest keyframe that isn't later than that
+ * turn, and replays only commands after it.
+ */
+class tkeyframes
+{
+public:
+	struct tkeyframe {
+		tkeyframe()
+			: turn(0)
+			, command(0)
+			, scenario()
+			, sides()
+			, heros()
+			, members()
+		{}
+
+		int turn;
+		// index of the first command in recorder after this keyframe.
+		int command;
+		// WML text: [snapshot] and [variables]
+		std::string scenario;
+		// side data, same as savegame_cache.
+		std::vector<uint8_t> sides;
+		// runtime hero data
+		std::vector<uint8_t> heros;
+		// runtime-member data
+		std::vector<uint8_t> members;
+	};
+
+	tkeyframes();
+
+	/** whether a keyframe should be recorded at begin of turn. */
+	bool should_record(int turn) const;
+
+	/**
+	 * record a keyframe.
+	 * @cfg: [snapshot] and [variables], side data must have be written into savegame_cache.
+	 */
+	void record(int turn, int command, const config& cfg, const hero_map& heros);
+
+	/** the last keyframe that isn't later than turn. NULL if there is none. */
+	const tkeyframe* nearest(int turn) const;
+
+	/**
+	 * restore keyframe to snapshot, savegame_cache, heros, runtime-member and game_state.
+	 * after it, snapshot can be used as level to construct controller.
+	 */
+	void restore(const tkeyframe& frame, config& snapshot, hero_map& heros, game_state& state) const;
+
+	void clear() { frames_.clear(); }
+	bool empty() const { return frames_.empty(); }
+
+	// savegame
+	size_t mem_size() const;
+	void to_mem(uint8_t* mem) const;
+	void from_mem(const uint8_t* mem, int len);
+
+private:
+	std::map<int, tkeyframe> frames_;
+};
+
+extern tkeyframes keyframes;
+
+#endif
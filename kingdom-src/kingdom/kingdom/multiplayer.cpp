@@ -33,6 +33,7 @@
 #include "hash.hpp"
 #include "multiplayer.hpp"
 #include "multiplayer_error_codes.hpp"
+#include "keyframe.hpp"
 #include "playmp_controller.hpp"
 #include "playcampaign.hpp"
 #include "formula_string_utils.hpp"
@@ -2907,6 +2908,7 @@ static void enter_wait_mode(display& disp, const config& game_config, hero_map&
 		play_game(disp, state, game_config, heros, heros_start, cards, IO_CLIENT,
 			preferences::skip_mp_replay() && observe);
 		recorder.clear();
+		keyframes.clear();
 
 		break;
 	case mp::QUIT:
@@ -2952,6 +2954,7 @@ static void enter_connect_mode(display& disp, const config& game_config, hero_ma
 	case mp::PLAY:
 		play_game(disp, state, game_config, heros, heros_start, cards, IO_SERVER);
 		recorder.clear();
+		keyframes.clear();
 
 		break;
 	case mp::CREATE:
@@ -20,6 +20,7 @@
 #include "map.hpp"
 #include "pathfind/pathfind.hpp"
 #include "wml_exception.hpp"
+#include "simulate.hpp"
 
 #include <queue>
 #include <map>
@@ -171,6 +172,8 @@ void release_pq()
 pathfind::plain_route pathfind::a_star_search(const map_location& src, const map_location& dst,
 		  	    double stop_at, const pathfind::cost_calculator *calc, const size_t width,
                             const size_t height, const std::set<map_location>* teleports) {
+	simulate::tphase phase(simulate::PATHFIND);
+
 	//----------------- PRE_CONDITIONS ------------------
 	VALIDATE(src.valid(width, height), "a_star_search, src.valid(width, height)!");
 	VALIDATE(dst.valid(width, height), "a_star_search, dst.valid(width, height)!");
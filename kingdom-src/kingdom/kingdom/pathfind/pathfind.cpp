@@ -33,6 +33,7 @@
 #include "unit_map.hpp"
 #include "wml_exception.hpp"
 #include "play_controller.hpp"
+#include "simulate.hpp"
 
 #include <boost/foreach.hpp>
 #include <iostream>
@@ -217,6 +218,8 @@ static void find_routes(const gamemap& map, const unit_map& units,
 		const team &viewing_team,
 		bool see_all, bool ignore_units)
 {
+	simulate::tphase phase(simulate::PATHFIND);
+
 	const team& current_team = teams[u.side() - 1];
 	std::set<map_location> teleports;
 	if (allow_teleport) {
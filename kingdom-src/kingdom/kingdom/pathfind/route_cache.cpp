@@ -0,0 +1,209 @@
+#include "global.hpp"
+#include "pathfind/route_cache.hpp"
+#include "pathfind/pathfind.hpp"
+
+#include "artifical.hpp"
+#include "map.hpp"
+#include "team.hpp"
+#include "unit_map.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace pathfind {
+
+bool troute_cache::tkey::operator<(const tkey& that) const
+{
+	if (cityno != that.cityno) {
+		return cityno < that.cityno;
+	}
+	if (dst != that.dst) {
+		return dst < that.dst;
+	}
+	return movetype < that.movetype;
+}
+
+troute_cache::troute_cache()
+	: routes_()
+	, hexes_()
+	, hits_(0)
+	, misses_(0)
+	, repairs_(0)
+{}
+
+bool troute_cache::route(const unit& u, const map_location& from, const map_location& to, double stop_at,
+	const unit_map& units, const std::vector<team>& teams, const gamemap& map, std::vector<map_location>& steps)
+{
+	steps.clear();
+
+	const artifical* city = units.city_from_cityno(u.cityno());
+	if (!city || city->side() == team::empty_side) {
+		misses_ ++;
+		return false;
+	}
+	const map_location& city_loc = city->get_location();
+	const tkey key(city->cityno(), to, u.type()->movementType_id());
+
+	const std::vector<map_location>* r = find(key);
+	if (!r) {
+		// only when commoner is at its city, route is same as other commoners.
+		if (from != city_loc) {
+			misses_ ++;
+			return false;
+		}
+		// ignore troops, so that it can be shared.
+		const shortest_path_calculator calc(u, teams[city->side() - 1], units, teams, map, true, true);
+		std::set<map_location> allowed_teleports;
+		plain_route shared = a_star_search(city_loc, to, 10000.0, &calc, map.w(), map.h(), &allowed_teleports);
+		if (shared.steps.empty()) {
+			misses_ ++;
+			return false;
+		}
+		insert(key, shared.steps);
+		r = find(key);
+		misses_ ++;
+	} else {
+		hits_ ++;
+	}
+
+	std::vector<map_location>::const_iterator it = std::find(r->begin(), r->end(), from);
+	if (it == r->end()) {
+		// commoner was pushed out of this route.
+		return false;
+	}
+	std::copy(it, r->end(), std::back_inserter(steps));
+
+	if (!repair(u, steps, stop_at, units, teams, map)) {
+		steps.clear();
+		return false;
+	}
+	return true;
+}
+
+bool troute_cache::repair(const unit& u, std::vector<map_location>& steps, double stop_at,
+	const unit_map& units, const std::vector<team>& teams, const gamemap& map)
+{
+	const team& current_team = teams[u.side() - 1];
+	// same calculator as A*-search of move_unit, units aren't ignored.
+	const shortest_path_calculator calc(u, current_team, units, teams, map, false, true);
+
+	// only grids that can arrive this turn are necessary to check.
+	int blocked = -1;
+	double so_far = 0;
+	for (int i = 1; i < (int)steps.size() && so_far < u.movement_left(); i ++) {
+		const double cost = calc.cost(steps[i], so_far);
+		if (cost >= calc.getUnitHoldValue()) {
+			blocked = i;
+			break;
+		}
+		so_far += cost;
+	}
+	if (blocked == -1) {
+		return true;
+	}
+
+	// search the first free grid behind blocked grids.
+	int rejoin = -1;
+	for (int i = blocked + 1; i < (int)steps.size(); i ++) {
+		if (calc.cost(steps[i], 0) < calc.getUnitHoldValue()) {
+			rejoin = i;
+			break;
+		}
+	}
+	if (rejoin == -1) {
+		return false;
+	}
+
+	std::set<map_location> allowed_teleports;
+	plain_route detour = a_star_search(steps.front(), steps[rejoin], stop_at, &calc, map.w(), map.h(), &allowed_teleports);
+	if (detour.steps.empty()) {
+		return false;
+	}
+	std::copy(steps.begin() + rejoin + 1, steps.end(), std::back_inserter(detour.steps));
+	steps.swap(detour.steps);
+
+	repairs_ ++;
+	return true;
+}
+
+const std::vector<map_location>* troute_cache::find(const tkey& key)
+{
+	std::map<tkey, std::vector<map_location> >::const_iterator it = routes_.find(key);
+	if (it == routes_.end()) {
+		return NULL;
+	}
+	return &it->second;
+}
+
+void troute_cache::insert(const tkey& key, const std::vector<map_location>& steps)
+{
+	erase(key);
+	routes_.insert(std::make_pair(key, steps));
+	for (std::vector<map_location>::const_iterator it = steps.begin(); it != steps.end(); ++ it) {
+		hexes_.insert(std::make_pair(*it, key));
+	}
+}
+
+void troute_cache::erase(const tkey& key)
+{
+	std::map<tkey, std::vector<map_location> >::iterator find = routes_.find(key);
+	if (find == routes_.end()) {
+		return;
+	}
+	const std::vector<map_location>& steps = find->second;
+	for (std::vector<map_location>::const_iterator it = steps.begin(); it != steps.end(); ++ it) {
+		std::pair<std::multimap<map_location, tkey>::iterator, std::multimap<map_location, tkey>::iterator> range = hexes_.equal_range(*it);
+		for (std::multimap<map_location, tkey>::iterator it2 = range.first; it2 != range.second; ) {
+			const tkey& that = it2->second;
+			if (!(that < key) && !(key < that)) {
+				hexes_.erase(it2 ++);
+			} else {
+				++ it2;
+			}
+		}
+	}
+	routes_.erase(find);
+}
+
+void troute_cache::invalidate(const map_location& loc)
+{
+	std::pair<std::multimap<map_location, tkey>::iterator, std::multimap<map_location, tkey>::iterator> range = hexes_.equal_range(loc);
+	if (range.first == range.second) {
+		return;
+	}
+	std::vector<tkey> keys;
+	for (std::multimap<map_location, tkey>::const_iterator it = range.first; it != range.second; ++ it) {
+		keys.push_back(it->second);
+	}
+	for (std::vector<tkey>::const_iterator it = keys.begin(); it != keys.end(); ++ it) {
+		erase(*it);
+	}
+}
+
+void troute_cache::invalidate_city(int cityno)
+{
+	std::vector<tkey> keys;
+	for (std::map<tkey, std::vector<map_location> >::const_iterator it = routes_.begin(); it != routes_.end(); ++ it) {
+		if (it->first.cityno == cityno) {
+			keys.push_back(it->first);
+		}
+	}
+	for (std::vector<tkey>::const_iterator it = keys.begin(); it != keys.end(); ++ it) {
+		erase(*it);
+	}
+}
+
+void troute_cache::clear()
+{
+	routes_.clear();
+	hexes_.clear();
+	hits_ = misses_ = repairs_ = 0;
+}
+
+int troute_cache::hit_rate() const
+{
+	int total = hits_ + misses_;
+	return total? hits_ * 100 / total: 0;
+}
+
+}
@@ -0,0 +1,89 @@
+#ifndef PATHFIND_ROUTE_CACHE_H_INCLUDED
+#define PATHFIND_ROUTE_CACHE_H_INCLUDED
+
+#include "map_location.hpp"
+
+#include <map>
+#include <vector>
+#include <string>
+
+class gamemap;
+class team;
+class unit;
+class unit_map;
+
+namespace pathfind {
+
+/**
+ * Shared routes of commoners that don't go along road(transport).
+ *
+ * A route is keyed by (origin city, destination, movetype) and is calculated
+ * ignoring units, so every commoner of the same movetype from the same city can
+ * share it. Nothing of units is cached: at every use, grids that commoner can
+ * arrive this turn are checked with the same calculator and stop_at as A*-search
+ * of move_unit, a blocked route is repaired by a local detour. Grids out of this
+ * turn are checked at next turn, when units have moved.
+ * A route is invalidated when a hex on it changes terrain, owner or artifical
+ * occupancy(wall, keep, fort, city).
+ */
+class troute_cache
+{
+public:
+	struct tkey {
+		tkey(int cityno, const map_location& dst, const std::string& movetype)
+			: cityno(cityno)
+			, dst(dst)
+			, movetype(movetype)
+		{}
+
+		bool operator<(const tkey& that) const;
+
+		int cityno;
+		map_location dst;
+		std::string movetype;
+	};
+
+	troute_cache();
+
+	/**
+	 * Get steps that commoner u at from should go to arrive to.
+	 * @stop_at: cost limit of caller's A*-search, detour uses it too.
+	 * @return false if there is no usable cached route, caller should do an A*-search itself.
+	 */
+	bool route(const unit& u, const map_location& from, const map_location& to, double stop_at,
+		const unit_map& units, const std::vector<team>& teams, const gamemap& map, std::vector<map_location>& steps);
+
+	/** loc's terrain, owner or artifical occupancy changed. */
+	void invalidate(const map_location& loc);
+	/** all routes from this city. city's owner changed. */
+	void invalidate_city(int cityno);
+	void clear();
+
+	int hits() const { return hits_; }
+	int misses() const { return misses_; }
+	int repairs() const { return repairs_; }
+	/** hit rate in percent. */
+	int hit_rate() const;
+	size_t size() const { return routes_.size(); }
+
+private:
+	const std::vector<map_location>* find(const tkey& key);
+	void insert(const tkey& key, const std::vector<map_location>& steps);
+	void erase(const tkey& key);
+
+	bool repair(const unit& u, std::vector<map_location>& steps, double stop_at,
+		const unit_map& units, const std::vector<team>& teams, const gamemap& map);
+
+private:
+	std::map<tkey, std::vector<map_location> > routes_;
+	// reverse index: which routes pass through this hex.
+	std::multimap<map_location, tkey> hexes_;
+
+	int hits_;
+	int misses_;
+	int repairs_;
+};
+
+}
+
+#endif
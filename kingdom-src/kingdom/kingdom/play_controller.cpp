@@ -44,6 +44,12 @@
 #include "playcampaign.hpp"
 #include "multiplayer.hpp"
 #include "version.hpp"
+#include "simulate.hpp"
+#include "keyframe.hpp"
+#include "state_hash.hpp"
+#include "statistics.hpp"
+#include "map_label.hpp"
+#include "savegame_config.hpp"
 
 #include "gui/dialogs/system.hpp"
 
@@ -68,6 +74,8 @@
 #include "gui/widgets/settings.hpp"
 
 #include "hotkeys.hpp"
+#include "base_instance.hpp"
+#include "filesystem.hpp"
 
 #include <boost/foreach.hpp>
 
@@ -167,6 +175,7 @@ play_controller::play_controller(const config& level, game_state& state_of_game,
 	troops_cache_(NULL),
 	troops_cache_vsize_(0),
 	roads_(),
+	route_cache_(),
 	renames_(),
 	fallen_to_unstage_(level_["fallen_to_unstage"].to_bool()),
 	card_mode_(level_["card_mode"].to_bool()),
@@ -191,6 +200,7 @@ play_controller::play_controller(const config& level, game_state& state_of_game,
 	persist_.start_transaction();
 
 	unit_map::top_side = first_player_;
+	state_hash::reset();
 
 	troops_cache_vsize_ = 40;
 	troops_cache_ = (unit**)malloc(troops_cache_vsize_ * sizeof(unit*));
@@ -308,6 +318,7 @@ play_controller::~play_controller()
 		}
 	}
 	
+	unit_types.stop_prewarm();
 	clear_resources();
 
 	if (troops_cache_) {
@@ -385,12 +396,50 @@ void play_controller::recover_layout(int random)
 	}
 }
 
+static void add_prewarm_type(const unit_type* ut, std::set<const unit_type*>& added, std::vector<const unit_type*>& types)
+{
+	if (ut && added.insert(ut).second) {
+		types.push_back(ut);
+	}
+}
+
+void play_controller::prewarm_unit_types()
+{
+	if (instance->load_threads() == 1) {
+		return;
+	}
+
+	// types of cities, what sides build and what cities recruit, and what recruits advance to.
+	std::vector<const unit_type*> types;
+	std::set<const unit_type*> added;
+	for (std::vector<team>::iterator it = teams_.begin(); it != teams_.end(); ++ it) {
+		const std::set<const unit_type*>& builds = it->builds();
+		for (std::set<const unit_type*>::const_iterator it2 = builds.begin(); it2 != builds.end(); ++ it2) {
+			add_prewarm_type(*it2, added, types);
+		}
+		const std::vector<artifical*>& cities = it->holden_cities();
+		for (std::vector<artifical*>::const_iterator it2 = cities.begin(); it2 != cities.end(); ++ it2) {
+			add_prewarm_type((*it2)->type(), added, types);
+			const std::vector<const unit_type*>& recruits = (*it2)->recruits(-1);
+			for (std::vector<const unit_type*>::const_iterator it3 = recruits.begin(); it3 != recruits.end(); ++ it3) {
+				add_prewarm_type(*it3, added, types);
+				const std::set<std::string> tree = (*it3)->advancement_tree();
+				for (std::set<std::string>::const_iterator it4 = tree.begin(); it4 != tree.end(); ++ it4) {
+					add_prewarm_type(unit_types.find(*it4), added, types);
+				}
+			}
+		}
+	}
+	unit_types.prewarm(types);
+}
+
 void play_controller::init(CVideo& video)
 {
 	provoke_cache_ready = false;
 	slot_cache::ready = false;
 	guard_cache::ready = false;
 	uint32_t start = SDL_GetTicks();
+	const tbinary_index_stats binary_start = binary_index_stats();
 
 	util::scoped_resource<loadscreen::global_loadscreen_manager*, util::delete_item> scoped_loadscreen_manager;
 	loadscreen::global_loadscreen_manager* loadscreen_manager = loadscreen::global_loadscreen_manager::get();
@@ -400,6 +449,7 @@ void play_controller::init(CVideo& video)
 	}
 
 	loadscreen::start_stage("load level");
+
 	// If the recorder has no event, adds an "game start" event
 	// to the recorder, whose only goal is to initialize the RNG
 	bool tent_valid = false;
@@ -807,6 +857,8 @@ void play_controller::init(CVideo& video)
 			}
 		}
 	}
+	// teams are built and controllers are known, what they recruit builds while the rest loads.
+	prewarm_unit_types();
 
 	for (std::vector<team>::iterator it = teams_.begin(); it != teams_.end(); ++ it) {
 		team& t = *it;
@@ -1057,6 +1109,11 @@ void play_controller::init(CVideo& video)
 
 	uint32_t stop = SDL_GetTicks();
 	posix_print("play_controller::init, used time: %u ms\n", stop - start);
+
+	const tbinary_index_stats binary_stop = binary_index_stats();
+	posix_print("play_controller::init, %i binary lookups, %i stat of walk, %i stat of lookups, %i stat saved\n",
+		binary_stop.lookups - binary_start.lookups, binary_stop.walk_syscalls - binary_start.walk_syscalls,
+		binary_stop.lookup_syscalls - binary_start.lookup_syscalls, binary_stop.saved_syscalls - binary_start.saved_syscalls);
 }
 
 void play_controller::adjust_according_to_group_interior()
@@ -2781,7 +2838,9 @@ bool play_controller::do_prefix_unit(int end_ticks, bool replay, bool record_at_
 void play_controller::do_post_unit(bool replay)
 {
 	if (!replay) {
-		recorder.add_post_unit();
+		state_hash::tstate state;
+		state_hash::compute(units_, teams_, heros_, state, false);
+		recorder.add_post_unit(state_hash::to_str(state));
 	}
 	finish_side_turn();
 
@@ -3068,6 +3127,33 @@ void play_controller::finish_turn()
 	LOG_NG << "turn event..." << (recorder.is_skipping() ? "skipping" : "no skip") << '\n';
 	update_locker lock_display(gui_->video(),recorder.is_skipping());
 	gamestate_.get_variable("turn_number") = int(turn());
+	statistics::end_turn(turn() - 1);
+
+	if (simulate::enabled) {
+		simulate::turn_ended(turn() - 1, units_, teams_, heros_);
+	}
+
+	if (keyframes.should_record(turn())) {
+		record_keyframe(recorder.ncommands());
+	}
+}
+
+void play_controller::record_keyframe(int command)
+{
+	// same as game_savegame, but side data keep in savegame_cache.
+	config cfg;
+	config& snapshot = cfg.add_child("snapshot");
+	to_config(snapshot);
+	snapshot["snapshot"] = "yes";
+	snapshot["playing_team"] = gui_->playing_team();
+	savegame::write_events(snapshot);
+	gamestate_.write_snapshot(snapshot);
+	gui_->labels().write(snapshot);
+
+	gamestate_.rpg_2_variable();
+	cfg.add_child("variables", gamestate_.get_variables());
+
+	keyframes.record(turn(), command, cfg, heros_);
 }
 
 bool play_controller::enemies_visible() const
@@ -3461,6 +3547,9 @@ void play_controller::slice_before_scroll()
 	do_delay_call(false);
 
 	soundsources_manager_->update();
+
+	// autosave of background writer may have failed since last slice.
+	savegame::show_async_error(gui_->video());
 }
 
 events::mouse_handler& play_controller::get_mouse_handler_base() {
@@ -4698,9 +4787,13 @@ map_location play_controller::move_unit(bool troop, team& current_team, const st
 			int ignore_units = (!tent::tower_mode())? 1: 3;
 			double stop_at = dst_must_reachable? 10000.0: calc.getUnitHoldValue() * ignore_units + 10000.0;
 
-			//allowed teleports
-			std::set<map_location> allowed_teleports;
-			pathfind::plain_route route_ = a_star_search(from, to, stop_at, &calc, map_.w(), map_.h(), &allowed_teleports);
+			pathfind::plain_route route_;
+			// transports of same city go to same fort along same route, try shared one.
+			if (!unit_ptr->is_commoner() || !route_cache_.route(*unit_ptr, from, to, stop_at, units_, teams_, map_, route_.steps)) {
+				//allowed teleports
+				std::set<map_location> allowed_teleports;
+				route_ = a_star_search(from, to, stop_at, &calc, map_.w(), map_.h(), &allowed_teleports);
+			}
 
 			if (route_.steps.empty()) {
 				return map_location();
@@ -30,6 +30,7 @@
 #include "hero.hpp"
 #include "card.hpp"
 #include "cursor.hpp"
+#include "pathfind/route_cache.hpp"
 
 #include <boost/scoped_ptr.hpp>
 
@@ -189,6 +190,7 @@ public:
 	const std::map<std::pair<int, int>, std::vector<map_location> >& roads() const { return roads_; }
 	const std::vector<map_location>& road(int a, int b) const;
 	const std::vector<map_location>& road(const unit& u) const;
+	pathfind::troute_cache& route_cache() { return route_cache_; }
 
 	std::map<int, std::string>& renames() { return renames_; }
 	const std::map<int, std::string>& renames() const { return renames_; }
@@ -249,6 +251,8 @@ protected:
 	void place_sides_in_preferred_locations();
 	virtual void finish_side_turn();
 	void finish_turn();
+	// @command: index of the first command after this keyframe.
+	void record_keyframe(int command);
 	bool clear_shroud();
 	bool enemies_visible() const;
 	void adjust_according_to_group_interior();
@@ -327,6 +331,8 @@ protected:
 
 private:
 	void init(CVideo &video);
+	// build unit types of scenario in background, --load-threads 1 disables it.
+	void prewarm_unit_types();
 	void more_card(team& current_team, int turn);
 	void recover_layout(int random);
 
@@ -342,6 +348,7 @@ private:
 	size_t troops_cache_vsize_;
 
 	std::map<std::pair<int, int>, std::vector<map_location> > roads_;
+	pathfind::troute_cache route_cache_;
 	std::map<int, std::string> renames_;
 	
 	bool victory_when_enemy_no_city_;
@@ -30,11 +30,13 @@
 #include "persist_manager.hpp"
 #include "playmp_controller.hpp"
 #include "replay_controller.hpp"
+#include "keyframe.hpp"
 #include "map_exception.hpp"
 #include "dialogs.hpp"
 #include "gettext.hpp"
 #include "resources.hpp"
 #include "savegame.hpp"
+#include "simulate.hpp"
 #include "sound.hpp"
 #include "wml_exception.hpp"
 #include "formula_string_utils.hpp"
@@ -82,18 +84,24 @@ void play_replay(display& disp, game_state& gamestate, const config& game_config
 
 		gamestate.snapshot = config();
 		recorder.clear();
+		keyframes.clear();
 		gamestate.replay_data.clear();
 		gamestate.start_scenario_ss.str("");
 		// gamestate.start_hero_ss.str("");
 		gamestate.clear_start_hero_data();
 
 	} catch(game::load_game_failed& e) {
+		if (simulate::enabled) throw;
 		gui2::show_error_message(disp.video(), _("The game could not be loaded: ") + e.message);
 	} catch(game::game_error& e) {
+		if (simulate::enabled) throw;
 		gui2::show_error_message(disp.video(), _("Error while playing the game: ") + e.message);
 	} catch(incorrect_map_format_error& e) {
+		if (simulate::enabled) throw;
 		gui2::show_error_message(disp.video(), std::string(_("The game map could not be loaded: ")) + e.message);
 	} catch(twml_exception& e) {
+		// headless replay reports it, there is no one to close dialog.
+		if (simulate::enabled) throw;
 		e.show(disp);
 	}
 }
@@ -117,13 +125,16 @@ static LEVEL_RESULT playsingle_scenario(const config& game_config,
 		if (resources::persist != NULL) {
 			resources::persist->end_transaction();
 		}
-		gui2::show_transient_message(disp.video(),
-				    _("Defeat"),
-				    _("You have been defeated!")
-				    );
+		// simulation has no one to answer dialog, i.e. when turns are over.
+		if (!simulate::enabled) {
+			gui2::show_transient_message(disp.video(),
+					    _("Defeat"),
+					    _("You have been defeated!")
+					    );
+		}
 	}
 
-	if (res != QUIT && end_level.linger_mode)
+	if (res != QUIT && end_level.linger_mode && !simulate::enabled)
 	{
 		try {
 			playcontroller.linger();
@@ -348,6 +359,10 @@ LEVEL_RESULT play_game(display& disp, game_state& gamestate, const config& game_
 			return QUIT;
 		}
 
+		if (simulate::enabled) {
+			// simulation is one scenario. Keep recorder, report counts its commands.
+			return res;
+		}
 
 		// Save-management options fire on game end.
 		// This means: (a) we have a victory, or
@@ -362,6 +377,7 @@ LEVEL_RESULT play_game(display& disp, game_state& gamestate, const config& game_
 		}
 
 		recorder.clear();
+		keyframes.clear();
 		gamestate.replay_data.clear();
 		gamestate.start_scenario_ss.str("");
 		gamestate.clear_start_hero_data();
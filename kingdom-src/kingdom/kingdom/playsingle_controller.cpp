@@ -49,6 +49,7 @@
 #include "artifical.hpp"
 #include "wml_exception.hpp"
 #include "hotkeys.hpp"
+#include "simulate.hpp"
 
 #include <boost/foreach.hpp>
 
@@ -709,10 +710,13 @@ void playsingle_controller::before_human_turn(bool save)
 	if (tent::mode != mode_tag::LAYOUT && save) {
 		autosave_ticks_ = unit_map::main_ticks;
 
-		config snapshot;
-		to_config(snapshot);
-		savegame::autosave_savegame save(heros_, heros_start_, gamestate_, *gui_, snapshot);
-		save.autosave(game_config::disable_autosave, preferences::autosavemax(), preferences::INFINITE_AUTO_SAVES);
+		{
+			simulate::tphase phase(simulate::AUTOSAVE);
+			config snapshot;
+			to_config(snapshot);
+			savegame::autosave_savegame save(heros_, heros_start_, gamestate_, *gui_, snapshot);
+			save.autosave(game_config::disable_autosave, preferences::autosavemax(), preferences::INFINITE_AUTO_SAVES);
+		}
 
 		if (tent::turn_based) {
 			const std::vector<hero*>& last_active_tactic = t.last_active_tactic();
@@ -1131,6 +1135,7 @@ void playsingle_controller::play_ai_turn(turn_info* turn_data)
 
 	uint32_t before = SDL_GetTicks();
 	try {
+		simulate::tphase phase(simulate::AI);
 		ai::manager::play_turn();
 	} catch (end_turn_exception&) {
 	}
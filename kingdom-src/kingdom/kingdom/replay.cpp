@@ -41,14 +41,84 @@
 #include "wml_exception.hpp"
 #include "gui/dialogs/preferences.hpp"
 #include "integrate.hpp"
+#include "state_hash.hpp"
 
 #include <boost/foreach.hpp>
 #include <boost/iostreams/filtering_streambuf.hpp>
 #include <boost/iostreams/filter/gzip.hpp>
+#include <zlib.h>
+#include "SDL_timer.h"
+
+// command was sent to network.
+#define COMMAND_FLAG_SENT		0x1
+// POST_UNIT command carries state hash.
+#define POST_UNIT_FLAG_STATE	0x2
+
+// sealed block is version of its dictionary in one byte, then deflate stream. Legacy
+// gzip block begins with 0x1f, a block of this series before versioning begins with
+// zlib header 0x78 and uses version 1, so versions must not be those values.
+static const int block_dictionary_version = 1;
+
+// version 1 of preset dictionary. Every command begins with command header,
+// frequent types are put at end, deflate prefers near distance.
+static std::string make_block_dictionary_v1()
+{
+	std::string dict;
+	{
+		static const command_pool::TYPE types[] = {
+			command_pool::START, command_pool::EMPLOY, command_pool::SCENARIO_ENV, command_pool::FINAL_BATTLE,
+			command_pool::APPOINT_NOBLE, command_pool::PURCHASE, command_pool::RPG_EXCHANGE, command_pool::ASSEMBLE_TREASURE,
+			command_pool::ARMORY, command_pool::REFORM_CAPTAIN, command_pool::ADD_CARD, command_pool::ERASE_CARD,
+			command_pool::INPUT, command_pool::DIPLOMATISM, command_pool::CLEAR_LABELS, command_pool::LABLE,
+			command_pool::RENAME, command_pool::SPEAK, command_pool::EVENT, command_pool::CHOOSE,
+			command_pool::INCHING_BLOCK, command_pool::BELONG_TO, command_pool::MOVE_HEROS, command_pool::INTERIOR,
+			command_pool::ING_TECHNOLOGY, command_pool::FRESH_HEROS, command_pool::EXPEDITE, command_pool::BOMB,
+			command_pool::DISBAND, command_pool::BUILD, command_pool::CAST_TACTIC, command_pool::ACTIVE_TACTIC,
+			command_pool::CLEAR_FORMATIONED, command_pool::COUNTDOWN_UPDATE, command_pool::FORMATION_ATTACK, command_pool::RECRUIT,
+			command_pool::SET_TASK, command_pool::SET_STATES, command_pool::INIT_AI, command_pool::PREFIX_UNIT,
+			command_pool::POST_UNIT, command_pool::INIT_SIDE, command_pool::END_TURN, command_pool::CHECKSUM_CHECK,
+			command_pool::ATTACK, command_pool::DO_COMMONER, command_pool::MOVEMENT
+		};
+		for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i ++) {
+			command_pool::command cmd;
+			cmd.type = types[i];
+			cmd.flags = 0;
+			dict.append((const char*)&cmd, sizeof(cmd));
+			// most commands continue with small ints: side, count, x, y.
+			int values[4] = {1, 1, 0, 0};
+			dict.append((const char*)values, sizeof(values));
+		}
+	}
+	return dict;
+}
+
+/**
+ * preset dictionary of sealed blocks. Don't change a version that is written,
+ * saves and replays would be unreadable. Add a version for new dictionary, and
+ * keep old ones for reading.
+ * @return NULL if version is unknown.
+ */
+static const std::string* block_dictionary(int version)
+{
+	static const std::string v1 = make_block_dictionary_v1();
+	if (version == 1) {
+		return &v1;
+	}
+	return NULL;
+}
+
+// legacy savegame has gzip segments.
+static bool is_gzip_block(const unsigned char* data, int len)
+{
+	return len >= 2 && data[0] == 0x1f && data[1] == 0x8b;
+}
 
 command_pool::command_pool()
 	: use_gzip_(true)
 	, cache_(NULL)
+	, blocks_()
+	, block_cache_(NULL)
+	, stats_()
 {
 	pool_data_ = (uint8_t*)malloc(POOL_ALLOC_DATA_SIZE);
 	pool_data_size_ = POOL_ALLOC_DATA_SIZE;
@@ -59,41 +129,27 @@ command_pool::command_pool()
 	pool_pos_vsize_ = 0;
 
 	current_gzip_seg_.min = current_gzip_seg_.max = -1;
+	block_cache_seg_.min = block_cache_seg_.max = -1;
 }
 
 command_pool::command_pool(const command_pool& that)
+	: use_gzip_(true)
+	, pool_data_(NULL)
+	, pool_pos_(NULL)
+	, pool_data_size_(0)
+	, pool_data_vsize_(0)
+	, pool_data_gzip_size_(0)
+	, pool_pos_size_(0)
+	, pool_pos_vsize_(0)
+	, cache_(NULL)
+	, blocks_()
+	, block_cache_(NULL)
+	, stats_()
 {
-	use_gzip_ = that.use_gzip_;
-
-	VALIDATE(use_gzip_, "command_pool::operator=, invalid use_gzip_ falg");
+	current_gzip_seg_.min = current_gzip_seg_.max = -1;
+	block_cache_seg_.min = block_cache_seg_.max = -1;
 
-	// pool data
-	pool_data_size_ = that.pool_data_size_;
-	pool_data_vsize_ = that.pool_data_vsize_;
-	pool_data_gzip_size_ = that.pool_data_gzip_size_;
-	if (pool_data_size_) {
-		pool_data_ = (uint8_t*)malloc(pool_data_size_);
-	}
-	if (pool_data_gzip_size_) {
-		memcpy(pool_data_, that.pool_data_, pool_data_gzip_size_);
-	}
-	// pool pos
-	pool_pos_size_ = that.pool_pos_size_;
-	pool_pos_vsize_ = that.pool_pos_vsize_;
-	if (pool_pos_size_) {
-		pool_pos_ = (unsigned int*)malloc(pool_pos_size_ * sizeof(unsigned int));
-	}
-	if (pool_pos_vsize_) {
-		memcpy(pool_pos_, that.pool_pos_, pool_pos_vsize_ * sizeof(unsigned int));
-	}
-	// cache_
-	if (pool_data_vsize_) {
-		VALIDATE(false, "command_pool::command_pool, pool_data_vsize_ isn't zero.");
-		cache_ = (unsigned char*)malloc(POOL_ALLOC_CACHE_SIZE);
-		memcpy(cache_, that.cache_, pool_data_vsize_);
-	} else {
-		cache_ = NULL;
-	}
+	*this = that;
 }
 
 command_pool::~command_pool()
@@ -107,27 +163,38 @@ command_pool::~command_pool()
 	if (cache_) {
 		free(cache_);
 	}
+	if (block_cache_) {
+		free(block_cache_);
+	}
 }
 
+// sealed blocks are copied as is, open block of that is sealed into this.
 command_pool& command_pool::operator=(const command_pool& that)
 {
 	VALIDATE(use_gzip_ && that.use_gzip_, "command_pool::operator=, invalid use_gzip_ falg");
 
-	use_gzip_ = that.use_gzip_;
+	if (this == &that) {
+		return *this;
+	}
 
 	if (pool_data_size_ < that.pool_data_size_) {
-		free(pool_data_);
+		if (pool_data_) {
+			free(pool_data_);
+		}
 		pool_data_size_ = that.pool_data_size_;
 		pool_data_ = (uint8_t*)malloc(pool_data_size_);
 	}
-	pool_data_vsize_ = that.pool_data_vsize_;
+	pool_data_vsize_ = 0;
 	pool_data_gzip_size_ = that.pool_data_gzip_size_;
 	if (pool_data_gzip_size_) {
 		memcpy(pool_data_, that.pool_data_, pool_data_gzip_size_);
 	}
+	blocks_ = that.blocks_;
 
 	if (pool_pos_size_ < that.pool_pos_size_) {
-		free(pool_pos_);
+		if (pool_pos_) {
+			free(pool_pos_);
+		}
 		pool_pos_size_ = that.pool_pos_size_;
 		pool_pos_ = (unsigned int*)malloc(pool_pos_size_ * sizeof(unsigned int));
 	}
@@ -135,13 +202,11 @@ command_pool& command_pool::operator=(const command_pool& that)
 	if (pool_pos_vsize_) {
 		memcpy(pool_pos_, that.pool_pos_, pool_pos_vsize_ * sizeof(unsigned int));
 	}
-	// cache
-	if (pool_data_vsize_) {
-		VALIDATE(false, "command_pool::command_pool, pool_data_vsize_ isn't zero.");
-		if (!cache_) {
-			cache_ = (unsigned char*)malloc(POOL_ALLOC_CACHE_SIZE);
-		}
-		memcpy(cache_, that.cache_, pool_data_vsize_);
+
+	current_gzip_seg_.min = current_gzip_seg_.max = -1;
+	block_cache_seg_.min = block_cache_seg_.max = -1;
+	if (that.pool_data_vsize_) {
+		append_block(that.cache_, that.pool_data_vsize_, that.current_gzip_seg_.min, that.pool_pos_vsize_ - 1);
 	}
 
 	return *this;
@@ -166,7 +231,7 @@ void command_pool::read(unsigned char* mem)
 		pool_data_size_ = pool_data_size;
 		pool_data_ = (uint8_t*)malloc(pool_data_size);
 	}
-	// pool_data_vsize_ = pool_data_vsize;
+	pool_data_vsize_ = 0;
 	pool_data_gzip_size_ = pool_data_gzip_size;
 	if (pool_data_gzip_size_) {
 		memcpy(pool_data_, (unsigned char*)ptr, pool_data_gzip_size_);
@@ -181,6 +246,10 @@ void command_pool::read(unsigned char* mem)
 	if (pool_pos_vsize_) {
 		memcpy(pool_pos_, (unsigned char*)ptr + pool_data_gzip_size_, pool_pos_vsize_ * sizeof(unsigned int));
 	}
+
+	current_gzip_seg_.min = current_gzip_seg_.max = -1;
+	block_cache_seg_.min = block_cache_seg_.max = -1;
+	rebuild_blocks();
 }
 
 void command_pool::clear()
@@ -190,6 +259,10 @@ void command_pool::clear()
 
 	pool_data_gzip_size_ = 0;
 	current_gzip_seg_.min = current_gzip_seg_.max = -1;
+
+	blocks_.clear();
+	block_cache_seg_.min = block_cache_seg_.max = -1;
+	stats_ = tstats();
 }
 
 void command_pool::set_use_gzip(bool val) 
@@ -197,50 +270,191 @@ void command_pool::set_use_gzip(bool val)
 	use_gzip_ = val; 
 }
 
+size_t command_pool::memory_size() const
+{
+	size_t size = pool_data_size_ + pool_pos_size_ * sizeof(unsigned int) + blocks_.capacity() * sizeof(tblock);
+	if (cache_) {
+		size += POOL_ALLOC_CACHE_SIZE;
+	}
+	if (block_cache_) {
+		size += POOL_ALLOC_CACHE_SIZE;
+	}
+	return size;
+}
+
+void command_pool::rebuild_blocks()
+{
+	blocks_.clear();
+
+	gzip_segment_t seg;
+	int start = 0;
+	while (start < pool_data_gzip_size_) {
+		memcpy(&seg, pool_data_ + start, sizeof(gzip_segment_t));
+		tblock block;
+		block.offset = start;
+		block.min = seg.min;
+		block.max = seg.max;
+		blocks_.push_back(block);
+		start += sizeof(gzip_segment_t) + seg.len;
+	}
+}
+
+int command_pool::find_block(int pool_pos_index) const
+{
+	int low = 0, high = (int)blocks_.size() - 1;
+	while (low <= high) {
+		const int mid = (low + high) / 2;
+		const tblock& block = blocks_[mid];
+		if (pool_pos_index < block.min) {
+			high = mid - 1;
+		} else if (pool_pos_index > block.max) {
+			low = mid + 1;
+		} else {
+			return mid;
+		}
+	}
+	return -1;
+}
+
+void command_pool::append_block(const unsigned char* data, int data_len, int min, int max)
+{
+	const Uint64 start = SDL_GetPerformanceCounter();
+	const std::string& dict = *block_dictionary(block_dictionary_version);
+
+	z_stream strm;
+	memset(&strm, 0, sizeof(strm));
+	int ret = deflateInit(&strm, Z_BEST_SPEED);
+	VALIDATE(ret == Z_OK, "command_pool::append_block, deflateInit fail.");
+	deflateSetDictionary(&strm, (const Bytef*)dict.c_str(), dict.size());
+
+	const int bound = sizeof(gzip_segment_t) + 1 + deflateBound(&strm, data_len);
+	if (pool_data_size_ - pool_data_gzip_size_ < bound) {
+		pool_data_size_ = pool_data_gzip_size_ + bound + POOL_ALLOC_DATA_SIZE;
+		uint8_t* tmp = (uint8_t*)malloc(pool_data_size_);
+		if (pool_data_) {
+			memcpy(tmp, pool_data_, pool_data_gzip_size_);
+			free(pool_data_);
+		}
+		pool_data_ = tmp;
+	}
+
+	uint8_t* dest = pool_data_ + pool_data_gzip_size_;
+	strm.next_in = (Bytef*)data;
+	strm.avail_in = data_len;
+	dest[sizeof(gzip_segment_t)] = block_dictionary_version;
+	strm.next_out = dest + sizeof(gzip_segment_t) + 1;
+	strm.avail_out = bound - sizeof(gzip_segment_t) - 1;
+	ret = deflate(&strm, Z_FINISH);
+	VALIDATE(ret == Z_STREAM_END, "command_pool::append_block, deflate fail.");
+
+	gzip_segment_t seg;
+	seg.len = 1 + strm.total_out;
+	seg.min = min;
+	seg.max = max;
+	deflateEnd(&strm);
+	memcpy(dest, &seg, sizeof(gzip_segment_t));
+
+	tblock block;
+	block.offset = pool_data_gzip_size_;
+	block.min = min;
+	block.max = max;
+	blocks_.push_back(block);
+	pool_data_gzip_size_ += sizeof(gzip_segment_t) + seg.len;
+
+	stats_.blocks ++;
+	stats_.raw_bytes += data_len;
+	stats_.sealed_bytes += sizeof(gzip_segment_t) + seg.len;
+	stats_.seal_counter += SDL_GetPerformanceCounter() - start;
+}
+
+void command_pool::seal_block()
+{
+	if (!pool_data_vsize_) {
+		return;
+	}
+	append_block(cache_, pool_data_vsize_, current_gzip_seg_.min, pool_pos_vsize_ - 1);
+	pool_data_vsize_ = 0;
+	current_gzip_seg_.min = current_gzip_seg_.max = -1;
+}
+
 // #define command_addr(pool_pos_index)	((command_pool::command*)(pool_data_ + pool_pos_[pool_pos_index]))
 
 void command_pool::load_for_queue(int pool_pos_index, gzip_segment_t& seg, int& pool_data_gzip_size, unsigned char* dest)
 {
-	int start;
-	// ungzip necessary data to cache
-	if (pool_pos_index < current_gzip_seg_.min) {
-		// search back
-		start = 0;
-	} else if (seg.max != -1 && pool_pos_index > seg.max) {
-		// search forword
-		start = pool_data_gzip_size;
+	const int at = find_block(pool_pos_index);
+	VALIDATE(at >= 0, "command_pool::load_for_queue, command isn't in sealed blocks.");
+
+	const Uint64 start = SDL_GetPerformanceCounter();
+	pool_data_gzip_size = blocks_[at].offset;
+	memcpy(&seg, pool_data_ + pool_data_gzip_size, sizeof(gzip_segment_t));
+	unsigned char* data = pool_data_ + pool_data_gzip_size + sizeof(gzip_segment_t);
+
+	if (is_gzip_block(data, seg.len)) {
+		gzip_codec(data, seg.len, false, dest);
+
 	} else {
-		// search from 0 to max
-		start = 0;
+		int len = seg.len;
+		int version = 1;
+		if (len && data[0] != 0x78) {
+			version = data[0];
+			data ++;
+			len --;
+		}
+		const std::string* dict = block_dictionary(version);
+		VALIDATE(dict, "command_pool::load_for_queue, block uses unknown dictionary.");
+
+		z_stream strm;
+		memset(&strm, 0, sizeof(strm));
+		int ret = inflateInit(&strm);
+		VALIDATE(ret == Z_OK, "command_pool::load_for_queue, inflateInit fail.");
+		strm.next_in = data;
+		strm.avail_in = len;
+		strm.next_out = dest;
+		strm.avail_out = POOL_ALLOC_CACHE_SIZE;
+		ret = inflate(&strm, Z_FINISH);
+		if (ret == Z_NEED_DICT) {
+			// stream keeps adler32 of its dictionary, inflateSetDictionary() checks it.
+			ret = inflateSetDictionary(&strm, (const Bytef*)dict->c_str(), dict->size());
+			if (ret == Z_OK) {
+				ret = inflate(&strm, Z_FINISH);
+			}
+		}
+		inflateEnd(&strm);
+		VALIDATE(ret == Z_STREAM_END, "command_pool::load_for_queue, corrupted block.");
 	}
 
-	memcpy(&seg, pool_data_ + start, sizeof(gzip_segment_t));
-	while (pool_pos_index < seg.min || pool_pos_index > seg.max) {
-		start += sizeof(gzip_segment_t) + seg.len;
-		memcpy(&seg, pool_data_ + start, sizeof(gzip_segment_t));
-	}
-	pool_data_gzip_size = start;
-	gzip_codec(pool_data_ + pool_data_gzip_size + sizeof(gzip_segment_t), seg.len, false, dest);
+	stats_.decodes ++;
+	stats_.decode_counter += SDL_GetPerformanceCounter() - start;
 }
 
 command_pool::command* command_pool::command_addr(int pool_pos_index, bool queue)
 {
 	if (use_gzip_) {
-		if (!cache_) {
-			cache_ = (unsigned char*)malloc(POOL_ALLOC_CACHE_SIZE);
-		}
 		if (queue) {
-			if (pool_pos_index < current_gzip_seg_.min || pool_pos_index > current_gzip_seg_.max) {
-				load_for_queue(pool_pos_index, current_gzip_seg_, pool_data_gzip_size_, cache_);
+			if (current_gzip_seg_.min != -1 && pool_pos_index >= current_gzip_seg_.min) {
+				// in open block
+				return (command_pool::command*)(cache_ + pool_pos_[pool_pos_index]);
 			}
+			if (!block_cache_) {
+				block_cache_ = (unsigned char*)malloc(POOL_ALLOC_CACHE_SIZE);
+			}
+			if (pool_pos_index < block_cache_seg_.min || pool_pos_index > block_cache_seg_.max) {
+				int offset;
+				load_for_queue(pool_pos_index, block_cache_seg_, offset, block_cache_);
+			}
+			return (command_pool::command*)(block_cache_ + pool_pos_[pool_pos_index]);
+
 		} else {
+			if (!cache_) {
+				cache_ = (unsigned char*)malloc(POOL_ALLOC_CACHE_SIZE);
+			}
 			// ensure current_gzip_seg.min/max is valid.
 			if (current_gzip_seg_.min == -1) {
 				current_gzip_seg_.min = pool_pos_vsize_ - 1;
 				current_gzip_seg_.max = INT_MAX;
 			}
+			return (command_pool::command*)(cache_ + pool_pos_[pool_pos_index]);
 		}
-		return (command_pool::command*)(cache_ + pool_pos_[pool_pos_index]);
 	} else {
 		return (command_pool::command*)(pool_data_ + pool_pos_[pool_pos_index]);
 	}
@@ -248,6 +462,9 @@ command_pool::command* command_pool::command_addr(int pool_pos_index, bool queue
 
 command_pool::command* command_pool::command_addr2(int pool_pos_index, gzip_segment_t& seg, int& pool_data_gzip_size, unsigned char* cache)
 {
+	if (current_gzip_seg_.min != -1 && pool_pos_index >= current_gzip_seg_.min) {
+		return (command_pool::command*)(cache_ + pool_pos_[pool_pos_index]);
+	}
 	if (pool_pos_index < seg.min || pool_pos_index > seg.max) {
 		load_for_queue(pool_pos_index, seg, pool_data_gzip_size, cache);
 	}
@@ -265,6 +482,8 @@ command_pool::command* command_pool::add_command()
 			free(pool_data_);
 			pool_data_ = tmp;
 		}
+	} else if (pool_data_vsize_ >= POOL_BLOCK_SIZE) {
+		seal_block();
 	}
 	
 	pool_pos_vsize_ ++;
@@ -1181,13 +1400,16 @@ void replay::add_prefix_unit(int side, bool new_turn, int end)
 	cmd->add_child("prefix_unit", val);
 }
 
-void replay::add_post_unit()
+void replay::add_post_unit(const std::string& state)
 {
 	config* const cmd = add_command();
 	(*cmd)["type"] = command_pool::POST_UNIT;
 
 	config val;
 	val["past"] = 0; // current, it is not used.
+	if (!state.empty()) {
+		val["state"] = state;
+	}
 
 	cmd->add_child("post_unit", val);
 }
@@ -1436,7 +1658,7 @@ config replay::get_data_range(int cmd_start, int cmd_end, DATA_TYPE data_type)
 	}
 	int cmd_end_from_pool = (cmd_end > pool_pos_vsize_)? cmd_end - 1: pool_pos_vsize_;
 	while (cmd_start < cmd_end_from_pool) {
-		if (!(command_addr(cmd_start)->flags & 1)) {
+		if (!(command_addr(cmd_start)->flags & COMMAND_FLAG_SENT)) {
 			config& cmd_cfg = res.add_child("command");
 			command_2_config(command_addr(cmd_start), cmd_cfg);
 			cmd_cfg["type"] = str_cast(command_addr(cmd_start)->type);
@@ -1490,7 +1712,7 @@ config* replay::add_command(bool update_random_context)
 		command_pool::command* cmd = command_pool::add_command();
 		config_2_command(cfg_, cmd);
 		if (cfg_["sent"] == "yes") {
-			cmd->flags = 1;
+			cmd->flags |= COMMAND_FLAG_SENT;
 		}
 	}
 
@@ -1676,6 +1898,13 @@ void replay::config_2_command(const config& cfg, command_pool::command* cmd)
 		ptr = ptr + 1; 
 
 		cmd->flags = 0;
+		// state hash follows. legacy command hasn't it, and hasn't POST_UNIT_FLAG_STATE.
+		uint32_t categories[state_hash::CATEGORIES];
+		if (state_hash::from_str(child["state"].str(), categories)) {
+			memcpy(ptr, categories, sizeof(categories));
+			ptr = ptr + state_hash::CATEGORIES;
+			cmd->flags = POST_UNIT_FLAG_STATE;
+		}
 		pool_data_vsize_ += sizeof(command_pool::command) + (int)((uint8_t*)ptr - (uint8_t*)(cmd + 1));
 
 	} else if (type == command_pool::FRESH_HEROS) {
@@ -2849,6 +3078,13 @@ void replay::command_2_config(command_pool::command* cmd, config& cfg)
 		child["past"] = *ptr;
 		ptr = ptr + 1;
 
+		if (cmd->flags & POST_UNIT_FLAG_STATE) {
+			state_hash::tstate state;
+			memcpy(state.categories, ptr, sizeof(state.categories));
+			ptr = ptr + state_hash::CATEGORIES;
+			child["state"] = state_hash::to_str(state);
+		}
+
 	} else if (cmd->type == command_pool::FRESH_HEROS) {
 		config& child = cfg.add_child("fresh_heros");
 		int* ptr = (int*)(cmd + 1);
@@ -3831,22 +4067,7 @@ void replay::get_replay_data(command_pool& that)
 			controller.sync_undo();
 		}
 	}
-	if (use_gzip_ && pool_data_vsize_) {
-		// encode pool_data
-		gzip_segment_t seg;
-		seg.min = current_gzip_seg_.min;
-		seg.max = pool_pos_vsize_ - 1;
-		
-		seg.len = gzip_codec(cache_, pool_data_vsize_, true);
-		pool_data_vsize_ = 0;
-		// once recallocate, gzip_codec maybe modify pool_data_, so dest must locate after gzip_codec. 
-		uint8_t* dest = pool_data_ + pool_data_gzip_size_;
-		pool_data_gzip_size_ += sizeof(gzip_segment_t) + seg.len;
-		current_gzip_seg_.min = current_gzip_seg_.max = -1;
-
-		memcpy(dest, &seg, sizeof(gzip_segment_t));
-	}
-
+	// sealed blocks are appended as is, only open block is compressed into that.
 	that = *(dynamic_cast<command_pool*>(this));
 }
 
@@ -3895,6 +4116,13 @@ bool replay::at_end() const
 	return pos_ >= pool_pos_vsize_;
 }
 
+void replay::seek(int pos)
+{
+	pos_ = pos;
+	current_ = NULL;
+	set_random(NULL);
+}
+
 void replay::set_to_end()
 {
 	pos_ = pool_pos_vsize_;
@@ -3928,7 +4156,7 @@ void replay::add_config(const config& cfg, MARK_SENT mark)
 			command_pool::command* cmd = command_pool::add_command();
 			config_2_command(cfg_, cmd);
 			if (cfg_["sent"] == "yes") {
-				cmd->flags = 1;
+				cmd->flags |= COMMAND_FLAG_SENT;
 			}
 		}
 		cfg_ = cmd_cfg;
@@ -4165,6 +4393,12 @@ bool do_replay_handle(int side_num, const std::string &do_untill)
 		}
 		else if (const config& child = cfg->child("post_unit"))
 		{
+			if (child.has_attribute("state")) {
+				const std::string report = state_hash::verify(child["state"].str(), units, teams, heros);
+				if (!report.empty()) {
+					replay::process_error(report);
+				}
+			}
 			controller.do_post_unit(true);
 
 			return true;
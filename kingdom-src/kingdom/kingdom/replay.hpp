@@ -88,7 +88,8 @@ public:
 	void end_turn();
 	void init_ai();
 	void add_prefix_unit(int side, bool new_turn, int end);
-	void add_post_unit();
+	// state: state_hash::to_str, empty if not verify.
+	void add_post_unit(const std::string& state);
 	void add_do_commoner();
 	void add_fresh_heros();
 	void add_inching_block(const unit& u, bool increase);
@@ -152,6 +153,11 @@ public:
 	bool at_end() const;
 	void set_to_end();
 
+	// index of the next command to replay.
+	int pos() const { return pos_; }
+	// replay will continue from command pos. used by keyframe.
+	void seek(int pos);
+
 	void clear();
 	bool empty();
 
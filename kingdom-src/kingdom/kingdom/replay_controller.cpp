@@ -27,6 +27,9 @@
 #include "unit_display.hpp"
 #include "artifical.hpp"
 #include "replay.hpp"
+#include "keyframe.hpp"
+#include "simulate.hpp"
+#include "sound.hpp"
 #include "wml_exception.hpp"
 #include "gui/dialogs/theme2.hpp"
 
@@ -53,15 +56,54 @@ LEVEL_RESULT play_replay_level(const config& game_config,
 		heros = heros_start;
 		runtime_groups::redirect_hero_map(heros);
 
-		replay_controller replaycontroller(*level, state_of_game, heros, heros_start, cards, ticks, num_turns, game_config, video);
-		const events::command_disabler disable_commands;
-
-		//replay event-loop
+		const config* current_level = level;
+		config keyframe_level;
+		int seek_turn = 0;
 		for (; ;) {
-			if (replaycontroller.is_playing()) {
-				replaycontroller.play_replay2();
+			try {
+				replay_controller replaycontroller(*current_level, state_of_game, heros, heros_start, cards, ticks, num_turns, game_config, video);
+				const events::command_disabler disable_commands;
+
+				if (seek_turn) {
+					replaycontroller.replay_to_turn(seek_turn);
+				}
+				if (simulate::enabled) {
+					// headless verification, run to the end.
+					replaycontroller.fast_forward(0);
+					if (recorder.unexpected) {
+						simulate::replay_error("replay ended unexpectedly");
+					}
+					return VICTORY;
+				}
+
+				//replay event-loop
+				for (; ;) {
+					if (replaycontroller.is_playing()) {
+						replaycontroller.play_replay2();
+					}
+					replaycontroller.play_slice();
+				}
+			} catch (replay_seek_exception& e) {
+				seek_turn = e.turn;
+			}
+
+			// restore the nearest keyframe, or restart from the beginning.
+			const tkeyframes::tkeyframe* frame = keyframes.nearest(seek_turn);
+			if (frame) {
+				keyframes.restore(*frame, keyframe_level, heros, state_of_game);
+				recorder.seek(frame->command);
+				current_level = &keyframe_level;
+			} else {
+				runtime_groups::redirect_hero_map(heros_start);
+				heros = heros_start;
+				runtime_groups::redirect_hero_map(heros);
+				if (const config& vars = level->child("variables")) {
+					state_of_game.set_variables(vars);
+				}
+				state_of_game.rng().seed_random(0);
+				recorder.start_replay();
+				current_level = level;
 			}
-			replaycontroller.play_slice();
 		}
 	}
 	catch(end_level_exception&){
@@ -83,6 +125,7 @@ replay_controller::replay_controller(const config& level,
 	current_turn_(1),
 	delay_(0),
 	is_playing_(false),
+	fast_forward_(false),
 	show_everything_(false),
 	show_team_(state_of_game.classification().campaign_type == "multiplayer" ? 0 : 1)
 {
@@ -169,8 +212,135 @@ void replay_controller::replay_next_side()
 	is_playing_ = false;
 }
 
+void replay_controller::replay_seek_turn(int turn)
+{
+	if (turn < 1) {
+		turn = 1;
+	}
+	const int current = (int)this->turn();
+	if (turn == current) {
+		return;
+	}
+	const tkeyframes::tkeyframe* frame = keyframes.nearest(turn);
+	if (turn < current || (frame && frame->turn > current)) {
+		throw replay_seek_exception(turn);
+	}
+	replay_to_turn(turn);
+}
+
+void replay_controller::replay_to_turn(int turn)
+{
+	fast_forward(turn);
+}
+
+namespace {
+// restore skip and delay even if replay throws.
+class tfast_forward_lock
+{
+public:
+	tfast_forward_lock(bool& fast_forward)
+		: fast_forward_(fast_forward)
+		, skip_(recorder.is_skipping())
+		, no_delay_(game_config::no_delay)
+	{
+		fast_forward_ = true;
+		recorder.set_skip(true);
+		game_config::no_delay = true;
+	}
+	~tfast_forward_lock()
+	{
+		fast_forward_ = false;
+		recorder.set_skip(skip_);
+		game_config::no_delay = no_delay_;
+	}
+
+private:
+	bool& fast_forward_;
+	bool skip_;
+	bool no_delay_;
+};
+}
+
+void replay_controller::fast_forward(int turn)
+{
+	const bool lingering = linger_;
+	is_playing_ = true;
+	{
+		const tfast_forward_lock lock(fast_forward_);
+		update_locker lock_display(gui_->video());
+		const sound::tmute_lock mute;
+
+		const int start_turn = this->turn();
+		const int start_pos = recorder.pos();
+		const int ncommands = recorder.ncommands();
+		int last_turn = start_turn;
+		int last_ticks = 0;
+		while (!recorder.at_end() && (!turn || (int)this->turn() < turn) && is_playing_ && !recorder.unexpected) {
+			play_side();
+
+			if ((int)this->turn() != last_turn) {
+				if (simulate::enabled) {
+					simulate::turn_ended(last_turn, units_, teams_, heros_);
+				}
+				last_turn = this->turn();
+			}
+			const int now = SDL_GetTicks();
+			if (!simulate::enabled && now - last_ticks >= 100) {
+				int percent;
+				if (turn) {
+					percent = (last_turn - start_turn) * 100 / std::max(turn - start_turn, 1);
+				} else {
+					percent = (recorder.pos() - start_pos) * 100 / std::max(ncommands - start_pos, 1);
+				}
+				draw_progress(percent);
+				last_ticks = now;
+			}
+		}
+
+		// units didn't animate, rebuild all of view.
+		for (unit_map::iterator it = units_.begin(); it != units_.end(); ++ it) {
+			unit* u = dynamic_cast<unit*>(&*it);
+			if (u) {
+				u->set_standing();
+			}
+		}
+		gui_->new_turn();
+	}
+	is_playing_ = false;
+
+	gui_->invalidate_game_status();
+	update_teams();
+	update_gui();
+
+	if (linger_ && !lingering && !simulate::enabled) {
+		linger();
+	}
+}
+
+void replay_controller::draw_progress(int percent) const
+{
+	CVideo& video = gui_->video();
+	surface& screen = video.getSurface();
+	const int width = screen->w / 2;
+	const int height = 12;
+
+	SDL_Rect rect = create_rect((screen->w - width) / 2, screen->h - 4 * height, width, height);
+	sdl_fill_rect(screen, &rect, SDL_MapRGB(screen->format, 0, 0, 0));
+	rect.w = width * std::min(std::max(percent, 0), 100) / 100;
+	sdl_fill_rect(screen, &rect, SDL_MapRGB(screen->format, 192, 160, 64));
+	video.flip();
+
+	// keep window responsive, but don't process commands.
+	events::pump();
+}
+
 void replay_controller::process_oos(const std::string& msg) const
 {
+	if (simulate::enabled) {
+		simulate::replay_error(msg);
+		throw end_level_exception(QUIT);
+	}
+
 	std::stringstream message;
 	message << _("The replay is corrupt/out of sync. It might not make much sense to continue. Do you want to save the game?");
 	message << "\n\n" << _("Error details:") << "\n\n" << msg;
@@ -239,9 +409,11 @@ void replay_controller::play_turn()
 
 	LOG_REPLAY << "turn: " << current_turn_ << "\n";
 
-	gui_->new_turn();
-	gui_->invalidate_game_status();
-	events::raise_draw_event();
+	if (!fast_forward_) {
+		gui_->new_turn();
+		gui_->invalidate_game_status();
+		events::raise_draw_event();
+	}
 
 	while (!recorder.at_end() && is_playing_ && !recorder.unexpected){
 		play_side();
@@ -268,15 +440,27 @@ void replay_controller::play_side()
 
 		if (unit_map::main_ticks == end_ticks) {
 			tod_manager_.next_turn();
+			// replay of old savegame hasn't keyframes, record them so that seek backward is fast next time.
+			if (keyframes.should_record(turn())) {
+				record_keyframe(recorder.pos());
+			}
 		}
 
-		update_teams();
-		update_gui();
+		if (!fast_forward_) {
+			update_teams();
+			update_gui();
+		}
 	}
 	catch (end_level_exception& e){
 		//VICTORY/DEFEAT end_level_exception shall not return to title screen
 		get_end_level_data().result = e.result;
 		if (e.result == VICTORY || e.result == DEFEAT) {
+			if (fast_forward_) {
+				// linger after view is rebuilt.
+				is_playing_ = false;
+				linger_ = true;
+				return;
+			}
 			linger();
 			return;
 		}
@@ -335,6 +519,12 @@ void replay_controller::execute_command2(int command, const std::string& sparam)
 	case tgame_theme::HOTKEY_STOP_REPLAY:
 		stop_replay();
 		break;
+	case tgame_theme::HOTKEY_REPLAY_PREV_TURN:
+		replay_seek_turn(turn() - 1);
+		break;
+	case tgame_theme::HOTKEY_REPLAY_NEXT_TURN:
+		replay_seek_turn(turn() + 1);
+		break;
 	default:
 		play_controller::execute_command2(command, sparam);
 	}
@@ -25,6 +25,16 @@
 
 class video;
 
+/**
+ * Thrown by replay_controller when seeking requires restoring game state.
+ * play_replay_level restores the nearest keyframe and reconstructs controller.
+ */
+struct replay_seek_exception
+{
+	explicit replay_seek_exception(int turn) : turn(turn) {}
+	int turn;
+};
+
 class replay_controller : public play_controller
 {
 public:
@@ -39,6 +49,19 @@ public:
 	void stop_replay();
 	void replay_next_turn();
 	void replay_next_side();
+	/**
+	 * turn-level scrubbing. seek forward replays remaining commands only,
+	 * seek backward or over a later keyframe throws replay_seek_exception.
+	 */
+	void replay_seek_turn(int turn);
+	/** replay quickly until turn begins. */
+	void replay_to_turn(int turn);
+	/**
+	 * replay commands until turn begins, to the end if turn is 0. display, sound
+	 * and delay are short-circuited and only a progress bar is drawn, full view
+	 * is rebuilt when it returns.
+	 */
+	void fast_forward(int turn);
 	void process_oos(const std::string& msg) const;
 	void replay_show_everything();
 	void replay_show_each();
@@ -67,6 +90,7 @@ private:
 	virtual void play_side();
 	void update_teams();
 	void update_gui();
+	void draw_progress(int percent) const;
 
 	game_state gamestate_start_;
 	tod_manager tod_manager_start_;
@@ -74,6 +98,7 @@ private:
 	unsigned int current_turn_;
 	int delay_;
 	bool is_playing_;
+	bool fast_forward_;
 
 	bool show_everything_;
 	unsigned int show_team_;
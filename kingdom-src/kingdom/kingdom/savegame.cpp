@@ -29,6 +29,7 @@
 #include "map.hpp"
 #include "map_label.hpp"
 #include "replay.hpp"
+#include "keyframe.hpp"
 #include "resources.hpp"
 #include "serialization/binary_or_text.hpp"
 #include "serialization/parser.hpp"
@@ -37,7 +38,9 @@
 #include "formula_string_utils.hpp"
 
 #include <boost/foreach.hpp>
+#include <memory>
 #include <iomanip>
+#include <zlib.h>
 #include "posix.h"
 
 static lg::log_domain log_engine("engine");
@@ -136,6 +139,898 @@ struct save_info_less_time {
 	}
 };
 
+/**
+ * Binary savegame.
+ *
+ * header, section table, and sections. Every section has a adler32 checksum, only
+ * sections that are requested are verified when loading. The file is memory mapped
+ * and objects are rebuilt from the mapped bytes directly.
+ * summary and scenario sections are still WML text, so they can be inspected by hand.
+ *
+ * Legacy savegame begins with the length of summary data, it never equals to magic.
+ */
+static const uint32_t savegame_magic = mmioFOURCC('K', 'S', 'A', 'V');
+static const uint32_t savegame_version = 1;
+
+enum {SECTION_SUMMARY, SECTION_SCENARIO, SECTION_SIDE, SECTION_START_SCENARIO, SECTION_START_HERO,
+	SECTION_REPLAY, SECTION_HERO, SECTION_MEMBER, SECTION_KEYFRAME, SECTION_COUNT};
+
+struct tsave_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t count;
+};
+
+struct tsave_section {
+	uint32_t id;
+	uint32_t offset;
+	uint32_t size;
+	uint32_t checksum;
+};
+
+class tsection_writer
+{
+public:
+	tsection_writer(posix_file_t fp, uint32_t offset)
+		: fp_(fp)
+		, offset_(offset)
+		, current_(NULL)
+		, ok_(true)
+	{
+		memset(sections_, 0, sizeof(sections_));
+	}
+
+	void begin(int id)
+	{
+		current_ = sections_ + id;
+		current_->id = id;
+		current_->offset = offset_;
+		current_->checksum = adler32(0, NULL, 0);
+	}
+
+	void write(const void* data, uint32_t size)
+	{
+		uint32_t bytertd;
+		if (!size) {
+			return;
+		}
+		posix_fwrite(fp_, data, size, bytertd);
+		if (bytertd != size) {
+			// i.e. disk is full.
+			ok_ = false;
+		}
+		current_->checksum = adler32(current_->checksum, (const Bytef*)data, size);
+		current_->size += size;
+		offset_ += size;
+	}
+
+	const tsave_section* sections() const { return sections_; }
+	// every write wrote all of its data.
+	bool ok() const { return ok_; }
+
+private:
+	posix_file_t fp_;
+	uint32_t offset_;
+	tsave_section sections_[SECTION_COUNT];
+	tsave_section* current_;
+	bool ok_;
+};
+
+// names of leader and city of runtime group are saved in member data, not in hero data.
+static void adjust_start_heros_from_groups(hero_map& start_heros)
+{
+	for (std::map<int, tgroup>::const_iterator it = runtime_groups::gs.begin(); it != runtime_groups::gs.end(); ++ it) {
+		const tgroup& g = it->second;
+		hero& leader = start_heros[it->first];
+		hero& city = start_heros[g.city().number_];
+
+		leader.set_name(g.leader().name());
+		leader.set_surname(g.leader().surname());
+		leader.set_uid(g.leader().uid());
+
+		city.set_name(g.city().name());
+	}
+}
+
+// throw load_game_failed if section doesn't exist or is corrupted.
+static const uint8_t* binary_save_section(const tmapped_file& file, int id, uint32_t& size)
+{
+	const tsave_header* header = (const tsave_header*)file.data;
+	const tsave_section* sections = (const tsave_section*)(file.data + sizeof(tsave_header));
+	for (uint32_t i = 0; i < header->count; i ++) {
+		const tsave_section& section = sections[i];
+		if (section.id != (uint32_t)id) {
+			continue;
+		}
+		if (section.offset > (uint32_t)file.size || section.size > (uint32_t)file.size - section.offset) {
+			throw game::load_game_failed();
+		}
+		const uint8_t* data = file.data + section.offset;
+		if (adler32(adler32(0, NULL, 0), data, section.size) != section.checksum) {
+			ERR_SAVE << "checksum mismatch of section " << id << "\n";
+			throw game::load_game_failed();
+		}
+		size = section.size;
+		return data;
+	}
+	throw game::load_game_failed();
+}
+
+static void read_binary_save_file(const tmapped_file& file, config* summary_cfg, config* cfg, hero_map* start_heros, command_pool* replay_data, hero_map* heros)
+{
+	const tsave_header* header = (const tsave_header*)file.data;
+	if (header->version > savegame_version || header->count > (file.size - sizeof(tsave_header)) / sizeof(tsave_section)) {
+		throw game::load_game_failed();
+	}
+
+	const uint8_t* data;
+	uint32_t size;
+
+	if (summary_cfg) {
+		data = binary_save_section(file, SECTION_SUMMARY, size);
+		read(*summary_cfg, (const char*)data, size);
+	}
+	if (cfg) {
+		cfg->clear();
+		data = binary_save_section(file, SECTION_SCENARIO, size);
+		read(*cfg, (const char*)data, size);
+
+		data = binary_save_section(file, SECTION_SIDE, size);
+		if (size > (uint32_t)game_config::savegame_cache_size) {
+			throw game::load_game_failed();
+		}
+		if (size) {
+			memcpy(game_config::savegame_cache, data, size);
+		} else {
+			memset(game_config::savegame_cache, 0, sizeof(unit_segment2));
+		}
+
+		data = binary_save_section(file, SECTION_START_SCENARIO, size);
+		config& replay_start_cfg = cfg->add_child("replay_start");
+		read(replay_start_cfg, (const char*)data, size);
+	}
+	if (start_heros) {
+		data = binary_save_section(file, SECTION_START_HERO, size);
+		start_heros->map_from_mem(data, size);
+	}
+	if (replay_data) {
+		data = binary_save_section(file, SECTION_REPLAY, size);
+		if (size) {
+			replay_data->read(const_cast<uint8_t*>(data));
+		} else {
+			replay_data->clear();
+		}
+
+		data = binary_save_section(file, SECTION_KEYFRAME, size);
+		if (size) {
+			keyframes.from_mem(data, size);
+		} else {
+			keyframes.clear();
+		}
+	}
+	if (heros) {
+		data = binary_save_section(file, SECTION_HERO, size);
+		heros->map_from_mem(data, size);
+
+		data = binary_save_section(file, SECTION_MEMBER, size);
+		runtime_groups::from_mem(*heros, const_cast<uint8_t*>(data), size);
+		adjust_start_heros_from_groups(*start_heros);
+	}
+}
+
+/**
+ * Index of saves directory.
+ *
+ * It caches name, mtime, size and summary of every savegame, and is persisted to
+ * index_filename in saves directory, so listing saves and showing summary don't
+ * open every savegame. The cache is trusted while mtime of saves directory equals
+ * the one recorded in index, otherwise directory is listed again and summaries
+ * are reused if mtime and size of savegame are unchanged.
+ * Save and delete update it incrementally. Background writer updates it too, so
+ * every method locks.
+ */
+static const uint32_t index_magic = mmioFOURCC('K', 'I', 'D', 'X');
+static const uint32_t index_version = 1;
+static const std::string index_filename = "saves.idx";
+
+class tsave_index
+{
+public:
+	tsave_index()
+		: mutex_()
+		, entries_()
+		, dir_modified_(0)
+		, loaded_(false)
+	{}
+
+	std::vector<save_info> list(const std::string* filter);
+
+	/** summary WML text, empty if it isn't cached. */
+	std::string summary(const std::string& name);
+	void set_summary(const std::string& name, const std::string& summary);
+
+	/** savegame is written. */
+	void update(const std::string& name, const std::string& summary);
+	/** savegame is deleted. */
+	void erase(const std::string& name);
+
+private:
+	struct tentry {
+		tentry()
+			: modified(0)
+			, size(0)
+			, summary()
+		{}
+
+		time_t modified;
+		int64_t size;
+		std::string summary;
+	};
+
+	void load();
+	/**
+	 * write index to temporary file and rename it.
+	 * @param rescanned entries are what is in directory, its mtime can be trusted.
+	 */
+	void save(bool rescanned);
+	void rescan();
+	bool stat(const std::string& name, tentry& entry) const;
+
+	threading::mutex mutex_;
+	// key is utf8 name, same as save_info.
+	std::map<std::string, tentry> entries_;
+	time_t dir_modified_;
+	bool loaded_;
+};
+
+static std::string native_saves_dir()
+{
+	std::string dir = get_saves_dir();
+#ifdef _WIN32
+	conv_ansi_utf8(dir, false);
+#endif
+	return dir;
+}
+
+static std::string native_save_path(const std::string& name)
+{
+	std::string fullname = get_saves_dir() + "/" + name;
+#ifdef _WIN32
+	conv_ansi_utf8(fullname, false);
+#endif
+	return fullname;
+}
+
+bool tsave_index::stat(const std::string& name, tentry& entry) const
+{
+	const std::string fullname = native_save_path(name);
+	entry.size = file_size(fullname, false);
+	if (entry.size < 0) {
+		return false;
+	}
+	entry.modified = file_create_time(fullname);
+	return true;
+}
+
+void tsave_index::load()
+{
+	loaded_ = true;
+	entries_.clear();
+	dir_modified_ = 0;
+
+	const tmapped_file file(native_saves_dir() + "/" + index_filename);
+	if (!file.valid() || file.size < 4 * (int)sizeof(uint32_t)) {
+		return;
+	}
+	const uint8_t* mem = file.data;
+	const uint8_t* end = file.data + file.size;
+	const uint32_t* header = (const uint32_t*)mem;
+	if (header[0] != index_magic || header[1] != index_version) {
+		return;
+	}
+	const uint32_t count = header[3];
+	mem += 4 * sizeof(uint32_t);
+
+	std::map<std::string, tentry> entries;
+	for (uint32_t i = 0; i < count; i ++) {
+		// name_len, summary_len, modified, size
+		uint32_t fields[2];
+		int64_t values[2];
+		if (end - mem < (int)(sizeof(fields) + sizeof(values))) {
+			return;
+		}
+		memcpy(fields, mem, sizeof(fields));
+		mem += sizeof(fields);
+		memcpy(values, mem, sizeof(values));
+		mem += sizeof(values);
+		if (end - mem < (int)(fields[0] + fields[1])) {
+			return;
+		}
+		tentry& entry = entries[std::string((const char*)mem, fields[0])];
+		mem += fields[0];
+		entry.summary.assign((const char*)mem, fields[1]);
+		mem += fields[1];
+		entry.modified = (time_t)values[0];
+		entry.size = values[1];
+	}
+	entries_.swap(entries);
+	dir_modified_ = header[2];
+}
+
+void tsave_index::save(bool rescanned)
+{
+	const std::string dir = native_saves_dir();
+	const std::string file = dir + "/" + index_filename;
+	const std::string tmp = file + ".tmp";
+
+	posix_file_t fp;
+	uint32_t bytertd;
+	posix_fopen(tmp.c_str(), GENERIC_WRITE, CREATE_ALWAYS, fp);
+	if (fp == INVALID_FILE) {
+		ERR_SAVE << "Could not write savegame index\n";
+		return;
+	}
+
+	uint32_t header[4] = {index_magic, index_version, (uint32_t)dir_modified_, (uint32_t)entries_.size()};
+	posix_fwrite(fp, header, sizeof(header), bytertd);
+	bool ok = bytertd == sizeof(header);
+	for (std::map<std::string, tentry>::const_iterator it = entries_.begin(); ok && it != entries_.end(); ++ it) {
+		const tentry& entry = it->second;
+		uint32_t fields[2] = {(uint32_t)it->first.size(), (uint32_t)entry.summary.size()};
+		int64_t values[2] = {(int64_t)entry.modified, entry.size};
+		posix_fwrite(fp, fields, sizeof(fields), bytertd);
+		ok = bytertd == sizeof(fields);
+		posix_fwrite(fp, values, sizeof(values), bytertd);
+		ok = ok && bytertd == sizeof(values);
+		posix_fwrite(fp, it->first.c_str(), fields[0], bytertd);
+		ok = ok && bytertd == fields[0];
+		if (fields[1]) {
+			posix_fwrite(fp, entry.summary.c_str(), fields[1], bytertd);
+			ok = ok && bytertd == fields[1];
+		}
+	}
+	posix_fclose(fp);
+	if (!ok) {
+		// i.e. disk is full, keep the last good index.
+		ERR_SAVE << "Could not write savegame index\n";
+		remove(tmp.c_str());
+		return;
+	}
+	// rename() doesn't replace existing file on windows.
+	remove(file.c_str());
+	if (rename(tmp.c_str(), file.c_str())) {
+		ERR_SAVE << "Could not write savegame index\n";
+		return;
+	}
+
+	// only listing of directory knows nothing else changed it. mtime is read after
+	// rename, index itself changes it, so next run lists directory once. Modification
+	// in this second may not change mtime of directory, don't trust it.
+	if (rescanned) {
+		const time_t dir_modified = file_create_time(dir);
+		dir_modified_ = dir_modified < time(NULL)? dir_modified: 0;
+	}
+}
+
+void tsave_index::rescan()
+{
+	const std::string saves_dir = native_saves_dir();
+	std::vector<std::string> files;
+	get_files_in_dir(saves_dir, &files);
+
+	std::map<std::string, tentry> entries;
+	for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++ it) {
+		if (*it == index_filename || ends_with(*it, ".tmp")) {
+			continue;
+		}
+#ifdef _WIN32
+		const std::string name = conv_ansi_utf8_2(*it, true);
+#else
+		const std::string& name = *it;
+#endif
+		tentry& entry = entries[name];
+		if (!stat(name, entry)) {
+			entries.erase(name);
+			continue;
+		}
+		std::map<std::string, tentry>::const_iterator find = entries_.find(name);
+		if (find != entries_.end() && find->second.modified == entry.modified && find->second.size == entry.size) {
+			entry.summary = find->second.summary;
+		}
+	}
+	entries_.swap(entries);
+	save(true);
+}
+
+std::vector<save_info> tsave_index::list(const std::string* filter)
+{
+	threading::lock lock(mutex_);
+	if (!loaded_) {
+		load();
+	}
+	if (!dir_modified_ || dir_modified_ != file_create_time(native_saves_dir())) {
+		rescan();
+	}
+
+	std::vector<save_info> res;
+	for (std::map<std::string, tentry>::const_iterator it = entries_.begin(); it != entries_.end(); ++ it) {
+		if (filter && it->first.find(*filter) == std::string::npos) {
+			continue;
+		}
+		res.push_back(save_info(it->first, it->second.modified));
+	}
+	return res;
+}
+
+std::string tsave_index::summary(const std::string& name)
+{
+	threading::lock lock(mutex_);
+	if (!loaded_) {
+		load();
+	}
+	std::map<std::string, tentry>::const_iterator it = entries_.find(name);
+	if (it == entries_.end()) {
+		return null_str;
+	}
+	tentry entry;
+	if (!stat(name, entry) || entry.modified != it->second.modified || entry.size != it->second.size) {
+		return null_str;
+	}
+	return it->second.summary;
+}
+
+void tsave_index::set_summary(const std::string& name, const std::string& summary)
+{
+	threading::lock lock(mutex_);
+	if (!loaded_) {
+		load();
+	}
+	tentry entry;
+	if (!stat(name, entry)) {
+		return;
+	}
+	entry.summary = summary;
+	entries_[name] = entry;
+	save(false);
+}
+
+void tsave_index::update(const std::string& name, const std::string& summary)
+{
+	set_summary(name, summary);
+}
+
+void tsave_index::erase(const std::string& name)
+{
+	threading::lock lock(mutex_);
+	if (!loaded_) {
+		load();
+	}
+	entries_.erase(name);
+	save(false);
+}
+
+static tsave_index& save_index()
+{
+	static tsave_index index;
+	return index;
+}
+
+static void write_capture_section(tsection_writer& writer, int id, const void* data, size_t size)
+{
+	writer.begin(id);
+	writer.write(data, size);
+}
+
+static const void* capture_data(const std::vector<uint8_t>& v)
+{
+	return v.empty()? NULL: &v[0];
+}
+
+/**
+ * round trip of savegame format: every section that is read back from file
+ * equals what is captured. It runs in debug mode, file isn't used if it fails.
+ */
+static bool verify_capture(const std::string& file, const tsave_capture& capture)
+{
+	const std::pair<const void*, size_t> expected[SECTION_COUNT] = {
+		std::make_pair(capture.summary.c_str(), capture.summary.size()),
+		std::make_pair(capture.scenario.c_str(), capture.scenario.size()),
+		std::make_pair(capture_data(capture.sides), capture.sides.size()),
+		std::make_pair(capture.start_scenario.c_str(), capture.start_scenario.size()),
+		std::make_pair(capture_data(capture.start_heros), capture.start_heros.size()),
+		std::make_pair(capture_data(capture.replay), capture.replay.size()),
+		std::make_pair(capture_data(capture.heros), capture.heros.size()),
+		std::make_pair(capture_data(capture.members), capture.members.size()),
+		std::make_pair(capture_data(capture.keyframes), capture.keyframes.size())
+	};
+
+	const tmapped_file mapped(file);
+	if (!mapped.valid() || mapped.size < (int)sizeof(tsave_header) || ((const tsave_header*)mapped.data)->magic != savegame_magic) {
+		ERR_SAVE << "savegame " << file << " can not be read back\n";
+		return false;
+	}
+	try {
+		for (int id = 0; id < SECTION_COUNT; id ++) {
+			uint32_t size;
+			const uint8_t* data = binary_save_section(mapped, id, size);
+			if (size != expected[id].second || (size && memcmp(data, expected[id].first, size))) {
+				ERR_SAVE << "section " << id << " of savegame " << file << " differs from what is written\n";
+				return false;
+			}
+		}
+	} catch (game::load_game_failed&) {
+		ERR_SAVE << "savegame " << file << " can not be read back\n";
+		return false;
+	}
+	return true;
+}
+
+void write_capture(const tsave_capture& capture)
+{
+	static const std::vector<uint8_t> empty(1);
+	posix_file_t fp;
+	uint32_t bytertd;
+
+	const std::string tmpfilename = capture.filename + ".tmp";
+#ifdef _WIN32
+	// utf8 ---> utf16
+	int wlen = MultiByteToWideChar(CP_UTF8, 0, tmpfilename.c_str(), -1, NULL, 0);
+	WCHAR *wc = new WCHAR[wlen];
+	MultiByteToWideChar(CP_UTF8, 0, tmpfilename.c_str(), -1, wc, wlen);
+			
+	fp = CreateFileW(wc, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+			CREATE_ALWAYS, 0, NULL);
+	// posix_fopen(wc, GENERIC_WRITE, CREATE_ALWAYS, fp);
+#else
+	posix_fopen(tmpfilename.c_str(), GENERIC_WRITE, CREATE_ALWAYS, fp);
+#endif
+	
+	if (fp == INVALID_FILE) {
+#ifdef _WIN32
+		delete [] wc;
+#endif
+		throw game::save_game_failed(_("Could not write to file"));
+	}
+
+	tsave_header header;
+	header.magic = savegame_magic;
+	header.version = savegame_version;
+	header.count = SECTION_COUNT;
+	// section table is written after all sections are written.
+	tsave_section sections[SECTION_COUNT];
+	memset(sections, 0, sizeof(sections));
+	posix_fwrite(fp, &header, sizeof(header), bytertd);
+	bool ok = bytertd == sizeof(header);
+	posix_fwrite(fp, sections, sizeof(sections), bytertd);
+	ok = ok && bytertd == sizeof(sections);
+
+	tsection_writer writer(fp, sizeof(header) + sizeof(sections));
+#define CAPTURE_DATA(v)	((v).empty()? &empty[0]: &(v)[0]), (v).size()
+	write_capture_section(writer, SECTION_SUMMARY, capture.summary.c_str(), capture.summary.size());
+	write_capture_section(writer, SECTION_SCENARIO, capture.scenario.c_str(), capture.scenario.size());
+	write_capture_section(writer, SECTION_SIDE, CAPTURE_DATA(capture.sides));
+	write_capture_section(writer, SECTION_START_SCENARIO, capture.start_scenario.c_str(), capture.start_scenario.size());
+	write_capture_section(writer, SECTION_START_HERO, CAPTURE_DATA(capture.start_heros));
+	write_capture_section(writer, SECTION_REPLAY, CAPTURE_DATA(capture.replay));
+	write_capture_section(writer, SECTION_HERO, CAPTURE_DATA(capture.heros));
+	write_capture_section(writer, SECTION_MEMBER, CAPTURE_DATA(capture.members));
+	write_capture_section(writer, SECTION_KEYFRAME, CAPTURE_DATA(capture.keyframes));
+#undef CAPTURE_DATA
+
+	posix_fseek(fp, sizeof(header), 0);
+	posix_fwrite(fp, writer.sections(), sizeof(sections), bytertd);
+	ok = ok && writer.ok() && bytertd == sizeof(sections);
+	posix_fclose(fp);
+	ok = ok && (!game_config::debug || verify_capture(tmpfilename, capture));
+
+	if (!ok) {
+		// truncated file must not replace the last good savegame.
+#ifdef _WIN32
+		DeleteFileW(wc);
+		delete [] wc;
+#else
+		remove(tmpfilename.c_str());
+#endif
+		throw game::save_game_failed(_("Could not write to file"));
+	}
+
+	// replace old savegame
+#ifdef _WIN32
+	wlen = MultiByteToWideChar(CP_UTF8, 0, capture.filename.c_str(), -1, NULL, 0);
+	WCHAR *wc2 = new WCHAR[wlen];
+	MultiByteToWideChar(CP_UTF8, 0, capture.filename.c_str(), -1, wc2, wlen);
+	ok = MoveFileExW(wc, wc2, MOVEFILE_REPLACE_EXISTING)? true: false;
+	delete [] wc;
+	delete [] wc2;
+#else
+	ok = rename(tmpfilename.c_str(), capture.filename.c_str()) == 0;
+#endif
+	if (!ok) {
+		throw game::save_game_failed(_("Could not write to file"));
+	}
+	save_index().update(capture.filename.substr(capture.filename.rfind('/') + 1), capture.summary);
+}
+
+tasync_writer::tasync_writer()
+	: mutex_()
+	, cond_()
+	, queue_()
+	, busy_(false)
+	, quit_(false)
+	, error_()
+	, thread_(NULL)
+{}
+
+tasync_writer::~tasync_writer()
+{
+	if (thread_) {
+		{
+			threading::lock lock(mutex_);
+			quit_ = true;
+			cond_.notify_all();
+		}
+		// thread writes all pending captures before quit.
+		delete thread_;
+	}
+}
+
+int tasync_writer::thread_main(void* data)
+{
+	static_cast<tasync_writer*>(data)->run();
+	return 0;
+}
+
+void tasync_writer::run()
+{
+	for (; ;) {
+		tsave_capture* capture;
+		{
+			threading::lock lock(mutex_);
+			while (queue_.empty() && !quit_) {
+				cond_.wait(mutex_);
+			}
+			if (queue_.empty()) {
+				return;
+			}
+			capture = queue_.front();
+			queue_.pop_front();
+			busy_ = true;
+		}
+
+		std::string error;
+		try {
+			const Uint32 start = SDL_GetTicks();
+			write_capture(*capture);
+			LOG_SAVE << "Milliseconds to write " << capture->filename << " in background: " << SDL_GetTicks() - start << "\n";
+			if (capture->autosave_max >= 0) {
+				manager::remove_old_auto_saves(capture->autosave_max, capture->infinite_autosaves);
+			}
+		} catch (game::error& e) {
+			// save_game_failed, io_exception, config::error...
+			error = e.message.empty()? _("Could not write to file"): e.message;
+		} catch (std::exception& e) {
+			error = e.what();
+		} catch (...) {
+			// nothing may escape this thread, busy_ must be cleared.
+			error = _("Could not write to file");
+		}
+		delete capture;
+
+		{
+			threading::lock lock(mutex_);
+			if (!error.empty()) {
+				ERR_SAVE << "background save failed: " << error << "\n";
+				error_ = error;
+			}
+			busy_ = false;
+			cond_.notify_all();
+		}
+	}
+}
+
+void tasync_writer::push(tsave_capture* capture)
+{
+	threading::lock lock(mutex_);
+	if (!thread_) {
+		thread_ = new threading::thread(thread_main, this);
+	}
+	while (queue_.size() >= max_pending) {
+		cond_.wait(mutex_);
+	}
+	queue_.push_back(capture);
+	cond_.notify_all();
+}
+
+void tasync_writer::wait()
+{
+	threading::lock lock(mutex_);
+	while (!queue_.empty() || busy_) {
+		cond_.wait(mutex_);
+	}
+}
+
+std::string tasync_writer::pop_error()
+{
+	threading::lock lock(mutex_);
+	std::string error;
+	error.swap(error_);
+	return error;
+}
+
+tasync_writer& async_writer()
+{
+	static tasync_writer writer;
+	return writer;
+}
+
+bool show_async_error(CVideo& video)
+{
+	const std::string error = async_writer().pop_error();
+	if (error.empty()) {
+		return false;
+	}
+	gui2::show_error_message(video, _("Could not auto save the game. Please save the game manually.") + std::string("\n") + error);
+	return true;
+}
+
+static Uint64 elapsed_us(Uint64 start)
+{
+	return (SDL_GetPerformanceCounter() - start) * 1000000 / SDL_GetPerformanceFrequency();
+}
+
+// everything read_binary_save_file() rebuilds from one savegame.
+struct tdecoded_save
+{
+	tdecoded_save()
+		: summary()
+		, cfg()
+		, start_heros()
+		, replay_data()
+		, heros()
+	{}
+
+	config summary;
+	config cfg;
+	hero_map start_heros;
+	command_pool replay_data;
+	hero_map heros;
+};
+
+static Uint64 decode_save(const tmapped_file& file, tdecoded_save& save)
+{
+	const Uint64 start = SDL_GetPerformanceCounter();
+	read_binary_save_file(file, &save.summary, &save.cfg, &save.start_heros, &save.replay_data, &save.heros);
+	return elapsed_us(start);
+}
+
+static std::vector<uint8_t> heros_bytes(const hero_map& heros)
+{
+	std::vector<uint8_t> bytes(heros.file_size());
+	if (!bytes.empty()) {
+		heros.map_to_mem(&bytes[0]);
+	}
+	return bytes;
+}
+
+static bool same_decoded(const tdecoded_save& a, const tdecoded_save& b)
+{
+	const command_pool& ra = a.replay_data;
+	const command_pool& rb = b.replay_data;
+	return a.summary == b.summary && a.cfg == b.cfg
+		&& heros_bytes(a.start_heros) == heros_bytes(b.start_heros) && heros_bytes(a.heros) == heros_bytes(b.heros)
+		&& ra.pool_data_size() == rb.pool_data_size() && ra.pool_pos_vsize() == rb.pool_pos_vsize()
+		&& !memcmp(ra.pool_data(), rb.pool_data(), ra.pool_data_size())
+		&& !memcmp(ra.pool_pos(), rb.pool_pos(), ra.pool_pos_vsize() * sizeof(unsigned int));
+}
+
+bool round_trip(std::ostream& out, const std::string& name)
+{
+	const std::string file = get_saves_dir() + "/" + name;
+	const std::string scratch = get_user_data_dir() + "/round-trip.sav";
+	int errors = 0;
+
+	tsave_capture capture;
+	tdecoded_save original;
+	{
+		const tmapped_file mapped(file);
+		if (!mapped.valid() || mapped.size < (int)sizeof(tsave_header) || ((const tsave_header*)mapped.data)->magic != savegame_magic) {
+			out << name << " isn't a binary savegame\n";
+			return false;
+		}
+		out << name << ", " << mapped.size / 1024 << " KB\n";
+
+		const Uint64 start = SDL_GetPerformanceCounter();
+		uint32_t size;
+		const uint8_t* data;
+		data = binary_save_section(mapped, SECTION_SUMMARY, size);
+		capture.summary.assign((const char*)data, size);
+		data = binary_save_section(mapped, SECTION_SCENARIO, size);
+		capture.scenario.assign((const char*)data, size);
+		data = binary_save_section(mapped, SECTION_SIDE, size);
+		capture.sides.assign(data, data + size);
+		data = binary_save_section(mapped, SECTION_START_SCENARIO, size);
+		capture.start_scenario.assign((const char*)data, size);
+		data = binary_save_section(mapped, SECTION_START_HERO, size);
+		capture.start_heros.assign(data, data + size);
+		data = binary_save_section(mapped, SECTION_REPLAY, size);
+		capture.replay.assign(data, data + size);
+		data = binary_save_section(mapped, SECTION_HERO, size);
+		capture.heros.assign(data, data + size);
+		data = binary_save_section(mapped, SECTION_MEMBER, size);
+		capture.members.assign(data, data + size);
+		data = binary_save_section(mapped, SECTION_KEYFRAME, size);
+		capture.keyframes.assign(data, data + size);
+		out << std::setw(24) << "verify sections" << std::setw(12) << elapsed_us(start) << " us\n";
+
+		out << std::setw(24) << "load" << std::setw(12) << decode_save(mapped, original) << " us\n";
+	}
+
+	// same scenario through text format, that legacy savegame uses.
+	{
+		Uint64 start = SDL_GetPerformanceCounter();
+		std::stringstream text;
+		{
+			config_writer writer(text, true);
+			writer.write(original.cfg);
+		}
+		out << std::setw(24) << "write scenario as text" << std::setw(12) << elapsed_us(start) << " us, " << text.str().size() / 1024 << " KB\n";
+		start = SDL_GetPerformanceCounter();
+		config cfg;
+		read_gz(cfg, text);
+		out << std::setw(24) << "read scenario as text" << std::setw(12) << elapsed_us(start) << " us\n";
+	}
+
+	capture.filename = scratch;
+	Uint64 start = SDL_GetPerformanceCounter();
+	write_capture(capture);
+	out << std::setw(24) << "save" << std::setw(12) << elapsed_us(start) << " us\n";
+
+	uint32_t offset = 0;
+	uint8_t byte = 0;
+	{
+		const tmapped_file mapped(scratch);
+		if (!verify_capture(scratch, capture)) {
+			out << "sections of written savegame differ\n";
+			errors ++;
+		}
+		tdecoded_save copy;
+		decode_save(mapped, copy);
+		if (!same_decoded(original, copy)) {
+			out << "savegame that is read back differs from original\n";
+			errors ++;
+		}
+		uint32_t size;
+		const uint8_t* data = binary_save_section(mapped, SECTION_SCENARIO, size);
+		offset = data - mapped.data + size / 2;
+		byte = data[size / 2] ^ 0xff;
+	}
+
+	// corrupt one byte of scenario, load must reject it.
+	{
+		posix_file_t fp;
+		uint32_t bytertd;
+		posix_fopen(scratch.c_str(), GENERIC_WRITE, OPEN_EXISTING, fp);
+		if (fp != INVALID_FILE) {
+			posix_fseek(fp, offset, 0);
+			posix_fwrite(fp, &byte, 1, bytertd);
+			posix_fclose(fp);
+		}
+		const tmapped_file mapped(scratch);
+		tdecoded_save corrupt;
+		try {
+			decode_save(mapped, corrupt);
+			out << "corrupt section isn't detected\n";
+			errors ++;
+		} catch (game::load_game_failed&) {
+			out << std::setw(24) << "corrupt section" << "  rejected\n";
+		}
+	}
+	remove(scratch.c_str());
+
+	out << errors << " errors\n";
+	return !errors;
+}
+
 // @name: short file name. uft8 codeset.
 // @start_heros: NULL, don't read start hero data
 // @replay_data: NULL, don't read replay data
@@ -145,8 +1040,22 @@ void manager::read_save_file(const std::string& name, config* summary_cfg, confi
 	std::string modified_name = name;
 	// replace_space2underbar(modified_name);
 
+	// background writer may be writing this file.
+	async_writer().wait();
+
 	try {
 		std::string str = get_saves_dir() + "/" + modified_name;
+		{
+			const Uint32 start = SDL_GetTicks();
+			const tmapped_file file(str);
+			if (file.valid() && file.size >= (int)sizeof(tsave_header) && ((const tsave_header*)file.data)->magic == savegame_magic) {
+				read_binary_save_file(file, summary_cfg, cfg, start_heros, replay_data, heros);
+				LOG_SAVE << "Milliseconds to load " << name << ": " << SDL_GetTicks() - start << "\n";
+				return;
+			}
+		}
+
+		// legacy savegame
 		posix_file_t fp = INVALID_FILE;
 #ifdef _WIN32
 		// utf8 ---> utf16
@@ -244,7 +1153,7 @@ void manager::read_save_file(const std::string& name, config* summary_cfg, confi
 			posix_fread(fp, data, start_scenario_size, bytertd);
 			data[start_scenario_size] = '\0';
 			config& replay_start_cfg = cfg->add_child("replay_start");
-			read(replay_start_cfg, std::string((char*)data));
+			read(replay_start_cfg, (const char*)data, start_scenario_size);
 
 		} else {
 			posix_fseek(fp, should_least_size, 0);
@@ -278,21 +1187,16 @@ void manager::read_save_file(const std::string& name, config* summary_cfg, confi
 		// read member data
 		if (heros) {
 			runtime_groups::from_fp(*heros, fp, member_data_size);
-			for (std::map<int, tgroup>::const_iterator it = runtime_groups::gs.begin(); it != runtime_groups::gs.end(); ++ it) {
-				const tgroup& g = it->second;
-				hero& leader = (*start_heros)[it->first];
-				hero& city = (*start_heros)[g.city().number_];
-
-				leader.set_name(g.leader().name());
-				leader.set_surname(g.leader().surname());
-				leader.set_uid(g.leader().uid());
-
-				city.set_name(g.city().name());
-			}
+			adjust_start_heros_from_groups(*start_heros);
 		}
 		should_least_size += member_data_size;
 		posix_fseek(fp, should_least_size, 0);
 
+		// legacy savegame hasn't keyframe data.
+		if (replay_data) {
+			keyframes.clear();
+		}
+
 		posix_fclose(fp);
 
 		// detect_format_and_read(cfg, *file_stream, error_log);
@@ -304,7 +1208,21 @@ void manager::read_save_file(const std::string& name, config* summary_cfg, confi
 
 void manager::load_summary(const std::string& name, config& cfg_summary, std::string* error_log)
 {
+	const std::string summary = save_index().summary(name);
+	if (!summary.empty()) {
+		try {
+			::read(cfg_summary, summary);
+			return;
+		} catch (config::error&) {
+			cfg_summary.clear();
+		}
+	}
+
 	read_save_file(name, &cfg_summary, NULL, NULL, NULL, NULL, error_log);
+
+	std::stringstream strstr;
+	::write(strstr, cfg_summary);
+	save_index().set_summary(name, strstr.str());
 }
 
 bool manager::save_game_exists(const std::string& name)
@@ -321,8 +1239,14 @@ bool manager::save_game_exists(const std::string& name)
 
 std::vector<save_info> manager::get_saves_list(const std::string *dir, const std::string* filter)
 {
+	if (!dir || *dir == get_saves_dir()) {
+		std::vector<save_info> res = save_index().list(filter);
+		std::sort(res.begin(), res.end(), save_info_less_time());
+		return res;
+	}
+
 	// Don't use a reference, it seems to break on arklinux with GCC-4.3.
-	std::string saves_dir = (dir) ? *dir : get_saves_dir();
+	std::string saves_dir = *dir;
 #ifdef _WIN32
 	conv_ansi_utf8(saves_dir, false);
 #endif
@@ -371,9 +1295,6 @@ void manager::remove_old_auto_saves(const int autosavemax, const int infinite_au
 	if (countdown == infinite_auto_saves)
 		return;
 
-#ifdef _WIN32
-	conv_ansi_utf8(auto_save, false);
-#endif
 	std::vector<save_info> games = get_saves_list(NULL, &auto_save);
 	for (std::vector<save_info>::iterator i = games.begin(); i != games.end(); ++i) {
 		if (countdown-- <= 0) {
@@ -393,6 +1314,7 @@ void manager::delete_game(const std::string& name)
 	conv_ansi_utf8(fullname, false);
 #endif
 	remove(fullname.c_str());
+	save_index().erase(name);
 
 	// remove((get_saves_dir() + "/" + modified_name).c_str());
 }
@@ -611,8 +1533,18 @@ savegame::savegame(hero_map& heros, hero_map& heros_start, game_state& gamestate
 	, title_(title)
 	, error_message_(_("The game could not be saved: "))
 	, show_confirmation_(false)
+	, async_(false)
+	, autosave_max_(-1)
+	, infinite_autosaves_(-1)
 {}
 
+void savegame::set_async(int autosave_max, int infinite_autosaves)
+{
+	async_ = true;
+	autosave_max_ = autosave_max;
+	infinite_autosaves_ = infinite_autosaves;
+}
+
 bool savegame::save_game_automatic(CVideo& video, bool ask_for_overwrite, const std::string& filename)
 {
 	bool overwrite = true;
@@ -813,104 +1745,52 @@ void savegame::write_game_to_disk(const std::string& filename)
 	extract_summary_data_from_save(cfg_summary);
 	::write(summary_ss, cfg_summary);
 
-	// if enable compress, ss.str() is compressed format data.
-	posix_file_t fp;
-	uint32_t summary_size, scenario_size, side_size, start_scenario_size, start_hero_size, replay_size, hero_size, member_data_size, bytertd;
-	int size;
+	// owned here until background writer takes it, filling it may throw.
+	std::auto_ptr<tsave_capture> capture(new tsave_capture);
 
 	// replace_space2underbar(filename_);
-	std::string fullfilename = get_saves_dir() + "/" + filename_;
-#ifdef _WIN32
-	// utf8 ---> utf16
-	int wlen = MultiByteToWideChar(CP_UTF8, 0, fullfilename.c_str(), -1, NULL, 0);
-	WCHAR *wc = new WCHAR[wlen];
-	MultiByteToWideChar(CP_UTF8, 0, fullfilename.c_str(), -1, wc, wlen);
-			
-	fp = CreateFileW(wc, GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
-			CREATE_ALWAYS, 0, NULL);
-	// posix_fopen(wc, GENERIC_WRITE, CREATE_ALWAYS, fp);
-	delete [] wc;
-#else
-	posix_fopen(fullfilename.c_str(), GENERIC_WRITE, CREATE_ALWAYS, fp);
-#endif
-	
-	if (fp == INVALID_FILE) {
-		throw game::save_game_failed(_("Could not write to file"));
-	}
+	capture->filename = get_saves_dir() + "/" + filename_;
+	capture->summary = summary_ss.str();
+	capture->scenario = ss.str();
+	capture->sides.assign(game_config::savegame_cache, game_config::savegame_cache + ((unit_segment2*)game_config::savegame_cache)->size_);
+	capture->start_scenario = gamestate_.start_scenario_ss.str();
+	capture->start_heros.assign(gamestate_.start_hero_data_, gamestate_.start_hero_data_ + heros_start_.file_size());
 
-	// length of summary data
-	summary_size = summary_ss.str().length();
-	// length of scenario data
-	scenario_size = ss.str().length();
-	// length of side data
-	side_size = ((unit_segment2*)game_config::savegame_cache)->size_;
-	// length of start scenario data
-	start_scenario_size = gamestate_.start_scenario_ss.str().length();
-	// length of start hero data
-	start_hero_size = heros_start_.file_size();
-	// length of replay data
-	if (gamestate_.replay_data.pool_pos_vsize()) {
-		replay_size = 16 + gamestate_.replay_data.pool_data_gzip_size() + gamestate_.replay_data.pool_pos_vsize() * sizeof(unsigned int);
-	} else {
-		replay_size = 0;
-	}
-	// length of runtime hero data
-	hero_size = heros_.file_size();
-	// length of runtime-member data
-	member_data_size = runtime_groups::size();
-
-	// [write] length of summary data
-	posix_fwrite(fp, &summary_size, sizeof(summary_size), bytertd);
-	// [write] length of scenario data
-	posix_fwrite(fp, &scenario_size, sizeof(scenario_size), bytertd);
-	// [write] length of side data
-	posix_fwrite(fp, &side_size, sizeof(side_size), bytertd);
-	// [write] length of start scenario data
-	posix_fwrite(fp, &start_scenario_size, sizeof(start_scenario_size), bytertd);
-	// [write] length of start hero data
-	posix_fwrite(fp, &start_hero_size, sizeof(start_hero_size), bytertd);
-	// [write] length of replay data
-	posix_fwrite(fp, &replay_size, sizeof(replay_size), bytertd);
-	// [write] length of runtime hero data
-	posix_fwrite(fp, &hero_size, sizeof(hero_size), bytertd);
-	// [write] length of member data
-	posix_fwrite(fp, &member_data_size, sizeof(member_data_size), bytertd);
-
-	// summary data
-	posix_fwrite(fp, summary_ss.str().c_str(), summary_ss.str().length(), bytertd);
-	// scenario data
-	posix_fwrite(fp, ss.str().c_str(), ss.str().length(), bytertd);
-	// side data
-	if (side_size) {
-		posix_fwrite(fp, game_config::savegame_cache, side_size, bytertd);
-	}
-	// start scenario data
-	posix_fwrite(fp, gamestate_.start_scenario_ss.str().c_str(), gamestate_.start_scenario_ss.str().length(), bytertd);
-	// start hero data
-	posix_fwrite(fp, gamestate_.start_hero_data_, start_hero_size, bytertd);
-	
 	// replay data
-	if (replay_size) {
-		size = gamestate_.replay_data.pool_data_size();
-		posix_fwrite(fp, &size, sizeof(size), bytertd);
-		size = gamestate_.replay_data.pool_data_gzip_size();
-		posix_fwrite(fp, &size, sizeof(size), bytertd);
-		size = gamestate_.replay_data.pool_pos_size();
-		posix_fwrite(fp, &size, sizeof(size), bytertd);
-		size = gamestate_.replay_data.pool_pos_vsize();
-		posix_fwrite(fp, &size, sizeof(size), bytertd);
-		// pool data
-		posix_fwrite(fp, gamestate_.replay_data.pool_data(), gamestate_.replay_data.pool_data_gzip_size(), bytertd);
-		// pool pos
-		posix_fwrite(fp, gamestate_.replay_data.pool_pos(), gamestate_.replay_data.pool_pos_vsize() * sizeof(unsigned int), bytertd);
-	}
-
-	// hero data
-	heros_.map_to_file_fp(fp);
-	// member data
-	runtime_groups::to_fp(fp); 
+	const command_pool& replay_data = gamestate_.replay_data;
+	if (replay_data.pool_pos_vsize()) {
+		const int gzip_size = replay_data.pool_data_gzip_size();
+		const int pos_size = replay_data.pool_pos_vsize() * sizeof(unsigned int);
+		capture->replay.resize(16 + gzip_size + pos_size);
+		int* ptr = (int*)&capture->replay[0];
+		ptr[0] = replay_data.pool_data_size();
+		ptr[1] = gzip_size;
+		ptr[2] = replay_data.pool_pos_size();
+		ptr[3] = replay_data.pool_pos_vsize();
+		memcpy(&capture->replay[16], replay_data.pool_data(), gzip_size);
+		memcpy(&capture->replay[16 + gzip_size], replay_data.pool_pos(), pos_size);
+	}
 
-	posix_fclose(fp);
+	capture->heros.resize(heros_.file_size());
+	heros_.map_to_mem(&capture->heros[0]);
+
+	capture->members.resize(runtime_groups::size());
+	if (!capture->members.empty()) {
+		runtime_groups::to_mem(&capture->members[0]);
+	}
+
+	capture->keyframes.resize(keyframes.mem_size());
+	if (!capture->keyframes.empty()) {
+		keyframes.to_mem(&capture->keyframes[0]);
+	}
+
+	if (async_) {
+		capture->autosave_max = autosave_max_;
+		capture->infinite_autosaves = infinite_autosaves_;
+		async_writer().push(capture.release());
+	} else {
+		write_capture(*capture);
+	}
 }
 
 void savegame::write_game(config_writer &out) const
@@ -1061,12 +1941,15 @@ autosave_savegame::autosave_savegame(hero_map& heros, hero_map& heros_start, gam
 
 void autosave_savegame::autosave(const bool disable_autosave, const int autosave_max, const int infinite_autosaves)
 {
+	// report failure of previous background autosave.
+	show_async_error(gui_.video());
+
 	if(disable_autosave)
 		return;
 
+	// old autosaves are removed by background writer.
+	set_async(autosave_max, infinite_autosaves);
 	save_game_automatic(gui_.video());
-
-	manager::remove_old_auto_saves(autosave_max, infinite_autosaves);
 }
 
 void autosave_savegame::create_filename()
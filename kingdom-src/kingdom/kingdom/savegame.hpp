@@ -20,6 +20,9 @@
 #include "gamestatus.hpp"
 #include "tod_manager.hpp"
 #include "display.hpp"
+#include "thread.hpp"
+
+#include <deque>
 
 class config_writer;
 class game_display;
@@ -123,6 +126,96 @@ private:
 	bool allow_network_; /** State of the "cancel_orders" checkbox in the load-game dialog. */
 };
 
+/**
+ * A savegame captured on game thread. Every section is a copy, so writing it to
+ * disk doesn't touch game state.
+ */
+struct tsave_capture
+{
+	tsave_capture()
+		: filename()
+		, summary()
+		, scenario()
+		, sides()
+		, start_scenario()
+		, start_heros()
+		, replay()
+		, heros()
+		, members()
+		, keyframes()
+		, autosave_max(-1)
+		, infinite_autosaves(-1)
+	{}
+
+	std::string filename; /** full filename */
+	std::string summary;
+	std::string scenario;
+	std::vector<uint8_t> sides;
+	std::string start_scenario;
+	std::vector<uint8_t> start_heros;
+	std::vector<uint8_t> replay;
+	std::vector<uint8_t> heros;
+	std::vector<uint8_t> members;
+	std::vector<uint8_t> keyframes;
+
+	/** if >= 0, remove old autosaves after writing. */
+	int autosave_max;
+	int infinite_autosaves;
+};
+
+/** Write a captured savegame to disk. temp file then rename, so it is atomic. */
+void write_capture(const tsave_capture& capture);
+
+/**
+ * Writes captured savegames on a background thread, so that autosave doesn't pause
+ * the game. At most max_pending captures are pending, push blocks when queue is full.
+ */
+class tasync_writer
+{
+public:
+	enum {max_pending = 2};
+
+	tasync_writer();
+	~tasync_writer();
+
+	/** take ownership of capture. */
+	void push(tsave_capture* capture);
+
+	/** block until every pending capture is written. Loading and shutdown must call it. */
+	void wait();
+
+	/** error of the last failed background save, empty if none. */
+	std::string pop_error();
+
+private:
+	static int thread_main(void* data);
+	void run();
+
+	threading::mutex mutex_;
+	threading::condition cond_;
+	std::deque<tsave_capture*> queue_;
+	bool busy_;
+	bool quit_;
+	std::string error_;
+	threading::thread* thread_;
+};
+
+tasync_writer& async_writer();
+
+/**
+ * tell player that a background save failed, if one failed since last call.
+ * @return true if error is shown.
+ */
+bool show_async_error(CVideo& video);
+
+/**
+ * round trip of binary savegame in saves directory: load it, write it to a scratch
+ * file, load that again and compare, then check that a corrupt section is rejected.
+ * Timings of every step are printed to out.
+ * @return false if savegame isn't binary or round trip differs.
+ */
+bool round_trip(std::ostream& out, const std::string& name);
+
 /** The base class for all savegame stuff */
 class savegame
 {
@@ -169,6 +262,9 @@ protected:
 	/** If there needs to be some data fiddling before saving the game, this is the place to go. */
 	virtual void before_save();
 
+	/** Capture on game thread, and write on background thread. */
+	void set_async(int autosave_max, int infinite_autosaves);
+
 	hero_map& heros_;
 	hero_map& heros_start_;
 
@@ -206,6 +302,10 @@ private:
 	std::string error_message_; /** Error message to be displayed if the savefile could not be generated. */
 
 	bool show_confirmation_; /** Determines if a confirmation of successful saving the game is shown. */
+
+	bool async_; /** Write by async_writer. */
+	int autosave_max_;
+	int infinite_autosaves_;
 };
 
 /** Class for "normal" midgame saves. The additional members are needed for creating the snapshot
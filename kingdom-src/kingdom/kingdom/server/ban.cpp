@@ -22,8 +22,11 @@
 
 #include "ban.hpp"
 
+#include "SDL_timer.h"
 #include <boost/foreach.hpp>
 #include <boost/bind.hpp>
+#include <cstring>
+#include <iomanip>
 
 namespace wesnothd {
 
@@ -57,7 +60,271 @@ static lg::log_domain log_server("server");
 
 	bool banned_compare_subnet::less(const banned_ptr& a, const banned_ptr& b) const
 	{
-		return a->get_int_ip() < b->get_int_ip();
+		// for IPv4, it is same as order of get_int_ip().
+		return memcmp(a->prefix().bytes, b->prefix().bytes, sizeof(a->prefix().bytes)) < 0;
+	}
+
+	ip_prefix::ip_prefix() :
+		bits(0),
+		ipv6(false)
+	{
+		memset(bytes, 0, sizeof(bytes));
+	}
+
+	static bool parse_ipv6_groups(const std::string& text, std::vector<unsigned int>& groups)
+	{
+		if (text.empty()) {
+			return true;
+		}
+		size_t start = 0;
+		while (true) {
+			const size_t end = text.find(':', start);
+			const std::string group = text.substr(start, end == std::string::npos? end: end - start);
+			if (group.empty() || group.size() > 4 || group.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+				return false;
+			}
+			groups.push_back(strtoul(group.c_str(), NULL, 16));
+			if (end == std::string::npos) {
+				return true;
+			}
+			start = end + 1;
+		}
+	}
+
+	static void parse_ipv6(const std::string& ip, ip_prefix& ret)
+	{
+		const size_t slash = ip.find('/');
+		const std::string address = ip.substr(0, slash);
+		ret.bits = 128;
+		if (slash != std::string::npos) {
+			ret.bits = lexical_cast_default<int>(ip.substr(slash + 1), -1);
+			if (ret.bits < 0 || ret.bits > 128) {
+				throw banned::error("Malformed ip address: '" + ip + "'");
+			}
+		}
+
+		std::vector<unsigned int> head, tail;
+		const size_t compressed = address.find("::");
+		bool ok;
+		if (compressed == std::string::npos) {
+			ok = parse_ipv6_groups(address, head) && head.size() == 8;
+		} else {
+			ok = parse_ipv6_groups(address.substr(0, compressed), head) &&
+				parse_ipv6_groups(address.substr(compressed + 2), tail) && head.size() + tail.size() <= 7;
+		}
+		if (!ok) {
+			throw banned::error("Malformed ip address: '" + ip + "'");
+		}
+		for (size_t i = 0; i < head.size(); i ++) {
+			ret.bytes[i * 2] = head[i] >> 8;
+			ret.bytes[i * 2 + 1] = head[i] & 0xff;
+		}
+		for (size_t i = 0; i < tail.size(); i ++) {
+			const size_t at = 16 - (tail.size() - i) * 2;
+			ret.bytes[at] = tail[i] >> 8;
+			ret.bytes[at + 1] = tail[i] & 0xff;
+		}
+		// host bits behind prefix are zero, 2001:db8::1/32 is same ban as 2001:db8::/32.
+		for (int i = 0; i < 16; i ++) {
+			const int remain = ret.bits - i * 8;
+			if (remain <= 0) {
+				ret.bytes[i] = 0;
+			} else if (remain < 8) {
+				ret.bytes[i] &= 0xff << (8 - remain);
+			}
+		}
+	}
+
+	ip_prefix parse_ip_prefix(const std::string& ip, ip_mask* ipv4)
+	{
+		ip_prefix ret;
+		if (ip.find(':') != std::string::npos) {
+			parse_ipv6(ip, ret);
+			ret.ipv6 = true;
+			if (ipv4) {
+				*ipv4 = ip_mask(0, 0);
+			}
+			return ret;
+		}
+
+		const ip_mask pair = parse_ip(ip);
+		ret.bytes[10] = ret.bytes[11] = 0xff;
+		for (int i = 0; i < 4; i ++) {
+			ret.bytes[12 + i] = (pair.first >> (24 - i * 8)) & 0xff;
+		}
+		const unsigned int inverse = ~pair.second;
+		if ((inverse & (inverse + 1)) == 0) {
+			int bits = 0;
+			for (unsigned int mask = pair.second; mask; mask <<= 1) {
+				bits ++;
+			}
+			ret.bits = 96 + bits;
+		} else {
+			ret.bits = -1;
+		}
+		if (ipv4) {
+			*ipv4 = pair;
+		}
+		return ret;
+	}
+
+	struct ban_trie::node {
+		node(const unsigned char* key, int bits) :
+			bits(bits),
+			ban()
+		{
+			// bits behind prefix are zero.
+			for (int i = 0; i < 16; i ++) {
+				const int remain = bits - i * 8;
+				bytes[i] = remain >= 8? key[i]: (remain <= 0? 0: key[i] & (0xff << (8 - remain)));
+			}
+			child[0] = child[1] = NULL;
+		}
+		~node()
+		{
+			delete child[0];
+			delete child[1];
+		}
+
+		unsigned char bytes[16];
+		int bits;
+		banned_ptr ban;
+		node* child[2];
+	};
+
+	static int key_bit(const unsigned char* key, int n)
+	{
+		return (key[n >> 3] >> (7 - (n & 7))) & 1;
+	}
+
+	// count of same leading bits, at most max.
+	static int common_bits(const unsigned char* a, const unsigned char* b, int max)
+	{
+		int n = 0;
+		while (n < max) {
+			if ((n & 7) == 0 && n + 8 <= max && a[n >> 3] == b[n >> 3]) {
+				n += 8;
+				continue;
+			}
+			if (key_bit(a, n) != key_bit(b, n)) {
+				break;
+			}
+			n ++;
+		}
+		return n;
+	}
+
+	ban_trie::ban_trie() :
+		root_(NULL),
+		size_(0)
+	{
+	}
+
+	ban_trie::~ban_trie()
+	{
+		delete root_;
+	}
+
+	void ban_trie::clear()
+	{
+		delete root_;
+		root_ = NULL;
+		size_ = 0;
+	}
+
+	void ban_trie::insert(const ip_prefix& prefix, const banned_ptr& ban)
+	{
+		node** link = &root_;
+		while (true) {
+			node* n = *link;
+			if (!n) {
+				*link = new node(prefix.bytes, prefix.bits);
+				(*link)->ban = ban;
+				size_ ++;
+				return;
+			}
+			const int common = common_bits(n->bytes, prefix.bytes, std::min(n->bits, prefix.bits));
+			if (common < n->bits) {
+				// fork at the first different bit, or prefix is above n.
+				node* fork = new node(prefix.bytes, common);
+				fork->child[key_bit(n->bytes, common)] = n;
+				*link = fork;
+				if (common == prefix.bits) {
+					fork->ban = ban;
+				} else {
+					node* leaf = new node(prefix.bytes, prefix.bits);
+					leaf->ban = ban;
+					fork->child[key_bit(prefix.bytes, common)] = leaf;
+				}
+				size_ ++;
+				return;
+			}
+			if (n->bits == prefix.bits) {
+				if (!n->ban) {
+					size_ ++;
+				}
+				n->ban = ban;
+				return;
+			}
+			link = &n->child[key_bit(prefix.bytes, n->bits)];
+		}
+	}
+
+	void ban_trie::compact(node** link)
+	{
+		node* n = *link;
+		if (n->ban || (n->child[0] && n->child[1])) {
+			return;
+		}
+		node* only = n->child[0]? n->child[0]: n->child[1];
+		n->child[0] = n->child[1] = NULL;
+		delete n;
+		*link = only;
+	}
+
+	void ban_trie::erase(const ip_prefix& prefix)
+	{
+		node** link = &root_;
+		node** parent = NULL;
+		while (*link) {
+			node* n = *link;
+			if (n->bits > prefix.bits || common_bits(n->bytes, prefix.bytes, n->bits) < n->bits) {
+				return;
+			}
+			if (n->bits == prefix.bits) {
+				if (!n->ban) {
+					return;
+				}
+				n->ban.reset();
+				size_ --;
+				compact(link);
+				if (parent) {
+					compact(parent);
+				}
+				return;
+			}
+			parent = link;
+			link = &n->child[key_bit(prefix.bytes, n->bits)];
+		}
+	}
+
+	banned_ptr ban_trie::find(const ip_prefix& address) const
+	{
+		banned_ptr best;
+		const node* n = root_;
+		while (n && n->bits <= address.bits) {
+			if (common_bits(n->bytes, address.bytes, n->bits) < n->bits) {
+				break;
+			}
+			if (n->ban) {
+				best = n->ban;
+			}
+			if (n->bits == address.bits) {
+				break;
+			}
+			n = n->child[key_bit(address.bytes, n->bits)];
+		}
+		return best;
 	}
 
 	const std::string banned::who_banned_default_ = "system";
@@ -77,11 +344,10 @@ static lg::log_domain log_server("server");
 		reason_(),
 		who_banned_(who_banned_default_),
 		group_(),
-		nick_()
+		nick_(),
+		prefix_()
 	{
-		ip_mask pair = parse_ip(ip);
-		ip_ = pair.first;
-		mask_ = 0xFFFFFFFF;
+		set_ip(ip);
 	}
 
 	banned::banned(const std::string& ip,
@@ -98,11 +364,10 @@ static lg::log_domain log_server("server");
 		reason_(reason),
 		who_banned_(who_banned),
 		group_(group),
-		nick_(nick)
+		nick_(nick),
+		prefix_()
 	{
-		ip_mask pair = parse_ip(ip_text_);
-		ip_ = pair.first;
-		mask_ = pair.second;
+		set_ip(ip_text_);
 	}
 
 	banned::banned(const config& cfg) :
@@ -114,11 +379,20 @@ static lg::log_domain log_server("server");
 		reason_(),
 		who_banned_(who_banned_default_),
 		group_(),
-		nick_()
+		nick_(),
+		prefix_()
 	{
 		read(cfg);
 	}
 
+	void banned::set_ip(const std::string& ip)
+	{
+		ip_mask pair;
+		prefix_ = parse_ip_prefix(ip, &pair);
+		ip_ = pair.first;
+		mask_ = pair.second;
+	}
+
 	ip_mask parse_ip(const std::string& ip)
 	{
 		// We use bit operations to construct the integer
@@ -168,9 +442,7 @@ static lg::log_domain log_server("server");
 		{
 			// parse ip and mask
 			ip_text_ = cfg["ip"].str();
-			ip_mask pair = parse_ip(ip_text_);
-			ip_ = pair.first;
-			mask_ = pair.second;
+			set_ip(ip_text_);
 		}
 		nick_ = cfg["nick"].str();
 		if (cfg.has_attribute("end_time"))
@@ -250,14 +522,41 @@ static lg::log_domain log_server("server");
 	}
 
 	bool banned::match_ip(const ip_mask& pair) const {
+		if (prefix_.ipv6) return false;
 		return (ip_ & mask_) == (pair.first & mask_);
 	}
 
 	// Unlike match_ip this function takes both masks into account.
 	bool banned::match_ipmask(const ip_mask& pair) const {
+		if (prefix_.ipv6) return pair.second == 0;
 		return (ip_ & mask_ & pair.second) == (pair.first & pair.second & mask_);
 	}
 
+	void ban_manager::insert_ban(const banned_ptr& ban)
+	{
+		bans_.insert(ban);
+		if (ban->prefix().bits >= 0) {
+			trie_.insert(ban->prefix(), ban);
+		} else {
+			sparse_bans_.push_back(ban);
+		}
+		if (ban->get_end_time() != 0) {
+			time_queue_.push(ban);
+		}
+	}
+
+	void ban_manager::erase_ban(ban_set::iterator it)
+	{
+		const banned_ptr& ban = *it;
+		if (ban->prefix().bits >= 0) {
+			trie_.erase(ban->prefix());
+		} else {
+			sparse_bans_.erase(std::find(sparse_bans_.begin(), sparse_bans_.end(), ban));
+		}
+		// entry in time_queue_ is skipped when it expires.
+		bans_.erase(it);
+	}
+
 	void ban_manager::read()
 	{
 		if (filename_.empty() || !file_exists(filename_))
@@ -271,10 +570,8 @@ static lg::log_domain log_server("server");
 		{
 			try {
 				banned_ptr new_ban(new banned(b));
-				assert(bans_.insert(new_ban).second);
-
-				if (new_ban->get_end_time() != 0)
-					time_queue_.push(new_ban);
+				assert(bans_.find(new_ban) == bans_.end());
+				insert_ban(new_ban);
 			} catch (banned::error& e) {
 				ERR_SERVER << e.message << " while reading bans\n";
 			}
@@ -492,7 +789,7 @@ static lg::log_domain log_server("server");
 			{
 				// Already exsiting ban for ip. We have to first remove it
 				ret << "Overwriting ban: " << (**ban) << "\n";
-				bans_.erase(ban);
+				erase_ban(ban);
 			}
 		} catch (banned::error& e) {
 			ERR_SERVER << e.message << " while creating dummy ban for finding existing ban\n";
@@ -500,9 +797,7 @@ static lg::log_domain log_server("server");
 		}
 		try {
 			banned_ptr new_ban(new banned(ip, end_time, reason,who_banned, group, nick));
-			bans_.insert(new_ban);
-			if (end_time != 0)
-				time_queue_.push(new_ban);
+			insert_ban(new_ban);
 			ret << *new_ban;
 		} catch (banned::error& e) {
 			ERR_SERVER << e.message << " while banning\n";
@@ -532,19 +827,24 @@ static lg::log_domain log_server("server");
 		os << "Ban on '" << **ban << "' removed.";
 		// group bans don't get saved
 		if ((*ban)->get_group().empty()) deleted_bans_.push_back(*ban);
-		bans_.erase(ban);
+		erase_ban(ban);
 		dirty_ = true;
 
 	}
 
 	void ban_manager::unban_group(std::ostringstream& os, const std::string& group)
 	{
-		ban_set temp;
-		std::insert_iterator<ban_set> temp_inserter(temp, temp.begin());
-		std::remove_copy_if(bans_.begin(), bans_.end(), temp_inserter, boost::bind(&banned::match_group,boost::bind(&banned_ptr::get,_1),group));
+		size_t removed = 0;
+		for (ban_set::iterator it = bans_.begin(); it != bans_.end(); ) {
+			if ((*it)->match_group(group)) {
+				erase_ban(it ++);
+				removed ++;
+			} else {
+				++ it;
+			}
+		}
 
-		os << "Removed " << (bans_.size() - temp.size()) << " bans";
-		bans_.swap(temp);
+		os << "Removed " << removed << " bans";
 		dirty_ = true;
 	}
 
@@ -561,11 +861,19 @@ static lg::log_domain log_server("server");
 				break;
 			}
 
+			time_queue_.pop();
+
+			// ban may be removed or overwritten since it is queued.
+			ban_set::iterator it = bans_.find(ban);
+			if (it == bans_.end() || *it != ban) {
+				continue;
+			}
+
 			// This ban is going to expire so delete it.
 			LOG_SERVER << "Remove a ban " << ban->get_ip() << ". time: " << time_now << " end_time " << ban->get_end_time() << "\n";
-			std::ostringstream os;
-			unban(os, ban->get_ip());
-			time_queue_.pop();
+			if (ban->get_group().empty()) deleted_bans_.push_back(ban);
+			erase_ban(it);
+			dirty_ = true;
 
 		}
 		// Save bans if there is any new ones
@@ -646,15 +954,20 @@ static lg::log_domain log_server("server");
 	std::string ban_manager::is_ip_banned(const std::string& ip) const
 	{
 		ip_mask pair;
+		ip_prefix address;
 		try {
-			pair = parse_ip(ip);
+			address = parse_ip_prefix(ip, &pair);
 		} catch (banned::error&) {
 			return "";
 		}
-		ban_set::const_iterator ban = std::find_if(bans_.begin(), bans_.end(), boost::bind(&banned::match_ip, boost::bind(&banned_ptr::get, _1), pair));
-		if (ban == bans_.end()) return "";
-		const std::string& nick = (*ban)->get_nick();
-		return (*ban)->get_reason() + (nick.empty() ? "" : " (" + nick + ")") + " (" + (*ban)->get_human_time_span() + ")";
+		banned_ptr ban = trie_.find(address);
+		if (!ban) {
+			std::vector<banned_ptr>::const_iterator it = std::find_if(sparse_bans_.begin(), sparse_bans_.end(), boost::bind(&banned::match_ip, boost::bind(&banned_ptr::get, _1), pair));
+			if (it == sparse_bans_.end()) return "";
+			ban = *it;
+		}
+		const std::string& nick = ban->get_nick();
+		return ban->get_reason() + (nick.empty() ? "" : " (" + nick + ")") + " (" + ban->get_human_time_span() + ")";
 	}
 
 	void ban_manager::init_ban_help()
@@ -708,6 +1021,8 @@ static lg::log_domain log_server("server");
 
 	ban_manager::ban_manager()
 		: bans_()
+		, trie_()
+		, sparse_bans_()
 		, deleted_bans_()
 		, time_queue_()
 		, ban_times_()
@@ -718,5 +1033,77 @@ static lg::log_domain log_server("server");
 		init_ban_help();
 	}
 
+	static std::string random_ip(int parts)
+	{
+		std::stringstream strstr;
+		for (int i = 0; i < 4; i ++) {
+			if (i) strstr << ".";
+			if (i < parts) {
+				strstr << rand() % 256;
+			} else {
+				strstr << "*";
+			}
+		}
+		return strstr.str();
+	}
+
+	static Uint64 elapsed_us(Uint64 start)
+	{
+		return (SDL_GetPerformanceCounter() - start) * 1000000 / SDL_GetPerformanceFrequency();
+	}
+
+	void ban_manager::benchmark(std::ostream& out, int count)
+	{
+		const int lookups = 100000;
+		const time_t now = time(NULL);
+		srand(count);
+
+		// 80% single address, 15% /24, 5% /16. half of them are temporary.
+		std::vector<std::string> ips;
+		for (int i = 0; i < count; i ++) {
+			const int kind = rand() % 20;
+			ips.push_back(random_ip(kind < 16? 4: (kind < 19? 3: 2)));
+		}
+		std::vector<std::string> addresses;
+		for (int i = 0; i < lookups; i ++) {
+			addresses.push_back(random_ip(4));
+		}
+
+		ban_manager manager;
+		Uint64 start = SDL_GetPerformanceCounter();
+		for (int i = 0; i < count; i ++) {
+			manager.ban(ips[i], i % 2? now + 60 + i % 3600: 0, "benchmark", "benchmark", "");
+		}
+		out << manager.bans_.size() << " bans, " << manager.trie_.size() << " in trie, "
+			<< manager.sparse_bans_.size() << " sparse\n";
+		out << std::setw(24) << "insert" << std::setw(12) << elapsed_us(start) << " us\n";
+
+		int banned_count = 0;
+		start = SDL_GetPerformanceCounter();
+		for (int i = 0; i < lookups; i ++) {
+			if (!manager.is_ip_banned(addresses[i]).empty()) {
+				banned_count ++;
+			}
+		}
+		out << std::setw(24) << "trie lookup" << std::setw(12) << elapsed_us(start) << " us, "
+			<< lookups << " addresses, " << banned_count << " banned\n";
+
+		// what is_ip_banned did before trie.
+		const int scans = std::min(lookups, 1000);
+		banned_count = 0;
+		start = SDL_GetPerformanceCounter();
+		for (int i = 0; i < scans; i ++) {
+			const ip_mask pair = parse_ip(addresses[i]);
+			if (std::find_if(manager.bans_.begin(), manager.bans_.end(), boost::bind(&banned::match_ip, boost::bind(&banned_ptr::get, _1), pair)) != manager.bans_.end()) {
+				banned_count ++;
+			}
+		}
+		out << std::setw(24) << "linear scan" << std::setw(12) << elapsed_us(start) << " us, "
+			<< scans << " addresses, " << banned_count << " banned\n";
 
+		start = SDL_GetPerformanceCounter();
+		manager.check_ban_times(now + 3600);
+		out << std::setw(24) << "expire" << std::setw(12) << elapsed_us(start) << " us, "
+			<< manager.bans_.size() << " bans left\n";
+	}
 }
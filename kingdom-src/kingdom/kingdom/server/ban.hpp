@@ -20,6 +20,7 @@
 #include <map>
 #include <list>
 #include <queue>
+#include <vector>
 #include <ctime>
 
 #include <boost/shared_ptr.hpp>
@@ -55,6 +56,50 @@ namespace wesnothd {
 
 	ip_mask parse_ip(const std::string&);
 
+	/** address or subnet as IPv6, IPv4 is mapped to ::ffff:0:0/96. */
+	struct ip_prefix {
+		ip_prefix();
+
+		unsigned char bytes[16];
+		// significant bits, -1 if mask of IPv4 isn't a prefix, like 1.*.3.4.
+		int bits;
+		bool ipv6;
+	};
+
+	/**
+	 * IPv4 with wildcards, or IPv6 with optional prefix length, like 2001:db8::/32.
+	 * ipv4 receives ip and mask of IPv4, it is 0/0 for IPv6.
+	 */
+	ip_prefix parse_ip_prefix(const std::string& ip, ip_mask* ipv4 = NULL);
+
+	/**
+	 * Binary radix trie of bans, keyed by ip_prefix. Path is compressed, so a
+	 * node exists only for a ban or for a fork of two subtrees. Lookup walks
+	 * at most 128 bits and returns the longest matched prefix.
+	 */
+	class ban_trie {
+	public:
+		ban_trie();
+		~ban_trie();
+
+		void insert(const ip_prefix& prefix, const banned_ptr& ban);
+		void erase(const ip_prefix& prefix);
+		banned_ptr find(const ip_prefix& address) const;
+		void clear();
+
+		size_t size() const { return size_; }
+
+	private:
+		ban_trie(const ban_trie&);
+		void operator=(const ban_trie&);
+
+		struct node;
+		void compact(node** link);
+
+		node* root_;
+		size_t size_;
+	};
+
 	class banned {
 		unsigned int ip_;
 		unsigned int mask_;
@@ -65,9 +110,11 @@ namespace wesnothd {
 		std::string who_banned_;
 		std::string group_;
 		std::string nick_;
+		ip_prefix prefix_;
 		static const std::string who_banned_default_;
 
 		banned(const std::string& ip);
+		void set_ip(const std::string& ip);
 
 	public:
 		banned(const std::string& ip, const time_t end_time, const std::string& reason, const std::string& who_banned=who_banned_default_, const std::string& group="", const std::string& nick="");
@@ -111,6 +158,9 @@ namespace wesnothd {
 		unsigned int mask() const
 		{ return mask_; }
 
+		const ip_prefix& prefix() const
+		{ return prefix_; }
+
 		static banned_ptr create_dummy(const std::string& ip);
 
 		bool operator>(const banned& b) const;
@@ -124,6 +174,10 @@ namespace wesnothd {
 	{
 
 		ban_set bans_;
+		// index of bans_ for is_ip_banned.
+		ban_trie trie_;
+		// bans whose mask isn't a prefix, they are rare and scanned.
+		std::vector<banned_ptr> sparse_bans_;
 		deleted_ban_list deleted_bans_;
 		ban_time_queue time_queue_;
 		default_ban_times ban_times_;
@@ -137,6 +191,8 @@ namespace wesnothd {
 		{ return c - '0'; }
 
 		void init_ban_help();
+		void insert_ban(const banned_ptr& ban);
+		void erase_ban(ban_set::iterator it);
 	public:
 		ban_manager();
 		~ban_manager();
@@ -169,6 +225,8 @@ namespace wesnothd {
 
 		void load_config(const config&);
 
+		/** time ban, lookup and expiry with count random bans. */
+		static void benchmark(std::ostream& out, int count);
 	};
 }
 
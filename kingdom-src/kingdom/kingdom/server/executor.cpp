@@ -0,0 +1,195 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/**
+ * @file
+ * Worker threads of games, and control lane of main thread.
+ */
+
+#include "global.hpp"
+
+#include "executor.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace wesnothd {
+
+executor_pool::executor_pool(size_t threads)
+	: mutex_()
+	, idle_()
+	, executors_()
+	, pending_()
+	, control_()
+	, running_(0)
+	, control_held_(false)
+	, quit_(false)
+{
+	for (size_t n = 0; n < threads; n ++) {
+		executors_.push_back(new texecutor(*this));
+	}
+	for (std::vector<texecutor*>::iterator it = executors_.begin(); it != executors_.end(); ++ it) {
+		(*it)->thread = new threading::thread(thread_main, *it);
+	}
+}
+
+executor_pool::~executor_pool()
+{
+	{
+		const threading::lock lock(mutex_);
+		quit_ = true;
+		control_held_ = false;
+		for (std::vector<texecutor*>::iterator it = executors_.begin(); it != executors_.end(); ++ it) {
+			(*it)->cond.notify_one();
+		}
+	}
+	// executors finish their queues before they exit.
+	for (std::vector<texecutor*>::iterator it = executors_.begin(); it != executors_.end(); ++ it) {
+		delete (*it)->thread;
+		delete *it;
+	}
+}
+
+int executor_pool::thread_main(void* data)
+{
+	texecutor* executor = static_cast<texecutor*>(data);
+	executor->pool.work(*executor);
+	return 0;
+}
+
+void executor_pool::work(texecutor& executor)
+{
+	for (;;) {
+		std::pair<int, task> item;
+		{
+			const threading::lock lock(mutex_);
+			while (executor.queue.empty() || (control_held_ && !quit_)) {
+				if (quit_ && executor.queue.empty()) {
+					return;
+				}
+				executor.cond.wait(mutex_);
+			}
+			item = executor.queue.front();
+			executor.queue.pop_front();
+			running_ ++;
+		}
+
+		item.second();
+
+		{
+			const threading::lock lock(mutex_);
+			running_ --;
+			executor.executed ++;
+			std::map<int, int>::iterator it = pending_.find(item.first);
+			if (-- it->second == 0) {
+				pending_.erase(it);
+			}
+			idle_.notify_all();
+		}
+	}
+}
+
+void executor_pool::post(int key, const task& t)
+{
+	texecutor& executor = *executors_[(unsigned)key % executors_.size()];
+
+	const threading::lock lock(mutex_);
+	executor.queue.push_back(std::make_pair(key, t));
+	executor.max_queue = std::max(executor.max_queue, executor.queue.size());
+	pending_[key] ++;
+	executor.cond.notify_one();
+}
+
+void executor_pool::post_control(const task& t)
+{
+	const threading::lock lock(mutex_);
+	control_.push_back(t);
+}
+
+void executor_pool::run_control()
+{
+	std::vector<task> tasks;
+	{
+		const threading::lock lock(mutex_);
+		tasks.swap(control_);
+	}
+	for (std::vector<task>::const_iterator it = tasks.begin(); it != tasks.end(); ++ it) {
+		(*it)();
+	}
+}
+
+void executor_pool::drain(int key)
+{
+	const threading::lock lock(mutex_);
+	while (pending_.count(key)) {
+		idle_.wait(mutex_);
+	}
+}
+
+void executor_pool::enter_control()
+{
+	const threading::lock lock(mutex_);
+	control_held_ = true;
+	while (running_) {
+		idle_.wait(mutex_);
+	}
+}
+
+void executor_pool::leave_control()
+{
+	const threading::lock lock(mutex_);
+	control_held_ = false;
+	for (std::vector<texecutor*>::iterator it = executors_.begin(); it != executors_.end(); ++ it) {
+		if (!(*it)->queue.empty()) {
+			(*it)->cond.notify_one();
+		}
+	}
+}
+
+std::ostream& executor_pool::stats(std::ostream& out) const
+{
+	const threading::lock lock(mutex_);
+	out << executors_.size() << " game executors, " << pending_.size() << " games with queued messages\n";
+	out << std::setw(10) << "executor" << std::setw(12) << "tasks" << std::setw(10) << "queued"
+		<< std::setw(12) << "max queue" << "\n";
+	for (size_t n = 0; n < executors_.size(); n ++) {
+		const texecutor& e = *executors_[n];
+		out << std::setw(10) << n << std::setw(12) << e.executed << std::setw(10) << e.queue.size()
+			<< std::setw(12) << e.max_queue << "\n";
+	}
+	return out;
+}
+
+tcontrol_lane::tcontrol_lane(executor_pool* pool, int key)
+	: pool_(pool)
+{
+	if (!pool_) {
+		return;
+	}
+	// before entering, executor can't finish tasks while control is held.
+	if (key) {
+		pool_->drain(key);
+	}
+	pool_->enter_control();
+}
+
+tcontrol_lane::~tcontrol_lane()
+{
+	if (pool_) {
+		pool_->leave_control();
+	}
+}
+
+}
@@ -0,0 +1,125 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/** @file */
+
+#ifndef SERVER_EXECUTOR_HPP_INCLUDED
+#define SERVER_EXECUTOR_HPP_INCLUDED
+
+#include "thread.hpp"
+
+#include <boost/function.hpp>
+
+#include <deque>
+#include <iosfwd>
+#include <map>
+#include <vector>
+
+namespace wesnothd {
+
+/**
+ * Worker threads that process messages of games. Every key (game id) is pinned
+ * to one executor, and its tasks run in the order they were posted, so
+ * messages of one game keep their order, and games on different executors run
+ * at the same time.
+ *
+ * Everything else is the control lane, i.e. main thread. While main thread is
+ * in control lane no task runs, so it can change players, games and lobby.
+ * Tasks only read that state, changes they need are posted to control lane.
+ */
+class executor_pool
+{
+public:
+	typedef boost::function<void ()> task;
+
+	explicit executor_pool(size_t threads);
+	~executor_pool();
+
+	size_t size() const { return executors_.size(); }
+
+	/** queue task to executor of key, after all tasks of key posted before. */
+	void post(int key, const task& t);
+
+	/** queue task to control lane, it runs in next run_control(). */
+	void post_control(const task& t);
+
+	/** run queued control tasks, caller is in control lane. */
+	void run_control();
+
+	/** wait until all tasks of key posted so far are done. */
+	void drain(int key);
+
+	/** wait for running tasks, and don't start any until leave_control(). */
+	void enter_control();
+	void leave_control();
+
+	/** tasks done and longest queue of every executor. */
+	std::ostream& stats(std::ostream& out) const;
+
+private:
+	struct texecutor {
+		texecutor(executor_pool& pool)
+			: pool(pool)
+			, queue()
+			, cond()
+			, thread(NULL)
+			, executed(0)
+			, max_queue(0)
+		{}
+
+		executor_pool& pool;
+		std::deque<std::pair<int, task> > queue;
+		threading::condition cond;
+		threading::thread* thread;
+		unsigned executed;
+		size_t max_queue;
+	};
+
+	static int thread_main(void* data);
+	void work(texecutor& executor);
+
+	mutable threading::mutex mutex_;
+	// notified when a task ends.
+	threading::condition idle_;
+	std::vector<texecutor*> executors_;
+	// queued and running tasks of key.
+	std::map<int, int> pending_;
+	std::vector<task> control_;
+	int running_;
+	bool control_held_;
+	bool quit_;
+};
+
+/**
+ * Main thread is in control lane during life of this object. If key is not 0,
+ * tasks of key are done before, so that what main thread does with that game
+ * is ordered after them. pool can be NULL, then messages are processed serially
+ * and there is nothing to wait for.
+ */
+class tcontrol_lane
+{
+public:
+	tcontrol_lane(executor_pool* pool, int key = 0);
+	~tcontrol_lane();
+
+private:
+	tcontrol_lane(const tcontrol_lane&);
+	void operator=(const tcontrol_lane&);
+
+	executor_pool* pool_;
+};
+
+}
+
+#endif
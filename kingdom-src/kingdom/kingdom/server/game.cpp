@@ -826,9 +826,6 @@ bool game::process_turn(simple_wml::document& data, const player_map::const_iter
 			if (prefix_unit["new_turn"].to_int()) {
 				turn_ended = true;
 				end_turn_ = current_turn() * nsides_; // +1 turn
-				if (description_) {
-					description_->set_attr_dup("turn", describe_turns(current_turn(), level_["turns"]).c_str());
-				}
 			}
 			end_turn_ = (nsides_? end_turn_ / nsides_ : 0) * nsides_ + prefix_unit["side"].to_int() - 1;
 
@@ -927,6 +924,12 @@ void game::process_whiteboard(simple_wml::document& data, const player_map::cons
 	send_data_team(data,team_name,user->first,"whiteboard");
 }
 
+void game::update_turn_description() {
+	if (description_) {
+		description_->set_attr_dup("turn", describe_turns(current_turn(), level_["turns"]).c_str());
+	}
+}
+
 bool game::end_turn() {
 	// It's a new turn every time each side in the game ends their turn.
 	++end_turn_;
@@ -127,10 +127,16 @@ public:
 	 * Currently removes all commands but [speak] for observers and all but
 	 * [speak], [label] and [rename] for players.
 	 *
-	 * @returns                   True if the turn ended.
+	 * It doesn't touch the description, it can run on a game executor.
+	 *
+	 * @returns                   True if the turn ended, caller then calls
+	 *                            update_turn_description() in control lane.
 	 */
 	bool process_turn(simple_wml::document& data, const player_map::const_iterator user);
 
+	/** Set 'turn' of the description in the lobby to current turn. */
+	void update_turn_description();
+
 	/** Handles incoming [whiteboard] data. */
 	void process_whiteboard(simple_wml::document& data, const player_map::const_iterator user);
 
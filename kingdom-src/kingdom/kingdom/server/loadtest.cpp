@@ -0,0 +1,964 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/**
+ * @file
+ * Load generator of simulated clients for the server.
+ */
+
+#include "global.hpp"
+
+#include "loadtest.hpp"
+#include "metrics.hpp"
+#include "simple_wml.hpp"
+
+#include "config.hpp"
+#include "filesystem.hpp"
+#include "rose_config.hpp"
+#include "serialization/parser.hpp"
+
+#include "SDL_net.h"
+#include "SDL_timer.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#ifndef _WIN32
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+enum {LAT_CONNECT, LAT_LOGIN, LAT_LOBBY_CHAT, LAT_GAME_CHAT, LAT_TURN, LATENCIES};
+const char* latency_names[LATENCIES] = {"connect", "login", "lobby chat", "game chat", "turn"};
+
+enum ROLE {LOBBY, HOST, PLAYER, OBSERVER};
+
+enum STATE {
+	CONNECTING,	// non-blocking connect() in progress
+	HANDSHAKE,	// waiting for 4 bytes of connection number
+	LOGIN,		// version, mustlogin, login
+	IN_LOBBY,
+	JOINING,	// sent [join], waiting for level data or [leave_game]
+	IN_GAME,
+	CLOSED
+};
+
+Uint64 now_counter()
+{
+	return SDL_GetPerformanceCounter();
+}
+
+Uint32 counter_to_us(Uint64 counter)
+{
+	static const Uint64 freq = SDL_GetPerformanceFrequency();
+	const Uint64 us = counter * 1000000 / freq;
+	return us > 0xffffffff? 0xffffffff: (Uint32)us;
+}
+
+Uint64 ms_to_counter(int ms)
+{
+	static const Uint64 freq = SDL_GetPerformanceFrequency();
+	return (Uint64)ms * freq / 1000;
+}
+
+// 0.5 - 1.5 of interval, so clients don't send in lockstep.
+Uint64 jitter(int ms)
+{
+	return ms_to_counter(ms / 2 + rand() % (ms + 1));
+}
+
+struct tclient
+{
+	tclient(ROLE role, const std::string& name, int game, int side)
+		: role(role)
+		, name(name)
+		, game(game)
+		, side(side)
+		, fd(-1)
+		, state(CONNECTING)
+		, game_id(0)
+		, started_at(0)
+		, next_chat(0)
+		, next_turn(0)
+		, next_join(0)
+		, joined(0)
+		, packets_left(0)
+		, in()
+		, out()
+	{}
+
+	ROLE role;
+	std::string name;
+	// index in games of script, side is 1 based, 0 for observer.
+	int game;
+	int side;
+
+	int fd;
+	STATE state;
+	// id of game on server, learned from gamelist.
+	int game_id;
+	Uint64 started_at;
+	Uint64 next_chat;
+	Uint64 next_turn;
+	Uint64 next_join;
+	// host: players that took their side.
+	int joined;
+	int packets_left;
+
+	std::vector<char> in;
+	std::string out;
+};
+
+struct tserver_usage
+{
+	tserver_usage()
+		: pid(0)
+		, last_cpu(0)
+		, last_at(0)
+		, cpu_percent(0)
+		, max_cpu_percent(0)
+		, cpu_sum(0)
+		, samples(0)
+		, rss_kb(0)
+		, max_rss_kb(0)
+	{}
+
+	int pid;
+	Uint64 last_cpu;
+	Uint64 last_at;
+	double cpu_percent;
+	double max_cpu_percent;
+	double cpu_sum;
+	int samples;
+	int rss_kb;
+	int max_rss_kb;
+};
+
+int find_server_pid()
+{
+	DIR* dir = opendir("/proc");
+	if (!dir) {
+		return 0;
+	}
+	int pid = 0;
+	const int self = getpid();
+	while (const dirent* entry = readdir(dir)) {
+		const int candidate = atoi(entry->d_name);
+		if (candidate <= 0 || candidate == self) {
+			continue;
+		}
+		std::stringstream file;
+		file << "/proc/" << candidate << "/comm";
+		const std::string comm = read_file(file.str());
+		if (comm.find("kingdomd") == 0 || comm.find("wesnothd") == 0) {
+			pid = candidate;
+			break;
+		}
+	}
+	closedir(dir);
+	return pid;
+}
+
+/** utime + stime in clock ticks, 0 if process is gone. */
+Uint64 read_cpu_ticks(int pid)
+{
+	std::stringstream file;
+	file << "/proc/" << pid << "/stat";
+	const std::string stat = read_file(file.str());
+	// comm can contain spaces, fields are counted after its ')'.
+	const size_t pos = stat.rfind(')');
+	if (pos == std::string::npos) {
+		return 0;
+	}
+	std::istringstream fields(stat.substr(pos + 2));
+	std::string field;
+	Uint64 utime = 0, stime = 0;
+	// state is field 3, utime 14 and stime 15.
+	for (int n = 3; n <= 15 && fields >> field; n ++) {
+		if (n == 14) {
+			utime = strtoull(field.c_str(), NULL, 10);
+		} else if (n == 15) {
+			stime = strtoull(field.c_str(), NULL, 10);
+		}
+	}
+	return utime + stime;
+}
+
+int read_rss_kb(int pid)
+{
+	std::stringstream file;
+	file << "/proc/" << pid << "/status";
+	const std::string status = read_file(file.str());
+	const size_t pos = status.find("VmRSS:");
+	if (pos == std::string::npos) {
+		return 0;
+	}
+	return atoi(status.c_str() + pos + 6);
+}
+
+class tload_test
+{
+public:
+	tload_test(std::ostream& out, const config& cfg);
+	~tload_test();
+
+	int run();
+
+private:
+	void spawn(tclient& c);
+	void connected(tclient& c);
+	void close(tclient& c, const std::string& reason);
+
+	bool flush(tclient& c);
+	void send(tclient& c, simple_wml::document& doc);
+	void receive(tclient& c);
+	void process(tclient& c, simple_wml::document& doc);
+
+	void find_game(tclient& c, const simple_wml::node& gamelist);
+	void begin_turn(tclient& c, int side, Uint64 now);
+	void act(tclient& c, Uint64 now);
+
+	void create_game(tclient& c);
+	void send_join(tclient& c);
+	void send_turn(tclient& c);
+	void send_chat(tclient& c);
+
+	void record_latency(int type, const simple_wml::node& stamped);
+	void error(const std::string& what);
+
+	void sample_server(Uint64 now);
+	void progress(Uint64 now);
+	void report(Uint64 now);
+
+	std::ostream& out_;
+	std::string host_;
+	int port_;
+	sockaddr_in addr_;
+	int duration_;
+	int connect_rate_;
+	int report_interval_;
+	int lobby_chat_;
+	int sides_;
+	int turn_packets_;
+	int turn_interval_;
+	int game_chat_;
+
+	std::vector<tclient> clients_;
+
+	Uint64 started_at_;
+	size_t spawned_;
+	int connected_;
+	int logged_in_;
+	Uint64 last_login_at_;
+	Uint32 packets_in_;
+	Uint32 packets_out_;
+	Uint64 bytes_in_;
+	Uint64 bytes_out_;
+	Uint32 last_packets_in_;
+	Uint32 last_packets_out_;
+	Uint64 last_progress_;
+
+	tlatency_histogram latencies_[LATENCIES];
+	std::map<std::string, int> errors_;
+	tserver_usage server_;
+};
+
+tload_test::tload_test(std::ostream& out, const config& cfg)
+	: out_(out)
+	, host_(cfg["host"].str())
+	, port_(cfg["port"].to_int(15000))
+	, addr_()
+	, duration_(cfg["duration"].to_int(60))
+	, connect_rate_(std::max(1, cfg["connect_rate"].to_int(50)))
+	, report_interval_(std::max(1, cfg["report_interval"].to_int(5)))
+	, lobby_chat_(0)
+	, sides_(2)
+	, turn_packets_(4)
+	, turn_interval_(250)
+	, game_chat_(0)
+	, clients_()
+	, started_at_(0)
+	, spawned_(0)
+	, connected_(0)
+	, logged_in_(0)
+	, last_login_at_(0)
+	, packets_in_(0)
+	, packets_out_(0)
+	, bytes_in_(0)
+	, bytes_out_(0)
+	, last_packets_in_(0)
+	, last_packets_out_(0)
+	, last_progress_(0)
+	, latencies_()
+	, errors_()
+	, server_()
+{
+	if (host_.empty()) {
+		host_ = "127.0.0.1";
+	}
+	server_.pid = cfg["server_pid"].to_int();
+
+	if (const config& game = cfg.child("game")) {
+		const int games = game["count"].to_int();
+		sides_ = std::max(1, std::min(game["sides"].to_int(2), 9));
+		const int observers = game["observers"].to_int();
+		turn_packets_ = std::max(1, game["turn_packets"].to_int(4));
+		turn_interval_ = game["interval"].to_int(250);
+		game_chat_ = game["chat"].to_int(0);
+
+		// host first, so game is in the list soon after players logged in.
+		for (int n = 0; n < games; n ++) {
+			std::stringstream name;
+			name << "lt_g" << n << "_";
+			clients_.push_back(tclient(HOST, name.str() + "s1", n, 1));
+			for (int side = 2; side <= sides_; side ++) {
+				std::stringstream player;
+				player << name.str() << "s" << side;
+				clients_.push_back(tclient(PLAYER, player.str(), n, side));
+			}
+			for (int o = 0; o < observers; o ++) {
+				std::stringstream observer;
+				observer << name.str() << "o" << o;
+				clients_.push_back(tclient(OBSERVER, observer.str(), n, 0));
+			}
+		}
+	}
+	if (const config& lobby = cfg.child("lobby")) {
+		const int count = lobby["count"].to_int();
+		lobby_chat_ = lobby["chat"].to_int(10000);
+		for (int n = 0; n < count; n ++) {
+			std::stringstream name;
+			name << "lt_l" << n;
+			clients_.push_back(tclient(LOBBY, name.str(), -1, 0));
+		}
+	}
+}
+
+tload_test::~tload_test()
+{
+	for (std::vector<tclient>::iterator it = clients_.begin(); it != clients_.end(); ++ it) {
+		if (it->fd >= 0) {
+			::close(it->fd);
+		}
+	}
+}
+
+void tload_test::error(const std::string& what)
+{
+	errors_[what] ++;
+}
+
+void tload_test::spawn(tclient& c)
+{
+	c.started_at = now_counter();
+	c.fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (c.fd < 0) {
+		close(c, "socket() failed");
+		return;
+	}
+	fcntl(c.fd, F_SETFL, fcntl(c.fd, F_GETFL, 0) | O_NONBLOCK);
+	int one = 1;
+	setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	if (::connect(c.fd, reinterpret_cast<const sockaddr*>(&addr_), sizeof(addr_)) == 0) {
+		connected(c);
+	} else if (errno != EINPROGRESS) {
+		close(c, "connect failed");
+	}
+}
+
+void tload_test::connected(tclient& c)
+{
+	// new connection is 0, server replies with our connection number.
+	c.state = HANDSHAKE;
+	c.out.append(4, '\0');
+	flush(c);
+}
+
+void tload_test::close(tclient& c, const std::string& reason)
+{
+	if (c.state == CLOSED) {
+		return;
+	}
+	if (!reason.empty()) {
+		error(reason);
+	}
+	if (c.fd >= 0) {
+		::close(c.fd);
+		c.fd = -1;
+	}
+	c.state = CLOSED;
+}
+
+bool tload_test::flush(tclient& c)
+{
+	while (!c.out.empty()) {
+		const ssize_t n = ::send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+		if (n < 0) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				return true;
+			}
+			close(c, "send failed");
+			return false;
+		}
+		c.out.erase(0, n);
+	}
+	return true;
+}
+
+void tload_test::send(tclient& c, simple_wml::document& doc)
+{
+	if (c.state == CLOSED) {
+		return;
+	}
+	const simple_wml::string_span s = doc.output_compressed();
+	char len[4];
+	SDLNet_Write32(s.size(), len);
+	c.out.append(len, 4);
+	c.out.append(s.begin(), s.size());
+	packets_out_ ++;
+	bytes_out_ += 4 + s.size();
+	flush(c);
+}
+
+void tload_test::receive(tclient& c)
+{
+	char buf[16384];
+	for (;;) {
+		const ssize_t n = ::recv(c.fd, buf, sizeof(buf), 0);
+		if (n == 0) {
+			close(c, "disconnected by server");
+			return;
+		} else if (n < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				close(c, "recv failed");
+			}
+			break;
+		}
+		c.in.insert(c.in.end(), buf, buf + n);
+		bytes_in_ += n;
+	}
+
+	size_t pos = 0;
+	if (c.state == HANDSHAKE && c.in.size() >= 4) {
+		latencies_[LAT_CONNECT].record(counter_to_us(now_counter() - c.started_at));
+		connected_ ++;
+		c.state = LOGIN;
+		pos = 4;
+	}
+	while (c.state != CLOSED && c.state != HANDSHAKE && c.in.size() - pos >= 4) {
+		const size_t len = SDLNet_Read32(&c.in[pos]);
+		if (c.in.size() - pos - 4 < len) {
+			break;
+		}
+		packets_in_ ++;
+
+		char* buf_ptr = new char [len];
+		memcpy(buf_ptr, &c.in[pos + 4], len);
+		pos += 4 + len;
+		try {
+			simple_wml::document doc(simple_wml::string_span(buf_ptr, len));
+			doc.take_ownership_of_buffer(buf_ptr);
+			// doc deletes it, process() may throw.
+			buf_ptr = NULL;
+			process(c, doc);
+		} catch (simple_wml::error& e) {
+			delete [] buf_ptr;
+			error("invalid WML received: " + e.message);
+		}
+	}
+	c.in.erase(c.in.begin(), c.in.begin() + std::min(pos, c.in.size()));
+}
+
+void tload_test::record_latency(int type, const simple_wml::node& stamped)
+{
+	const simple_wml::string_span& sent = stamped["lt_sent"];
+	if (sent.empty()) {
+		return;
+	}
+	const Uint64 at = strtoull(sent.to_string().c_str(), NULL, 10);
+	latencies_[type].record(counter_to_us(now_counter() - at));
+}
+
+void tload_test::find_game(tclient& c, const simple_wml::node& gamelist)
+{
+	std::stringstream name;
+	name << "lt_game" << c.game;
+	const simple_wml::node::child_list& games = gamelist.children("game");
+	for (simple_wml::node::child_list::const_iterator it = games.begin(); it != games.end(); ++ it) {
+		if ((**it)["name"] == name.str() && (**it)["id"].to_int()) {
+			c.game_id = (**it)["id"].to_int();
+			c.next_join = now_counter();
+			return;
+		}
+	}
+}
+
+void tload_test::process(tclient& c, simple_wml::document& doc)
+{
+	const simple_wml::node& root = doc.root();
+	if (root.has_attr("ping")) {
+		return;
+	}
+
+	if (const simple_wml::node* err = root.child("error")) {
+		error("server error: " + (*err)["message"].to_string().substr(0, 60));
+		if (c.state == LOGIN) {
+			close(c, "");
+		}
+		return;
+	}
+
+	if (c.state == LOGIN) {
+		if (root.child("version")) {
+			simple_wml::document response;
+			response.root().add_child("version").set_attr("version", game_config::version.c_str());
+			send(c, response);
+
+		} else if (root.child("mustlogin")) {
+			simple_wml::document response;
+			simple_wml::node& login = response.root().add_child("login");
+			login.set_attr_dup("username", c.name.c_str());
+			login.set_attr("selective_ping", "yes");
+			send(c, response);
+
+		} else if (root.child("join_lobby")) {
+			const Uint64 now = now_counter();
+			latencies_[LAT_LOGIN].record(counter_to_us(now - c.started_at));
+			logged_in_ ++;
+			last_login_at_ = now;
+			c.state = IN_LOBBY;
+			if (c.role == HOST) {
+				create_game(c);
+			} else if (c.role == LOBBY && lobby_chat_) {
+				c.next_chat = now + jitter(lobby_chat_);
+			}
+		}
+		return;
+	}
+
+	if (const simple_wml::node* message = root.child("message")) {
+		record_latency(c.state == IN_LOBBY? LAT_LOBBY_CHAT: LAT_GAME_CHAT, *message);
+		return;
+	}
+
+	if (c.state == IN_LOBBY || c.state == JOINING) {
+		if (c.role == PLAYER || c.role == OBSERVER) {
+			if (!c.game_id) {
+				if (const simple_wml::node* gamelist = root.child("gamelist")) {
+					find_game(c, *gamelist);
+				} else if (const simple_wml::node* diff = root.child("gamelist_diff")) {
+					const simple_wml::node* change = diff->child("change_child");
+					const simple_wml::node* gamelist = change? change->child("gamelist"): NULL;
+					const simple_wml::node* insert = gamelist? gamelist->child("insert_child"): NULL;
+					if (insert) {
+						find_game(c, *insert);
+					}
+				}
+			}
+		}
+		if (c.state == JOINING) {
+			if (root.child("leave_game")) {
+				error("join rejected");
+				c.state = IN_LOBBY;
+				c.next_join = now_counter() + ms_to_counter(1000);
+			} else if (root.child("side")) {
+				// level data of game is the reply of successful join.
+				c.state = IN_GAME;
+				if (game_chat_) {
+					c.next_chat = now_counter() + jitter(game_chat_);
+				}
+			}
+		}
+		return;
+	}
+
+	if (c.state != IN_GAME) {
+		return;
+	}
+	if (c.role == HOST && root.has_attr("faction") && root.has_attr("side")) {
+		// a player took its side.
+		if (++ c.joined == sides_ - 1) {
+			simple_wml::document start;
+			start.root().add_child("start_game");
+			send(c, start);
+			begin_turn(c, 1, now_counter());
+		}
+
+	} else if (root.child("start_game")) {
+		begin_turn(c, 1, now_counter());
+
+	} else if (const simple_wml::node* turn = root.child("turn")) {
+		const simple_wml::node::child_list& commands = turn->children("command");
+		for (simple_wml::node::child_list::const_iterator it = commands.begin(); it != commands.end(); ++ it) {
+			record_latency(LAT_TURN, **it);
+			if (const simple_wml::node* prefix = (*it)->child("prefix_unit")) {
+				begin_turn(c, (*prefix)["side"].to_int(), now_counter());
+			}
+		}
+	}
+}
+
+void tload_test::begin_turn(tclient& c, int side, Uint64 now)
+{
+	if (side != c.side) {
+		return;
+	}
+	c.packets_left = turn_packets_;
+	c.next_turn = now + ms_to_counter(turn_interval_);
+}
+
+void tload_test::create_game(tclient& c)
+{
+	std::stringstream name;
+	name << "lt_game" << c.game;
+
+	simple_wml::document create;
+	create.root().add_child("create_game").set_attr_dup("name", name.str().c_str());
+	send(c, create);
+
+	// level data, sides of players are reserved by current_player, so take_side
+	// of server gives them their side and nobody else's.
+	simple_wml::document level;
+	simple_wml::node& root = level.root();
+	root.set_attr_dup("name", name.str().c_str());
+	root.set_attr("observer", "yes");
+	root.set_attr("mp_shroud", "yes");
+	for (int side = 1; side <= sides_; side ++) {
+		simple_wml::node& s = root.add_child("side");
+		s.set_attr_int("side", side);
+		if (side == 1) {
+			s.set_attr("controller", "human");
+			s.set_attr_dup("current_player", c.name.c_str());
+		} else {
+			std::stringstream player;
+			player << "lt_g" << c.game << "_s" << side;
+			s.set_attr("controller", "network");
+			s.set_attr_dup("current_player", player.str().c_str());
+		}
+	}
+	root.add_child("multiplayer").set_attr("observer", "yes");
+	send(c, level);
+
+	c.state = IN_GAME;
+	if (sides_ == 1) {
+		simple_wml::document start;
+		start.root().add_child("start_game");
+		send(c, start);
+		begin_turn(c, 1, now_counter());
+	}
+	if (game_chat_) {
+		c.next_chat = now_counter() + jitter(game_chat_);
+	}
+}
+
+void tload_test::send_join(tclient& c)
+{
+	simple_wml::document join;
+	simple_wml::node& node = join.root().add_child("join");
+	node.set_attr_int("id", c.game_id);
+	node.set_attr("observe", c.role == OBSERVER? "yes": "no");
+	send(c, join);
+	c.state = JOINING;
+	c.next_join = 0;
+}
+
+void tload_test::send_turn(tclient& c)
+{
+	std::stringstream stamp;
+	stamp << now_counter();
+
+	simple_wml::document doc;
+	simple_wml::node& turn = doc.root().add_child("turn");
+	simple_wml::node& command = turn.add_child("command");
+	command.set_attr_dup("lt_sent", stamp.str().c_str());
+	simple_wml::node& move = command.add_child("move");
+	move.set_attr_int("x", 1 + rand() % 40);
+	move.set_attr_int("y", 1 + rand() % 40);
+
+	if (-- c.packets_left == 0) {
+		const int next = c.side % sides_ + 1;
+		simple_wml::node& prefix = turn.add_child("command").add_child("prefix_unit");
+		prefix.set_attr_int("side", next);
+		prefix.set_attr_int("new_turn", next == 1? 1: 0);
+		prefix.set_attr_int("end", 0);
+		c.next_turn = 0;
+		if (next == c.side) {
+			begin_turn(c, next, now_counter());
+		}
+	} else {
+		c.next_turn += ms_to_counter(turn_interval_);
+	}
+	send(c, doc);
+}
+
+void tload_test::send_chat(tclient& c)
+{
+	std::stringstream stamp;
+	stamp << now_counter();
+
+	simple_wml::document doc;
+	simple_wml::node& message = doc.root().add_child("message");
+	message.set_attr("message", "load test message");
+	message.set_attr_dup("lt_sent", stamp.str().c_str());
+	send(c, doc);
+
+	c.next_chat += jitter(c.state == IN_LOBBY? lobby_chat_: game_chat_);
+}
+
+void tload_test::act(tclient& c, Uint64 now)
+{
+	if (c.next_join && c.next_join <= now && c.state == IN_LOBBY) {
+		send_join(c);
+	}
+	if (c.next_turn && c.next_turn <= now && c.state == IN_GAME) {
+		send_turn(c);
+	}
+	if (c.next_chat && c.next_chat <= now && (c.state == IN_LOBBY || c.state == IN_GAME)) {
+		send_chat(c);
+	}
+}
+
+void tload_test::sample_server(Uint64 now)
+{
+	if (!server_.pid) {
+		return;
+	}
+	const Uint64 cpu = read_cpu_ticks(server_.pid);
+	if (!cpu) {
+		return;
+	}
+	if (server_.last_at) {
+		static const long ticks_per_second = sysconf(_SC_CLK_TCK);
+		const double wall = (double)(now - server_.last_at) / SDL_GetPerformanceFrequency();
+		server_.cpu_percent = wall > 0? 100.0 * (cpu - server_.last_cpu) / ticks_per_second / wall: 0;
+		server_.max_cpu_percent = std::max(server_.max_cpu_percent, server_.cpu_percent);
+		server_.cpu_sum += server_.cpu_percent;
+		server_.samples ++;
+	}
+	server_.last_cpu = cpu;
+	server_.last_at = now;
+	server_.rss_kb = read_rss_kb(server_.pid);
+	server_.max_rss_kb = std::max(server_.max_rss_kb, server_.rss_kb);
+}
+
+void tload_test::progress(Uint64 now)
+{
+	const double wall = (double)(now - last_progress_) / SDL_GetPerformanceFrequency();
+	out_ << std::fixed << std::setprecision(1)
+		<< std::setw(6) << (double)(now - started_at_) / SDL_GetPerformanceFrequency() << "s"
+		<< "  spawned " << spawned_
+		<< "  connected " << connected_
+		<< "  logged in " << logged_in_
+		<< "  in/s " << (int)((packets_in_ - last_packets_in_) / wall)
+		<< "  out/s " << (int)((packets_out_ - last_packets_out_) / wall);
+	if (server_.pid) {
+		out_ << "  server cpu " << server_.cpu_percent << "%"
+			<< "  rss " << server_.rss_kb / 1024 << " MB";
+	}
+	out_ << "\n";
+	last_packets_in_ = packets_in_;
+	last_packets_out_ = packets_out_;
+	last_progress_ = now;
+}
+
+void tload_test::report(Uint64 now)
+{
+	const double wall = (double)(now - started_at_) / SDL_GetPerformanceFrequency();
+	const double ramp = (double)(last_login_at_ - started_at_) / SDL_GetPerformanceFrequency();
+
+	out_ << "\nclients " << clients_.size() << ", connected " << connected_
+		<< ", logged in " << logged_in_ << " in " << ramp << "s";
+	if (ramp > 0) {
+		out_ << " (" << logged_in_ / ramp << " logins/s)";
+	}
+	out_ << "\npackets in " << packets_in_ << " (" << (int)(packets_in_ / wall) << "/s, "
+		<< bytes_in_ / 1024 << " KB), out " << packets_out_ << " (" << (int)(packets_out_ / wall) << "/s, "
+		<< bytes_out_ / 1024 << " KB)\n";
+
+	if (server_.pid) {
+		out_ << "server pid " << server_.pid << ": cpu avg "
+			<< (server_.samples? server_.cpu_sum / server_.samples: 0) << "%, max "
+			<< server_.max_cpu_percent << "%, rss max " << server_.max_rss_kb / 1024 << " MB\n";
+	} else {
+		out_ << "server process not found, no cpu and memory.\n";
+	}
+
+	out_ << "\nlatency (us)" << std::setw(10) << "count" << std::setw(10) << "p50"
+		<< std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "max" << "\n";
+	for (int n = 0; n < LATENCIES; n ++) {
+		const tlatency_histogram& h = latencies_[n];
+		out_ << std::left << std::setw(12) << latency_names[n] << std::right
+			<< std::setw(10) << h.count() << std::setw(10) << h.percentile(500)
+			<< std::setw(10) << h.percentile(900) << std::setw(10) << h.percentile(990)
+			<< std::setw(10) << h.maximum() << "\n";
+	}
+
+	if (!errors_.empty()) {
+		out_ << "\nerrors:\n";
+		for (std::map<std::string, int>::const_iterator it = errors_.begin(); it != errors_.end(); ++ it) {
+			out_ << std::setw(8) << it->second << "  " << it->first << "\n";
+		}
+	}
+}
+
+int tload_test::run()
+{
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* res = NULL;
+	if (getaddrinfo(host_.c_str(), NULL, &hints, &res) || !res) {
+		out_ << "cannot resolve " << host_ << "\n";
+		return 1;
+	}
+	memcpy(&addr_, res->ai_addr, sizeof(addr_));
+	addr_.sin_port = htons(port_);
+	freeaddrinfo(res);
+
+	if (clients_.empty()) {
+		out_ << "script has no [lobby] or [game] clients.\n";
+		return 1;
+	}
+	if (!server_.pid) {
+		server_.pid = find_server_pid();
+	}
+
+	started_at_ = last_progress_ = now_counter();
+	const Uint64 end_at = started_at_ + ms_to_counter(duration_ * 1000);
+	Uint64 next_sample = started_at_;
+	std::vector<pollfd> fds;
+	std::vector<size_t> polled;
+
+	for (Uint64 now = started_at_; now < end_at; now = now_counter()) {
+		// ramp up at connect_rate.
+		const size_t due = std::min(clients_.size(),
+			(size_t)((now - started_at_) * connect_rate_ / SDL_GetPerformanceFrequency()) + 1);
+		while (spawned_ < due) {
+			spawn(clients_[spawned_ ++]);
+		}
+
+		fds.clear();
+		polled.clear();
+		for (size_t n = 0; n < spawned_; n ++) {
+			const tclient& c = clients_[n];
+			if (c.fd < 0) {
+				continue;
+			}
+			pollfd pfd;
+			pfd.fd = c.fd;
+			pfd.events = c.state == CONNECTING? POLLOUT: POLLIN;
+			if (!c.out.empty()) {
+				pfd.events |= POLLOUT;
+			}
+			pfd.revents = 0;
+			fds.push_back(pfd);
+			polled.push_back(n);
+		}
+		poll(fds.empty()? NULL: &fds[0], fds.size(), 5);
+
+		for (size_t n = 0; n < fds.size(); n ++) {
+			tclient& c = clients_[polled[n]];
+			const short revents = fds[n].revents;
+			if (!revents) {
+				continue;
+			}
+			if (c.state == CONNECTING) {
+				int err = 0;
+				socklen_t len = sizeof(err);
+				getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+				if (err) {
+					close(c, "connect failed");
+				} else {
+					connected(c);
+				}
+				continue;
+			}
+			if (revents & POLLOUT) {
+				flush(c);
+			}
+			if (revents & (POLLIN | POLLHUP | POLLERR)) {
+				receive(c);
+			}
+		}
+
+		now = now_counter();
+		for (size_t n = 0; n < spawned_; n ++) {
+			act(clients_[n], now);
+		}
+
+		if (now >= next_sample) {
+			sample_server(now);
+			next_sample = now + SDL_GetPerformanceFrequency();
+		}
+		if (now - last_progress_ >= (Uint64)report_interval_ * SDL_GetPerformanceFrequency()) {
+			progress(now);
+		}
+	}
+
+	report(now_counter());
+	return logged_in_? 0: 1;
+}
+
+}
+
+namespace wesnothd {
+
+int load_test(std::ostream& out, const std::string& script)
+{
+	config cfg;
+	try {
+		scoped_istream stream = istream_file(script);
+		read(cfg, *stream);
+	} catch (config::error& e) {
+		out << "cannot read load test script '" << script << "': " << e.message << "\n";
+		return 1;
+	}
+	const config& loadtest = cfg.child("loadtest");
+	if (!loadtest) {
+		out << "load test script '" << script << "' has no [loadtest].\n";
+		return 1;
+	}
+	return tload_test(out, loadtest).run();
+}
+
+}
+
+#else
+
+namespace wesnothd {
+
+int load_test(std::ostream& out, const std::string& /*script*/)
+{
+	out << "load test is not supported on this platform.\n";
+	return 1;
+}
+
+}
+
+#endif
@@ -0,0 +1,63 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/** @file */
+
+#ifndef LOADTEST_HPP_INCLUDED
+#define LOADTEST_HPP_INCLUDED
+
+#include <iosfwd>
+#include <string>
+
+namespace wesnothd {
+
+/**
+ * Simulated clients, they speak the protocol of kingdom client to a running
+ * server: handshake, version, login, lobby chat, create/join/observe game and
+ * [turn] commands. Linux only, all clients are in one thread and poll().
+ *
+ * kingdomd --loadtest <script>
+ *
+ * [loadtest]
+ *     host=127.0.0.1
+ *     port=15000
+ *     server_pid=0         # 0: find process named kingdomd/wesnothd
+ *     duration=60          # seconds, from first connection
+ *     connect_rate=50      # new connections per second
+ *     report_interval=5    # seconds between progress lines
+ *     [lobby]
+ *         count=100
+ *         chat=10000       # ms between lobby messages, 0: silent
+ *     [/lobby]
+ *     [game]
+ *         count=20         # games, every game has one host
+ *         sides=2          # host plays side 1, sides-1 players join
+ *         observers=5
+ *         turn_packets=4   # [turn] packets of a side before it ends turn
+ *         interval=250     # ms between [turn] packets
+ *         chat=30000       # ms between in-game messages of every member
+ *     [/game]
+ * [/loadtest]
+ *
+ * Latency of a message is from sender to every receiver, stamped in an
+ * attribute, so it includes queueing and processing of server. Server should
+ * set connections_allowed=0 and max_messages high enough for the script.
+ *
+ * @return exit code, 1 if script is invalid or no client logged in.
+ */
+int load_test(std::ostream& out, const std::string& script);
+
+}
+
+#endif
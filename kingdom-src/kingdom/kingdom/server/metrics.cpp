@@ -20,9 +20,96 @@
 #include "global.hpp"
 
 #include "metrics.hpp"
+#include "config.hpp"
+#include "filesystem.hpp"
+#include "serialization/parser.hpp"
+#include "util.hpp"
 
+#include "SDL_timer.h"
 #include <algorithm>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
+
+tlatency_histogram::tlatency_histogram() :
+	count_(0),
+	max_(0),
+	sum_(0)
+{
+	memset(counts_, 0, sizeof(counts_));
+}
+
+int tlatency_histogram::bucket(Uint32 us)
+{
+	if (us < SUB_BUCKETS) {
+		return us;
+	}
+	int exponent = 4;
+	while (us >> (exponent + 1)) {
+		exponent ++;
+	}
+	// us >> (exponent - 4) is in [16, 31], leading bit is implicit.
+	return (exponent - 3) * SUB_BUCKETS + ((us >> (exponent - 4)) & (SUB_BUCKETS - 1));
+}
+
+Uint32 tlatency_histogram::bucket_upper(int index)
+{
+	if (index < SUB_BUCKETS) {
+		return index;
+	}
+	const int exponent = index / SUB_BUCKETS + 3;
+	const Uint64 lower = (Uint64)(SUB_BUCKETS + index % SUB_BUCKETS) << (exponent - 4);
+	const Uint64 upper = lower + ((Uint64)1 << (exponent - 4)) - 1;
+	return upper > 0xffffffff? 0xffffffff: (Uint32)upper;
+}
+
+void tlatency_histogram::record(Uint32 us)
+{
+	counts_[bucket(us)] ++;
+	count_ ++;
+	sum_ += us;
+	if (us > max_) {
+		max_ = us;
+	}
+}
+
+Uint32 tlatency_histogram::percentile(int permille) const
+{
+	if (!count_) {
+		return 0;
+	}
+	const Uint64 threshold = ((Uint64)count_ * permille + 999) / 1000;
+	Uint64 seen = 0;
+	for (int i = 0; i < BUCKETS; i ++) {
+		seen += counts_[i];
+		if (seen >= threshold) {
+			return std::min(bucket_upper(i), max_);
+		}
+	}
+	return max_;
+}
+
+std::string tlatency_histogram::to_str() const
+{
+	std::stringstream strstr;
+	for (int i = 0; i < BUCKETS; i ++) {
+		if (!counts_[i]) {
+			continue;
+		}
+		if (!strstr.str().empty()) {
+			strstr << ",";
+		}
+		strstr << bucket_upper(i) << ":" << counts_[i];
+	}
+	return strstr.str();
+}
+
+static Uint32 counter_to_us(Uint64 counter)
+{
+	static const Uint64 freq = SDL_GetPerformanceFrequency();
+	const Uint64 us = counter * 1000000 / freq;
+	return us > 0xffffffff? 0xffffffff: (Uint32)us;
+}
 
 struct compare_samples_to_stringspan {
 	bool operator()(const simple_wml::string_span& a, const simple_wml::string_span& b)
@@ -40,6 +127,8 @@ struct compare_samples_by_time {
 
 metrics::metrics() :
 	samples_(),
+	packets_(),
+	packets_mutex_(),
 	most_consecutive_requests_(0),
 	current_requests_(0),
 	nrequests_(0),
@@ -59,6 +148,37 @@ metrics::~metrics()
 	samples_.clear();
 }
 
+metrics::packet_stats& metrics::find_packet(const std::string& type)
+{
+	std::map<std::string, packet_stats>::iterator it = packets_.find(type);
+	if (it != packets_.end()) {
+		return it->second;
+	}
+	//protect against DoS with memory exhaustion
+	if (packets_.size() > 64) {
+		return packets_["other"];
+	}
+	return packets_[type];
+}
+
+void metrics::record_packet(const std::string& type, size_t bytes, Uint64 wait, Uint64 processing)
+{
+	const threading::lock lock(packets_mutex_);
+	packet_stats& stats = find_packet(type);
+	stats.packets_in ++;
+	stats.bytes_in += bytes;
+	stats.wait.record(counter_to_us(wait));
+	stats.processing.record(counter_to_us(processing));
+}
+
+void metrics::record_out(const std::string& type, size_t bytes)
+{
+	const threading::lock lock(packets_mutex_);
+	packet_stats& stats = find_packet(type);
+	stats.packets_out ++;
+	stats.bytes_out += bytes;
+}
+
 void metrics::service_request()
 {
 	if(current_requests_ > 0) {
@@ -150,6 +270,81 @@ std::ostream& metrics::requests(std::ostream& out) const
 	return out;
 }
 
+std::ostream& metrics::histograms(std::ostream& out, const std::string& type) const
+{
+	const threading::lock lock(packets_mutex_);
+	if (packets_.empty()) return out << "No packet is received so far.";
+
+	if (!type.empty()) {
+		std::map<std::string, packet_stats>::const_iterator it = packets_.find(type);
+		if (it == packets_.end()) {
+			return out << "No packet of type '" << type << "'.";
+		}
+		out << "'" << type << "' latency buckets (upper bound in us:count)\n"
+			<< "queue wait: " << it->second.wait.to_str() << "\n"
+			<< "processing: " << it->second.processing.to_str();
+		return out;
+	}
+
+	out << "Latency per packet type, in us (wait in queue / processing):\n";
+	out << std::setw(20) << "type" << std::setw(8) << "in" << std::setw(10) << "KB in"
+		<< std::setw(8) << "out" << std::setw(10) << "KB out"
+		<< std::setw(16) << "p50" << std::setw(16) << "p99" << std::setw(20) << "max" << "\n";
+	for (std::map<std::string, packet_stats>::const_iterator it = packets_.begin(); it != packets_.end(); ++ it) {
+		const packet_stats& s = it->second;
+		std::stringstream p50, p99, max;
+		p50 << s.wait.percentile(500) << "/" << s.processing.percentile(500);
+		p99 << s.wait.percentile(990) << "/" << s.processing.percentile(990);
+		max << s.wait.maximum() << "/" << s.processing.maximum();
+		out << std::setw(20) << it->first << std::setw(8) << s.packets_in << std::setw(10) << s.bytes_in / 1024
+			<< std::setw(8) << s.packets_out << std::setw(10) << s.bytes_out / 1024
+			<< std::setw(16) << p50.str() << std::setw(16) << p99.str() << std::setw(20) << max.str() << "\n";
+	}
+	return out;
+}
+
+void metrics::dump(const std::string& file) const
+{
+	config cfg;
+	cfg["time"] = (int)time(NULL);
+	cfg["uptime"] = (int)(time(NULL) - started_at_);
+	const threading::lock lock(packets_mutex_);
+	for (std::map<std::string, packet_stats>::const_iterator it = packets_.begin(); it != packets_.end(); ++ it) {
+		const packet_stats& s = it->second;
+		config& packet = cfg.add_child("packet");
+		packet["type"] = it->first;
+		packet["packets_in"] = (int)s.packets_in;
+		packet["bytes_in"] = str_cast(s.bytes_in);
+		packet["packets_out"] = (int)s.packets_out;
+		packet["bytes_out"] = str_cast(s.bytes_out);
+
+		const tlatency_histogram* histograms[] = {&s.wait, &s.processing};
+		const char* names[] = {"wait", "processing"};
+		for (int i = 0; i < 2; i ++) {
+			config& h = packet.add_child(names[i]);
+			h["count"] = (int)histograms[i]->count();
+			h["sum"] = str_cast(histograms[i]->sum());
+			h["max"] = (int)histograms[i]->maximum();
+			h["p50"] = (int)histograms[i]->percentile(500);
+			h["p90"] = (int)histograms[i]->percentile(900);
+			h["p99"] = (int)histograms[i]->percentile(990);
+			h["p999"] = (int)histograms[i]->percentile(999);
+			h["buckets"] = histograms[i]->to_str();
+		}
+	}
+
+	// write to temporary file then rename, reader never sees a partial file.
+	const std::string tmp = file + ".tmp";
+	{
+		scoped_ostream stream = ostream_file(tmp);
+		write(*stream, cfg);
+	}
+	if (rename(tmp.c_str(), file.c_str())) {
+		remove(file.c_str());
+		rename(tmp.c_str(), file.c_str());
+	}
+}
+
 std::ostream& operator<<(std::ostream& out, metrics& met)
 {
 	const time_t time_up = time(NULL) - met.started_at_;
@@ -24,6 +24,42 @@
 #include <time.h>
 
 #include "simple_wml.hpp"
+#include "thread.hpp"
+#include "SDL_types.h"
+
+/**
+ * Log-linear histogram of microseconds, like HDR histogram. Values below 16 have
+ * their own bucket, every power of two above is split into 16 buckets, so
+ * error of a bucket is less than 1/16. Recording is an array increment.
+ */
+class tlatency_histogram
+{
+public:
+	enum {SUB_BUCKETS = 16, BUCKETS = 29 * SUB_BUCKETS};
+
+	tlatency_histogram();
+
+	void record(Uint32 us);
+
+	Uint32 count() const { return count_; }
+	Uint32 maximum() const { return max_; }
+	Uint64 sum() const { return sum_; }
+
+	/** upper bound of bucket where permille of values are below. */
+	Uint32 percentile(int permille) const;
+
+	/** non-empty buckets as "upper:count,...". */
+	std::string to_str() const;
+
+	static int bucket(Uint32 us);
+	static Uint32 bucket_upper(int index);
+
+private:
+	Uint32 counts_[BUCKETS];
+	Uint32 count_;
+	Uint32 max_;
+	Uint64 sum_;
+};
 
 class metrics
 {
@@ -37,10 +73,21 @@ public:
 	void record_sample(const simple_wml::string_span& name,
 	                   clock_t parsing_time, clock_t processing_time);
 
+	/**
+	 * every received packet, wait is time in queue of network layer, processing
+	 * includes parsing. Both are in performance counter.
+	 */
+	void record_packet(const std::string& type, size_t bytes, Uint64 wait, Uint64 processing);
+	void record_out(const std::string& type, size_t bytes);
+
 	void game_terminated(const std::string& reason);
 
 	std::ostream& games(std::ostream& out) const;
 	std::ostream& requests(std::ostream& out) const;
+	/** percentiles of all types, or buckets of one type. */
+	std::ostream& histograms(std::ostream& out, const std::string& type) const;
+	/** write all types in WML, for tools that plot them. */
+	void dump(const std::string& file) const;
 	friend std::ostream& operator<<(std::ostream& out, metrics& met);
 
 	struct sample {
@@ -66,8 +113,34 @@ public:
 		}
 	};
 
+	struct packet_stats {
+
+		packet_stats() :
+			wait(),
+			processing(),
+			packets_in(0),
+			bytes_in(0),
+			packets_out(0),
+			bytes_out(0)
+		{
+		}
+
+		tlatency_histogram wait;
+		tlatency_histogram processing;
+		Uint32 packets_in;
+		Uint64 bytes_in;
+		Uint32 packets_out;
+		Uint64 bytes_out;
+	};
+
 private:
+	packet_stats& find_packet(const std::string& type);
+
 	std::vector<sample> samples_;
+	// type is received from client, so count of types is limited.
+	std::map<std::string, packet_stats> packets_;
+	// game executors record their packets.
+	mutable threading::mutex packets_mutex_;
 
 	int most_consecutive_requests_;
 	int current_requests_;
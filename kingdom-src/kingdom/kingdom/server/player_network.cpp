@@ -14,9 +14,14 @@
 */
 
 #include "player_network.hpp"
+#include "lobby.hpp"
 #include "log.hpp"
+#include "serialization/binary_wml.hpp"
 #include "serialization/string_utils.hpp"
 
+#include "SDL_timer.h"
+#include <boost/scoped_ptr.hpp>
+
 static lg::log_domain log_config("config");
 #define WRN_CONFIG LOG_STREAM(warn, log_config)
 
@@ -41,12 +46,61 @@ void truncate_message(const simple_wml::string_span& str, simple_wml::node& mess
 
 } // end chat_message namespace
 
+simple_wml::string_span output_for(simple_wml::document& data, const network::connection sock)
+{
+	const tsock* s = lobby->find_connection(sock);
+	if (s && s->wire_binary) {
+		return data.output_binary();
+	}
+	return data.output_compressed();
+}
+
+void compare_output(simple_wml::document& data)
+{
+	if (!binary_wml::compare_due()) {
+		return;
+	}
+	std::string type = data.root().first_child().to_string();
+	if (type.empty()) {
+		type = "attributes";
+	}
+	try {
+		// clone, encoding caches of data are kept.
+		boost::scoped_ptr<simple_wml::document> text(data.clone());
+		boost::scoped_ptr<simple_wml::document> binary(data.clone());
+
+		Uint64 start = SDL_GetPerformanceCounter();
+		const simple_wml::string_span t = text->output_compressed();
+		const Uint64 text_encode = SDL_GetPerformanceCounter() - start;
+
+		start = SDL_GetPerformanceCounter();
+		const simple_wml::string_span b = binary->output_binary();
+		const Uint64 binary_encode = SDL_GetPerformanceCounter() - start;
+
+		start = SDL_GetPerformanceCounter();
+		{
+			simple_wml::document tmp(t);
+		}
+		const Uint64 text_decode = SDL_GetPerformanceCounter() - start;
+
+		start = SDL_GetPerformanceCounter();
+		{
+			simple_wml::document tmp(b);
+		}
+		const Uint64 binary_decode = SDL_GetPerformanceCounter() - start;
+
+		binary_wml::record(type, t.size(), b.size(), text_encode, text_decode, binary_encode, binary_decode);
+	} catch (simple_wml::error& e) {
+		WRN_CONFIG << __func__ << ": simple_wml error: " << e.message << std::endl;
+	}
+}
+
 bool send_to_one(simple_wml::document& data, const network::connection sock, std::string packet_type)
 {
 	if (packet_type.empty())
 		packet_type = data.root().first_child().to_string();
 	try {
-		simple_wml::string_span s = data.output_compressed();
+		simple_wml::string_span s = output_for(data, sock);
 		network::send_raw_data(s.begin(), s.size(), sock, packet_type);
 	} catch (simple_wml::error& e) {
 		WRN_CONFIG << __func__ << ": simple_wml error: " << e.message << std::endl;
@@ -61,9 +115,10 @@ void send_to_many(simple_wml::document& data, const connection_vector& vec,
 	if (packet_type.empty())
 		packet_type = data.root().first_child().to_string();
 	try {
-		simple_wml::string_span s = data.output_compressed();
 		for(connection_vector::const_iterator i = vec.begin(); i != vec.end(); ++i) {
 			if (*i != exclude) {
+				// both encodings are cached by document, every one is done at most once.
+				simple_wml::string_span s = output_for(data, *i);
 				network::send_raw_data(s.begin(), s.size(), *i, packet_type);
 			}
 		}
@@ -79,9 +134,9 @@ void send_to_many(simple_wml::document& data, const connection_vector& vec,
 	if (packet_type.empty())
 		packet_type = data.root().first_child().to_string();
 	try {
-		simple_wml::string_span s = data.output_compressed();
 		for(connection_vector::const_iterator i = vec.begin(); i != vec.end(); ++i) {
 			if ((*i != exclude) && pred(*i)) {
+				simple_wml::string_span s = output_for(data, *i);
 				network::send_raw_data(s.begin(), s.size(), *i, packet_type);
 			}
 		}
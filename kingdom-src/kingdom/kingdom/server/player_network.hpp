@@ -35,6 +35,18 @@ namespace chat_message {
 typedef std::map<network::connection,player> player_map;
 typedef std::vector<network::connection> connection_vector;
 
+/**
+ * Encoded document for one player, binary WML if it is accepted at handshake,
+ * otherwise compressed text WML.
+ */
+simple_wml::string_span output_for(simple_wml::document& data, const network::connection sock);
+
+/**
+ * Encode a copy of received document both ways and record size and time of them,
+ * if it is time to. See binary_wml::compare_interval.
+ */
+void compare_output(simple_wml::document& data);
+
 /**
  * Send a wml document to a single player
  * @param data        the document to send
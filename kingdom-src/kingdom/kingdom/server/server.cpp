@@ -29,15 +29,20 @@
 #include "filesystem.hpp"
 #include "multiplayer_error_codes.hpp"
 #include "serialization/parser.hpp"
+#include "serialization/binary_wml.hpp"
 #include "serialization/preprocessor.hpp"
 #include "serialization/string_utils.hpp"
 #include "util.hpp"
+#include "wml_exception.hpp"
 #include "lobby.hpp"
 
+#include "executor.hpp"
 #include "game.hpp"
 #include "input_stream.hpp"
+#include "loadtest.hpp"
 #include "metrics.hpp"
 #include "player.hpp"
+#include "player_network.hpp"
 #include "proxy.hpp"
 #include "simple_wml.hpp"
 #include "ban.hpp"
@@ -159,13 +164,15 @@ public:
 			if (len != 4) {
 				return false;
 			}
-			const int handle = SDLNet_Read32(reinterpret_cast<void*>(buf));
+			const uint32_t handle = SDLNet_Read32(reinterpret_cast<void*>(buf));
 			// DBG_NW << "received handshake from client: '" << handle << "'\n";
 
 			tsock::connect(sock, host, port);
 
-			// Send back their connection number
-			SDLNet_Write32(conn_, reinterpret_cast<void*>(buf));
+			// Send back their connection number, flag it if binary WML is accepted.
+			// old client sends 0, it receives gzip text WML.
+			wire_binary = binary_wml::is_handshake(handle);
+			SDLNet_Write32(wire_binary? conn_ | binary_wml::handshake_accepted: conn_, reinterpret_cast<void*>(buf));
 			const int nbytes = SDLNet_TCP_Send(sock,buf,4);
 			if(nbytes != 4) {
 				return false;
@@ -197,7 +204,7 @@ public:
 size_t twesnothd_lobby::taccept_sock::queue_raw_data(const char* buf, int len)
 {
 	network::buffer* queued_buf = new network::buffer(sock2_);
-	assert(*buf == 31);
+	assert(*buf == 31 || binary_wml::is_binary(buf, len));
 	network::make_network_buffer(buf, len, queued_buf->raw_buffer);
 	network::queue_buffer(sock2_, queued_buf);
 	return 4 + len;
@@ -276,12 +283,20 @@ namespace {
 // we take profiling info on every n requests
 int request_sample_frequency = 1;
 
+// metrics of server, network layer reports sent packets to it.
+metrics* packet_metrics = NULL;
+
+void record_bandwidth_out(const std::string& packet_type, size_t len)
+{
+	packet_metrics->record_out(packet_type, len);
+}
+
 void send_doc(simple_wml::document& doc, network::connection connection, std::string type = "")
 {
 	if (type.empty())
 		type = doc.root().first_child().to_string();
 	try {
-		simple_wml::string_span s = doc.output_compressed();
+		simple_wml::string_span s = wesnothd::output_for(doc, connection);
 		network::send_raw_data(s.begin(), s.size(), connection, type);
 	} catch (simple_wml::error& e) {
 		WRN_CONFIG << __func__ << ": simple_wml error: " << e.message << std::endl;
@@ -432,9 +447,9 @@ namespace {
 	const std::string denied_msg = "You're not allowed to execute this command.";
 	const std::string help_msg = "Available commands are: adminmsg <msg>,"
 		" ban <mask> <time> <reason>, bans [deleted] [<ipmask>], clones,"
-		" dul|deny_unregistered_login [yes|no], kick <mask> [<reason>],"
-		" k[ick]ban <mask> <time> <reason>, help, games, metrics,"
-		" netstats [all], [lobby]msg <message>, motd [<message>],"
+		" dul|deny_unregistered_login [yes|no], executors, kick <mask> [<reason>],"
+		" k[ick]ban <mask> <time> <reason>, help, games, latency [<type>], metrics,"
+		" netstats [all|wire], [lobby]msg <message>, motd [<message>],"
 		" pm|privatemsg <nickname> <message>, requests, sample, searchlog <mask>,"
 		" signout, stats, status [<mask>], unban <ipmask>\n"
 		"Specific strings (those not inbetween <> like the command names)"
@@ -443,7 +458,7 @@ namespace {
 
 
 server::server(int port, const std::string& config_file, size_t min_threads,
-		size_t max_threads) :
+		size_t max_threads, size_t game_threads) :
 	net_manager_(min_threads, max_threads),
 	server_(lobby->sock(twesnothd_lobby::wesnoth_tag), port),
 	ban_manager_(),
@@ -478,6 +493,7 @@ server::server(int port, const std::string& config_file, size_t min_threads,
 	deny_unregistered_login_(false),
 	save_replays_(false),
 	replay_save_path_(),
+	metrics_dump_(),
 	allow_remote_shutdown_(false),
 	tor_ip_list_(),
 	failed_login_limit_(),
@@ -488,6 +504,7 @@ server::server(int port, const std::string& config_file, size_t min_threads,
 	join_lobby_response_("[join_lobby]\n[/join_lobby]\n", simple_wml::INIT_COMPRESSED),
 	games_and_users_list_("[gamelist]\n[/gamelist]\n", simple_wml::INIT_STATIC),
 	metrics_(),
+	executors_(game_threads? new wesnothd::executor_pool(game_threads): NULL),
 	last_ping_(time(NULL)),
 	last_stats_(last_ping_),
 	last_uh_clean_(last_ping_),
@@ -496,6 +513,8 @@ server::server(int port, const std::string& config_file, size_t min_threads,
 	setup_handlers();
 	load_config();
 	ban_manager_.read();
+	packet_metrics = &metrics_;
+	network::bandwidth_out_observer = record_bandwidth_out;
 	rooms_.read_rooms();
 
 #ifndef _MSC_VER
@@ -515,6 +534,8 @@ void server::setup_handlers()
 	cmd_handlers_["stats"] = &server::stats_handler;
 	cmd_handlers_["metrics"] = &server::metrics_handler;
 	cmd_handlers_["requests"] = &server::requests_handler;
+	cmd_handlers_["latency"] = &server::latency_handler;
+	cmd_handlers_["executors"] = &server::executors_handler;
 	cmd_handlers_["games"] = &server::games_handler;
 	cmd_handlers_["wml"] = &server::wml_handler;
 	cmd_handlers_["netstats"] = &server::netstats_handler;
@@ -629,11 +650,13 @@ void server::load_config() {
 
 	save_replays_ = cfg_["save_replays"].to_bool();
 	replay_save_path_ = cfg_["replay_save_path"].str();
+	metrics_dump_ = cfg_["metrics_dump"].str();
 
 	tor_ip_list_ = utils::split(cfg_["tor_ip_list_path"].empty() ? "" : read_file(cfg_["tor_ip_list_path"]), '\n');
 
 	admin_passwd_ = cfg_["passwd"].str();
 	motd_ = cfg_["motd"].str();
+	binary_wml::compare_interval = cfg_["wire_compare"].to_int(0);
 	lan_server_ = lexical_cast_default<time_t>(cfg_["lan_server"], 0);
 	uh_name_ = cfg_["user_handler"].str();
 
@@ -742,6 +765,9 @@ void server::dump_stats(const time_t& now) {
 		<< "\tnumber_of_games = " << games_.size()
 		<< "\tnumber_of_users = " << players_.size()
 		<< "\tlobby_users = " << rooms_.lobby().size() << "\n";
+	if (!metrics_dump_.empty()) {
+		metrics_.dump(metrics_dump_);
+	}
 }
 
 void server::clean_user_handler(const time_t& now) {
@@ -760,130 +786,150 @@ void server::run() {
 		// Server will respond a bit faster under heavy load
 		fps_limit_.limit();
 		try {
-			// We are going to waith 10 seconds before shutting down so users can get out of game.
-			if (graceful_restart && games_.empty() && ++graceful_counter > 500 )
+			network::connection sock;
 			{
-				// TODO: We should implement client side autoreconnect.
-				// Idea:
-				// server should send [reconnect]host=host,port=number[/reconnect]
-				// Then client would reconnect to new server automatically.
-				// This would also allow server to move to new port or address if there is need
-
-				process_command("msg All games ended. Shutting down now. Reconnect to the new server instance.", "system");
-				throw network::error("shut down");
-			}
-
-			if (config_reload == 1) {
-				cfg_ = read_config();
-				load_config();
-				config_reload = 0;
-			}
-
-			// Process commands from the server socket/fifo
-			std::string admin_cmd;
-			if (input_ && input_->read_line(admin_cmd)) {
-				LOG_SERVER << "Admin Command: type: " << admin_cmd << "\n";
-				const std::string res = process_command(admin_cmd, "*socket*");
-				// Only mark the response if we fake the issuer (i.e. command comes from IRC or so)
-				if (admin_cmd.at(0) == '+') {
-					LOG_SERVER << "[admin_command_response]\n" << res << "\n" << "[/admin_command_response]\n";
-				} else {
-					LOG_SERVER << res << "\n";
+				// Game executors don't run while main thread changes connections,
+				// players and lobby.
+				const wesnothd::tcontrol_lane control(executors_.get());
+				if (executors_) {
+					executors_->run_control();
 				}
-			}
 
-			time_t now = time(NULL);
-			if (last_ping_ + network::ping_interval <= now) {
-				if (lan_server_ && players_.empty() && last_user_seen_time_ + lan_server_ < now)
+				// We are going to waith 10 seconds before shutting down so users can get out of game.
+				if (graceful_restart && games_.empty() && ++graceful_counter > 500 )
 				{
-					LOG_SERVER << "Lan server has been empty for  " << (now - last_user_seen_time_) << " seconds. Shutting down!\n";
-					// We have to shutdown
-					graceful_restart = true;
+					// TODO: We should implement client side autoreconnect.
+					// Idea:
+					// server should send [reconnect]host=host,port=number[/reconnect]
+					// Then client would reconnect to new server automatically.
+					// This would also allow server to move to new port or address if there is need
+
+					process_command("msg All games ended. Shutting down now. Reconnect to the new server instance.", "system");
+					throw network::error("shut down");
 				}
-				// and check if bans have expired
-				ban_manager_.check_ban_times(now);
-				// Make sure we log stats every 5 minutes
-				if (last_stats_ + 5 * 60 <= now) {
-					dump_stats(now);
-					if (rooms_.dirty()) rooms_.write_rooms();
+
+				if (config_reload == 1) {
+					cfg_ = read_config();
+					load_config();
+					config_reload = 0;
 				}
 
-				// Cleaning the user_handler once a day should be more than enough
-				if (last_uh_clean_ + 60 * 60 * 24 <= now) {
-					clean_user_handler(now);
+				// Process commands from the server socket/fifo
+				std::string admin_cmd;
+				if (input_ && input_->read_line(admin_cmd)) {
+					LOG_SERVER << "Admin Command: type: " << admin_cmd << "\n";
+					const std::string res = process_command(admin_cmd, "*socket*");
+					// Only mark the response if we fake the issuer (i.e. command comes from IRC or so)
+					if (admin_cmd.at(0) == '+') {
+						LOG_SERVER << "[admin_command_response]\n" << res << "\n" << "[/admin_command_response]\n";
+					} else {
+						LOG_SERVER << res << "\n";
+					}
 				}
 
-				// Send network stats every hour
-				static int prev_hour = localtime(&now)->tm_hour;
-				if (prev_hour != localtime(&now)->tm_hour)
-				{
-					prev_hour = localtime(&now)->tm_hour;
-					LOG_SERVER << network::get_bandwidth_stats();
+				time_t now = time(NULL);
+				if (last_ping_ + network::ping_interval <= now) {
+					if (lan_server_ && players_.empty() && last_user_seen_time_ + lan_server_ < now)
+					{
+						LOG_SERVER << "Lan server has been empty for  " << (now - last_user_seen_time_) << " seconds. Shutting down!\n";
+						// We have to shutdown
+						graceful_restart = true;
+					}
+					// and check if bans have expired
+					ban_manager_.check_ban_times(now);
+					// Make sure we log stats every 5 minutes
+					if (last_stats_ + 5 * 60 <= now) {
+						dump_stats(now);
+						if (rooms_.dirty()) rooms_.write_rooms();
+					}
 
-				}
+					// Cleaning the user_handler once a day should be more than enough
+					if (last_uh_clean_ + 60 * 60 * 24 <= now) {
+						clean_user_handler(now);
+					}
+
+					// Send network stats every hour
+					static int prev_hour = localtime(&now)->tm_hour;
+					if (prev_hour != localtime(&now)->tm_hour)
+					{
+						prev_hour = localtime(&now)->tm_hour;
+						LOG_SERVER << network::get_bandwidth_stats();
+
+					}
 
-				// send a 'ping' to all players to detect ghosts
-				DBG_SERVER << "Pinging inactive players.\n" ;
-				std::ostringstream strstr ;
-				strstr << "ping=\"" << now << "\"" ;
-				simple_wml::document ping( strstr.str().c_str(),
-							   simple_wml::INIT_COMPRESSED );
-				simple_wml::string_span s = ping.output_compressed();
-				BOOST_FOREACH(network::connection sock, ghost_players_) {
-					if (!lg::debug.dont_log(log_server)) {
-						wesnothd::player_map::const_iterator i = players_.find(sock);
-						if (i != players_.end()) {
-							DBG_SERVER << "Pinging " << i->second.name() << "(" << i->first << ").\n";
-						} else {
-							ERR_SERVER << "Player " << sock << " is in ghost_players_ but not in players_.\n";
+					// send a 'ping' to all players to detect ghosts
+					DBG_SERVER << "Pinging inactive players.\n" ;
+					std::ostringstream strstr ;
+					strstr << "ping=\"" << now << "\"" ;
+					simple_wml::document ping( strstr.str().c_str(),
+								   simple_wml::INIT_COMPRESSED );
+					simple_wml::string_span s = ping.output_compressed();
+					BOOST_FOREACH(network::connection sock, ghost_players_) {
+						if (!lg::debug.dont_log(log_server)) {
+							wesnothd::player_map::const_iterator i = players_.find(sock);
+							if (i != players_.end()) {
+								DBG_SERVER << "Pinging " << i->second.name() << "(" << i->first << ").\n";
+							} else {
+								ERR_SERVER << "Player " << sock << " is in ghost_players_ but not in players_.\n";
+							}
 						}
+						network::send_raw_data(s.begin(), s.size(), sock, "ping") ;
 					}
-					network::send_raw_data(s.begin(), s.size(), sock, "ping") ;
-				}
 
- 				// Copy new player list on top of ghost_players_ list.
- 				// Only a single thread should be accessing this
-				// Erase before we copy - speeds inserts
-				ghost_players_.clear();
-				BOOST_FOREACH(const wesnothd::player_map::value_type v, players_) {
-					ghost_players_.insert(v.first);
+	 				// Copy new player list on top of ghost_players_ list.
+	 				// Only a single thread should be accessing this
+					// Erase before we copy - speeds inserts
+					ghost_players_.clear();
+					BOOST_FOREACH(const wesnothd::player_map::value_type v, players_) {
+						ghost_players_.insert(v.first);
+					}
+					last_ping_ = now;
 				}
-				last_ping_ = now;
-			}
 
-			network::process_send_queue();
-
-			network::connection sock = network::accept_connection(lobby->sock(twesnothd_lobby::wesnoth_tag));
-			if (sock) {
-				const std::string ip = network::ip_address(sock);
-				const std::string reason = is_ip_banned(ip);
-				if (!reason.empty()) {
-					LOG_SERVER << ip << "\trejected banned user. Reason: " << reason << "\n";
-					send_error(sock, "You are banned. Reason: " + reason);
-					network::queue_disconnect(sock);
-				} else if (ip_exceeds_connection_limit(ip)) {
-					LOG_SERVER << ip << "\trejected ip due to excessive connections\n";
-					send_error(sock, "Too many connections from your IP.");
-					network::queue_disconnect(sock);
-				} else {
-					DBG_SERVER << ip << "\tnew connection accepted. (socket: "
-						<< sock << ")\n";
-					send_doc(version_query_response_, sock);
+				network::process_send_queue();
+
+				sock = network::accept_connection(lobby->sock(twesnothd_lobby::wesnoth_tag));
+				if (sock) {
+					const std::string ip = network::ip_address(sock);
+					const std::string reason = is_ip_banned(ip);
+					if (!reason.empty()) {
+						LOG_SERVER << ip << "\trejected banned user. Reason: " << reason << "\n";
+						send_error(sock, "You are banned. Reason: " + reason);
+						network::queue_disconnect(sock);
+					} else if (ip_exceeds_connection_limit(ip)) {
+						LOG_SERVER << ip << "\trejected ip due to excessive connections\n";
+						send_error(sock, "Too many connections from your IP.");
+						network::queue_disconnect(sock);
+					} else {
+						DBG_SERVER << ip << "\tnew connection accepted. (socket: "
+							<< sock << ")\n";
+						send_doc(version_query_response_, sock);
+					}
+					not_logged_in_.insert(sock);
 				}
-				not_logged_in_.insert(sock);
 			}
 
 			static int sample_counter = 0;
 
 			std::vector<char> buf;
 			network::bandwidth_in_ptr bandwidth_type;
-			while ((sock = network::receive_data(buf, 0, &bandwidth_type)) != network::null_connection) {
+			for (;;) {
+				{
+					// receiving changes tsock of lobby, i.e. remote handle, that tasks look up when they send.
+					const wesnothd::tcontrol_lane control(executors_.get());
+					sock = network::receive_data(buf, 0, &bandwidth_type);
+				}
+				if (sock == network::null_connection) {
+					break;
+				}
 				metrics_.service_request();
 
 				if(buf.empty()) {
 					WRN_SERVER << "received empty packet\n";
 					continue;
 				}
+				const Uint64 start_processing = SDL_GetPerformanceCounter();
+				const size_t packet_size = buf.size();
 
 				const bool sample = request_sample_frequency >= 1 && (sample_counter++ % request_sample_frequency) == 0;
 
@@ -912,9 +958,20 @@ void server::run() {
 
 				const clock_t after_parsing = get_cpu_time(sample);
 
-				process_data(sock, data);
+				const std::string packet_type = data.root().first_child().to_string();
+				bandwidth_type->set_type(packet_type);
+				if (dispatch_to_game(sock, data_ptr, packet_size, bandwidth_type->received_at())) {
+					// executor records metrics of packet.
+					continue;
+				}
+				{
+					const wesnothd::tcontrol_lane control(executors_.get(), game_of(sock));
+					process_data(sock, data);
+				}
 
-				bandwidth_type->set_type(data.root().first_child().to_string());
+				metrics_.record_packet(packet_type, packet_size,
+					start_processing - bandwidth_type->received_at(),
+					SDL_GetPerformanceCounter() - start_processing);
 				if(sample) {
 					const clock_t after_processing = get_cpu_time(sample);
 					metrics_.record_sample(data.root().first_child(),
@@ -929,6 +986,7 @@ void server::run() {
 		} catch(simple_wml::error& e) {
 			WRN_CONFIG << "Warning: error in received data: " << e.message << "\n";
 		} catch(network::error& e) {
+			const wesnothd::tcontrol_lane control(executors_.get(), game_of(e.socket));
 			if (e.message == "shut down") {
 				LOG_SERVER << "Try to disconnect all users...\n";
 				for (wesnothd::player_map::const_iterator pl = players_.begin();
@@ -1039,18 +1097,8 @@ void server::process_data(const network::connection sock,
 		return;
 	}
 
-	// We know the client is alive for this interval
-	// Remove player from ghost_players map if selective_ping
-	// is enabled for the player.
-
-	if (ghost_players_.find(sock) != ghost_players_.end()) {
-		const wesnothd::player_map::const_iterator pl = players_.find(sock);
-		if (pl != players_.end()) {
-			if (pl->second.selective_ping() ) {
-				ghost_players_.erase(sock);
-			}
-		}
-	}
+	note_alive(sock);
+	wesnothd::compare_output(data);
 
 	// Process the message
 	simple_wml::node& root = data.root();
@@ -1075,6 +1123,116 @@ void server::process_data(const network::connection sock,
 
 
 
+void server::note_alive(const network::connection sock)
+{
+	// We know the client is alive for this interval
+	// Remove player from ghost_players map if selective_ping
+	// is enabled for the player.
+
+	if (ghost_players_.find(sock) != ghost_players_.end()) {
+		const wesnothd::player_map::const_iterator pl = players_.find(sock);
+		if (pl != players_.end()) {
+			if (pl->second.selective_ping() ) {
+				ghost_players_.erase(sock);
+			}
+		}
+	}
+}
+
+int server::game_of(const network::connection sock) const
+{
+	const std::vector<wesnothd::game*>::const_iterator g =
+		std::find_if(games_.begin(), games_.end(), wesnothd::game_is_member(sock));
+	return g != games_.end()? (*g)->id(): 0;
+}
+
+bool server::dispatch_to_game(const network::connection sock,
+                              boost::scoped_ptr<simple_wml::document>& data,
+                              size_t packet_size, Uint64 received_at)
+{
+	if (!executors_ || proxy::is_proxy(sock)
+	|| not_logged_in_.find(sock) != not_logged_in_.end() || rooms_.in_lobby(sock)) {
+		return false;
+	}
+	// the same that process_data() and process_data_game() send to game.
+	const simple_wml::node& root = data->root();
+	const simple_wml::string_span& type = root.first_child();
+	if (root.has_attr("ping") || !root.one_child()
+	|| (type != "turn" && type != "message" && type != "whiteboard")) {
+		return false;
+	}
+	const std::vector<wesnothd::game*>::const_iterator g =
+		std::find_if(games_.begin(), games_.end(), wesnothd::game_is_member(sock));
+	if (g == games_.end() || !(*g)->started()) {
+		return false;
+	}
+
+	note_alive(sock);
+	wesnothd::compare_output(*data);
+
+	const int game_id = (*g)->id();
+	executors_->post(game_id, boost::bind(&server::process_game_task, this,
+		sock, data.get(), game_id, packet_size, received_at));
+	data.reset();
+	return true;
+}
+
+void server::process_game_task(const network::connection sock,
+                               simple_wml::document* data, int game_id,
+                               size_t packet_size, Uint64 received_at)
+{
+	// data was released by dispatch_to_game().
+	boost::scoped_ptr<simple_wml::document> data_ptr(data);
+	const Uint64 start_processing = SDL_GetPerformanceCounter();
+	const std::string packet_type = data->root().first_child().to_string();
+
+	// player may have left or game ended after the message was queued.
+	const std::vector<wesnothd::game*>::const_iterator g =
+		std::find_if(games_.begin(), games_.end(), wesnothd::game_id_matches(game_id));
+	const wesnothd::player_map::iterator pl = players_.find(sock);
+	if (g == games_.end() || pl == players_.end() || !(*g)->is_member(sock)) {
+		return;
+	}
+
+	try {
+		if (data->child("turn")) {
+			if ((*g)->process_turn(*data, pl)) {
+				executors_->post_control(boost::bind(&server::turn_ended, this, game_id));
+			}
+		} else if (data->child("whiteboard")) {
+			(*g)->process_whiteboard(*data, pl);
+		} else {
+			(*g)->process_message(*data, pl);
+		}
+	} catch (simple_wml::error& e) {
+		WRN_CONFIG << "simple_wml error in game " << game_id << ": " << e.message << std::endl;
+	} catch (twml_exception& e) {
+		ERR_SERVER << "wml exception in game " << game_id << ": " << e.dev_message << "\n";
+	} catch (network::error& e) {
+		// main thread disconnects it, players and games are changed in control lane.
+		ERR_SERVER << "network error in game " << game_id << ": " << e.message << "\n";
+		if (e.socket) {
+			executors_->post_control(boost::bind(&network::queue_disconnect, e.socket));
+		}
+	} catch (std::exception& e) {
+		ERR_SERVER << "exception in game " << game_id << ": " << e.what() << "\n";
+	}
+
+	metrics_.record_packet(packet_type, packet_size,
+		start_processing - received_at,
+		SDL_GetPerformanceCounter() - start_processing);
+}
+
+void server::turn_ended(int game_id)
+{
+	const std::vector<wesnothd::game*>::const_iterator g =
+		std::find_if(games_.begin(), games_.end(), wesnothd::game_id_matches(game_id));
+	if (g != games_.end()) {
+		(*g)->update_turn_description();
+		update_game_in_lobby(*g);
+	}
+}
+
 void server::process_login(const network::connection sock,
                            simple_wml::document& data) {
 
@@ -1400,7 +1558,7 @@ void server::process_query(const network::connection sock,
 	const std::string command(query["type"].to_string());
 	std::ostringstream response;
 	const std::string& help_msg = "Available commands are: adminmsg <msg>, help, games, metrics,"
-			" motd, netstats [all], requests, sample, stats, status, wml.";
+			" motd, netstats [all|wire], requests, sample, stats, status, wml.";
 	// Commands a player may issue.
 	if (command == "status") {
 		response << process_command(command + " " + pl->second.name(), pl->second.name());
@@ -1410,6 +1568,7 @@ void server::process_query(const network::connection sock,
 			|| command == "motd"
 			|| command == "netstats"
 			|| command == "netstats all"
+			|| command == "netstats wire"
 			|| command == "requests"
 			|| command == "sample"
 			|| command == "stats"
@@ -1597,6 +1756,20 @@ void server::requests_handler(const std::string& /*issuer_name*/, const std::str
 	metrics_.requests(*out);
 }
 
+void server::latency_handler(const std::string& /*issuer_name*/, const std::string& /*query*/, std::string& parameters, std::ostringstream *out) {
+	assert(out != NULL);
+	metrics_.histograms(*out, parameters);
+}
+
+void server::executors_handler(const std::string& /*issuer_name*/, const std::string& /*query*/, std::string& /*parameters*/, std::ostringstream *out) {
+	assert(out != NULL);
+	if (!executors_) {
+		*out << "Games are processed by main thread.";
+		return;
+	}
+	executors_->stats(*out);
+}
+
 void server::games_handler(const std::string& /*issuer_name*/, const std::string& /*query*/, std::string& /*parameters*/, std::ostringstream *out) {
 	assert(out != NULL);
 	metrics_.games(*out);
@@ -1617,6 +1790,9 @@ void server::netstats_handler(const std::string& /*issuer_name*/, const std::str
 
 	if (utils::lowercase(parameters) == "all") {
 		*out << network::get_bandwidth_stats_all();
+	} else if (utils::lowercase(parameters) == "wire") {
+		// text vs binary WML, sampled every wire_compare messages.
+		*out << binary_wml::stats_report();
 	} else {
 		*out << network::get_bandwidth_stats(); // stats from previuos hour
 	}
@@ -1833,9 +2009,9 @@ void server::ban_handler(const std::string& issuer_name, const std::string& /*qu
 
 	std::string dummy_group;
 
-	// if we find a '.' consider it an ip mask
+	// if we find a '.' or ':' consider it an ip mask
 	/** @todo  FIXME: make a proper check for valid IPs. */
-	if (std::count(target.begin(), target.end(), '.') >= 1) {
+	if (std::count(target.begin(), target.end(), '.') >= 1 || target.find(':') != std::string::npos) {
 		banned = true;
 
 		*out << ban_manager_.ban(target, parsed_time, reason, issuer_name, dummy_group);
@@ -1902,9 +2078,9 @@ void server::kickban_handler(const std::string& issuer_name, const std::string&
 
 		std::string dummy_group;
 
-		// if we find a '.' consider it an ip mask
+		// if we find a '.' or ':' consider it an ip mask
 		/** @todo  FIXME: make a proper check for valid IPs. */
-		if (std::count(target.begin(), target.end(), '.') >= 1) {
+		if (std::count(target.begin(), target.end(), '.') >= 1 || target.find(':') != std::string::npos) {
 			banned = true;
 
 			*out << ban_manager_.ban(target, parsed_time, reason, issuer_name, dummy_group);
@@ -1988,9 +2164,9 @@ void server::gban_handler(const std::string& issuer_name, const std::string& /*q
 				return;
 			}
 
-			// if we find a '.' consider it an ip mask
+			// if we find a '.' or ':' consider it an ip mask
 			/** @todo  FIXME: make a proper check for valid IPs. */
-			if (std::count(target.begin(), target.end(), '.') >= 1) {
+			if (std::count(target.begin(), target.end(), '.') >= 1 || target.find(':') != std::string::npos) {
 				banned = true;
 
 				*out << ban_manager_.ban(target, parsed_time, reason, issuer_name, group);
@@ -2783,6 +2959,7 @@ void server::process_data_game(const network::connection sock,
 		// the description, then sync the new description
 		// to players in the lobby.
 		if (g->process_turn(data, pl)) {
+			g->update_turn_description();
 			update_game_in_lobby(g);
 		}
 		return;
@@ -2918,6 +3095,7 @@ int main(int argc, char** argv) {
 	int port = 15000;
 	size_t min_threads = 5;
 	size_t max_threads = 0;
+	size_t game_threads = 0;
 
 	srand(static_cast<unsigned>(time(NULL)));
 
@@ -2970,9 +3148,13 @@ int main(int argc, char** argv) {
 		} else if (val == "--help" || val == "-h") {
 			std::cout << "usage: " << argv[0]
 				<< " [-dvV] [-c path] [-m n] [-p port] [-t n]\n"
+				<< "  --benchmark-bans <n>       Times ban lookup and expiry with n random bans, then exits.\n"
+				<< "  --benchmark-wml <n>        Times n WML messages with and without arena, then exits.\n"
 				<< "  -c, --config <path>        Tells wesnothd where to find the config file to use.\n"
 				<< "  -d, --daemon               Runs wesnothd as a daemon.\n"
+				<< "  -g, --game-threads <n>     Processes turns and messages of games on n threads (default: 0, main thread).\n"
 				<< "  -h, --help                 Shows this usage message.\n"
+				<< "  --loadtest <script>        Runs simulated clients of script against a server, then exits.\n"
 				<< "  --log-<level>=<domain1>,<domain2>,...\n"
 				<< "                             sets the severity level of the debug domains.\n"
 				<< "                             'all' can be used to match any debug domain.\n"
@@ -3008,10 +3190,23 @@ int main(int argc, char** argv) {
 			if (min_threads > 30) {
 				min_threads = 30;
 			}
+		} else if ((val == "--game-threads" || val == "-g") && arg+1 != argc) {
+			game_threads = atoi(argv[++arg]);
+			if (game_threads > 64) {
+				game_threads = 64;
+			}
 		} else if ((val == "--max-threads" || val == "-T") && arg+1 != argc) {
 			max_threads = atoi(argv[++arg]);
 		} else if(val == "--request_sample_frequency" && arg+1 != argc) {
 			request_sample_frequency = atoi(argv[++arg]);
+		} else if(val == "--benchmark-bans" && arg+1 != argc) {
+			wesnothd::ban_manager::benchmark(std::cout, atoi(argv[++arg]));
+			return 0;
+		} else if(val == "--benchmark-wml" && arg+1 != argc) {
+			simple_wml::benchmark(std::cout, atoi(argv[++arg]));
+			return 0;
+		} else if(val == "--loadtest" && arg+1 != argc) {
+			return wesnothd::load_test(std::cout, argv[++arg]);
 		} else {
 			ERR_SERVER << "unknown option: " << val << "\n";
 			return 2;
@@ -3022,7 +3217,7 @@ int main(int argc, char** argv) {
 
 	try {
 		tlobby_manager lobby_manager;
-		server(port, config_file, min_threads, max_threads).run();
+		server(port, config_file, min_threads, max_threads, game_threads).run();
 	} catch(network::error& e) {
 		ERR_SERVER << "Caught network error while server was running. Aborting.: "
 			<< e.message << "\n";
@@ -16,6 +16,7 @@
 #define SERVER_HPP_INCLUDED
 
 #include "config.hpp"
+#include "executor.hpp"
 #include "user_handler.hpp"
 #include "input_stream.hpp"
 #include "metrics.hpp"
@@ -31,7 +32,7 @@
 class server
 {
 public:
-	server(int port, const std::string& config_file, size_t min_threads,size_t max_threads);
+	server(int port, const std::string& config_file, size_t min_threads,size_t max_threads, size_t game_threads);
 	void run();
 private:
 	void send_error(network::connection sock, const char* msg, const char* error_code ="") const;
@@ -128,6 +129,8 @@ private:
 	bool deny_unregistered_login_;
 	bool save_replays_;
 	std::string replay_save_path_;
+	// file where metrics of packets are dumped with statistics, empty disables it.
+	std::string metrics_dump_;
 	bool allow_remote_shutdown_;
 	std::vector<std::string> tor_ip_list_;
 	int failed_login_limit_;
@@ -147,6 +150,13 @@ private:
 
 	metrics metrics_;
 
+	/**
+	 * NULL: every message is processed by main thread.
+	 * Declared after players and games, so it is destroyed, and its threads
+	 * are joined, before what tasks refer to.
+	 */
+	boost::scoped_ptr<wesnothd::executor_pool> executors_;
+
 	time_t last_ping_;
 	time_t last_stats_;
 	void dump_stats(const time_t& now);
@@ -156,6 +166,24 @@ private:
 
 	void process_data(const network::connection sock,
 	                  simple_wml::document& data);
+	/** Remove player from ghost_players_ if selective ping is enabled. */
+	void note_alive(const network::connection sock);
+
+	/** id of game that sock is member of, 0 if it isn't in a game. */
+	int game_of(const network::connection sock) const;
+
+	/**
+	 * Queue [turn], [message] and [whiteboard] of a started game to its
+	 * executor, it takes data then. False if main thread has to process it.
+	 */
+	bool dispatch_to_game(const network::connection sock,
+	                      boost::scoped_ptr<simple_wml::document>& data,
+	                      size_t packet_size, Uint64 received_at);
+	void process_game_task(const network::connection sock,
+	                       simple_wml::document* data, int game_id,
+	                       size_t packet_size, Uint64 received_at);
+	/** Control lane part of a [turn] that ended a turn. */
+	void turn_ended(int game_id);
 	void process_login(const network::connection sock,
 	                   simple_wml::document& data);
 
@@ -194,6 +222,8 @@ private:
 	void stats_handler(const std::string &, const std::string &, std::string &, std::ostringstream *);
 	void metrics_handler(const std::string &, const std::string &, std::string &, std::ostringstream *);
 	void requests_handler(const std::string &, const std::string &, std::string &, std::ostringstream *);
+	void latency_handler(const std::string &, const std::string &, std::string &, std::ostringstream *);
+	void executors_handler(const std::string &, const std::string &, std::string &, std::ostringstream *);
 	void games_handler(const std::string &, const std::string &, std::string &, std::ostringstream *);
 	void wml_handler(const std::string &, const std::string &, std::string &, std::ostringstream *);
 	void netstats_handler(const std::string &, const std::string &, std::string &, std::ostringstream *);
@@ -24,21 +24,55 @@
 
 #include "simple_wml.hpp"
 
+#include "config.hpp"
 #include "log.hpp"
+#include "serialization/binary_wml.hpp"
+#include "thread.hpp"
+
+#include "SDL_timer.h"
+#include <iomanip>
 
 static lg::log_domain log_config("config");
 #define ERR_SWML LOG_STREAM(err, log_config)
 
 namespace simple_wml {
 
+bool use_arena = true;
+
 namespace {
 
+// first block is kept when arena is reset, and when it returns to pool.
+const size_t arena_first_block = 4096;
+const size_t arena_max_block = 65536;
+const size_t arena_pool_size = 32;
+
+threading::mutex arena_mutex;
+std::vector<tarena*> arena_pool;
+
+size_t arena_align(size_t size)
+{
+	return (size + 7) & ~(size_t)7;
+}
+
 void debug_delete(node* n) {
-	delete n;
+	node::destroy(n);
 }
 
 char* uncompress_buffer(const string_span& input, string_span* span)
 {
+	if (binary_wml::is_binary(input.begin(), input.size())) {
+		std::string text;
+		try {
+			binary_wml::read_text(text, input.begin(), input.size());
+		} catch (config::error& e) {
+			throw error(e.message.c_str());
+		}
+		char* out = new char[text.size() + 1];
+		memcpy(out, text.c_str(), text.size() + 1);
+		*span = string_span(out, text.size());
+		return out;
+	}
+
 	int nalloc = input.size();
 	int state = 0;
 	try {
@@ -193,6 +227,142 @@ char* string_span::duplicate() const
 	return buf;
 }
 
+tarena::tarena()
+	: blocks_()
+	, used_(0)
+	, enabled_(false)
+{
+	tblock block;
+	block.data = static_cast<char*>(::operator new(arena_first_block));
+	block.size = arena_first_block;
+	blocks_.push_back(block);
+}
+
+tarena::~tarena()
+{
+	for (std::vector<tblock>::iterator it = blocks_.begin(); it != blocks_.end(); ++ it) {
+		::operator delete(it->data);
+	}
+}
+
+tarena* tarena::acquire()
+{
+	if (!use_arena) {
+		return NULL;
+	}
+	tarena* arena = NULL;
+	{
+		const threading::lock lock(arena_mutex);
+		if (!arena_pool.empty()) {
+			arena = arena_pool.back();
+			arena_pool.pop_back();
+		}
+	}
+	if (!arena) {
+		arena = new tarena();
+	}
+	arena->enabled_ = true;
+	return arena;
+}
+
+void tarena::release(tarena* arena)
+{
+	if (!arena) {
+		return;
+	}
+	arena->reset();
+	arena->enabled_ = false;
+	{
+		const threading::lock lock(arena_mutex);
+		if (arena_pool.size() < arena_pool_size) {
+			arena_pool.push_back(arena);
+			return;
+		}
+	}
+	delete arena;
+}
+
+void* tarena::allocate(size_t size)
+{
+	if (!enabled_) {
+		return ::operator new(size);
+	}
+	size = arena_align(size);
+	if (used_ + size > blocks_.back().size) {
+		size_t block_size = std::min(blocks_.back().size * 2, arena_max_block);
+		if (block_size < size) {
+			block_size = size;
+		}
+		tblock block;
+		block.data = static_cast<char*>(::operator new(block_size));
+		block.size = block_size;
+		blocks_.push_back(block);
+		used_ = 0;
+	}
+	void* result = blocks_.back().data + used_;
+	used_ += size;
+	return result;
+}
+
+void tarena::deallocate(void* p)
+{
+	if (!owns(p)) {
+		::operator delete(p);
+	}
+}
+
+bool tarena::owns(const void* p) const
+{
+	const char* ptr = static_cast<const char*>(p);
+	// the latest block is the most likely one.
+	for (std::vector<tblock>::const_reverse_iterator it = blocks_.rbegin(); it != blocks_.rend(); ++ it) {
+		if (ptr >= it->data && ptr < it->data + it->size) {
+			return true;
+		}
+	}
+	return false;
+}
+
+char* tarena::duplicate(const char* str, int size)
+{
+	char* buf = static_cast<char*>(allocate(size + 1));
+	memcpy(buf, str, size);
+	buf[size] = 0;
+	return buf;
+}
+
+void tarena::reset()
+{
+	for (std::vector<tblock>::iterator it = blocks_.begin() + 1; it != blocks_.end(); ++ it) {
+		::operator delete(it->data);
+	}
+	blocks_.resize(1);
+	used_ = 0;
+}
+
+size_t tarena::reserved() const
+{
+	size_t result = 0;
+	for (std::vector<tblock>::const_iterator it = blocks_.begin(); it != blocks_.end(); ++ it) {
+		result += it->size;
+	}
+	return result;
+}
+
+void* arena_allocate(tarena* arena, size_t size)
+{
+	return arena? arena->allocate(size): ::operator new(size);
+}
+
+void arena_deallocate(tarena* arena, void* p)
+{
+	if (arena) {
+		arena->deallocate(p);
+	} else {
+		::operator delete(p);
+	}
+}
+
 error::error(const char* msg)
   : game::error(msg)
 {
@@ -207,10 +377,10 @@ std::ostream& operator<<(std::ostream& o, const string_span& s)
 
 node::node(document& doc, node* parent) :
 	doc_(&doc),
-	attr_(),
+	attr_(attribute_list::allocator_type(doc.arena())),
 	parent_(parent),
-	children_(),
-	ordered_children_(),
+	children_(child_map::allocator_type(doc.arena())),
+	ordered_children_(node_pos_list::allocator_type(doc.arena())),
 	output_cache_()
 {
 }
@@ -221,10 +391,10 @@ node::node(document& doc, node* parent) :
 #endif
 node::node(document& doc, node* parent, const char** str, int depth) :
 	doc_(&doc),
-	attr_(),
+	attr_(attribute_list::allocator_type(doc.arena())),
 	parent_(parent),
-	children_(),
-	ordered_children_(),
+	children_(child_map::allocator_type(doc.arena())),
+	ordered_children_(node_pos_list::allocator_type(doc.arena())),
 	output_cache_()
 {
 	if(depth >= 1000) {
@@ -259,7 +429,7 @@ node::node(document& doc, node* parent, const char** str, int depth) :
 
 			s = end + 1;
 
-			children_[list_index].second.push_back(new node(doc, this, str, depth+1));
+			children_[list_index].second.push_back(new (doc.arena()) node(doc, this, str, depth+1));
 			ordered_children_.push_back(node_pos(list_index, children_[list_index].second.size() - 1));
 			check_ordered_children();
 
@@ -362,6 +532,15 @@ node::node(document& doc, node* parent, const char** str, int depth) :
 	check_ordered_children();
 }
 
+void node::destroy(node* n)
+{
+	if (n) {
+		tarena* arena = n->attr_.get_allocator().arena();
+		n->~node();
+		arena_deallocate(arena, n);
+	}
+}
+
 node::~node()
 {
 	for(child_map::iterator i = children_.begin(); i != children_.end(); ++i) {
@@ -433,9 +612,7 @@ node& node::set_attr_dup(const char* key, const char* value)
 
 node& node::set_attr_dup(const char* key, const string_span& value)
 {
-	char* buf = value.duplicate();
-	doc_->take_ownership_of_buffer(buf);
-	return set_attr(key, buf);
+	return set_attr(key, doc_->dup_span(value));
 }
 
 node& node::set_attr_int(const char* key, int value)
@@ -456,7 +633,7 @@ node& node::add_child_at(const char* name, size_t index)
 	}
 
 	check_ordered_children();
-	list.insert(list.begin() + index, new node(*doc_, this));
+	list.insert(list.begin() + index, new (doc_->arena()) node(*doc_, this));
 	insert_ordered_child(list_index, index);
 
 	check_ordered_children();
@@ -471,7 +648,7 @@ node& node::add_child(const char* name)
 	const int list_index = get_children(name);
 	check_ordered_children();
 	child_list& list = children_[list_index].second;
-	list.push_back(new node(*doc_, this));
+	list.push_back(new (doc_->arena()) node(*doc_, this));
 	ordered_children_.push_back(node_pos(list_index, list.size() - 1));
 	check_ordered_children();
 	return *list.back();
@@ -506,7 +683,7 @@ void node::remove_child(const string_span& name, size_t index)
 void node::insert_ordered_child(int child_map_index, int child_list_index)
 {
 	bool inserted = false;
-	std::vector<node_pos>::iterator i = ordered_children_.begin();
+	node_pos_list::iterator i = ordered_children_.begin();
 	while(i != ordered_children_.end()) {
 		if(i->child_map_index == child_map_index && i->child_list_index > child_list_index) {
 			i->child_list_index++;
@@ -528,7 +705,7 @@ void node::insert_ordered_child(int child_map_index, int child_list_index)
 void node::remove_ordered_child(int child_map_index, int child_list_index)
 {
 	int erase_count = 0;
-	std::vector<node_pos>::iterator i = ordered_children_.begin();
+	node_pos_list::iterator i = ordered_children_.begin();
 	while(i != ordered_children_.end()) {
 		if(i->child_map_index == child_map_index && i->child_list_index == child_list_index) {
 			i = ordered_children_.erase(i);
@@ -546,7 +723,7 @@ void node::remove_ordered_child(int child_map_index, int child_list_index)
 
 void node::insert_ordered_child_list(int child_map_index)
 {
-	std::vector<node_pos>::iterator i = ordered_children_.begin();
+	node_pos_list::iterator i = ordered_children_.begin();
 	while(i != ordered_children_.end()) {
 		if(i->child_map_index >= child_map_index) {
 			i->child_map_index++;
@@ -556,7 +733,7 @@ void node::insert_ordered_child_list(int child_map_index)
 
 void node::remove_ordered_child_list(int child_map_index)
 {
-	std::vector<node_pos>::iterator i = ordered_children_.begin();
+	node_pos_list::iterator i = ordered_children_.begin();
 	while(i != ordered_children_.end()) {
 		if(i->child_map_index == child_map_index) {
 			assert(false);
@@ -575,7 +752,7 @@ void node::check_ordered_children() const
 {
 // only define this symbol in debug mode to work out child ordering.
 #ifdef CHECK_ORDERED_CHILDREN
-	std::vector<node_pos>::const_iterator i = ordered_children_.begin();
+	node_pos_list::const_iterator i = ordered_children_.begin();
 	while(i != ordered_children_.end()) {
 		assert(i->child_map_index < children_.size());
 		assert(i->child_list_index < children_[i->child_map_index].second.size());
@@ -658,7 +835,7 @@ int node::get_children(const string_span& name)
 		}
 	}
 
-	children_.push_back(child_pair(string_span(name), child_list()));
+	children_.push_back(child_pair(string_span(name), child_list(child_list::allocator_type(doc_->arena()))));
 	return children_.size() - 1;
 }
 
@@ -728,7 +905,7 @@ void node::shift_buffers(ptrdiff_t offset)
 		output_cache_ = string_span(output_cache_.begin() + offset, output_cache_.size());
 	}
 
-	for(std::vector<attribute>::iterator i = attr_.begin(); i != attr_.end(); ++i) {
+	for(attribute_list::iterator i = attr_.begin(); i != attr_.end(); ++i) {
 		i->first = string_span(i->first.begin() + offset, i->first.size());
 		i->second = string_span(i->second.begin() + offset, i->second.size());
 	}
@@ -755,7 +932,7 @@ void node::output(char*& buf, CACHE_STATUS cache_status)
 
 	char* begin = buf;
 
-	for(std::vector<attribute>::iterator i = attr_.begin(); i != attr_.end(); ++i) {
+	for(attribute_list::iterator i = attr_.begin(); i != attr_.end(); ++i) {
 		memcpy(buf, i->first.begin(), i->first.size());
 		i->first = string_span(buf, i->first.size());
 		buf += i->first.size();
@@ -768,7 +945,7 @@ void node::output(char*& buf, CACHE_STATUS cache_status)
 		*buf++ = '\n';
 	}
 
-	for(std::vector<node_pos>::const_iterator i = ordered_children_.begin();
+	for(node_pos_list::const_iterator i = ordered_children_.begin();
 	    i != ordered_children_.end(); ++i) {
 		assert(i->child_map_index < children_.size());
 		assert(i->child_list_index < children_[i->child_map_index].second.size());
@@ -809,20 +986,15 @@ void node::copy_into(node& n) const
 {
 	n.set_dirty();
 	for(attribute_list::const_iterator i = attr_.begin(); i != attr_.end(); ++i) {
-		char* key = i->first.duplicate();
-		char* value = i->second.duplicate();
-		n.doc_->take_ownership_of_buffer(key);
-		n.doc_->take_ownership_of_buffer(value);
-		n.set_attr(key, value);
+		n.set_attr(n.doc_->dup_span(i->first), n.doc_->dup_span(i->second));
 	}
 
-	for(std::vector<node_pos>::const_iterator i = ordered_children_.begin();
+	for(node_pos_list::const_iterator i = ordered_children_.begin();
 	    i != ordered_children_.end(); ++i) {
 		assert(i->child_map_index < children_.size());
 		assert(i->child_list_index < children_[i->child_map_index].second.size());
-		char* buf = children_[i->child_map_index].first.duplicate();
-		n.doc_->take_ownership_of_buffer(buf);
-		children_[i->child_map_index].second[i->child_list_index]->copy_into(n.add_child(buf));
+		const char* name = n.doc_->dup_span(children_[i->child_map_index].first);
+		children_[i->child_map_index].second[i->child_list_index]->copy_into(n.add_child(name));
 	}
 }
 
@@ -832,11 +1004,7 @@ void node::apply_diff(const node& diff)
 	const node* inserts = diff.child("insert");
 	if(inserts != NULL) {
 		for(attribute_list::const_iterator i = inserts->attr_.begin(); i != inserts->attr_.end(); ++i) {
-			char* name = i->first.duplicate();
-			char* value = i->second.duplicate();
-			set_attr(name, value);
-			doc_->take_ownership_of_buffer(name);
-			doc_->take_ownership_of_buffer(value);
+			set_attr(doc_->dup_span(i->first), doc_->dup_span(i->second));
 		}
 	}
 
@@ -873,9 +1041,7 @@ void node::apply_diff(const node& diff)
 		for(child_map::const_iterator j = (*i)->children_.begin(); j != (*i)->children_.end(); ++j) {
 			const string_span& name = j->first;
 			for(child_list::const_iterator k = j->second.begin(); k != j->second.end(); ++k) {
-				char* buf = name.duplicate();
-				doc_->take_ownership_of_buffer(buf);
-				(*k)->copy_into(add_child_at(buf, index));
+				(*k)->copy_into(add_child_at(doc_->dup_span(name), index));
 			}
 		}
 	}
@@ -894,6 +1060,35 @@ void node::apply_diff(const node& diff)
 	}
 }
 
+void node::output_binary(binary_wml::tencoder& encoder) const
+{
+	std::string value;
+	for (attribute_list::const_iterator i = attr_.begin(); i != attr_.end(); ++i) {
+		const string_span& v = i->second;
+		if (!memchr(v.begin(), '"', v.size())) {
+			encoder.attribute(i->first.begin(), i->first.size(), v.begin(), v.size());
+			continue;
+		}
+		// value keeps doubled quotes of text WML.
+		value.clear();
+		for (const char* c = v.begin(); c != v.end(); ++c) {
+			value.push_back(*c);
+			if (*c == '"' && c + 1 != v.end() && c[1] == '"') {
+				++c;
+			}
+		}
+		encoder.attribute(i->first.begin(), i->first.size(), value.data(), value.size());
+	}
+
+	for(node_pos_list::const_iterator i = ordered_children_.begin();
+	    i != ordered_children_.end(); ++i) {
+		const string_span& attr = children_[i->child_map_index].first;
+		encoder.open_child(attr.begin(), attr.size());
+		children_[i->child_map_index].second[i->child_list_index]->output_binary(encoder);
+		encoder.close_child();
+	}
+}
+
 void node::set_doc(document* doc)
 {
 	doc_ = doc;
@@ -939,9 +1134,11 @@ void node::set_dirty()
 
 document::document() :
 	compressed_buf_(),
+	binary_buf_(),
+	arena_(tarena::acquire()),
 	output_(NULL),
 	buffers_(),
-	root_(new node(*this, NULL)),
+	root_(new (arena_) node(*this, NULL)),
 	prev_(NULL),
 	next_(NULL)
 {
@@ -950,6 +1147,8 @@ document::document() :
 
 document::document(char* buf, INIT_BUFFER_CONTROL control) :
 	compressed_buf_(),
+	binary_buf_(),
+	arena_(tarena::acquire()),
 	output_(buf),
 	buffers_(),
 	root_(NULL),
@@ -960,13 +1159,15 @@ document::document(char* buf, INIT_BUFFER_CONTROL control) :
 		buffers_.push_back(buf);
 	}
 	const char* cbuf = buf;
-	root_ = new node(*this, NULL, &cbuf);
+	root_ = new (arena_) node(*this, NULL, &cbuf);
 
 	attach_list();
 }
 
 document::document(const char* buf, INIT_STATE state) :
 	compressed_buf_(),
+	binary_buf_(),
+	arena_(tarena::acquire()),
 	output_(buf),
 	buffers_(),
 	root_(NULL),
@@ -977,7 +1178,7 @@ document::document(const char* buf, INIT_STATE state) :
 		output_compressed();
 		output_ = NULL;
 	} else {
-		root_ = new node(*this, NULL, &buf);
+		root_ = new (arena_) node(*this, NULL, &buf);
 	}
 
 	attach_list();
@@ -985,6 +1186,8 @@ document::document(const char* buf, INIT_STATE state) :
 
 document::document(string_span compressed_buf) :
 	compressed_buf_(compressed_buf),
+	binary_buf_(),
+	arena_(tarena::acquire()),
 	output_(NULL),
 	buffers_(),
 	root_(NULL),
@@ -995,12 +1198,18 @@ document::document(string_span compressed_buf) :
 	buffers_.push_back(uncompress_buffer(compressed_buf, &uncompressed_buf));
 	output_ = uncompressed_buf.begin();
 	const char* cbuf = output_;
+	if (binary_wml::is_binary(compressed_buf.begin(), compressed_buf.size())) {
+		// it is sent as is to binary client.
+		binary_buf_ = compressed_buf;
+		compressed_buf_ = string_span();
+	}
 
 	try {
-		root_ = new node(*this, NULL, &cbuf);
+		root_ = new (arena_) node(*this, NULL, &cbuf);
 	} catch(...) {
 		delete [] buffers_.front();
 		buffers_.clear();
+		tarena::release(arena_);
 		throw;
 	}
 
@@ -1015,6 +1224,7 @@ document::~document()
 
 	buffers_.clear();
 	debug_delete(root_);
+	tarena::release(arena_);
 
 	detach_list();
 }
@@ -1022,12 +1232,25 @@ document::~document()
 const char* document::dup_string(const char* str)
 {
 	const int len = strlen(str);
+	if(arena_ && arena_->enabled()) {
+		return arena_->duplicate(str, len);
+	}
 	char* res = new char[len+1];
 	memcpy(res, str, len + 1);
 	buffers_.push_back(res);
 	return res;
 }
 
+const char* document::dup_span(const string_span& str)
+{
+	if(arena_ && arena_->enabled()) {
+		return arena_->duplicate(str.begin(), str.size());
+	}
+	char* res = str.duplicate();
+	buffers_.push_back(res);
+	return res;
+}
+
 const char* document::output()
 {
 	if(output_ && (!root_ || root_->is_dirty() == false)) {
@@ -1043,6 +1266,14 @@ const char* document::output()
 
 	//we're dirty, so the compressed buf must also be dirty; clear it.
 	compressed_buf_ = string_span();
+	binary_buf_ = string_span();
+
+	// strings copied into arena before it are dropped by new output, but
+	// arena can't free them. from now on document may change again and
+	// again, use heap so memory of it doesn't grow.
+	if(arena_) {
+		arena_->set_enabled(false);
+	}
 
 	std::vector<char*> bufs;
 	bufs.swap(buffers_);
@@ -1074,9 +1305,8 @@ const char* document::output()
 
 string_span document::output_compressed(bool bzip2)
 {
-	if(compressed_buf_.empty() == false &&
+	if(compressed_buf_.empty() == false && *compressed_buf_.begin() == (bzip2 ? 'B' : 31) &&
 	   (root_ == NULL || root_->is_dirty() == false)) {
-		assert(*compressed_buf_.begin() == (bzip2 ? 'B' : 31));
 		return compressed_buf_;
 	}
 
@@ -1086,12 +1316,37 @@ string_span document::output_compressed(bool bzip2)
 	return compressed_buf_;
 }
 
+string_span document::output_binary()
+{
+	if(binary_buf_.empty() == false &&
+	   (root_ == NULL || root_->is_dirty() == false)) {
+		return binary_buf_;
+	}
+
+	// refresh output cache of nodes, so binary is valid until document is changed.
+	output();
+	binary_wml::tencoder encoder;
+	root().output_binary(encoder);
+	std::string out;
+	encoder.finish(out);
+
+	char* buf = new char[out.size()];
+	memcpy(buf, out.data(), out.size());
+	buffers_.push_back(buf);
+	binary_buf_ = string_span(buf, out.size());
+	return binary_buf_;
+}
+
 void document::compress()
 {
 	output_compressed();
+	binary_buf_ = string_span();
 	debug_delete(root_);
 	root_ = NULL;
 	output_ = NULL;
+	if(arena_) {
+		arena_->reset();
+	}
 	std::vector<char*> new_buffers;
 	for(std::vector<char*>::iterator i = buffers_.begin(); i != buffers_.end(); ++i) {
 		if(*i != compressed_buf_.begin()) {
@@ -1115,8 +1370,12 @@ void document::generate_root()
 	}
 
 	assert(root_ == NULL);
+	if(arena_) {
+		arena_->reset();
+		arena_->set_enabled(true);
+	}
 	const char* cbuf = output_;
-	root_ = new node(*this, NULL, &cbuf);
+	root_ = new (arena_) node(*this, NULL, &cbuf);
 }
 
 document* document::clone()
@@ -1129,8 +1388,10 @@ document* document::clone()
 void document::swap(document& o)
 {
 	std::swap(compressed_buf_, o.compressed_buf_);
+	std::swap(binary_buf_, o.binary_buf_);
 	std::swap(output_, o.output_);
 	buffers_.swap(o.buffers_);
+	std::swap(arena_, o.arena_);
 	std::swap(root_, o.root_);
 
 	root_->set_doc(this);
@@ -1140,9 +1401,14 @@ void document::swap(document& o)
 void document::clear()
 {
 	compressed_buf_ = string_span();
+	binary_buf_ = string_span();
 	output_ = NULL;
 	debug_delete(root_);
-	root_ = new node(*this, NULL);
+	if(arena_) {
+		arena_->reset();
+		arena_->set_enabled(true);
+	}
+	root_ = new (arena_) node(*this, NULL);
 	for(std::vector<char*>::iterator i = buffers_.begin(); i != buffers_.end(); ++i) {
 		delete [] *i;
 	}
@@ -1151,11 +1417,14 @@ void document::clear()
 }
 
 namespace {
+// documents are created and destroyed by game executors too.
+threading::mutex list_mutex;
 document* head_doc = NULL;
 }
 
 void document::attach_list()
 {
+	const threading::lock lock(list_mutex);
 	prev_ = NULL;
 	next_ = head_doc;
 
@@ -1167,6 +1436,7 @@ void document::attach_list()
 
 void document::detach_list()
 {
+	const threading::lock lock(list_mutex);
 	if(head_doc == this) {
 		head_doc = next_;
 	}
@@ -1193,9 +1463,16 @@ std::string document::stats()
 	int nnodes = 0;
 	int ndirty = 0;
 	int nattributes = 0;
+	int narenas = 0;
+	size_t arena_size = 0;
+	const threading::lock lock(list_mutex);
 	for(document* d = head_doc; d != NULL; d = d->next_) {
 		ndocs++;
 		nbuffers += d->buffers_.size();
+		if(d->arena_) {
+			++narenas;
+			arena_size += d->arena_->reserved();
+		}
 
 		if(d->compressed_buf_.is_null() == false) {
 			++ncompressed;
@@ -1230,11 +1507,79 @@ std::string document::stats()
 	  << "Nodes: " << nnodes << " (" << nodes_alloc << " bytes)\n"
 	  << "Attr: " << nattributes << " (" << attr_alloc << " bytes)\n"
 	  << "Buffers: " << nbuffers << "\n"
+	  << "Arenas: " << narenas << " (" << arena_size << " bytes, " << arena_pool.size() << " pooled)\n"
 	  << "Total allocation: " << total_alloc << " bytes\n";
 
 	return s.str();
 }
 
+namespace {
+
+// gamelist of a busy lobby, it is the most frequent large message.
+std::string benchmark_message()
+{
+	std::ostringstream strstr;
+	strstr << "[gamelist]\n";
+	for (int i = 0; i < 40; i ++) {
+		strstr << "[game]\n"
+			<< "human_sides=\"" << i % 4 + 2 << "\"\n"
+			<< "id=\"" << 1000 + i << "\"\n"
+			<< "mp_era=\"era_default\"\n"
+			<< "mp_scenario=\"multiplayer_scenario_" << i << "\"\n"
+			<< "name=\"game of player" << i << "\"\n"
+			<< "observer=\"yes\"\n"
+			<< "slots=\"" << i % 4 << "/" << i % 4 + 2 << "\"\n"
+			<< "turn=\"" << i % 20 << "/30\"\n"
+			<< "[side]\n"
+			<< "controller=\"human\"\n"
+			<< "player=\"player" << i << "\"\n"
+			<< "[/side]\n"
+			<< "[/game]\n";
+	}
+	strstr << "[/gamelist]\n";
+	return strstr.str();
+}
+
+Uint64 benchmark_pass(const std::string& text, int messages)
+{
+	const Uint64 start = SDL_GetPerformanceCounter();
+	for (int i = 0; i < messages; i ++) {
+		char* buf = new char[text.size() + 1];
+		memcpy(buf, text.c_str(), text.size() + 1);
+		document doc(buf);
+
+		// what server does with incoming data: a copy per receiver, and
+		// a part of it copied into another message.
+		document* copy = doc.clone();
+		document reply;
+		doc.root().copy_into(reply.root().add_child("gamelist"));
+		reply.output();
+		delete copy;
+	}
+	return (SDL_GetPerformanceCounter() - start) * 1000000 / SDL_GetPerformanceFrequency();
+}
+
+}
+
+void benchmark(std::ostream& out, int messages)
+{
+	const std::string text = benchmark_message();
+	const bool original = use_arena;
+
+	// warm up pool and heap.
+	benchmark_pass(text, std::min(messages, 100));
+
+	use_arena = false;
+	const Uint64 heap = benchmark_pass(text, messages);
+	use_arena = true;
+	const Uint64 arena = benchmark_pass(text, messages);
+	use_arena = original;
+
+	out << messages << " messages, " << text.size() << " bytes each\n";
+	out << std::setw(10) << "heap" << std::setw(12) << heap << " us\n";
+	out << std::setw(10) << "arena" << std::setw(12) << arena << " us\n";
+}
+
 }
 
 #ifdef UNIT_TEST_SIMPLE_WML
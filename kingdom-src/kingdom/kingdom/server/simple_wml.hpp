@@ -20,11 +20,16 @@
 #include <cstddef>
 #include <iosfwd>
 #include <map>
+#include <new>
 #include <string>
 #include <vector>
 
 #include "exceptions.hpp"
 
+namespace binary_wml {
+class tencoder;
+}
+
 namespace simple_wml {
 
 struct error : public game::error {
@@ -102,6 +107,98 @@ private:
 
 std::ostream& operator<<(std::ostream& o, const string_span& s);
 
+/**
+ * Bump allocator of one document: nodes, their vectors and copied strings.
+ * Nothing is freed alone, all is freed when document dies, and the arena
+ * goes back to a pool, with its first block, for the next document.
+ *
+ * It is enabled while document is built, until it is output the first time.
+ * After that, allocations are from heap, so a long-lived document that is
+ * changed again and again doesn't grow its arena.
+ */
+class tarena
+{
+public:
+	/** from pool, NULL if use_arena is false. */
+	static tarena* acquire();
+	static void release(tarena* arena);
+
+	void* allocate(size_t size);
+	// no-op for memory of arena.
+	void deallocate(void* p);
+	bool owns(const void* p) const;
+
+	char* duplicate(const char* str, int size);
+
+	void set_enabled(bool enabled) { enabled_ = enabled; }
+	bool enabled() const { return enabled_; }
+
+	/** forget all allocations. keep the first block only. */
+	void reset();
+
+	size_t reserved() const;
+
+private:
+	tarena();
+	~tarena();
+	tarena(const tarena&);
+	void operator=(const tarena&);
+
+	struct tblock {
+		char* data;
+		size_t size;
+	};
+	std::vector<tblock> blocks_;
+	// used bytes of the last block.
+	size_t used_;
+	bool enabled_;
+};
+
+// false: every document allocates from heap. benchmark compares both.
+extern bool use_arena;
+
+void* arena_allocate(tarena* arena, size_t size);
+void arena_deallocate(tarena* arena, void* p);
+
+/** memory of containers is from arena when it is enabled. */
+template<typename T>
+class arena_allocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template<typename U>
+	struct rebind { typedef arena_allocator<U> other; };
+
+	arena_allocator(tarena* arena = NULL) throw() : arena_(arena) {}
+	template<typename U>
+	arena_allocator(const arena_allocator<U>& that) throw() : arena_(that.arena()) {}
+
+	pointer address(reference x) const { return &x; }
+	const_pointer address(const_reference x) const { return &x; }
+
+	pointer allocate(size_type n, const void* = 0) { return static_cast<pointer>(arena_allocate(arena_, n * sizeof(T))); }
+	void deallocate(pointer p, size_type) { arena_deallocate(arena_, p); }
+
+	size_type max_size() const throw() { return size_t(-1) / sizeof(T); }
+	void construct(pointer p, const T& val) { new(p) T(val); }
+	void destroy(pointer p) { p->~T(); }
+
+	tarena* arena() const { return arena_; }
+
+	bool operator==(const arena_allocator& that) const { return arena_ == that.arena_; }
+	bool operator!=(const arena_allocator& that) const { return arena_ != that.arena_; }
+
+private:
+	tarena* arena_;
+};
+
 class document;
 
 class node
@@ -112,7 +209,12 @@ public:
 	~node();
 
 	typedef std::pair<string_span, string_span> attribute;
-	typedef std::vector<node*> child_list;
+	typedef std::vector<node*, arena_allocator<node*> > child_list;
+
+	// node is created in arena of document, destroy it by destroy().
+	static void* operator new(size_t size, tarena* arena) { return arena_allocate(arena, size); }
+	static void operator delete(void* p, tarena* arena) { arena_deallocate(arena, p); }
+	static void destroy(node* n);
 
 	const string_span& operator[](const char* key) const;
 	const string_span& attr(const char* key) const {
@@ -154,6 +256,7 @@ public:
 
 	int output_size() const;
 	void output(char*& buf, CACHE_STATUS status=DO_NOT_MODIFY_CACHE);
+	void output_binary(binary_wml::tencoder& encoder) const;
 
 	void copy_into(node& n) const;
 
@@ -179,13 +282,13 @@ private:
 
 	document* doc_;
 
-	typedef std::vector<attribute> attribute_list;
+	typedef std::vector<attribute, arena_allocator<attribute> > attribute_list;
 	attribute_list attr_;
 
 	node* parent_;
 
 	typedef std::pair<string_span, child_list> child_pair;
-	typedef std::vector<child_pair> child_map;
+	typedef std::vector<child_pair, arena_allocator<child_pair> > child_map;
 
 	static child_map::const_iterator find_in_map(const child_map& m, const string_span& attr);
 	static child_map::iterator find_in_map(child_map& m, const string_span& attr);
@@ -203,7 +306,8 @@ private:
 	};
 
 	//a list of all the children in order.
-	std::vector<node_pos> ordered_children_;
+	typedef std::vector<node_pos, arena_allocator<node_pos> > node_pos_list;
+	node_pos_list ordered_children_;
 
 	void insert_ordered_child(int child_map_index, int child_list_index);
 	void remove_ordered_child(int child_map_index, int child_list_index);
@@ -217,6 +321,9 @@ private:
 
 std::string node_to_string(const node& n);
 
+/** time parse, clone and copy of a message, with and without arena. */
+void benchmark(std::ostream& out, int messages);
+
 enum INIT_BUFFER_CONTROL { INIT_TAKE_OWNERSHIP };
 
 enum INIT_STATE { INIT_COMPRESSED, INIT_STATIC };
@@ -230,11 +337,16 @@ public:
 	explicit document(string_span compressed_buf);
 	~document();
 	const char* dup_string(const char* str);
+	// copy in arena if it is enabled, otherwise in a buffer of document.
+	const char* dup_span(const string_span& str);
+	tarena* arena() const { return arena_; }
 	node& root() { if(!root_) { generate_root(); } return *root_; }
 	const node& root() const { if(!root_) { const_cast<document*>(this)->generate_root(); } return *root_; }
 
 	const char* output();
 	string_span output_compressed(bool bzip2 = false);
+	// binary WML, it is sent to client that accepted it at handshake.
+	string_span output_binary();
 
 	void compress();
 
@@ -283,6 +395,9 @@ private:
 	void operator=(const document&);
 
 	string_span compressed_buf_;
+	string_span binary_buf_;
+	// before root_, nodes are created in it.
+	tarena* arena_;
 	const char* output_;
 	std::vector<char*> buffers_;
 	node* root_;
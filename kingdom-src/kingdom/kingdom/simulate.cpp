@@ -0,0 +1,223 @@
+#include "global.hpp"
+#include "simulate.hpp"
+
+#include "team.hpp"
+#include "unit_map.hpp"
+#include "hero.hpp"
+#include "replay.hpp"
+#include "state_hash.hpp"
+#include "statistics.hpp"
+#include "util.hpp"
+
+#include "SDL_timer.h"
+#include <iostream>
+#include <iomanip>
+#include <cstring>
+
+namespace simulate {
+
+bool enabled = false;
+std::string campaign;
+std::string scenario;
+int turns = 20;
+std::string replay;
+int chat_messages = 0;
+std::string round_trip;
+static std::string replay_error_msg;
+
+static const char* phase_names[PHASES] = {
+	"ai", "pathfind", "combat", "events", "fog", "autosave", "hash"
+};
+
+static Uint64 phase_counters[PHASES];
+static int current_phase = NONE;
+static Uint64 last_switch = 0;
+
+static Uint64 start_counter = 0;
+static int ended_turns = 0;
+static uint32_t last_checksum = 0;
+
+bool parse_cmdline(int& argc, char** argv)
+{
+	int valid = 1;
+	bool ok = true;
+	for (int arg_ = 1; arg_ < argc; ++ arg_) {
+		const std::string val(argv[arg_]);
+		if (val == "--no-statistics") {
+			statistics::recording = false;
+		} else if (val == "--simulate" || val == "--scenario" || val == "--turns" || val == "--replay" || val == "--benchmark-chat" || val == "--test-savegame") {
+			if (arg_ + 1 >= argc) {
+				std::cerr << val << " requires a value\n";
+				ok = false;
+				break;
+			}
+			const std::string param(argv[++ arg_]);
+			if (val == "--simulate") {
+				enabled = true;
+				campaign = param;
+			} else if (val == "--replay") {
+				enabled = true;
+				replay = param;
+			} else if (val == "--test-savegame") {
+				round_trip = param;
+			} else if (val == "--benchmark-chat") {
+				chat_messages = lexical_cast_default<int>(param, 0);
+				if (chat_messages <= 0) {
+					std::cerr << "--benchmark-chat must be great than 0\n";
+					ok = false;
+				}
+			} else if (val == "--scenario") {
+				scenario = param;
+			} else {
+				turns = lexical_cast_default<int>(param, 0);
+				if (turns <= 0) {
+					std::cerr << "--turns must be great than 0\n";
+					ok = false;
+				}
+			}
+		} else {
+			argv[valid ++] = argv[arg_];
+		}
+	}
+	argc = valid;
+	return ok;
+}
+
+static void switch_phase(int phase)
+{
+	const Uint64 now = SDL_GetPerformanceCounter();
+	if (current_phase != NONE) {
+		phase_counters[current_phase] += now - last_switch;
+	}
+	current_phase = phase;
+	last_switch = now;
+}
+
+tphase::tphase(int phase)
+	: previous_(current_phase)
+{
+	if (enabled) {
+		switch_phase(phase);
+	}
+}
+
+tphase::~tphase()
+{
+	if (enabled) {
+		switch_phase(previous_);
+	}
+}
+
+void reset()
+{
+	memset(phase_counters, 0, sizeof(phase_counters));
+	current_phase = NONE;
+	last_switch = 0;
+	start_counter = SDL_GetPerformanceCounter();
+	ended_turns = 0;
+	last_checksum = 0;
+	state_hash::reset_stats();
+	replay_error_msg.clear();
+}
+
+uint32_t checksum(const unit_map& units, const std::vector<team>& teams, const hero_map& heros)
+{
+	state_hash::tstate state;
+	state_hash::compute(units, teams, heros, state, false);
+	return state_hash::total(state);
+}
+
+void turn_ended(int turn, const unit_map& units, const std::vector<team>& teams, const hero_map& heros)
+{
+	ended_turns ++;
+	last_checksum = checksum(units, teams, heros);
+
+	const Uint64 elapsed = SDL_GetPerformanceCounter() - start_counter;
+	std::cout << "turn " << turn << ", checksum 0x" << std::hex << std::setw(8) << std::setfill('0') << last_checksum
+		<< std::dec << std::setfill(' ') << ", elapsed " << elapsed * 1000 / SDL_GetPerformanceFrequency() << " ms\n";
+}
+
+void replay_error(const std::string& msg)
+{
+	if (replay_error_msg.empty()) {
+		replay_error_msg = msg.empty()? "unknown error": msg;
+	}
+}
+
+bool replay_ok()
+{
+	return replay_error_msg.empty();
+}
+
+// per-turn graph of damage inflicted by every side, from turn rows of statistics.
+static void report_statistics()
+{
+	if (!statistics::recording) {
+		std::cout << "\nstatistics: off\n";
+		return;
+	}
+	const int bar_width = 40;
+	const std::vector<std::string> sides = statistics::scenario_sides();
+	for (std::vector<std::string>::const_iterator it = sides.begin(); it != sides.end(); ++ it) {
+		const statistics::stats s = statistics::calculate_stats(1, *it);
+		const std::vector<long long> series = s.turn_series(statistics::DAMAGE_INFLICTED);
+		long long top = 1;
+		for (std::vector<long long>::const_iterator it2 = series.begin(); it2 != series.end(); ++ it2) {
+			top = std::max(top, *it2);
+		}
+		std::cout << "\ndamage inflicted of " << *it << ", recruits " << s.sum(statistics::RECRUITS)
+			<< ", kills " << s.sum(statistics::KILLS) << ", deaths " << s.sum(statistics::DEATHS) << "\n";
+		for (size_t n = 0; n < series.size(); n ++) {
+			std::cout << std::setw(6) << s.turns[n].turn << " " << std::setw(8) << series[n] << " "
+				<< std::string(std::max<long long>(series[n], 0) * bar_width / top, '#') << "\n";
+		}
+	}
+}
+
+void report()
+{
+	const Uint64 freq = SDL_GetPerformanceFrequency();
+	const Uint64 total = SDL_GetPerformanceCounter() - start_counter;
+	Uint64 accounted = 0;
+
+	if (!replay.empty()) {
+		std::cout << "\nreplay: " << replay << ", " << ended_turns << " turns, " << (replay_ok()? "completed": "failed") << "\n";
+		if (!replay_ok()) {
+			std::cout << replay_error_msg << "\n";
+		}
+	} else {
+		std::cout << "\nsimulation: " << campaign;
+		if (!scenario.empty()) {
+			std::cout << "/" << scenario;
+		}
+		std::cout << ", " << ended_turns << " turns\n";
+	}
+	for (int i = 0; i < PHASES; i ++) {
+		accounted += phase_counters[i];
+		std::cout << std::setw(10) << phase_names[i] << std::setw(10) << phase_counters[i] * 1000 / freq << " ms\n";
+	}
+	std::cout << std::setw(10) << "other" << std::setw(10) << (total - accounted) * 1000 / freq << " ms\n";
+	std::cout << std::setw(10) << "total" << std::setw(10) << total * 1000 / freq << " ms\n";
+	std::cout << "checksum 0x" << std::hex << std::setw(8) << std::setfill('0') << last_checksum << std::dec << std::setfill(' ') << "\n";
+
+	// replay store
+	const command_pool::tstats& stats = recorder.stats();
+	std::cout << "\nreplay: " << recorder.pool_pos_vsize() << " commands, " << stats.blocks << " sealed blocks, "
+		<< stats.raw_bytes / 1024 << " KB -> " << stats.sealed_bytes / 1024 << " KB, memory " << recorder.memory_size() / 1024 << " KB\n";
+	if (stats.seal_counter) {
+		std::cout << "  seal " << stats.seal_counter * 1000 / freq << " ms, " << stats.raw_bytes * freq / stats.seal_counter / 1024 << " KB/s\n";
+	}
+	if (stats.decodes) {
+		std::cout << "  decode " << stats.decodes << " blocks, " << stats.decode_counter * 1000 / freq << " ms\n";
+	}
+
+	const state_hash::tstats& hash_stats = state_hash::stats();
+	if (hash_stats.computes) {
+		std::cout << "\nstate hash: " << hash_stats.computes << " computes, " << hash_stats.objects / hash_stats.computes << " objects each, "
+			<< phase_counters[STATE_HASH] * 1000000 / freq / hash_stats.computes << " us each\n";
+	}
+
+	report_statistics();
+}
+
+}
@@ -0,0 +1,89 @@
+#ifndef SIMULATE_HPP_INCLUDED
+#define SIMULATE_HPP_INCLUDED
+
+#include "SDL_types.h"
+#include <string>
+#include <vector>
+
+class unit_map;
+class team;
+class hero_map;
+
+/**
+ * Headless AI-vs-AI simulation.
+ *
+ * kingdom --simulate <campaign> [--scenario <id>] [--turns <n>]
+ *
+ * Every side is controlled by AI, there is no delay and no sound, and screen
+ * updates are locked. When game ends, it prints per-phase wall time and a
+ * checksum of game state, so that it can be used as performance and determinism
+ * benchmark.
+ *
+ * kingdom --replay <savegame>
+ *
+ * Fast-forward replay of savegame to the end, headless too. It prints checksum at
+ * every turn and report, exit code is 1 if replay doesn't run to completion.
+ *
+ * Report of both ends with per-turn graph of statistics. --no-statistics disables
+ * statistics hooks, checksums must be same as without it.
+ *
+ * kingdom --benchmark-chat <n>
+ *
+ * Times chat history store with n messages in a scratch directory of user data,
+ * then exits.
+ *
+ * kingdom --test-savegame <savegame>
+ *
+ * Round trip of binary savegame in saves directory, with timings of load, save and
+ * text format, then exits. Exit code is 1 if it fails.
+ */
+namespace simulate {
+
+enum {NONE = -1, AI, PATHFIND, COMBAT, EVENTS, FOG, AUTOSAVE, STATE_HASH, PHASES};
+
+extern bool enabled;
+extern std::string campaign;
+extern std::string scenario;
+extern int turns;
+// savegame to replay, empty if it is ai simulation.
+extern std::string replay;
+// messages of chat store benchmark, 0 if it isn't benchmark.
+extern int chat_messages;
+// savegame of round trip test, empty if it isn't test.
+extern std::string round_trip;
+
+/**
+ * parse and remove simulation options from argv, other options are left to base_instance.
+ * @return false if options are invalid.
+ */
+bool parse_cmdline(int& argc, char** argv);
+
+/**
+ * Account wall time between construct and destruct to phase.
+ * phases can nest, time of a nested phase isn't counted to its outer phase.
+ */
+class tphase
+{
+public:
+	explicit tphase(int phase);
+	~tphase();
+
+private:
+	int previous_;
+};
+
+void reset();
+
+/** checksum of units, teams and heros. */
+uint32_t checksum(const unit_map& units, const std::vector<team>& teams, const hero_map& heros);
+/** called when one turn end. */
+void turn_ended(int turn, const unit_map& units, const std::vector<team>& teams, const hero_map& heros);
+
+/** replay stopped because of out-of-sync or error. */
+void replay_error(const std::string& msg);
+bool replay_ok();
+
+void report();
+}
+
+#endif
@@ -0,0 +1,276 @@
+#include "global.hpp"
+#include "state_hash.hpp"
+
+#include "artifical.hpp"
+#include "team.hpp"
+#include "unit_map.hpp"
+#include "hero.hpp"
+#include "gettext.hpp"
+#include "simulate.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace state_hash {
+
+static const char* category_names[CATEGORIES] = {
+	"unit", "city", "team", "hero"
+};
+
+// maximal objects listed for one category in report.
+static const int max_report_objects = 8;
+
+// objects of the last matched verification.
+static tstate last_matched;
+
+static tstats hash_stats;
+
+tstate::tstate()
+	: objects()
+{
+	memset(categories, 0, sizeof(categories));
+}
+
+// FNV-1a
+static void hash_int(uint32_t& hash, int value)
+{
+	const uint8_t* p = (const uint8_t*)&value;
+	for (size_t i = 0; i < sizeof(value); i ++) {
+		hash ^= p[i];
+		hash *= 16777619;
+	}
+}
+
+static void add_object(tstate& state, bool objects, int category, int id, uint32_t hash)
+{
+	hash_stats.objects ++;
+	// id is a part of hash, so exchanging two objects is detected.
+	hash_int(hash, id);
+	state.categories[category] ^= hash;
+	if (objects) {
+		tobject obj;
+		obj.key = (category << 24) | (id & 0xffffff);
+		obj.hash = hash;
+		state.objects.push_back(obj);
+	}
+}
+
+static uint32_t unit_hash(const unit& u)
+{
+	const map_location& loc = u.get_location();
+	uint32_t hash = 2166136261u;
+	hash_int(hash, u.side());
+	hash_int(hash, loc.x);
+	hash_int(hash, loc.y);
+	hash_int(hash, u.hitpoints());
+	hash_int(hash, u.experience());
+	hash_int(hash, u.movement_left());
+	hash_int(hash, u.cityno());
+	return hash;
+}
+
+void compute(const unit_map& units, const std::vector<team>& teams, const hero_map& heros, tstate& state, bool objects)
+{
+	simulate::tphase phase(simulate::STATE_HASH);
+	hash_stats.computes ++;
+	memset(state.categories, 0, sizeof(state.categories));
+	state.objects.clear();
+
+	for (unit_map::const_iterator it = units.begin(); it != units.end(); ++ it) {
+		const unit* u = dynamic_cast<const unit*>(&*it);
+		if (!u) {
+			continue;
+		}
+		add_object(state, objects, u->is_artifical()? CITY: UNIT, u->master().number_, unit_hash(*u));
+		if (!u->is_artifical()) {
+			continue;
+		}
+		// troops that reside in city aren't in unit_map.
+		const std::vector<unit*>& reside_troops = static_cast<const artifical*>(u)->reside_troops();
+		for (std::vector<unit*>::const_iterator it2 = reside_troops.begin(); it2 != reside_troops.end(); ++ it2) {
+			add_object(state, objects, UNIT, (*it2)->master().number_, unit_hash(**it2));
+		}
+	}
+	for (std::vector<team>::const_iterator it = teams.begin(); it != teams.end(); ++ it) {
+		uint32_t hash = 2166136261u;
+		hash_int(hash, it->gold());
+		add_object(state, objects, TEAM, it->side(), hash);
+	}
+	for (size_t i = 0; i < heros.size(); i ++) {
+		const hero& h = heros[i];
+		uint32_t hash = 2166136261u;
+		hash_int(hash, h.side_);
+		hash_int(hash, h.city_);
+		hash_int(hash, h.status_);
+		add_object(state, objects, HERO, h.number_, hash);
+	}
+
+	if (objects) {
+		std::sort(state.objects.begin(), state.objects.end());
+	}
+}
+
+const tstats& stats()
+{
+	return hash_stats;
+}
+
+void reset_stats()
+{
+	hash_stats = tstats();
+}
+
+uint32_t total(const tstate& state)
+{
+	uint32_t hash = 2166136261u;
+	for (int i = 0; i < CATEGORIES; i ++) {
+		hash_int(hash, state.categories[i]);
+	}
+	return hash;
+}
+
+std::string to_str(const tstate& state)
+{
+	std::stringstream strstr;
+	for (int i = 0; i < CATEGORIES; i ++) {
+		if (i) {
+			strstr << ",";
+		}
+		strstr << state.categories[i];
+	}
+	return strstr.str();
+}
+
+bool from_str(const std::string& str, uint32_t* categories)
+{
+	std::stringstream strstr(str);
+	for (int i = 0; i < CATEGORIES; i ++) {
+		if (i) {
+			char comma = 0;
+			strstr >> comma;
+			if (comma != ',') {
+				return false;
+			}
+		}
+		if (!(strstr >> categories[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void describe(std::stringstream& strstr, uint32_t key, unit_map& units, const std::vector<team>& teams, hero_map& heros)
+{
+	const int category = key >> 24;
+	const int id = key & 0xffffff;
+
+	if (category == TEAM) {
+		if (id >= 1 && id <= (int)teams.size()) {
+			const team& t = teams[id - 1];
+			strstr << "team " << id << ": gold " << t.gold();
+		} else {
+			strstr << "team " << id << ": not exist";
+		}
+		return;
+	}
+	if (id >= (int)heros.size()) {
+		strstr << category_names[category] << " #" << id << ": not exist";
+		return;
+	}
+	hero& h = heros[id];
+	if (category == HERO) {
+		strstr << "hero " << h.name() << "(#" << id << "): side " << h.side_ << ", city " << h.city_ << ", status " << h.status_;
+		return;
+	}
+	const unit* u = units.find_unit(h);
+	if (!u) {
+		strstr << category_names[category] << " of " << h.name() << "(#" << id << "): not exist locally";
+		return;
+	}
+	const map_location& loc = u->get_location();
+	strstr << category_names[category] << " " << u->name() << "(#" << id << "): side " << u->side()
+		<< ", location " << loc << ", hitpoints " << u->hitpoints() << ", experience " << u->experience()
+		<< ", movement " << u->movement_left();
+}
+
+std::string verify(const std::string& remote, unit_map& units, const std::vector<team>& teams, hero_map& heros)
+{
+	uint32_t remote_categories[CATEGORIES];
+	if (!from_str(remote, remote_categories)) {
+		return "invalid state hash: " + remote;
+	}
+
+	tstate local;
+	compute(units, teams, heros, local, true);
+
+	bool match = true;
+	for (int i = 0; i < CATEGORIES; i ++) {
+		if (local.categories[i] != remote_categories[i]) {
+			match = false;
+			break;
+		}
+	}
+	if (match) {
+		last_matched.objects.swap(local.objects);
+		memcpy(last_matched.categories, local.categories, sizeof(local.categories));
+		return null_str;
+	}
+
+	std::stringstream strstr;
+	strstr << "STATE HASH MISMATCH\n";
+	for (int i = 0; i < CATEGORIES; i ++) {
+		if (local.categories[i] == remote_categories[i]) {
+			continue;
+		}
+		strstr << "\n" << category_names[i] << ": local " << local.categories[i] << ", remote " << remote_categories[i] << "\n";
+		if (last_matched.objects.empty()) {
+			strstr << "  there is no matched state before.\n";
+			continue;
+		}
+
+		// objects changed since last matched, in sorted order of key.
+		std::vector<uint32_t> changed;
+		std::vector<tobject>::const_iterator a = last_matched.objects.begin(), b = local.objects.begin();
+		while (a != last_matched.objects.end() || b != local.objects.end()) {
+			if (b == local.objects.end() || (a != last_matched.objects.end() && a->key < b->key)) {
+				if ((int)(a->key >> 24) == i) {
+					changed.push_back(a->key);
+				}
+				++ a;
+			} else if (a == last_matched.objects.end() || b->key < a->key) {
+				if ((int)(b->key >> 24) == i) {
+					changed.push_back(b->key);
+				}
+				++ b;
+			} else {
+				if ((int)(a->key >> 24) == i && a->hash != b->hash) {
+					changed.push_back(a->key);
+				}
+				++ a;
+				++ b;
+			}
+		}
+		if (changed.empty()) {
+			strstr << "  no object changed since last matched state.\n";
+			continue;
+		}
+		int listed = 0;
+		for (std::vector<uint32_t>::const_iterator it = changed.begin(); it != changed.end() && listed < max_report_objects; ++ it, listed ++) {
+			strstr << (listed? "  ": "  first divergent candidate, ");
+			describe(strstr, *it, units, teams, heros);
+			strstr << "\n";
+		}
+		if ((int)changed.size() > listed) {
+			strstr << "  ... and " << changed.size() - listed << " more\n";
+		}
+	}
+	return strstr.str();
+}
+
+void reset()
+{
+	last_matched = tstate();
+}
+
+}
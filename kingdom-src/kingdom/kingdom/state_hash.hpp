@@ -0,0 +1,83 @@
+#ifndef STATE_HASH_HPP_INCLUDED
+#define STATE_HASH_HPP_INCLUDED
+
+#include "SDL_types.h"
+#include <string>
+#include <vector>
+
+class unit_map;
+class team;
+class hero_map;
+
+/**
+ * Hash of game state for out-of-sync detection.
+ *
+ * Every unit, city, team and hero has its own hash of fields that must be same
+ * on all clients: side, location, hitpoints, experience, gold, ownership etc.
+ * Hashes of one category are XOR-combined, so result doesn't depend on order.
+ *
+ * POST_UNIT command carries category hashes of recorder, receiver compares them
+ * with local state. The last verification matched, so on mismatch, divergence
+ * must be in objects that changed since then. They are listed in the report.
+ */
+namespace state_hash {
+
+enum {UNIT, CITY, TEAM, HERO, CATEGORIES};
+
+struct tobject {
+	// category << 24 | id
+	uint32_t key;
+	uint32_t hash;
+
+	bool operator<(const tobject& that) const { return key < that.key; }
+};
+
+struct tstate {
+	tstate();
+
+	uint32_t categories[CATEGORIES];
+	// sorted by key. only filled when required.
+	std::vector<tobject> objects;
+};
+
+void compute(const unit_map& units, const std::vector<team>& teams, const hero_map& heros, tstate& state, bool objects);
+
+/**
+ * compute() walks every unit, team and hero, it is called at every POST_UNIT.
+ * Its time is accounted to simulate::STATE_HASH, these are counts of it.
+ */
+struct tstats {
+	tstats()
+		: computes(0)
+		, objects(0)
+	{}
+
+	int computes;
+	// objects hashed in all computes.
+	Uint64 objects;
+};
+const tstats& stats();
+void reset_stats();
+
+/** all categories combined. */
+uint32_t total(const tstate& state);
+
+/** categories as "a,b,c,d", it is saved in POST_UNIT command. */
+std::string to_str(const tstate& state);
+
+/** parse categories from to_str. */
+bool from_str(const std::string& str, uint32_t* categories);
+
+/**
+ * compare local state with categories recorded by remote.
+ * @return empty if they are same, otherwise report names objects changed since
+ * the last matched verification.
+ */
+std::string verify(const std::string& remote, unit_map& units, const std::vector<team>& teams, hero_map& heros);
+
+/** forget the last matched state, call it when scenario starts. */
+void reset();
+
+}
+
+#endif
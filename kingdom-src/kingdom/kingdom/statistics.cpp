@@ -22,6 +22,8 @@
 #include "statistics.hpp"
 #include "log.hpp"
 #include "serialization/binary_or_text.hpp"
+#include "serialization/string_utils.hpp"
+#include "team.hpp"
 #include "unit.hpp"
 #include "util.hpp"
 
@@ -38,6 +40,18 @@ bool mid_scenario = false;
 
 typedef statistics::stats stats;
 
+const char* type_column_names[statistics::TYPE_COLUMNS] = {
+	"recruits", "recalls", "advances", "deaths", "killed"
+};
+
+const char* scalar_column_names[statistics::SCALAR_COLUMNS] = {
+	"recruit_cost", "recall_cost", "damage_inflicted", "damage_taken",
+	"expected_damage_inflicted", "expected_damage_taken"
+};
+
+std::map<std::string, int> type_indexs;
+std::vector<std::string> type_ids;
+
 struct scenario_stats
 {
 	explicit scenario_stats(const std::string& name) :
@@ -45,33 +59,70 @@ struct scenario_stats
 		scenario_name(name)
 	{}
 
-	explicit scenario_stats(const config& cfg);
+	// @types: dense index of unit types in cfg.
+	scenario_stats(const config& cfg, const std::vector<int>& types);
 
-	config write() const;
 	void write(config_writer &out) const;
 
 	std::map<std::string,stats> team_stats;
 	std::string scenario_name;
 };
 
-scenario_stats::scenario_stats(const config& cfg) :
-	team_stats(),
-	scenario_name(cfg["scenario"])
+std::vector<scenario_stats> master_stats;
+
+// it is used when reading stats.
+const std::vector<int>* reading_types = NULL;
+
+} // end anon namespace
+
+static stats &get_stats(const std::string &save_id)
 {
-	BOOST_FOREACH (const config &team, cfg.child_range("team")) {
-		team_stats[team["save_id"]] = stats(team);
+	if(master_stats.empty()) {
+		master_stats.push_back(scenario_stats(std::string()));
 	}
+
+	std::map<std::string,stats>& team_stats = master_stats.back().team_stats;
+	stats& s = team_stats[save_id];
+	s.save_id = save_id;
+	return s;
 }
 
-config scenario_stats::write() const
+static std::string join_column(const std::vector<int>& column)
 {
-	config res;
-	res["scenario"] = scenario_name;
-	for(std::map<std::string,stats>::const_iterator i = team_stats.begin(); i != team_stats.end(); ++i) {
-		res.add_child("team",i->second.write());
+	// trailing zeros are omitted.
+	size_t size = column.size();
+	while (size && !column[size - 1]) {
+		size --;
+	}
+	std::stringstream strstr;
+	for (size_t i = 0; i < size; i ++) {
+		if (i) {
+			strstr << ",";
+		}
+		strstr << column[i];
 	}
+	return strstr.str();
+}
 
-	return res;
+template<typename T>
+static void split_column(const std::string& str, std::vector<T>& column)
+{
+	column.clear();
+	const std::vector<std::string> vstr = utils::split(str);
+	for (std::vector<std::string>::const_iterator it = vstr.begin(); it != vstr.end(); ++ it) {
+		column.push_back(lexical_cast_default<T>(*it, 0));
+	}
+}
+
+scenario_stats::scenario_stats(const config& cfg, const std::vector<int>& types) :
+	team_stats(),
+	scenario_name(cfg["scenario"])
+{
+	reading_types = &types;
+	BOOST_FOREACH (const config &team, cfg.child_range("team")) {
+		team_stats[team["save_id"]] = stats(team);
+	}
+	reading_types = NULL;
 }
 
 void scenario_stats::write(config_writer &out) const
@@ -84,329 +135,187 @@ void scenario_stats::write(config_writer &out) const
 	}
 }
 
-std::vector<scenario_stats> master_stats;
+namespace statistics
+{
 
-} // end anon namespace
+bool recording = true;
 
-static stats &get_stats(const std::string &save_id)
+int type_index(const std::string& type_id)
 {
-	if(master_stats.empty()) {
-		master_stats.push_back(scenario_stats(std::string()));
+	std::map<std::string, int>::const_iterator it = type_indexs.find(type_id);
+	if (it != type_indexs.end()) {
+		return it->second;
 	}
-
-	std::map<std::string,stats>& team_stats = master_stats.back().team_stats;
-	return team_stats[save_id];
+	const int index = type_ids.size();
+	type_indexs.insert(std::make_pair(type_id, index));
+	type_ids.push_back(type_id);
+	return index;
 }
 
-static config write_str_int_map(const stats::str_int_map& m)
+const std::string& type_id(int index)
 {
-	config res;
-	for(stats::str_int_map::const_iterator i = m.begin(); i != m.end(); ++i) {
-		char buf[50];
-		snprintf(buf,sizeof(buf),"%d",i->second);
-		res[i->first] = buf;
-	}
-
-	return res;
+	return type_ids[index];
 }
 
-static void write_str_int_map(config_writer &out, const stats::str_int_map& m)
+int type_count()
 {
-	for(stats::str_int_map::const_iterator i = m.begin(); i != m.end(); ++i) {
-		char buf[50];
-		snprintf(buf,sizeof(buf),"%d",i->second);
-		out.write_key_val(i->first, buf);
-	}
+	return type_ids.size();
 }
 
-static stats::str_int_map read_str_int_map(const config& cfg)
+stats::stats() :
+	turns(),
+	save_id()
 {
-	stats::str_int_map m;
-	BOOST_FOREACH (const config::attribute &i, cfg.attribute_range()) {
-		m[i.first] = i.second;
-	}
+	memset(scalars, 0, sizeof(scalars));
+}
 
-	return m;
+stats::stats(const config& cfg) :
+	turns(),
+	save_id()
+{
+	memset(scalars, 0, sizeof(scalars));
+	read(cfg);
 }
 
-static config write_battle_result_map(const stats::battle_result_map& m)
+void stats::write(config_writer &out) const
 {
-	config res;
-	for(stats::battle_result_map::const_iterator i = m.begin(); i != m.end(); ++i) {
-		config& new_cfg = res.add_child("sequence");
-		new_cfg = write_str_int_map(i->second);
+	for (int i = 0; i < TYPE_COLUMNS; i ++) {
+		out.write_key_val(type_column_names[i], join_column(types[i]));
+	}
+	for (int i = 0; i < SCALAR_COLUMNS; i ++) {
+		out.write_key_val(scalar_column_names[i], str_cast(scalars[i]));
+	}
 
-		char buf[50];
-		snprintf(buf,sizeof(buf),"%d",i->first);
-		new_cfg["_num"] = buf;
+	// rows: turn, scalars...
+	std::stringstream strstr;
+	for (std::vector<trow>::const_iterator it = turns.begin(); it != turns.end(); ++ it) {
+		if (it != turns.begin()) {
+			strstr << ",";
+		}
+		strstr << it->turn;
+		for (int i = 0; i < SCALAR_COLUMNS; i ++) {
+			strstr << "," << it->scalars[i];
+		}
 	}
+	out.write_key_val("turns", strstr.str());
 
-	return res;
+	out.write_key_val("save_id", save_id);
 }
 
-static void write_battle_result_map(config_writer &out, const stats::battle_result_map& m)
+void stats::read(const config& cfg)
 {
-	for(stats::battle_result_map::const_iterator i = m.begin(); i != m.end(); ++i) {
-		out.open_child("sequence");
-		write_str_int_map(out, i->second);
-
-		char buf[50];
-		snprintf(buf,sizeof(buf),"%d",i->first);
-		out.write_key_val("_num", buf);
-		out.close_child("sequence");
+	for (int i = 0; i < TYPE_COLUMNS; i ++) {
+		types[i].clear();
+		if (const config& c = cfg.child(type_column_names[i])) {
+			// legacy: [recruits] type_id=count
+			BOOST_FOREACH (const config::attribute &attr, c.attribute_range()) {
+				add(i, type_index(attr.first), attr.second.to_int());
+			}
+		} else if (reading_types) {
+			std::vector<int> column;
+			split_column(cfg[type_column_names[i]], column);
+			for (size_t n = 0; n < column.size() && n < reading_types->size(); n ++) {
+				add(i, (*reading_types)[n], column[n]);
+			}
+		}
+	}
+	for (int i = 0; i < SCALAR_COLUMNS; i ++) {
+		scalars[i] = lexical_cast_default<long long>(cfg[scalar_column_names[i]], 0);
 	}
-}
 
-static stats::battle_result_map read_battle_result_map(const config& cfg)
-{
-	stats::battle_result_map m;
-	BOOST_FOREACH (const config &i, cfg.child_range("sequence"))
-	{
-		config item = i;
-		int key = item["_num"];
-		item.remove_attribute("_num");
-		m[key] = read_str_int_map(item);
+	turns.clear();
+	std::vector<long long> values;
+	split_column(cfg["turns"], values);
+	for (size_t n = 0; n + SCALAR_COLUMNS < values.size(); n += SCALAR_COLUMNS + 1) {
+		trow row;
+		row.turn = values[n];
+		for (int i = 0; i < SCALAR_COLUMNS; i ++) {
+			row.scalars[i] = values[n + 1 + i];
+		}
+		turns.push_back(row);
 	}
 
-	return m;
+	save_id = cfg["save_id"].str();
 }
 
-static void merge_str_int_map(stats::str_int_map& a, const stats::str_int_map& b)
+void stats::add(int column, int type, int value)
 {
-	for(stats::str_int_map::const_iterator i = b.begin(); i != b.end(); ++i) {
-		a[i->first] += i->second;
+	std::vector<int>& v = types[column];
+	if (type >= (int)v.size()) {
+		v.resize(type + 1, 0);
 	}
+	v[type] += value;
 }
 
-static void merge_battle_result_maps(stats::battle_result_map& a, const stats::battle_result_map& b)
+int stats::count(int column, int type) const
 {
-	for(stats::battle_result_map::const_iterator i = b.begin(); i != b.end(); ++i) {
-		merge_str_int_map(a[i->first],i->second);
-	}
+	const std::vector<int>& v = types[column];
+	return type < (int)v.size()? v[type]: 0;
 }
 
-static void merge_stats(stats& a, const stats& b)
+int stats::sum(int column) const
 {
-	DBG_NG << "Merging statistics\n";
-	merge_str_int_map(a.recruits,b.recruits);
-	merge_str_int_map(a.recalls,b.recalls);
-	merge_str_int_map(a.advanced_to,b.advanced_to);
-	merge_str_int_map(a.deaths,b.deaths);
-	merge_str_int_map(a.killed,b.killed);
-
-	merge_battle_result_maps(a.attacks,b.attacks);
-	merge_battle_result_maps(a.defends,b.defends);
-
-	a.recruit_cost += b.recruit_cost;
-	a.recall_cost += b.recall_cost;
-
-	a.damage_inflicted += b.damage_inflicted;
-	a.damage_taken += b.damage_taken;
-	a.expected_damage_inflicted += b.expected_damage_inflicted;
-	a.expected_damage_taken += b.expected_damage_taken;
-	// Only take the last value for this turn
-	a.turn_damage_inflicted = b.turn_damage_inflicted;
-	a.turn_damage_taken = b.turn_damage_taken;
-	a.turn_expected_damage_inflicted = b.turn_expected_damage_inflicted;
-	a.turn_expected_damage_taken = b.turn_expected_damage_taken;
+	int res = 0;
+	const std::vector<int>& v = types[column];
+	for (std::vector<int>::const_iterator it = v.begin(); it != v.end(); ++ it) {
+		res += *it;
+	}
+	return res;
 }
 
-namespace statistics
-{
-
-stats::stats() :
-	recruits(),
-	recalls(),
-	advanced_to(),
-	deaths(),
-	killed(),
-	recruit_cost(0),
-	recall_cost(0),
-	attacks(),
-	defends(),
-	damage_inflicted(0),
-	damage_taken(0),
-	turn_damage_inflicted(0),
-	turn_damage_taken(0),
-	expected_damage_inflicted(0),
-	expected_damage_taken(0),
-	turn_expected_damage_inflicted(0),
-	turn_expected_damage_taken(0),
-	save_id()
-{}
-
-stats::stats(const config& cfg) :
-	recruits(),
-	recalls(),
-	advanced_to(),
-	deaths(),
-	killed(),
-	recruit_cost(0),
-	recall_cost(0),
-	attacks(),
-	defends(),
-	damage_inflicted(0),
-	damage_taken(0),
-	turn_damage_inflicted(0),
-	turn_damage_taken(0),
-	expected_damage_inflicted(0),
-	expected_damage_taken(0),
-	turn_expected_damage_inflicted(0),
-	turn_expected_damage_taken(0),
-	save_id(std::string())
+int stats::sum_cost(int column) const
 {
-	read(cfg);
+	int cost = 0;
+	const std::vector<int>& v = types[column];
+	for (size_t i = 0; i < v.size(); i ++) {
+		if (v[i]) {
+			const unit_type* ut = unit_types.find(type_ids[i]);
+			if (ut) {
+				cost += v[i] * ut->cost();
+			}
+		}
+	}
+	return cost;
 }
 
-config stats::write() const
-{
-	config res;
-	res.add_child("recruits",write_str_int_map(recruits));
-	res.add_child("recalls",write_str_int_map(recalls));
-	res.add_child("advances",write_str_int_map(advanced_to));
-	res.add_child("deaths",write_str_int_map(deaths));
-	res.add_child("killed",write_str_int_map(killed));
-	res.add_child("attacks",write_battle_result_map(attacks));
-	res.add_child("defends",write_battle_result_map(defends));
-
-	std::ostringstream ss;
-	ss << recruit_cost;
-	res["recruit_cost"] = ss.str();
-	ss.str(std::string());
-	ss << recall_cost;
-	res["recall_cost"] = ss.str();
-
-	ss.str(std::string());
-	ss << damage_inflicted;
-	res["damage_inflicted"] = ss.str();
-	ss.str(std::string());
-	ss << damage_taken;
-	res["damage_taken"] = ss.str();
-	ss.str(std::string());
-	ss << expected_damage_inflicted;
-	res["expected_damage_inflicted"] = ss.str();
-	ss.str(std::string());
-	ss << expected_damage_taken;
-	res["expected_damage_taken"] = ss.str();
-	ss.str(std::string());
-	ss << turn_damage_inflicted;
-
-	res["turn_damage_inflicted"] = ss.str();
-	ss.str(std::string());
-	ss << turn_damage_taken;
-	res["turn_damage_taken"] = ss.str();
-	ss.str(std::string());
-	ss << turn_expected_damage_inflicted;
-	res["turn_expected_damage_inflicted"] = ss.str();
-	ss.str(std::string());
-	ss << turn_expected_damage_taken;
-	res["turn_expected_damage_taken"] = ss.str();
-
-	return res;
+long long stats::turn_scalar(int column) const
+{
+	return turns.empty()? scalars[column]: scalars[column] - turns.back().scalars[column];
 }
 
-void stats::write(config_writer &out) const
+std::vector<long long> stats::turn_series(int column) const
 {
-	out.open_child("recruits");
-	write_str_int_map(out, recruits);
-	out.close_child("recruits");
-	out.open_child("recalls");
-	write_str_int_map(out, recalls);
-	out.close_child("recalls");
-	out.open_child("advances");
-	write_str_int_map(out, advanced_to);
-	out.close_child("advances");
-	out.open_child("deaths");
-	write_str_int_map(out, deaths);
-	out.close_child("deaths");
-	out.open_child("killed");
-	write_str_int_map(out, killed);
-	out.close_child("killed");
-	out.open_child("attacks");
-	write_battle_result_map(out, attacks);
-	out.close_child("attacks");
-	out.open_child("defends");
-	write_battle_result_map(out, defends);
-	out.close_child("defends");
-
-	std::ostringstream ss;
-	ss << recruit_cost;
-	out.write_key_val("recruit_cost", ss.str());
-	ss.str(std::string());
-	ss << recall_cost;
-	out.write_key_val("recall_cost", ss.str());
-
-	ss.str(std::string());
-	ss << damage_inflicted;
-	out.write_key_val("damage_inflicted", ss.str());
-	ss.str(std::string());
-	ss << damage_taken;
-	out.write_key_val("damage_taken", ss.str());
-	ss.str(std::string());
-	ss << expected_damage_inflicted;
-	out.write_key_val("expected_damage_inflicted", ss.str());
-	ss.str(std::string());
-	ss << expected_damage_taken;
-	out.write_key_val("expected_damage_taken", ss.str());
-	ss.str(std::string());
-	ss << turn_damage_inflicted;
-
-	out.write_key_val("turn_damage_inflicted", ss.str());
-	ss.str(std::string());
-	ss << turn_damage_taken;
-	out.write_key_val("turn_damage_taken", ss.str());
-	ss.str(std::string());
-	ss << turn_expected_damage_inflicted;
-	out.write_key_val("turn_expected_damage_inflicted", ss.str());
-	ss.str(std::string());
-	ss << turn_expected_damage_taken;
-	out.write_key_val("turn_expected_damage_taken", ss.str());
-
-	out.write_key_val("save_id", save_id);
-
+	std::vector<long long> res;
+	long long last = 0;
+	for (std::vector<trow>::const_iterator it = turns.begin(); it != turns.end(); ++ it) {
+		res.push_back(it->scalars[column] - last);
+		last = it->scalars[column];
+	}
+	return res;
 }
 
-void stats::read(const config& cfg)
+void stats::merge(const stats& that)
 {
-	if (const config &c = cfg.child("recruits")) {
-		recruits = read_str_int_map(c);
-	}
-	if (const config &c = cfg.child("recalls")) {
-		recalls = read_str_int_map(c);
-	}
-	if (const config &c = cfg.child("advances")) {
-		advanced_to = read_str_int_map(c);
-	}
-	if (const config &c = cfg.child("deaths")) {
-		deaths = read_str_int_map(c);
-	}
-	if (const config &c = cfg.child("killed")) {
-		killed = read_str_int_map(c);
-	}
-	if (const config &c = cfg.child("recalls")) {
-		recalls = read_str_int_map(c);
+	DBG_NG << "Merging statistics\n";
+	for (int i = 0; i < TYPE_COLUMNS; i ++) {
+		const std::vector<int>& v = that.types[i];
+		for (size_t n = 0; n < v.size(); n ++) {
+			if (v[n]) {
+				add(i, n, v[n]);
+			}
+		}
 	}
-	if (const config &c = cfg.child("attacks")) {
-		attacks = read_battle_result_map(c);
+	// rows of that follow rows of this.
+	for (std::vector<trow>::const_iterator it = that.turns.begin(); it != that.turns.end(); ++ it) {
+		trow row = *it;
+		for (int i = 0; i < SCALAR_COLUMNS; i ++) {
+			row.scalars[i] += scalars[i];
+		}
+		turns.push_back(row);
 	}
-	if (const config &c = cfg.child("defends")) {
-		defends = read_battle_result_map(c);
+	for (int i = 0; i < SCALAR_COLUMNS; i ++) {
+		scalars[i] += that.scalars[i];
 	}
-
-	recruit_cost = lexical_cast<long long>(cfg["recruit_cost"]);
-	recall_cost = lexical_cast<long long>(cfg["recall_cost"]);
-
-	damage_inflicted = lexical_cast<long long>(cfg["damage_inflicted"]);
-	damage_taken = lexical_cast<long long>(cfg["damage_taken"]);
-	expected_damage_inflicted = lexical_cast<long long>(cfg["expected_damage_inflicted"]);
-	expected_damage_taken = lexical_cast<long long>(cfg["expected_damage_taken"]);
-
-	turn_damage_inflicted = lexical_cast<long long>(cfg["turn_damage_inflicted"]);
-	turn_damage_taken = lexical_cast<long long>(cfg["turn_damage_taken"]);
-	turn_expected_damage_inflicted = lexical_cast<long long>(cfg["turn_expected_damage_inflicted"]);
-	turn_expected_damage_taken = lexical_cast<long long>(cfg["turn_expected_damage_taken"]);
-
-	save_id = cfg["save_id"].str();
 }
 
 scenario_context::scenario_context(const std::string& name)
@@ -423,14 +332,61 @@ scenario_context::~scenario_context()
 	mid_scenario = false;
 }
 
-void reset_turn_stats(std::string save_id)
+void recruit(const team& t, const unit_type& ut, int cost)
 {
-	stats &s = get_stats(save_id);
-	s.turn_damage_inflicted = 0;
-	s.turn_damage_taken = 0;
-	s.turn_expected_damage_inflicted = 0;
-	s.turn_expected_damage_taken = 0;
-	s.save_id = save_id;
+	if (!recording) {
+		return;
+	}
+	stats& s = get_stats(t.save_id());
+	s.add(RECRUITS, type_index(ut.id()), 1);
+	s.scalars[RECRUIT_COST] += cost;
+}
+
+void death(const team& t, const std::string& type_id)
+{
+	if (!recording) {
+		return;
+	}
+	get_stats(t.save_id()).add(DEATHS, type_index(type_id), 1);
+}
+
+void kill(const team& t, const std::string& type_id)
+{
+	if (!recording) {
+		return;
+	}
+	get_stats(t.save_id()).add(KILLS, type_index(type_id), 1);
+}
+
+void attack_hit(const team& attacker, const team& defender, int damage, int chance, bool hits)
+{
+	if (!recording) {
+		return;
+	}
+	const long long expected = (long long)damage * chance * stats::decimal_shift / 100;
+	stats& a = get_stats(attacker.save_id());
+	stats& d = get_stats(defender.save_id());
+	a.scalars[EXPECTED_DAMAGE_INFLICTED] += expected;
+	d.scalars[EXPECTED_DAMAGE_TAKEN] += expected;
+	if (hits) {
+		a.scalars[DAMAGE_INFLICTED] += damage;
+		d.scalars[DAMAGE_TAKEN] += damage;
+	}
+}
+
+void end_turn(int turn)
+{
+	if (!recording || master_stats.empty()) {
+		return;
+	}
+	std::map<std::string,stats>& team_stats = master_stats.back().team_stats;
+	for (std::map<std::string,stats>::iterator it = team_stats.begin(); it != team_stats.end(); ++ it) {
+		stats& s = it->second;
+		stats::trow row;
+		row.turn = turn;
+		memcpy(row.scalars, s.scalars, sizeof(row.scalars));
+		s.turns.push_back(row);
+	}
 }
 
 stats calculate_stats(int category, std::string save_id)
@@ -438,9 +394,9 @@ stats calculate_stats(int category, std::string save_id)
 	DBG_NG << "calculate_stats, category: " << category << " side: " << save_id << " master_stats.size: " << master_stats.size() << "\n";
 	if(category == 0) {
 		stats res;
-		// We are going from last to first to include correct turn stats in result
-		for(int i = int(master_stats.size()); i > 0 ; --i) {
-			merge_stats(res,calculate_stats(i,save_id));
+		// from first to last, so that turn rows are in order.
+		for(int i = 1; i <= int(master_stats.size()); ++i) {
+			res.merge(calculate_stats(int(master_stats.size()) + 1 - i, save_id));
 		}
 
 		return res;
@@ -454,21 +410,23 @@ stats calculate_stats(int category, std::string save_id)
 	}
 }
 
-config write_stats()
+std::vector<std::string> scenario_sides()
 {
-	config res;
-	res["mid_scenario"] = mid_scenario;
-
-	for(std::vector<scenario_stats>::const_iterator i = master_stats.begin(); i != master_stats.end(); ++i) {
-		res.add_child("scenario",i->write());
+	std::vector<std::string> res;
+	if (!master_stats.empty()) {
+		const std::map<std::string,stats>& team_stats = master_stats.back().team_stats;
+		for (std::map<std::string,stats>::const_iterator it = team_stats.begin(); it != team_stats.end(); ++ it) {
+			res.push_back(it->first);
+		}
 	}
-
 	return res;
 }
 
 void write_stats(config_writer &out)
 {
 	out.write_key_val("mid_scenario", mid_scenario ? "yes" : "no");
+	// type index of columns
+	out.write_key_val("types", utils::join(type_ids));
 
 	for(std::vector<scenario_stats>::const_iterator i = master_stats.begin(); i != master_stats.end(); ++i) {
 		out.open_child("scenario");
@@ -482,8 +440,15 @@ void read_stats(const config& cfg)
 	fresh_stats();
 	mid_scenario = cfg["mid_scenario"].to_bool();
 
+	// map type index in cfg to local type index.
+	std::vector<int> types;
+	const std::vector<std::string> vstr = utils::split(cfg["types"]);
+	for (std::vector<std::string>::const_iterator it = vstr.begin(); it != vstr.end(); ++ it) {
+		types.push_back(type_index(*it));
+	}
+
 	BOOST_FOREACH (const config &s, cfg.child_range("scenario")) {
-		master_stats.push_back(scenario_stats(s));
+		master_stats.push_back(scenario_stats(s, types));
 	}
 }
 
@@ -501,25 +466,5 @@ void clear_current_scenario()
 	}
 }
 
-int sum_str_int_map(const stats::str_int_map& m)
-{
-	int res = 0;
-	for(stats::str_int_map::const_iterator i = m.begin(); i != m.end(); ++i) {
-		res += i->second;
-	}
-
-	return res;
-}
-
-int sum_cost_str_int_map(const stats::str_int_map &m)
-{
-	int cost = 0;
-	for (stats::str_int_map::const_iterator i = m.begin(); i != m.end(); ++i) {
-		cost += i->second * unit_types.find(i->first)->cost();
-	}
-
-	return cost;
-}
-
 } // end namespace statistics
 
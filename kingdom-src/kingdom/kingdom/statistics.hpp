@@ -20,69 +20,101 @@
 
 class config;
 class config_writer;
+class team;
 class unit;
+class unit_type;
 //#include "actions.hpp"
 #include <string>
 #include <map>
 #include <vector>
 
+/**
+ * Statistics are stored in columns.
+ *
+ * Counters by unit type(recruits, deaths...) are arrays indexed by dense type
+ * index, it is assigned to unit type when it is counted at first time. Scalars
+ * (damage, cost...) are fixed columns. At end of every turn, a row of scalars
+ * is appended, so per-turn history is difference of two rows.
+ * Columns are written as comma-separated integers, not as config trees.
+ *
+ * Record hooks read their arguments only and write statistics only, they never
+ * change units, teams or random results. So replay and state hash don't depend
+ * on them, --no-statistics disables them to verify it.
+ */
 namespace statistics
 {
+	/** false if record hooks are disabled. */
+	extern bool recording;
+	enum {RECRUITS, RECALLS, ADVANCES, DEATHS, KILLS, TYPE_COLUMNS};
+	enum {RECRUIT_COST, RECALL_COST, DAMAGE_INFLICTED, DAMAGE_TAKEN,
+		EXPECTED_DAMAGE_INFLICTED, EXPECTED_DAMAGE_TAKEN, SCALAR_COLUMNS};
+
+	/** dense index of unit type, assigned at first use. */
+	int type_index(const std::string& type_id);
+	const std::string& type_id(int index);
+	int type_count();
+
 	struct stats
 	{
 		stats();
 		explicit stats(const config& cfg);
 
-		config write() const;
 		void write(config_writer &out) const;
 		void read(const config& cfg);
 
-		typedef std::map<std::string,int> str_int_map;
-		str_int_map recruits, recalls, advanced_to, deaths, killed;
-		int recruit_cost, recall_cost;
-
-		/*
-		 *  A type that will map a string of hit/miss to the number of times
-		 *  that sequence has occurred.
-		 */
-		typedef str_int_map battle_sequence_frequency_map;
-
-		/** A type that will map different % chances to hit to different results. */
-		typedef std::map<int,battle_sequence_frequency_map> battle_result_map;
+		void add(int column, int type, int value);
+		int count(int column, int type) const;
+		/** sum of a type column. */
+		int sum(int column) const;
+		/** sum of a type column, every count multiplies cost of the type. */
+		int sum_cost(int column) const;
 
-		battle_result_map attacks, defends;
+		/** scalar of the current turn, difference to the last row. */
+		long long turn_scalar(int column) const;
+		/** per-turn values of a scalar column, one for every row. */
+		std::vector<long long> turn_series(int column) const;
 
-		long long damage_inflicted, damage_taken;
-		long long turn_damage_inflicted, turn_damage_taken;
+		void merge(const stats& that);
 
 		static const int decimal_shift = 1000;
 
+		struct trow {
+			int turn;
+			long long scalars[SCALAR_COLUMNS];
+		};
+
+		std::vector<int> types[TYPE_COLUMNS];
 		// Expected value for damage inflicted/taken * 1000, based on
 		// probability to hit,
 		// Use this long term to see how lucky a side is.
-
-		long long expected_damage_inflicted, expected_damage_taken;
-		long long turn_expected_damage_inflicted, turn_expected_damage_taken;
+		long long scalars[SCALAR_COLUMNS];
+		// cumulative scalars at end of every turn.
+		std::vector<trow> turns;
 		std::string save_id;
 	};
 
-	int sum_str_int_map(const stats::str_int_map& m);
-	int sum_cost_str_int_map(const stats::str_int_map &m);
-
 	struct scenario_context
 	{
 		scenario_context(const std::string& name);
 		~scenario_context();
 	};
 
-	config write_stats();
 	void write_stats(config_writer &out);
 	void read_stats(const config& cfg);
 	void fresh_stats();
 	void clear_current_scenario();
 
-	void reset_turn_stats(std::string save_id);
+	// record
+	void recruit(const team& t, const unit_type& ut, int cost);
+	void death(const team& t, const std::string& type_id);
+	void kill(const team& t, const std::string& type_id);
+	void attack_hit(const team& attacker, const team& defender, int damage, int chance, bool hits);
+	/** append a row to every side in current scenario. */
+	void end_turn(int turn);
+
 	stats calculate_stats(int category, std::string save_id);
+	/** save_id of every side in current scenario. */
+	std::vector<std::string> scenario_sides();
 } // end namespace statistics
 
 #endif
@@ -1182,7 +1182,8 @@ void team::read(const uint8_t* mem, const gamemap& map, size_t team_size)
 	info_.side = fields->side_;
 
 	config tmp_cfg;
-	::read(tmp_cfg, std::string((char*)(mem + fields->cfg_.offset_)));
+	const char* cfg_str = (const char*)(mem + fields->cfg_.offset_);
+	::read(tmp_cfg, cfg_str, strlen(cfg_str));
 	shroud_.read(tmp_cfg["shroud_data"]);
 	avoid_cfg_ = tmp_cfg.child("avoid")? tmp_cfg.child("avoid"): config();
 	has_avoid_ = tmp_cfg.child("avoid")? true: false;
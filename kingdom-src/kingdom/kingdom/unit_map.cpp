@@ -690,6 +690,11 @@ void unit_map::insert(const map_location loc, base_unit* base_u)
 
 	game_display* disp = resources::screen;
 
+	if (u->is_artifical() && resources::controller) {
+		// artifical change path's cost, shared route through it is stale.
+		resources::controller->route_cache().invalidate(u->get_location());
+	}
+
 	if (unit_is_city(u)) {
 		citys_.add(unit_2_artifical(u));
 	} else if (!u->is_artifical()) {
@@ -754,6 +759,9 @@ bool unit_map::erase2(base_unit* base_u, bool delete_unit)
 	} else if (u->is_artifical() && citys_.map_[u->cityno()]) {
 		citys_.map_[u->cityno()]->field_arts_erase(unit_2_artifical(u));
 	}
+	if (u->is_artifical() && resources::controller) {
+		resources::controller->route_cache().invalidate(u->get_location());
+	}
 	if (!unit_is_city(u)) {
 		(*resources::teams)[u->side() - 1].erase_troop(u);
 	}
@@ -28,6 +28,8 @@
 #include "hero.hpp"
 #include "wml_exception.hpp"
 #include "filesystem.hpp"
+#include "asset_pack.hpp"
+#include "log.hpp"
 #include "area_anim.hpp"
 #include "help.hpp"
 
@@ -38,6 +40,10 @@
 #include "font.hpp"
 
 #include <boost/foreach.hpp>
+#include <iostream>
+
+static lg::log_domain log_unit("unit");
+#define LOG_UT LOG_STREAM(info, log_unit)
 
 department::department(int type, const std::string& name, const std::string& image, const std::string& portrait)
 	: type_(type)
@@ -1929,7 +1935,7 @@ void unit_type::healing_anim(const std::string& tag, const std::string& race, co
 void unit_type::idle_anim(const std::string& tag, const std::string& race, const std::string& id, bool terrain, const std::string& idle_sound, config& cfg, bool multigrid)
 {
 	utils::string_map symbols;
-	std::string idle1 = get_binary_file_location("images", idle(race, id, terrain, 1));
+	std::string idle1 = asset_pack::location("images", idle(race, id, terrain, 1));
 	if (!idle1.empty()) {
 		symbols["idle_1_png"] = idle(race, id, terrain, 1);
 		symbols["idle_2_png"] = idle(race, id, terrain, 2);
@@ -1950,7 +1956,7 @@ void unit_type::idle_anim(const std::string& tag, const std::string& race, const
 void unit_type::healed_anim(const std::string& tag, const std::string& race, const std::string& id, bool terrain, config& cfg)
 {
 	utils::string_map symbols;
-	std::string idle1 = get_binary_file_location("images", idle(race, id, terrain, 1));
+	std::string idle1 = asset_pack::location("images", idle(race, id, terrain, 1));
 	if (!idle1.empty()) {
 		symbols["idle_1_png"] = idle(race, id, terrain, 1);
 		symbols["idle_2_png"] = idle(race, id, terrain, 2);
@@ -1969,7 +1975,7 @@ void unit_type::healed_anim(const std::string& tag, const std::string& race, con
 void unit_type::movement_anim(const std::string& tag, const std::string& race, const std::string& id, bool terrain, const std::string& movement_sound, const std::string& src, config& cfg)
 {
 	utils::string_map symbols;
-	std::string move1 = get_binary_file_location("images", move(race, id, terrain, 1));
+	std::string move1 = asset_pack::location("images", move(race, id, terrain, 1));
 	if (!move1.empty()) {
 		symbols["move_1_png"] = move(race, id, terrain, 1);
 		symbols["move_2_png"] = move(race, id, terrain, 2);
@@ -1985,7 +1991,7 @@ void unit_type::movement_anim(const std::string& tag, const std::string& race, c
 void unit_type::build_anim(const std::string& tag, const std::string& race, const std::string& id, bool terrain, config& cfg)
 {
 	utils::string_map symbols;
-	std::string build1 = get_binary_file_location("images", build(race, id, terrain, 1));
+	std::string build1 = asset_pack::location("images", build(race, id, terrain, 1));
 	if (!build1.empty()) {
 		symbols["build_1_png"] = build(race, id, terrain, 1);
 		symbols["build_2_png"] = build(race, id, terrain, 2);
@@ -2004,7 +2010,7 @@ void unit_type::build_anim(const std::string& tag, const std::string& race, cons
 void unit_type::repair_anim(const std::string& tag, const std::string& race, const std::string& id, bool terrain, config& cfg)
 {
 	utils::string_map symbols;
-	std::string repair1 = get_binary_file_location("images", build(race, id, terrain, 1));
+	std::string repair1 = asset_pack::location("images", build(race, id, terrain, 1));
 	if (!repair1.empty()) {
 		symbols["repair_1_png"] = repair(race, id, terrain, 1);
 		symbols["repair_2_png"] = repair(race, id, terrain, 2);
@@ -2023,7 +2029,7 @@ void unit_type::repair_anim(const std::string& tag, const std::string& race, con
 void unit_type::die_anim(const std::string& tag, const std::string& race, const std::string& id, bool terrain, const std::string& die_sound, config& cfg, bool multigrid)
 {
 	utils::string_map symbols;
-	std::string die1 = get_binary_file_location("images", die(race, id, terrain, 1));
+	std::string die1 = asset_pack::location("images", die(race, id, terrain, 1));
 	if (!die1.empty()) {
 		symbols["die_1_png"] = die(race, id, terrain, 1);
 		symbols["die_2_png"] = die(race, id, terrain, 2);
@@ -2057,7 +2063,7 @@ void unit_type::attack_anim_melee(const std::string& tag, const std::string& aid
 	symbols["hit_sound"] = hit_sound;
 	symbols["miss_sound"] = miss_sound;
 
-	std::string melee_attack_1 = get_binary_file_location("images", attack_image(race, id, terrain, 0, 1));
+	std::string melee_attack_1 = asset_pack::location("images", attack_image(race, id, terrain, 0, 1));
 	if (!melee_attack_1.empty()) {
 		symbols["melee_attack_1_png"] = attack_image(race, id, terrain, 0, 1);
 		symbols["melee_attack_2_png"] = attack_image(race, id, terrain, 0, 2);
@@ -2098,7 +2104,7 @@ void unit_type::attack_anim_multi_melee(const std::string& tag, const std::strin
 	symbols["hit_sound"] = hit_sound;
 	symbols["miss_sound"] = miss_sound;
 
-	std::string melee_attack_1 = get_binary_file_location("images", attack_image(race, id, terrain, 0, 1));
+	std::string melee_attack_1 = asset_pack::location("images", attack_image(race, id, terrain, 0, 1));
 	if (!melee_attack_1.empty()) {
 		symbols["melee_attack_1_png"] = attack_image(race, id, terrain, 0, 1);
 		symbols["melee_attack_2_png"] = attack_image(race, id, terrain, 0, 2);
@@ -2137,7 +2143,7 @@ void unit_type::attack_anim_cyclone(const std::string& tag, const std::string& a
 	}
 	symbols["hit_sound"] = hit_sound;
 
-	std::string melee_attack_1 = get_binary_file_location("images", attack_image(race, id, terrain, 0, 1));
+	std::string melee_attack_1 = asset_pack::location("images", attack_image(race, id, terrain, 0, 1));
 	if (!melee_attack_1.empty()) {
 		symbols["melee_attack_1_png"] = attack_image(race, id, terrain, 0, 1);
 		symbols["melee_attack_2_png"] = attack_image(race, id, terrain, 0, 2);
@@ -2168,7 +2174,7 @@ void unit_type::attack_anim_penetrate(const std::string& tag, const std::string&
 	}
 	symbols["hit_sound"] = hit_sound;
 
-	std::string melee_attack_1 = get_binary_file_location("images", attack_image(race, id, terrain, 0, 1));
+	std::string melee_attack_1 = asset_pack::location("images", attack_image(race, id, terrain, 0, 1));
 	if (!melee_attack_1.empty()) {
 		symbols["melee_attack_1_png"] = attack_image(race, id, terrain, 0, 1);
 		symbols["melee_attack_2_png"] = attack_image(race, id, terrain, 0, 2);
@@ -2365,6 +2371,7 @@ void unit_type::attack_anim_ranged_archery(const std::string& tag, const std::st
 }
 
 unit_type::unit_type(const unit_type& o) :
+	src_cfg_(o.src_cfg_),
 	cfg_(o.cfg_),
 	id_(o.id_),
 	type_name_(o.type_name_),
@@ -2433,6 +2440,8 @@ unit_type::unit_type(const unit_type& o) :
 	packer_(o.packer_),
 	attacks_(o.attacks_)
 {
+	SDL_AtomicSet(&lazy_built_, SDL_AtomicGet(&o.lazy_built_));
+
 	for (variations_map::const_iterator i = o.gender_types_.begin(); i != o.gender_types_.end(); ++ i) {
 		gender_types_[i->first] = new unit_type(*i->second);
 	}
@@ -2444,6 +2453,7 @@ unit_type::unit_type(const unit_type& o) :
 
 
 unit_type::unit_type(const config &cfg) :
+	src_cfg_(),
 	cfg_(),
 	id_(cfg["id"]),
 	type_name_(),
@@ -2512,9 +2522,18 @@ unit_type::unit_type(const config &cfg) :
 	touch_dirs_(),
 	packer_(false)
 {
+	SDL_AtomicSet(&lazy_built_, 0);
+
+	// other attributes are read by build_help_index, from cfg.
 	BOOST_FOREACH (const config::any_child& c, cfg.all_children_range()) {
 		if (c.key == "attack") continue;
-		cfg_.add_child(c.key, c.cfg);
+		src_cfg_.add_child(c.key, c.cfg);
+	}
+	static const char* movement_keys[] = {"name", "flies"};
+	for (size_t n = 0; n < sizeof(movement_keys) / sizeof(movement_keys[0]); n ++) {
+		if (const config::attribute_value* v = cfg.get(movement_keys[n])) {
+			src_cfg_[movement_keys[n]] = *v;
+		}
 	}
 
 	BOOST_FOREACH (const config &att, cfg.child_range("attack")) {
@@ -2583,9 +2602,11 @@ void unit_type::build_full(const config& cfg, const movement_type_map &mv_types,
 	if (build_status_ == NOT_BUILT || build_status_ == CREATED)
 		build_help_index(cfg, mv_types, races);
 
+	// build_help_index checked config, what is here doesn't throw config::error.
 	movementType_ = unit_movement_type(cfg);
-	alpha_ = ftofxp(1.0);
+	movementType_.set_parent(&mv_types.find(movementType_id_)->second);
 
+	possibleTraits_.clear();
 	const traits_map& units_traits = unit_types.traits();
 	for (traits_map::const_iterator it = units_traits.begin(); it != units_traits.end(); ++ it) {
 		if (it->second["special"].to_bool()) {
@@ -2597,20 +2618,6 @@ void unit_type::build_full(const config& cfg, const movement_type_map &mv_types,
 	for (variations_map::const_iterator it = gender_types_.begin(); it != gender_types_.end(); ++ it) {
 		it->second->build_full(cfg, mv_types, races);
 	}
-
-	const std::string& align = cfg["alignment"];
-	if(align == "lawful")
-		alignment_ = LAWFUL;
-	else if(align == "chaotic")
-		alignment_ = CHAOTIC;
-	else if(align == "neutral")
-		alignment_ = NEUTRAL;
-	else if(align == "liminal")
-		alignment_ = LIMINAL;
-	else {
-		throw config::error("Invalid alignment found for " + id() + ": '" + align);
-		alignment_ = NEUTRAL;
-	}
 /*
 	// temporarily only support common traits
 	if (race_ != &dummy_race())
@@ -2629,73 +2636,57 @@ void unit_type::build_full(const config& cfg, const movement_type_map &mv_types,
 		}
 	}
 */
-	zoc_ = cfg["zoc"].to_bool(level_ > 0);
-	cancel_zoc_ = cfg["cancel_zoc"].to_bool();
-	require_ = cfg["require"].to_int(REQUIRE_NONE);
-
-	const std::string& alpha_blend = cfg["alpha"];
-	if(alpha_blend.empty() == false) {
-		alpha_ = ftofxp(atof(alpha_blend.c_str()));
-	}
-
-	const std::string& move_type = cfg["movement_type"];
-
-	const movement_type_map::const_iterator it = mv_types.find(move_type);
-
-	if(it != mv_types.end()) {
-	    movementType_.set_parent(&(it->second));
-	} else{
-		throw config::error("no parent found for movement_type " + move_type);
+	cfg_.clear();
+	BOOST_FOREACH (const config::any_child& c, cfg.all_children_range()) {
+		if (c.key == "attack") continue;
+		cfg_.add_child(c.key, c.cfg);
 	}
 
-	flag_rgb_ = cfg["flag_rgb"].str();
-	game_config::add_color_info(cfg);
+#if defined(_KINGDOM_EXE) || !defined(_WIN32)
+	fill_animations();
+#endif
 
-	die_sound_ = cfg["die_sound"].str();
+	build_status_ = FULL;
+}
 
-	match_ = cfg["match"].str();
+namespace {
+// build_lazy of one type at a time, it is short.
+threading::mutex build_lazy_mutex;
 
-	terrain_ = t_translation::read_terrain_code(cfg["terrain"].str());
-	can_recruit_ = cfg["can_recruit"].to_bool();
-	// if can_recruit, it must can_reside.
-	if (can_recruit_) {
-		can_reside_ = true;
-	} else {
-		can_reside_ = cfg["can_reside"].to_bool();
-	}
-	base_ = cfg["base"].to_bool();
-	
-	if (!cfg["arms"].blank()) {
-		arms_ = unit_types.arms_from_id(cfg["arms"].str());
-		if (arms_ < 0 || arms_ >= HEROS_MAX_ARMS) {
-			throw config::error(id_ + "'s arms is invalid: " + cfg["arms"].str());
-		}
+size_t config_bytes(const config& cfg)
+{
+	size_t bytes = 0;
+	BOOST_FOREACH (const config::attribute& a, cfg.attribute_range()) {
+		bytes += a.first.size() + a.second.str().size();
 	}
-	if (!cfg["especial"].blank()) {
-		especial_ = unit_types.especial_from_id(cfg["especial"].str());
-		if (especial_ < 0) {
-			throw config::error(id_ + "'s especial is invalid: " + cfg["especial"].str());
-		}
+	BOOST_FOREACH (const config::any_child& c, cfg.all_children_range()) {
+		bytes += c.key.size() + config_bytes(c.cfg);
 	}
-	raw_icon_ = cfg["icon"].str();
-	raw_movement_sound_ = cfg["movement_sound"].str();
-	raw_idle_sound_ = cfg["idle_sound"].str();
-	
-	land_wall_ = cfg["land_wall"].to_bool(true);
-	guard_ = cfg["guard"].to_int(NO_GUARD);
+	return bytes;
+}
+}
 
-	const std::vector<std::string> vstr = utils::split(cfg["touch_dirs"]);
-	std::vector<std::string>::const_iterator tmp;
-	for (std::vector<std::string>::const_iterator it = vstr.begin(); it != vstr.end(); ++ it) {
-		map_location::DIRECTION dir = map_location::parse_direction(*it);
-		if (dir != map_location::NDIRECTIONS) {
-			touch_dirs_.insert(dir);
-		}
+void unit_type::build_lazy() const
+{
+	if (SDL_AtomicGet(&lazy_built_)) {
+		return;
 	}
 
-	// Deprecation messages, only seen when unit is parsed for the first time.
+	const threading::lock lock(build_lazy_mutex);
+	if (SDL_AtomicGet(&lazy_built_)) {
+		return;
+	}
+	unit_type& ut = const_cast<unit_type&>(*this);
+	ut.build_full(src_cfg_, unit_types.movement_types(), unit_types.races());
+	ut.src_cfg_.clear();
+	// fields of build_full must be visible before flag.
+	SDL_AtomicSet(&lazy_built_, 1);
+}
 
-	build_status_ = FULL;
+size_t unit_type::lazy_bytes() const
+{
+	const threading::lock lock(build_lazy_mutex);
+	return SDL_AtomicGet(&lazy_built_)? 0: config_bytes(src_cfg_);
 }
 
 bool unit_type::terrain_matches(t_translation::t_terrain tcode) const
@@ -2812,6 +2803,78 @@ void unit_type::build_help_index(const config& cfg, const movement_type_map &mv_
 
 	hide_help_= cfg["hide_help"].to_bool();
 
+	const std::string& align = cfg["alignment"];
+	if(align == "lawful")
+		alignment_ = LAWFUL;
+	else if(align == "chaotic")
+		alignment_ = CHAOTIC;
+	else if(align == "neutral")
+		alignment_ = NEUTRAL;
+	else if(align == "liminal")
+		alignment_ = LIMINAL;
+	else {
+		throw config::error("Invalid alignment found for " + id() + ": '" + align);
+		alignment_ = NEUTRAL;
+	}
+
+	zoc_ = cfg["zoc"].to_bool(level_ > 0);
+	cancel_zoc_ = cfg["cancel_zoc"].to_bool();
+	require_ = cfg["require"].to_int(REQUIRE_NONE);
+
+	alpha_ = ftofxp(1.0);
+	const std::string& alpha_blend = cfg["alpha"];
+	if(alpha_blend.empty() == false) {
+		alpha_ = ftofxp(atof(alpha_blend.c_str()));
+	}
+
+	if (mv_types.find(movementType_id_) == mv_types.end()) {
+		throw config::error("no parent found for movement_type " + movementType_id_);
+	}
+
+	flag_rgb_ = cfg["flag_rgb"].str();
+	game_config::add_color_info(cfg);
+
+	die_sound_ = cfg["die_sound"].str();
+
+	match_ = cfg["match"].str();
+
+	terrain_ = t_translation::read_terrain_code(cfg["terrain"].str());
+	can_recruit_ = cfg["can_recruit"].to_bool();
+	// if can_recruit, it must can_reside.
+	if (can_recruit_) {
+		can_reside_ = true;
+	} else {
+		can_reside_ = cfg["can_reside"].to_bool();
+	}
+	base_ = cfg["base"].to_bool();
+	
+	if (!cfg["arms"].blank()) {
+		arms_ = unit_types.arms_from_id(cfg["arms"].str());
+		if (arms_ < 0 || arms_ >= HEROS_MAX_ARMS) {
+			throw config::error(id_ + "'s arms is invalid: " + cfg["arms"].str());
+		}
+	}
+	if (!cfg["especial"].blank()) {
+		especial_ = unit_types.especial_from_id(cfg["especial"].str());
+		if (especial_ < 0) {
+			throw config::error(id_ + "'s especial is invalid: " + cfg["especial"].str());
+		}
+	}
+	raw_icon_ = cfg["icon"].str();
+	raw_movement_sound_ = cfg["movement_sound"].str();
+	raw_idle_sound_ = cfg["idle_sound"].str();
+	
+	land_wall_ = cfg["land_wall"].to_bool(true);
+	guard_ = cfg["guard"].to_int(NO_GUARD);
+
+	const std::vector<std::string> vstr = utils::split(cfg["touch_dirs"]);
+	for (std::vector<std::string>::const_iterator it = vstr.begin(); it != vstr.end(); ++ it) {
+		map_location::DIRECTION dir = map_location::parse_direction(*it);
+		if (dir != map_location::NDIRECTIONS) {
+			touch_dirs_.insert(dir);
+		}
+	}
+
 	build_status_ = BS_HELP_INDEX;
 }
 
@@ -2893,7 +2956,13 @@ bool unit_type::use_terrain_image() const
 #if defined(_KINGDOM_EXE) || !defined(_WIN32)
 const std::vector<unit_animation>& unit_type::animations() const 
 {
-	if (!animations_.empty()) return animations_;
+	build_lazy();
+	return animations_;
+}
+
+void unit_type::fill_animations()
+{
+	animations_.clear();
 
 	std::set<std::string> abilities;
 	for (std::multimap<const std::string, const config*>::const_iterator it = abilities_cfg_.begin(); it != abilities_cfg_.end(); ++ it) {
@@ -2990,8 +3059,6 @@ const std::vector<unit_animation>& unit_type::animations() const
 	const std::string& default_image = (terrain_ == t_translation::NONE_TERRAIN)? image_: "";
 	utype_cfg["die_sound"] = die_sound_;
 	unit_animation::fill_initial_animations(default_image, animations_, utype_cfg);
-
-	return animations_;
 }
 #endif
 
@@ -3154,12 +3221,17 @@ unit_type_data::unit_type_data() :
 	hide_help_all_(false),
 	hide_help_type_(),
 	hide_help_race_(),
-	build_status_(unit_type::NOT_BUILT)
+	build_status_(unit_type::NOT_BUILT),
+	prewarm_thread_(NULL),
+	prewarm_types_()
 {
+	SDL_AtomicSet(&prewarm_stop_, 0);
 }
 
 unit_type_data::~unit_type_data()
 {
+	stop_prewarm();
+
 	for (std::vector<advance_tree::node*>::iterator it = utype_tree_.begin(); it != utype_tree_.end(); ++ it) {
 		delete *it;
 	}
@@ -3576,6 +3648,13 @@ bool valid(const std::string& str)
 }
 
 void unit_type_data::set_config(const config &cfg)
+{
+	fill_tables(cfg);
+	anim2::fill_anims(cfg);
+	fill_types(cfg);
+}
+
+void unit_type_data::fill_tables(const config &cfg)
 {
     clear();
 
@@ -3720,8 +3799,6 @@ void unit_type_data::set_config(const config &cfg)
 		loadscreen::increment_progress();
 	}
 
-	anim2::fill_anims(cfg);
-
 	BOOST_FOREACH (const config &sp, cfg.child_range("specials"))
 	{
 		BOOST_FOREACH (const config::any_child &c, sp.all_children_range()) {
@@ -3979,7 +4056,10 @@ void unit_type_data::set_config(const config &cfg)
 		index ++;
 		loadscreen::increment_progress();
 	}
+}
 
+void unit_type_data::fill_types(const config &cfg)
+{
 	std::map<unit_type*, const config*> ut_cfg_map;
 	BOOST_FOREACH (const config &ut, cfg.child_range("unit_type"))
 	{
@@ -3999,8 +4079,9 @@ void unit_type_data::set_config(const config &cfg)
 	// You may use member variable in unit_type to rember which config relative to this unit_type,
 	// But this config maybe destroy after this call, in order to avoid confuse, 
 	// don't let ths config appear in unit_type's member variable.
+	// Only build what help and lists need, movement type and animations are built on first use.
 	for (std::map<unit_type*, const config*>::const_iterator it = ut_cfg_map.begin(); it != ut_cfg_map.end(); ++ it) {
-		build_unit_type(*(it->first), *(it->second));
+		build_unit_type(*(it->first), *(it->second), unit_type::BS_HELP_INDEX);
 	}
 
 	for (std::vector<std::string>::const_iterator it = navigation_types_.begin(); it != navigation_types_.end(); ++ it) {
@@ -4188,7 +4269,7 @@ void unit_type_data::set_config(const config &cfg)
 		throw config::error("[recruit] error, must define [recruit] block in [units].");
 	}
 
-	index = 0, complex_index = tdecree::min_complex_index;
+	int index = 0, complex_index = tdecree::min_complex_index;
 	BOOST_FOREACH (const config &decree, cfg.child_range("decree")) {
 		const std::string id = decree["id"].str();
 		if (id.empty()) {
@@ -4245,6 +4326,8 @@ const unit_type *unit_type_data::find(const std::string& key, unit_type::BUILD_S
 
 void unit_type_data::clear()
 {
+	stop_prewarm();
+
 	types_.clear();
 	keytypes_.clear();
 	artifical_types_.clear();
@@ -4357,6 +4440,61 @@ unit_type& unit_type_data::build_unit_type(unit_type &ut, const config& cfg, uni
 	return ut;
 }
 
+void unit_type_data::prewarm(const std::vector<const unit_type*>& types)
+{
+	stop_prewarm();
+
+	prewarm_types_ = types;
+	SDL_AtomicSet(&prewarm_stop_, 0);
+	prewarm_thread_ = new threading::thread(prewarm_main, this);
+}
+
+void unit_type_data::stop_prewarm()
+{
+	if (!prewarm_thread_) {
+		return;
+	}
+	SDL_AtomicSet(&prewarm_stop_, 1);
+	// destructor joins thread.
+	delete prewarm_thread_;
+	prewarm_thread_ = NULL;
+	prewarm_types_.clear();
+}
+
+int unit_type_data::prewarm_main(void* data)
+{
+	unit_type_data& utypes = *static_cast<unit_type_data*>(data);
+	const uint32_t start = SDL_GetTicks();
+	size_t built = 0;
+	try {
+		for (std::vector<const unit_type*>::const_iterator it = utypes.prewarm_types_.begin(); it != utypes.prewarm_types_.end(); ++ it) {
+			if (SDL_AtomicGet(&utypes.prewarm_stop_)) {
+				break;
+			}
+			(*it)->build_lazy();
+			built ++;
+		}
+	} catch (...) {
+		// thread that uses this type builds it again, and gets exception.
+	}
+	LOG_UT << "prewarm " << built << "/" << utypes.prewarm_types_.size() << " unit types, " << (SDL_GetTicks() - start) << " ms\n";
+
+	if (!lg::info.dont_log(log_unit)) {
+		// what unused types still keep.
+		int lazy = 0;
+		size_t bytes = 0;
+		for (unit_type_map::const_iterator it = utypes.types_.begin(); it != utypes.types_.end(); ++ it) {
+			const size_t b = it->second.lazy_bytes();
+			if (b) {
+				lazy ++;
+				bytes += b;
+			}
+		}
+		LOG_UT << lazy << "/" << utypes.types_.size() << " unit types aren't built, they keep " << (bytes / 1024) << " KB of config\n";
+	}
+	return 0;
+}
+
 void unit_type_data::read_hide_help(const config& cfg)
 {
 	if (!cfg)
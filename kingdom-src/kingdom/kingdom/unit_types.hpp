@@ -20,6 +20,7 @@
 #include "hero.hpp"
 #include "filter_tag.hpp"
 #include "area_anim.hpp"
+#include "thread.hpp"
 
 class gamemap;
 class unit;
@@ -786,9 +787,8 @@ public:
 	
 	/**
 	 * Creates a unit type for the given config, but delays its build
-	 * till later.
-	 * @note @a cfg is not copied, so it has to point to some permanent
-	 *       storage, that is, a child of unit_type_data::unit_cfg.
+	 * till later. @a cfg is copied, and the copy is released when type
+	 * is fully built.
 	 */
 	unit_type(const config &cfg);
 	unit_type(const unit_type& o);
@@ -805,6 +805,14 @@ public:
 	void build_created(const config& cfg, const movement_type_map &movement_types,
 		const race_map &races);
 
+	/**
+	 * Build what build_full adds on first use of it: cfg, movement type,
+	 * traits and animations. Threads can call it at the same time.
+	 */
+	void build_lazy() const;
+	/** bytes of config that is kept until build_lazy, 0 if it is built. */
+	size_t lazy_bytes() const;
+
 	/** Get the advancement tree
 	 *  Build a set of unit type's id of this unit type's advancement tree */
 	std::set<std::string> advancement_tree() const;
@@ -853,7 +861,7 @@ public:
 	const std::string& die_sound() const { return die_sound_; }
 
 	std::vector<attack_type> attacks() const;
-	const unit_movement_type& movement_type() const { return movementType_; }
+	const unit_movement_type& movement_type() const { build_lazy(); return movementType_; }
 	const std::string& movementType_id() const { return movementType_id_; }
 
 	int experience_needed(bool with_acceleration=true) const;
@@ -913,7 +921,7 @@ public:
 	// bool has_ability_by_id(const std::string& ability) const;
 
 	const std::vector<const config*>& possible_traits() const
-	{ return possibleTraits_; }
+	{ build_lazy(); return possibleTraits_; }
 
 	const std::vector<unit_race::GENDER>& genders() const { return genders_; }
 
@@ -924,14 +932,20 @@ public:
 
     BUILD_STATUS build_status() const { return build_status_; }
 
-	const config& get_cfg() const { return cfg_; }
+	const config& get_cfg() const { build_lazy(); return cfg_; }
 
 	bool use_terrain_image() const;
 
 private:
 	void operator=(const unit_type& o);
 	void fill_abilities_cfg(const std::string& abilities);
+#if defined(_KINGDOM_EXE) || !defined(_WIN32)
+	void fill_animations();
+#endif
 
+	// what build_lazy reads of [unit_type]: children without [attack], and
+	// attributes of movement type. Released after build_lazy.
+	config src_cfg_;
 	config cfg_;
 
 	std::string id_;
@@ -992,12 +1006,13 @@ private:
 	std::vector<unit_race::GENDER> genders_;
 	std::vector<attack_type> attacks_;
 
-	// animations are loaded only after the first animations() call
 #if defined(_KINGDOM_EXE) || !defined(_WIN32)
-	mutable std::vector<unit_animation> animations_;
+	std::vector<unit_animation> animations_;
 #endif
 
 	BUILD_STATUS build_status_;
+	// 1 when build_lazy is done.
+	mutable SDL_atomic_t lazy_built_;
 
 	std::string match_;
 	std::string raw_icon_;
@@ -1116,6 +1131,20 @@ public:
 	const std::set<const ttechnology*>& selectable_technologies() const { return selectable_technologies_; }
 
 	void set_config(const config &cfg);
+	/**
+	 * set_config in two parts, anim2::fill_anims(cfg) can run between them.
+	 * fill_tables doesn't need animations, fill_types does.
+	 */
+	void fill_tables(const config &cfg);
+	void fill_types(const config &cfg);
+
+	/**
+	 * Build types in a background thread before they are used, i.e. types
+	 * that sides of scenario can recruit. Types that aren't built when they
+	 * are used are built by the thread that uses them.
+	 */
+	void prewarm(const std::vector<const unit_type*>& types);
+	void stop_prewarm();
 
 	const unit_type* find(const std::string &key, unit_type::BUILD_STATUS status = unit_type::FULL) const;
 	const unit_race* find_race(const std::string &) const;
@@ -1146,6 +1175,8 @@ private:
 	unit_type& build_unit_type(unit_type &ut, const config& cfg, unit_type::BUILD_STATUS status = unit_type::FULL) const;
 	void add_advancefrom(const config& unit_cfg) const;
 
+	static int prewarm_main(void* data);
+
 	mutable unit_type_map types_;
 	std::map<int, const unit_type*> keytypes_;
 	std::map<std::string, const unit_type*> artifical_types_;
@@ -1210,6 +1241,10 @@ private:
 	std::vector< std::set<std::string> > hide_help_race_;
 
 	unit_type::BUILD_STATUS build_status_;
+
+	threading::thread* prewarm_thread_;
+	std::vector<const unit_type*> prewarm_types_;
+	SDL_atomic_t prewarm_stop_;
 };
 
 namespace stratagem_tag {
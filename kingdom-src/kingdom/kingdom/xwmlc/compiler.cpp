@@ -0,0 +1,685 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/**
+ * @file
+ * Generate xwml binaries from data tree, and decide whether they are stale.
+ */
+
+#include "global.hpp"
+
+#include "xwmlc/compiler.hpp"
+#include "rose_config.hpp"
+#include "builder.hpp"
+#include "image.hpp"
+#include "loadscreen.hpp"
+#include "serialization/parser.hpp"
+#include "serialization/string_utils.hpp"
+#include "sha1.hpp"
+#include "wml_exception.hpp"
+
+#include <boost/foreach.hpp>
+#include <sys/stat.h>
+
+#define BASENAME_DATA		"data.bin"
+#define BASENAME_GUI		"gui.bin"
+#define BASENAME_LANGUAGE	"language.bin"
+#define CAMPAIGNS_CFG_PATH	"/data/app-kingdom/campaigns.cfg"
+
+// increase it when manifest or output format changes, every output is generated again.
+static const int manifest_version = 1;
+
+static std::string file_hash(const std::string& file)
+{
+	return sha1_hash(read_file(file)).display();
+}
+
+static void list_tree(const std::string& dir, std::stringstream& out)
+{
+	std::vector<std::string> files, dirs;
+	get_files_in_dir(dir, &files, &dirs, ENTIRE_FILE_PATH, NO_FILTER, DONT_REORDER);
+	for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++ it) {
+		out << *it << "\n";
+	}
+	for (std::vector<std::string>::const_iterator it = dirs.begin(); it != dirs.end(); ++ it) {
+		list_tree(*it, out);
+	}
+}
+
+// only names, builder cares whether an image exists, not its content.
+static std::string listing_hash(const std::string& dir, bool tree)
+{
+	std::stringstream out;
+	if (tree) {
+		list_tree(dir, out);
+	} else {
+		// same as preprocessor lists an included directory.
+		std::vector<std::string> files;
+		get_files_in_dir(dir, &files, NULL, ENTIRE_FILE_PATH, SKIP_MEDIA_DIR, DO_REORDER);
+		for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++ it) {
+			out << *it << "\n";
+		}
+	}
+	return sha1_hash(out.str()).display();
+}
+
+// check location:
+//   1. heros_army of artifcal
+//   2. service_heros of artifcal
+//   3. wander_heros of artifcal
+//   4. heros_army of unit
+std::string tcompiler::check_scenario_cfg(const config& scenario_cfg)
+{
+	std::set<std::string> holded_str;
+	std::set<int> holded_number;
+	std::set<std::string> officialed_str;
+	std::map<std::string, std::set<std::string> > officialed_map;
+	std::map<std::string, std::string> mayor_map;
+	int number;
+	std::vector<std::string> str_vec;
+	std::vector<std::string>::const_iterator tmp;
+	std::stringstream str;
+
+	BOOST_FOREACH (const config& side, scenario_cfg.child_range("side")) {
+		const std::string leader = side["leader"];
+		BOOST_FOREACH (const config& art, side.child_range("artifical")) {
+			officialed_str.clear();
+			const std::string cityno = art["cityno"].str();
+			mayor_map[cityno] = art["mayor"].str();
+
+			str_vec = utils::split(art["heros_army"]);
+			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
+				if (holded_str.count(*tmp)) {
+					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is conflicted!";
+					return str.str();
+				}
+				number = lexical_cast_default<int>(*tmp);
+				if (holded_number.count(number)) {
+					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is invalid!";
+					return str.str();
+				}
+				holded_str.insert(*tmp);
+				holded_number.insert(number);
+			}
+			str_vec = utils::split(art["service_heros"]);
+			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
+				if (holded_str.count(*tmp)) {
+					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is conflicted!";
+					return str.str();
+				}
+				number = lexical_cast_default<int>(*tmp);
+				if (holded_number.count(number)) {
+					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is invalid!";
+					return str.str();
+				}
+				holded_str.insert(*tmp);
+				holded_number.insert(number);
+				officialed_str.insert(*tmp);
+			}
+			str_vec = utils::split(art["wander_heros"]);
+			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
+				if (holded_str.count(*tmp)) {
+					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is conflicted!";
+					return str.str();
+				}
+				number = lexical_cast_default<int>(*tmp);
+				if (holded_number.count(number)) {
+					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is invalid!";
+					return str.str();
+				}
+				holded_str.insert(*tmp);
+				holded_number.insert(number);
+			}
+			officialed_map[cityno] = officialed_str;
+		}
+		BOOST_FOREACH (const config& u, side.child_range("unit")) {
+			const std::string cityno = u["cityno"].str();
+			std::map<std::string, std::set<std::string> >::iterator find_it = officialed_map.find(cityno);
+			if (cityno != "0" && find_it == officialed_map.end()) {
+				str << "." << scenario_cfg["id"].str() << ", heros_army=" << u["heros_army"].str() << " uses undefined cityno: " << cityno << "";
+				return str.str();
+			}
+			str_vec = utils::split(u["heros_army"]);
+			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
+				if (holded_str.count(*tmp)) {
+					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is conflicted!";
+					return str.str();
+				}
+				number = lexical_cast_default<int>(*tmp);
+				if (holded_number.count(number)) {
+					str << "." << scenario_cfg["id"].str() << ", hero number: " << *tmp << " is invalid!";
+					return str.str();
+				}
+				holded_str.insert(*tmp);
+				holded_number.insert(number);
+				if (find_it != officialed_map.end()) {
+					find_it->second.insert(*tmp);
+				}
+			}
+		}
+		for (std::map<std::string, std::set<std::string> >::const_iterator it = officialed_map.begin(); it != officialed_map.end(); ++ it) {
+			std::map<std::string, std::string>::const_iterator mayor_it = mayor_map.find(it->first);
+			if (mayor_it->second.empty()) {
+				continue;
+			}
+			if (mayor_it->second == leader) {
+				str << "." << scenario_cfg["id"].str() << ", in cityno=" << it->first << " mayor(" << mayor_it->second << ") cannot be leader!";
+				return str.str();
+			}
+			if (it->second.find(mayor_it->second) == it->second.end()) {
+				str << "." << scenario_cfg["id"].str() << ", in ciytno=" << it->first << " mayor(" << mayor_it->second << ") must be in offical hero!";
+				return str.str();
+			}
+		}
+	}
+	return "";
+}
+
+// check location:
+//   1. heros_army of artifcal
+//   2. service_heros of artifcal
+//   3. wander_heros of artifcal
+std::string tcompiler::check_mplayer_bin(const config& mplayer_cfg)
+{
+	std::set<std::string> holded_str;
+	std::set<int> holded_number;
+	int number;
+	std::vector<std::string> str_vec;
+	std::vector<std::string>::const_iterator tmp;
+	std::stringstream str;
+
+	BOOST_FOREACH (const config& faction, mplayer_cfg.child_range("faction")) {
+		BOOST_FOREACH (const config& art, faction.child_range("artifical")) {
+			str_vec = utils::split(art["heros_army"]);
+			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
+				if (holded_str.count(*tmp)) {
+					str << "hero number: " << *tmp << " is conflicted!";
+					return str.str();
+				}
+				number = lexical_cast_default<int>(*tmp);
+				if (holded_number.count(number)) {
+					str << "hero number: " << *tmp << " is invalid!";
+					return str.str();
+				}
+				holded_str.insert(*tmp);
+				holded_number.insert(number);
+			}
+			str_vec = utils::split(art["service_heros"]);
+			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
+				if (holded_str.count(*tmp)) {
+					str << "hero number: " << *tmp << " is conflicted!";
+					return str.str();
+				}
+				number = lexical_cast_default<int>(*tmp);
+				if (holded_number.count(number)) {
+					str << "hero number: " << *tmp << " is invalid!";
+					return str.str();
+				}
+				holded_str.insert(*tmp);
+				holded_number.insert(number);
+			}
+			str_vec = utils::split(art["wander_heros"]);
+			for (tmp = str_vec.begin(); tmp != str_vec.end(); ++ tmp) {
+				if (holded_str.count(*tmp)) {
+					str << "hero number: " << *tmp << " is conflicted!";
+					return str.str();
+				}
+				number = lexical_cast_default<int>(*tmp);
+				if (holded_number.count(number)) {
+					str << "hero number: " << *tmp << " is invalid!";
+					return str.str();
+				}
+				holded_str.insert(*tmp);
+				holded_number.insert(number);
+			}
+		}
+	}
+	return "";
+}
+
+// check location:
+std::string tcompiler::check_data_bin(const config& data_cfg)
+{
+	std::stringstream str;
+
+	BOOST_FOREACH (const config& campaign, data_cfg.child_range("campaign")) {
+		if (!campaign.has_attribute("id")) {
+			str << "Compaign hasn't id!";
+			return str.str();
+		}
+	}
+	return "";
+}
+
+std::vector<std::string> tcompiler::tb_short_paths(const std::string& id, const config& cfg)
+{
+	std::stringstream ss;
+	std::vector<std::string> short_paths;
+
+	ss.str("");
+	ss << "data/core/terrain-graphics-" << id;
+	short_paths.push_back(ss.str());
+
+	binary_paths_manager paths_manager(cfg);
+	const std::vector<std::string>& paths = paths_manager.paths();
+	if (paths.empty()) {
+		ss.str("");
+		ss << "data/core/images/terrain-" << id;
+		short_paths.push_back(ss.str());
+	} else {
+		for (std::vector<std::string>::const_iterator it = paths.begin(); it != paths.end(); ++ it) {
+			ss.str("");
+			ss << *it << "/images/terrain-" << id;
+			short_paths.push_back(ss.str());
+		}
+	}
+	return short_paths;
+}
+
+tcompiler::tcompiler(bool force)
+	: campaigns_config_()
+	, tbs_config_()
+	, cache_(game_config::config_cache::instance())
+	, targets_()
+	, force_(force)
+	, input_files_()
+	, input_dirs_()
+{
+}
+
+bool tcompiler::load_targets(std::string& err)
+{
+	targets_.clear();
+	if (!is_directory(game_config::path + "/data")) {
+		err = game_config::path + " hasn't data directory";
+		return false;
+	}
+
+	try {
+		cache_.clear_defines();
+		const std::string campaigns_cfg = game_config::path + CAMPAIGNS_CFG_PATH;
+		if (file_exists(campaigns_cfg)) {
+			cache_.get_config(campaigns_cfg, campaigns_config_);
+		}
+		const std::string tb_cfg = game_config::path + "/data/tb.cfg";
+		if (file_exists(tb_cfg)) {
+			cache_.get_config(tb_cfg, tbs_config_);
+		}
+	} catch (game::error& e) {
+		err = e.message;
+		return false;
+	}
+
+	// same order and short paths as editor::get_wml2bin_desc_from_wml.
+	ttarget data(MAIN_DATA, BASENAME_DATA);
+	data.define = "CORE";
+	data.short_paths.push_back("data");
+	data.filter |= SKIP_SCENARIO_DIR | SKIP_GUI_DIR;
+	targets_.push_back(data);
+
+	ttarget gui(GUI, BASENAME_GUI);
+	gui.short_paths.push_back("data/gui");
+	targets_.push_back(gui);
+
+	ttarget language(LANGUAGE, BASENAME_LANGUAGE);
+	language.short_paths.push_back("data/languages");
+	targets_.push_back(language);
+
+	BOOST_FOREACH (const config& cfg, tbs_config_.child_range("tb")) {
+		ttarget tb(TB_DAT, terrain_builder::tb_dat_prefix + cfg["id"].str() + ".dat");
+		tb.id = cfg["id"].str();
+		tb.define = cfg["define"].str();
+		tb.short_paths = tb_short_paths(tb.id, cfg);
+		tb.filter = NO_FILTER;
+		// builder uses [game_config] of data.bin.
+		tb.after = 0;
+		targets_.push_back(tb);
+	}
+
+	BOOST_FOREACH (const config& cfg, campaigns_config_.child_range("campaign")) {
+		ttarget campaign(SCENARIO_DATA, "campaigns/" + cfg["id"].str() + ".bin");
+		campaign.id = cfg["id"].str();
+		campaign.define = cfg["define"].str();
+		campaign.short_paths.push_back("data/core");
+		campaign.short_paths.push_back("data/app-kingdom/campaigns/" + campaign.id);
+		campaign.filter |= SKIP_GUI_DIR | SKIP_INTERNAL_DIR | SKIP_BOOK;
+		targets_.push_back(campaign);
+	}
+	return true;
+}
+
+std::string tcompiler::output(const ttarget& target) const
+{
+	return game_config::path + "/xwml/" + target.bin;
+}
+
+std::string tcompiler::manifest_file(const ttarget& target) const
+{
+	// one cache is used by every data tree.
+	return get_cache_dir() + "/xwml/" + sha1_hash(output(target)).display() + ".cfg";
+}
+
+std::string tcompiler::target_key(const ttarget& target) const
+{
+	std::stringstream ss;
+	ss << manifest_version << " " << target.type << " " << target.id << " " << target.define;
+	return sha1_hash(ss.str()).display();
+}
+
+file_tree_checksum tcompiler::header_checksum(const ttarget& target) const
+{
+	file_tree_checksum checksum;
+	data_tree_checksum(target.short_paths, checksum, target.filter);
+
+	if (target.type == TB_DAT) {
+		struct stat st;
+		const std::string terrain_graphics_cfg = game_config::path + "/data/core/terrain-graphics-" + target.id + ".cfg";
+		if (::stat(terrain_graphics_cfg.c_str(), &st) != -1) {
+			if (st.st_mtime > checksum.modified) {
+				checksum.modified = st.st_mtime;
+			}
+			checksum.sum_size += st.st_size;
+			checksum.nfiles ++;
+		}
+	}
+	return checksum;
+}
+
+void tcompiler::record_input(const std::string& name, uint32_t is_file, void* ctx)
+{
+	tcompiler& compiler = *static_cast<tcompiler*>(ctx);
+	if (is_file) {
+		compiler.input_files_.insert(name);
+	} else {
+		compiler.input_dirs_.insert(name);
+	}
+}
+
+bool tcompiler::read_manifest(const ttarget& target, tmanifest& manifest) const
+{
+	const std::string file = manifest_file(target);
+	if (!file_exists(file)) {
+		return false;
+	}
+
+	config cfg;
+	try {
+		scoped_istream stream = istream_file(file);
+		read(cfg, *stream);
+	} catch (config::error&) {
+		return false;
+	}
+
+	manifest.key = cfg["key"].str();
+	manifest.bin_size = lexical_cast_default<int64_t>(cfg["bin_size"].str());
+	manifest.bin_modified = lexical_cast_default<time_t>(cfg["bin_modified"].str());
+	BOOST_FOREACH (const config& c, cfg.child_range("file")) {
+		tfile file;
+		file.name = c["name"].str();
+		file.size = lexical_cast_default<int64_t>(c["size"].str());
+		file.modified = lexical_cast_default<time_t>(c["modified"].str());
+		file.sha1 = c["sha1"].str();
+		manifest.files.push_back(file);
+	}
+	BOOST_FOREACH (const config& c, cfg.child_range("listing")) {
+		tlisting listing;
+		listing.name = c["name"].str();
+		listing.tree = c["tree"].to_bool();
+		listing.sha1 = c["sha1"].str();
+		manifest.listings.push_back(listing);
+	}
+	return true;
+}
+
+void tcompiler::write_manifest(const ttarget& target, tmanifest& manifest) const
+{
+	struct stat st;
+	if (::stat(output(target).c_str(), &st) == -1) {
+		return;
+	}
+	manifest.key = target_key(target);
+	manifest.bin_size = st.st_size;
+	manifest.bin_modified = st.st_mtime;
+
+	config cfg;
+	cfg["key"] = manifest.key;
+	cfg["bin_size"] = str_cast(manifest.bin_size);
+	cfg["bin_modified"] = str_cast(manifest.bin_modified);
+	for (std::vector<tfile>::const_iterator it = manifest.files.begin(); it != manifest.files.end(); ++ it) {
+		config& c = cfg.add_child("file");
+		c["name"] = it->name;
+		c["size"] = str_cast(it->size);
+		c["modified"] = str_cast(it->modified);
+		c["sha1"] = it->sha1;
+	}
+	for (std::vector<tlisting>::const_iterator it = manifest.listings.begin(); it != manifest.listings.end(); ++ it) {
+		config& c = cfg.add_child("listing");
+		c["name"] = it->name;
+		c["tree"] = it->tree;
+		c["sha1"] = it->sha1;
+	}
+
+	const std::string file = manifest_file(target);
+	create_directory_if_missing_recursive(directory_name(file));
+	std::stringstream ss;
+	write(ss, cfg);
+	write_file(file, ss.str());
+}
+
+void tcompiler::make_manifest(const ttarget& target, tmanifest& manifest) const
+{
+	manifest.files.clear();
+	manifest.listings.clear();
+
+	std::set<std::string> files = input_files_;
+	if (target.type == TB_DAT) {
+		files.insert(game_config::path + "/xwml/" + BASENAME_DATA);
+	}
+	for (std::set<std::string>::const_iterator it = files.begin(); it != files.end(); ++ it) {
+		struct stat st;
+		if (::stat(it->c_str(), &st) == -1) {
+			continue;
+		}
+		tfile file;
+		file.name = *it;
+		file.size = st.st_size;
+		file.modified = st.st_mtime;
+		file.sha1 = file_hash(*it);
+		manifest.files.push_back(file);
+	}
+
+	for (std::set<std::string>::const_iterator it = input_dirs_.begin(); it != input_dirs_.end(); ++ it) {
+		tlisting listing;
+		listing.name = *it;
+		listing.sha1 = listing_hash(*it, false);
+		manifest.listings.push_back(listing);
+	}
+	if (target.type == TB_DAT) {
+		for (std::vector<std::string>::const_iterator it = target.short_paths.begin(); it != target.short_paths.end(); ++ it) {
+			tlisting listing;
+			listing.name = *it;
+			listing.tree = true;
+			listing.sha1 = listing_hash(*it, true);
+			manifest.listings.push_back(listing);
+		}
+	}
+}
+
+std::string tcompiler::stale(const ttarget& target, tmanifest& manifest, bool& touched) const
+{
+	struct stat st;
+	if (::stat(output(target).c_str(), &st) == -1) {
+		return "no output";
+	}
+	if (!read_manifest(target, manifest)) {
+		return "no manifest";
+	}
+	if (manifest.key != target_key(target)) {
+		return "defines changed";
+	}
+	if (st.st_size != manifest.bin_size || st.st_mtime != manifest.bin_modified) {
+		return "output was modified";
+	}
+
+	for (std::vector<tlisting>::const_iterator it = manifest.listings.begin(); it != manifest.listings.end(); ++ it) {
+		if (listing_hash(it->name, it->tree) != it->sha1) {
+			return "files of " + it->name + " were added or removed";
+		}
+	}
+	for (std::vector<tfile>::iterator it = manifest.files.begin(); it != manifest.files.end(); ++ it) {
+		if (::stat(it->name.c_str(), &st) == -1) {
+			return it->name + " was removed";
+		}
+		if (st.st_size == it->size && st.st_mtime == it->modified) {
+			continue;
+		}
+		if (file_hash(it->name) != it->sha1) {
+			return it->name + " changed";
+		}
+		it->size = st.st_size;
+		it->modified = st.st_mtime;
+		touched = true;
+	}
+	return null_str;
+}
+
+bool tcompiler::compile(const ttarget& target, const file_tree_checksum& checksum, std::string& err)
+{
+	config tmpcfg, game_cfg;
+	const uint32_t nfiles = checksum.nfiles;
+	const uint32_t sum_size = checksum.sum_size;
+	const uint32_t modified = checksum.modified;
+
+	game_config::config_cache_transaction main_transaction;
+
+	try {
+		cache_.clear_defines();
+
+		if (target.type == TB_DAT) {
+			config data_cfg;
+			wml_config_from_file(game_config::path + "/xwml/" + BASENAME_DATA, data_cfg);
+			const config& data_game_cfg = data_cfg.child("game_config");
+			if (!data_game_cfg) {
+				err = std::string("Generate ") + target.bin + " must be after " + BASENAME_DATA + "!";
+				return false;
+			}
+			game_config::load_config(&data_game_cfg);
+
+			cache_.add_define(target.define);
+			cache_.get_config(game_config::path + "/data/tb.cfg", tmpcfg);
+
+			const config& tb_parsed_cfg = tmpcfg.find_child("tb", "id", target.id);
+			if (!tb_parsed_cfg) {
+				err = "tb.cfg hasn't [tb] of " + target.id;
+				return false;
+			}
+			binary_paths_manager paths_manager(tb_parsed_cfg);
+			terrain_builder(tb_parsed_cfg, nfiles, sum_size, modified);
+
+		} else if (target.type == SCENARIO_DATA) {
+			cache_.add_define(target.define);
+			cache_.get_config(game_config::path + "/data", game_cfg);
+
+			// extract [compaign_addon] block
+			config& refcfg = game_cfg.child("campaign_addon");
+			if (!refcfg) {
+				err = "<" + target.bin + "> hasn't [campaign_addon]";
+				return false;
+			}
+			BOOST_FOREACH (const config &i, game_cfg.child_range("textdomain")) {
+				refcfg.add_child("textdomain", i);
+			}
+
+			// check scenario config valid
+			BOOST_FOREACH (const config& scenario, refcfg.child_range("scenario")) {
+				std::string err_str = check_scenario_cfg(scenario);
+				if (!err_str.empty()) {
+					err = "<" + target.bin + ">" + err_str;
+					return false;
+				}
+			}
+
+			create_directory_if_missing_recursive(directory_name(output(target)));
+			wml_config_to_file(output(target), refcfg, nfiles, sum_size, modified);
+
+		} else if (target.type == GUI) {
+			// no pre-defined
+			cache_.get_config(game_config::path + "/data/gui", game_cfg);
+			wml_config_to_file(output(target), game_cfg, nfiles, sum_size, modified);
+
+		} else if (target.type == LANGUAGE) {
+			// no pre-defined
+			cache_.get_config(game_config::path + "/data/languages", game_cfg);
+			wml_config_to_file(output(target), game_cfg, nfiles, sum_size, modified);
+
+		} else {
+			// target.type == MAIN_DATA
+			cache_.add_define(target.define);
+			cache_.get_config(game_config::path + "/data", game_cfg);
+
+			std::string err_str = check_data_bin(game_cfg);
+			if (!err_str.empty()) {
+				err = "<" + target.bin + ">" + err_str;
+				return false;
+			}
+			wml_config_to_file(output(target), game_cfg, nfiles, sum_size, modified);
+		}
+	}
+	catch (game::error& e) {
+		err = e.message;
+		return false;
+	}
+	catch (twml_exception& e) {
+		err = e.dev_message.empty()? e.user_message: e.dev_message;
+		return false;
+	}
+	return file_exists(output(target));
+}
+
+int tcompiler::build(const ttarget& target, std::string& message)
+{
+	tmanifest manifest;
+	bool touched = false;
+
+	message = force_? "forced": stale(target, manifest, touched);
+	if (message.empty()) {
+		if (!touched) {
+			return UP_TO_DATE;
+		}
+		// content is same, refresh checksum in header so editor sees it synced.
+		const file_tree_checksum checksum = header_checksum(target);
+		if (wml_checksum_to_file(output(target), checksum.nfiles, checksum.sum_size, checksum.modified)) {
+			write_manifest(target, manifest);
+			return UP_TO_DATE;
+		}
+		// header cannot be refreshed, rebuild it.
+		message = "header of output cannot be refreshed";
+	}
+
+	const file_tree_checksum checksum = header_checksum(target);
+
+	input_files_.clear();
+	input_dirs_.clear();
+	{
+		set_increment_progress progress(record_input, this);
+		std::string err;
+		if (!compile(target, checksum, err)) {
+			message = err;
+			return FAILED;
+		}
+	}
+	make_manifest(target, manifest);
+	write_manifest(target, manifest);
+	return GENERATED;
+}
@@ -0,0 +1,157 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/** @file */
+
+#ifndef XWMLC_COMPILER_HPP_INCLUDED
+#define XWMLC_COMPILER_HPP_INCLUDED
+
+#include "config_cache.hpp"
+#include "config.hpp"
+#include "filesystem.hpp"
+
+#include <set>
+
+/**
+ * Generates binaries of <game_config::path>/xwml from WML of data tree without
+ * window, it is what editor::load_game_cfg does.
+ *
+ * Every output has a manifest in <cache>/xwml: files that were preprocessed
+ * with their size, modify time and sha1, and listings of directories that were
+ * included. Output is generated again only when content of one of them changed,
+ * or define set of output changed. A file that is only touched is hashed, but
+ * doesn't result to generate.
+ */
+class tcompiler
+{
+public:
+	// same values as editor::BIN_TYPE.
+	enum {MAIN_DATA, GUI, LANGUAGE, TB_DAT, SCENARIO_DATA};
+	enum {UP_TO_DATE, GENERATED, FAILED};
+
+	struct ttarget {
+		ttarget(int type, const std::string& bin)
+			: type(type)
+			, id()
+			, bin(bin)
+			, define()
+			, short_paths()
+			, filter(SKIP_MEDIA_DIR)
+			, after(-1)
+		{}
+
+		int type;
+		// id of tb or campaign, empty for others.
+		std::string id;
+		// relative to <game_config::path>/xwml.
+		std::string bin;
+		std::string define;
+		// where checksum in header of output is calculated, same as editor.
+		std::vector<std::string> short_paths;
+		int filter;
+		// index of target that must be generated before this, -1 if none.
+		int after;
+	};
+
+	static std::string check_scenario_cfg(const config& scenario_cfg);
+	static std::string check_mplayer_bin(const config& mplayer_cfg);
+	static std::string check_data_bin(const config& data_cfg);
+	static std::vector<std::string> tb_short_paths(const std::string& id, const config& cfg);
+
+	explicit tcompiler(bool force);
+
+	/**
+	 * read campaigns.cfg and tb.cfg, and form targets.
+	 * @return false if game_config::path isn't a data tree.
+	 */
+	bool load_targets(std::string& err);
+	const std::vector<ttarget>& targets() const { return targets_; }
+
+	/**
+	 * generate output of target if it is stale.
+	 * @param message why target is generated, or error if FAILED.
+	 */
+	int build(const ttarget& target, std::string& message);
+
+private:
+	struct tfile {
+		tfile()
+			: name()
+			, size(0)
+			, modified(0)
+			, sha1()
+		{}
+
+		std::string name;
+		int64_t size;
+		time_t modified;
+		std::string sha1;
+	};
+
+	struct tlisting {
+		tlisting()
+			: name()
+			, tree(false)
+			, sha1()
+		{}
+
+		std::string name;
+		// recursive, directories of media aren't skipped.
+		bool tree;
+		std::string sha1;
+	};
+
+	struct tmanifest {
+		tmanifest()
+			: key()
+			, bin_size(0)
+			, bin_modified(0)
+			, files()
+			, listings()
+		{}
+
+		std::string key;
+		int64_t bin_size;
+		time_t bin_modified;
+		std::vector<tfile> files;
+		std::vector<tlisting> listings;
+	};
+
+	static void record_input(const std::string& name, uint32_t is_file, void* ctx);
+
+	std::string output(const ttarget& target) const;
+	std::string manifest_file(const ttarget& target) const;
+	std::string target_key(const ttarget& target) const;
+	file_tree_checksum header_checksum(const ttarget& target) const;
+
+	/** @return empty if output is valid, else why it must be generated. */
+	std::string stale(const ttarget& target, tmanifest& manifest, bool& touched) const;
+	bool compile(const ttarget& target, const file_tree_checksum& checksum, std::string& err);
+	void make_manifest(const ttarget& target, tmanifest& manifest) const;
+
+	bool read_manifest(const ttarget& target, tmanifest& manifest) const;
+	void write_manifest(const ttarget& target, tmanifest& manifest) const;
+
+	config campaigns_config_;
+	config tbs_config_;
+	game_config::config_cache& cache_;
+	std::vector<ttarget> targets_;
+	bool force_;
+
+	// files and directories that preprocessor opened during compile.
+	std::set<std::string> input_files_;
+	std::set<std::string> input_dirs_;
+};
+
+#endif
@@ -0,0 +1,295 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/**
+ * @file
+ * Command line compiler of xwml binaries: data.bin, gui.bin, language.bin,
+ * campaigns/<id>.bin and tb-<id>.dat.
+ *
+ * Every output is generated in its own process, so outputs that don't depend
+ * on each other are generated in parallel. Only tb-<id>.dat waits data.bin.
+ */
+
+#include "global.hpp"
+
+#include "xwmlc/compiler.hpp"
+#include "rose_config.hpp"
+#include "filesystem.hpp"
+#include "log.hpp"
+#include "serialization/preprocessor.hpp"
+
+#include "SDL_timer.h"
+#include <iomanip>
+#include <iostream>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+enum {PENDING, RUNNING, DONE};
+
+struct tjob {
+	tjob(const tcompiler::ttarget& target)
+		: target(&target)
+		, state(PENDING)
+		, result(tcompiler::FAILED)
+		, start(0)
+	{}
+
+	const tcompiler::ttarget* target;
+	int state;
+	int result;
+	uint32_t start;
+};
+
+const char* result_str(int result)
+{
+	if (result == tcompiler::UP_TO_DATE) {
+		return "up to date";
+	} else if (result == tcompiler::GENERATED) {
+		return "generated";
+	}
+	return "FAILED";
+}
+
+void report(const tjob& job, const std::string& message)
+{
+	std::stringstream ss;
+	ss << std::setw(32) << std::left << job.target->bin << std::setw(12) << result_str(job.result)
+		<< std::setw(8) << std::right << (SDL_GetTicks() - job.start) << " ms";
+	if (!message.empty()) {
+		ss << "  (" << message << ")";
+	}
+	ss << "\n";
+	// children write at the same time, one write per line.
+	std::cout << ss.str() << std::flush;
+}
+
+// job can start when job it depends on is generated or up to date.
+int ready(const std::vector<tjob>& jobs, const std::vector<int>& indexes, const tjob& job)
+{
+	if (job.target->after < 0 || indexes[job.target->after] < 0) {
+		return 1;
+	}
+	const tjob& after = jobs[indexes[job.target->after]];
+	if (after.state != DONE) {
+		return 0;
+	}
+	return after.result == tcompiler::FAILED? -1: 1;
+}
+
+int run_jobs(tcompiler& compiler, std::vector<tjob>& jobs, const std::vector<int>& indexes, int parallel)
+{
+	int failed = 0;
+	size_t done = 0;
+
+#ifndef _WIN32
+	std::map<pid_t, size_t> running;
+#endif
+
+	while (done < jobs.size()) {
+		bool started = false;
+		for (size_t n = 0; n < jobs.size(); n ++) {
+			tjob& job = jobs[n];
+			if (job.state != PENDING) {
+				continue;
+			}
+			const int r = ready(jobs, indexes, job);
+			if (r < 0) {
+				job.state = DONE;
+				job.start = SDL_GetTicks();
+				report(job, "skipped, it depends on failed output");
+				failed ++;
+				done ++;
+				continue;
+			} else if (!r) {
+				continue;
+			}
+			job.start = SDL_GetTicks();
+
+#ifndef _WIN32
+			if (parallel > 1) {
+				if ((int)running.size() >= parallel) {
+					break;
+				}
+				std::cout << std::flush;
+				const pid_t pid = fork();
+				if (pid == 0) {
+					std::string message;
+					job.result = compiler.build(*job.target, message);
+					report(job, message);
+					// don't run destructors of parent's objects.
+					_exit(job.result);
+				} else if (pid > 0) {
+					job.state = RUNNING;
+					running.insert(std::make_pair(pid, n));
+					started = true;
+					continue;
+				}
+				std::cerr << "fork failed, generate " << job.target->bin << " in this process\n";
+			}
+#endif
+			std::string message;
+			job.result = compiler.build(*job.target, message);
+			job.state = DONE;
+			report(job, message);
+			if (job.result == tcompiler::FAILED) {
+				failed ++;
+			}
+			done ++;
+			started = true;
+		}
+
+#ifndef _WIN32
+		if (!running.empty()) {
+			int status;
+			const pid_t pid = waitpid(-1, &status, 0);
+			std::map<pid_t, size_t>::iterator it = running.find(pid);
+			if (it != running.end()) {
+				tjob& job = jobs[it->second];
+				job.state = DONE;
+				job.result = WIFEXITED(status)? WEXITSTATUS(status): tcompiler::FAILED;
+				if (!WIFEXITED(status)) {
+					report(job, "process was killed");
+				}
+				if (job.result == tcompiler::FAILED) {
+					failed ++;
+				}
+				done ++;
+				running.erase(it);
+			}
+			continue;
+		}
+#endif
+		if (!started) {
+			// nothing can start, and nothing is running.
+			break;
+		}
+	}
+	return failed;
+}
+
+void usage(const char* program)
+{
+	std::cout << "usage: " << program << " [-fhl] [-d path] [-j n] [output...]\n"
+		<< "  -d, --data <path>          Data tree that has data/ and xwml/ (default: current directory).\n"
+		<< "  -f, --force                Generates outputs even if nothing changed.\n"
+		<< "  -h, --help                 Shows this usage message.\n"
+		<< "  -j, --jobs <n>             Generates up to n outputs at the same time (default: 1).\n"
+		<< "  -l, --list                 Lists outputs of data tree, then exits.\n"
+		<< "  --no-cache                 Doesn't use preprocessor cache.\n"
+		<< "  output                     data.bin, gui.bin, language.bin, tb-<id>.dat or campaigns/<id>.bin.\n"
+		<< "                             All outputs if none is given.\n";
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	bool force = false;
+	bool list = false;
+	bool cache = true;
+	int parallel = 1;
+	std::set<std::string> names;
+
+	game_config::path = get_cwd();
+
+	for (int arg = 1; arg != argc; ++ arg) {
+		const std::string val(argv[arg]);
+		if (val.empty()) {
+			continue;
+		}
+
+		if ((val == "--data" || val == "-d") && arg + 1 != argc) {
+			game_config::path = normalize_path(argv[++ arg]);
+		} else if (val == "--force" || val == "-f") {
+			force = true;
+		} else if ((val == "--jobs" || val == "-j") && arg + 1 != argc) {
+			parallel = atoi(argv[++ arg]);
+			if (parallel < 1) {
+				parallel = 1;
+			}
+		} else if (val == "--list" || val == "-l") {
+			list = true;
+		} else if (val == "--no-cache") {
+			cache = false;
+		} else if (val == "--help" || val == "-h") {
+			usage(argv[0]);
+			return 0;
+		} else if (val[0] == '-') {
+			std::cerr << "unknown option: " << val << "\n";
+			return 2;
+		} else {
+			names.insert(val);
+		}
+	}
+
+	set_preferences_dir("kingdom");
+	game_config::init("editor", "Rose", "#rose", false, true);
+	if (cache) {
+		set_preprocessor_cache(get_cache_dir() + "/preprocessor");
+	}
+
+	tcompiler compiler(force);
+	std::string err;
+	if (!compiler.load_targets(err)) {
+		std::cerr << err << "\n";
+		return 2;
+	}
+	const std::vector<tcompiler::ttarget>& targets = compiler.targets();
+
+	if (list) {
+		for (std::vector<tcompiler::ttarget>::const_iterator it = targets.begin(); it != targets.end(); ++ it) {
+			std::cout << it->bin << "\n";
+		}
+		return 0;
+	}
+
+	// index of target in jobs, -1 if it isn't generated.
+	std::vector<int> indexes(targets.size(), -1);
+	std::vector<tjob> jobs;
+	std::set<std::string> unknown = names;
+	for (size_t n = 0; n < targets.size(); n ++) {
+		const tcompiler::ttarget& target = targets[n];
+		if (!names.empty() && !names.count(target.bin)) {
+			continue;
+		}
+		unknown.erase(target.bin);
+		indexes[n] = jobs.size();
+		jobs.push_back(tjob(target));
+	}
+	for (std::set<std::string>::const_iterator it = unknown.begin(); it != unknown.end(); ++ it) {
+		std::cerr << "unknown output: " << *it << ", --list shows outputs.\n";
+		return 2;
+	}
+
+	create_directory_if_missing_recursive(game_config::path + "/xwml/campaigns");
+
+	const uint32_t start = SDL_GetTicks();
+	const int failed = run_jobs(compiler, jobs, indexes, parallel);
+
+	int generated = 0;
+	for (std::vector<tjob>::const_iterator it = jobs.begin(); it != jobs.end(); ++ it) {
+		if (it->result == tcompiler::GENERATED) {
+			generated ++;
+		}
+	}
+	std::cout << jobs.size() << " outputs, " << generated << " generated, " << failed << " failed, "
+		<< (SDL_GetTicks() - start) << " ms\n";
+
+	return failed? 1: 0;
+}
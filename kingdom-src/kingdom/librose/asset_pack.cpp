@@ -0,0 +1,407 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/**
+ * @file
+ * Packed assets that are mapped to memory.
+ */
+
+#include "global.hpp"
+
+#include "asset_pack.hpp"
+#include "filesystem.hpp"
+#include "log.hpp"
+#include "rose_config.hpp"
+#include "serialization/string_utils.hpp"
+#include "thread.hpp"
+#include "wml_exception.hpp"
+
+#include <cstring>
+#include <zlib.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+static lg::log_domain log_filesystem("filesystem");
+#define ERR_FS LOG_STREAM(err, log_filesystem)
+
+namespace asset_pack {
+
+namespace {
+
+const uint32_t pack_fourcc = mmioFOURCC('A', 'P', 'K', '1');
+
+// crc covers directory, names and roots, payloads aren't checked.
+struct theader {
+	uint32_t fourcc;
+	uint32_t size;
+	uint32_t crc;
+	uint32_t entries;
+	uint32_t directory;
+	uint32_t names;
+	uint32_t roots;
+	uint32_t roots_size;
+};
+
+std::string pack_file;
+const uint8_t* base = NULL;
+uint32_t mapped_size = 0;
+#ifdef _WIN32
+HANDLE mapping = NULL;
+#endif
+
+const tentry* directory = NULL;
+uint32_t entries = 0;
+const char* names = NULL;
+// packed binary paths, game_config::path is prefixed.
+std::vector<std::string> roots;
+
+// location() is called by background threads too, i.e. prewarm of unit types.
+threading::mutex stats_mutex;
+
+int compare(const tentry& entry, const char* name, uint32_t size)
+{
+	const int ret = memcmp(names + entry.name, name, std::min(entry.name_size, size));
+	if (ret) {
+		return ret;
+	}
+	return entry.name_size < size? -1: (entry.name_size > size? 1: 0);
+}
+
+const tentry* find_name(const std::string& name)
+{
+	uint32_t first = 0, last = entries;
+	while (first < last) {
+		const uint32_t mid = first + (last - first) / 2;
+		const int ret = compare(directory[mid], name.c_str(), name.size());
+		if (!ret) {
+			return directory + mid;
+		} else if (ret < 0) {
+			first = mid + 1;
+		} else {
+			last = mid;
+		}
+	}
+	return NULL;
+}
+
+bool verify()
+{
+	theader header;
+	memcpy(&header, base, sizeof(header));
+
+	if (header.fourcc != pack_fourcc || header.size != mapped_size) {
+		return false;
+	}
+	if (header.directory < sizeof(header) || header.directory % sizeof(uint32_t) || header.directory > header.size) {
+		return false;
+	}
+	if (header.entries > (header.size - header.directory) / sizeof(tentry)) {
+		return false;
+	}
+	if (header.names != header.directory + header.entries * sizeof(tentry) || header.roots < header.names || header.roots > header.size || header.roots_size != header.size - header.roots) {
+		return false;
+	}
+	if (header.crc != crc32(crc32(0, NULL, 0), (const Bytef*)base + header.directory, header.size - header.directory)) {
+		return false;
+	}
+
+	directory = (const tentry*)(base + header.directory);
+	entries = header.entries;
+	names = (const char*)base + header.names;
+
+	const std::vector<std::string> vstr = utils::split(std::string((const char*)base + header.roots, header.roots_size), '\n');
+	for (std::vector<std::string>::const_iterator it = vstr.begin(); it != vstr.end(); ++ it) {
+		roots.push_back(game_config::path + "/" + *it);
+	}
+
+	const uint32_t names_size = header.roots - header.names;
+	for (uint32_t n = 0; n < entries; n ++) {
+		const tentry& entry = directory[n];
+		if (entry.name > names_size || entry.name_size > names_size - entry.name) {
+			return false;
+		}
+		if (entry.offset < sizeof(header) || entry.offset > header.directory || entry.size > header.directory - entry.offset) {
+			return false;
+		}
+		if (entry.root >= roots.size()) {
+			return false;
+		}
+		if (entry.format == PIXELS) {
+			if ((uint64_t)entry.w * entry.h * 4 != entry.size) {
+				return false;
+			}
+		} else if (entry.format != RAW) {
+			return false;
+		}
+		if (n && compare(directory[n - 1], names + entry.name, entry.name_size) >= 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+}
+
+bool open(const std::string& file)
+{
+	close();
+
+	uint32_t fsizelow, fsizehigh;
+	void* mem = NULL;
+	{
+		tfopen_lock lock(file, GENERIC_READ, OPEN_EXISTING);
+		if (!lock.valid()) {
+			return false;
+		}
+		posix_fsize(lock.fp, fsizelow, fsizehigh);
+		if (fsizehigh || fsizelow < sizeof(theader)) {
+			ERR_FS << "asset pack " << file << " is corrupt, use loose files\n";
+			return false;
+		}
+		// mapping is still valid after file is closed.
+#ifdef _WIN32
+		mapping = CreateFileMapping(lock.fp, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping) {
+			mem = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+#else
+		mem = mmap(NULL, fsizelow, PROT_READ, MAP_SHARED, fileno(lock.fp), 0);
+		if (mem == MAP_FAILED) {
+			mem = NULL;
+		}
+#endif
+	}
+	base = (const uint8_t*)mem;
+	mapped_size = fsizelow;
+	if (!base) {
+		ERR_FS << "can not map asset pack " << file << ", use loose files\n";
+		close();
+		return false;
+	}
+	if (!verify()) {
+		ERR_FS << "asset pack " << file << " is corrupt, use loose files\n";
+		close();
+		return false;
+	}
+	pack_file = file;
+
+	posix_print("asset pack %s, %u assets, %u KB\n", file.c_str(), entries, mapped_size / 1024);
+	return true;
+}
+
+void close()
+{
+	if (base) {
+		posix_print("asset pack, %i packed locations, %i loose locations\n", stats().packed, stats().loose);
+#ifdef _WIN32
+		UnmapViewOfFile(base);
+#else
+		munmap((void*)base, mapped_size);
+#endif
+	}
+#ifdef _WIN32
+	if (mapping) {
+		CloseHandle(mapping);
+		mapping = NULL;
+	}
+#endif
+	base = NULL;
+	mapped_size = 0;
+	directory = NULL;
+	entries = 0;
+	names = NULL;
+	roots.clear();
+	pack_file.clear();
+}
+
+std::string location(const std::string& type, const std::string& filename)
+{
+	const std::string loose = get_binary_file_location(type, filename);
+	if (!base) {
+		return loose;
+	}
+
+	// loose file in a binary path that isn't packed overrides packed asset.
+	bool packed_root = loose.empty();
+	for (std::vector<std::string>::const_iterator it = roots.begin(); !packed_root && it != roots.end(); ++ it) {
+		packed_root = !loose.compare(0, it->size(), *it);
+	}
+	if (packed_root) {
+		const std::string name = type + "/" + filename;
+		if (find_name(name)) {
+			const threading::lock lock(stats_mutex);
+			stats().packed ++;
+			return pack_file + "/" + name;
+		}
+	}
+	if (!loose.empty()) {
+		const threading::lock lock(stats_mutex);
+		stats().loose ++;
+	}
+	return loose;
+}
+
+const tentry* find(const std::string& location)
+{
+	if (!base || location.size() <= pack_file.size() || location[pack_file.size()] != '/' || location.compare(0, pack_file.size(), pack_file)) {
+		return NULL;
+	}
+	return find_name(location.substr(pack_file.size() + 1));
+}
+
+std::string disk_location(const std::string& location)
+{
+	const tentry* entry = find(location);
+	if (!entry) {
+		return location;
+	}
+	return roots[entry->root] + location.substr(pack_file.size() + 1);
+}
+
+const uint8_t* data(const tentry& entry)
+{
+	return base + entry.offset;
+}
+
+SDL_RWops* open_rw(const std::string& location)
+{
+	const tentry* entry = find(location);
+	if (entry) {
+		return SDL_RWFromConstMem(data(*entry), entry->size);
+	}
+	return SDL_RWFromFile(location.c_str(), "rb");
+}
+
+tstats& stats()
+{
+	static tstats s;
+	return s;
+}
+
+twriter::twriter(const std::string& file)
+	: file_(file)
+	, tmp_(file + ".tmp")
+	, fp_(INVALID_FILE)
+	, offset_(sizeof(theader))
+	, entries_()
+	, names_()
+	, last_()
+{
+	posix_fopen(tmp_.c_str(), GENERIC_WRITE, CREATE_ALWAYS, fp_);
+	if (fp_ == INVALID_FILE) {
+		ERR_FS << "can not write asset pack " << tmp_ << "\n";
+		return;
+	}
+	// header is written by finish().
+	const theader header = {0};
+	if (!write(&header, sizeof(header))) {
+		posix_fclose(fp_);
+		fp_ = INVALID_FILE;
+	}
+}
+
+twriter::~twriter()
+{
+	if (fp_ != INVALID_FILE) {
+		// not finished.
+		posix_fclose(fp_);
+		remove(tmp_.c_str());
+	}
+}
+
+bool twriter::write(const void* data, uint32_t size)
+{
+	uint32_t bytertd;
+	posix_fwrite(fp_, data, size, bytertd);
+	return bytertd == size;
+}
+
+bool twriter::add(const std::string& name, uint32_t root, const void* data, uint32_t size, uint32_t format, uint32_t w, uint32_t h)
+{
+	VALIDATE(fp_ != INVALID_FILE, null_str);
+	VALIDATE(entries_.empty() || name > last_, "asset_pack::twriter, assets must be added in order of name!");
+
+	tentry entry;
+	entry.name = names_.size();
+	entry.name_size = name.size();
+	entry.offset = offset_;
+	entry.size = size;
+	entry.format = format;
+	entry.w = w;
+	entry.h = h;
+	entry.root = root;
+
+	// payloads are aligned, pixels can be copied as uint32_t.
+	const char pad[sizeof(uint32_t)] = {0};
+	const uint32_t padding = (sizeof(uint32_t) - size % sizeof(uint32_t)) % sizeof(uint32_t);
+	if (!write(data, size) || !write(pad, padding)) {
+		return false;
+	}
+	offset_ += size + padding;
+
+	entries_.push_back(entry);
+	names_.append(name);
+	last_ = name;
+	return true;
+}
+
+bool twriter::finish(const std::vector<std::string>& roots)
+{
+	VALIDATE(fp_ != INVALID_FILE, null_str);
+
+	std::string tail;
+	if (!entries_.empty()) {
+		tail.assign((const char*)&entries_[0], entries_.size() * sizeof(tentry));
+	}
+	tail.append(names_);
+	const size_t roots_offset = tail.size();
+	for (std::vector<std::string>::const_iterator it = roots.begin(); it != roots.end(); ++ it) {
+		tail.append(*it).append("\n");
+	}
+
+	theader header;
+	header.fourcc = pack_fourcc;
+	header.entries = entries_.size();
+	header.directory = offset_;
+	header.names = offset_ + entries_.size() * sizeof(tentry);
+	header.roots = offset_ + roots_offset;
+	header.roots_size = tail.size() - roots_offset;
+	header.size = offset_ + tail.size();
+	header.crc = crc32(crc32(0, NULL, 0), (const Bytef*)tail.data(), tail.size());
+
+	bool ok = write(tail.data(), tail.size());
+	if (ok) {
+		posix_fseek(fp_, 0, 0);
+		ok = write(&header, sizeof(header));
+	}
+	posix_fclose(fp_);
+	fp_ = INVALID_FILE;
+	if (!ok) {
+		ERR_FS << "can not write asset pack " << tmp_ << "\n";
+		remove(tmp_.c_str());
+		return false;
+	}
+
+	// rename() doesn't replace existing file on windows.
+	remove(file_.c_str());
+	if (rename(tmp_.c_str(), file_.c_str())) {
+		ERR_FS << "can not rename " << tmp_ << " to " << file_ << "\n";
+		return false;
+	}
+	return true;
+}
+
+}
@@ -0,0 +1,137 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/** @file */
+
+#ifndef LIBROSE_ASSET_PACK_HPP_INCLUDED
+#define LIBROSE_ASSET_PACK_HPP_INCLUDED
+
+#include "posix.h"
+
+#include "SDL_rwops.h"
+#include <string>
+#include <vector>
+
+/**
+ * Images, sounds and music of some binary paths packed in one file, that is
+ * mapped to memory. Loading a packed asset doesn't open or stat a file.
+ *
+ * Name of asset is <type>/<filename>, i.e. images/units/archer.png. It is
+ * packed as file's content, or an image as pixels of neutral surface, that
+ * are copied to surface without decoding.
+ *
+ * Pack is optional. Loose file in a binary path that isn't packed, i.e. user
+ * data directory or add-on, is used instead of packed one, so mods still
+ * override it. Asset that isn't packed is read from loose file.
+ */
+namespace asset_pack {
+
+/** pack in data directory. */
+#define ASSET_PACK_FILE		"assets.pak"
+
+enum {RAW, PIXELS};
+
+// file is header, payloads, directory, names and roots. Directory is sorted by name.
+struct tentry {
+	// offset of name in names, name isn't null-terminated.
+	uint32_t name;
+	uint32_t name_size;
+	// offset of payload in file.
+	uint32_t offset;
+	uint32_t size;
+	uint32_t format;
+	// size of PIXELS, payload is w * h of neutral pixels.
+	uint32_t w;
+	uint32_t h;
+	// index of binary path in roots, that asset is packed from.
+	uint32_t root;
+};
+
+/**
+ * map file to memory.
+ * @return false if there is no file or it is corrupt, assets are read from loose files.
+ */
+bool open(const std::string& file);
+void close();
+
+/**
+ * location of filename of type, like get_binary_file_location(). Location of
+ * packed asset is <pack>/<type>/<filename>, it isn't a file on disk.
+ * @return empty if there is neither packed asset nor loose file.
+ */
+std::string location(const std::string& type, const std::string& filename);
+
+/** @return entry of packed location, NULL if location is loose file. */
+const tentry* find(const std::string& location);
+
+/**
+ * file that packed location is packed from, i.e. to compare it with paths of
+ * data tree. File may not be on disk. Loose location is returned as it is.
+ */
+std::string disk_location(const std::string& location);
+
+const uint8_t* data(const tentry& entry);
+
+/** read packed location from memory, or loose file. NULL if it can't be opened. */
+SDL_RWops* open_rw(const std::string& location);
+
+struct tstats {
+	tstats()
+		: packed(0)
+		, loose(0)
+	{}
+
+	// locations that are found in pack, and found in loose files.
+	int packed;
+	int loose;
+};
+
+tstats& stats();
+
+/**
+ * write pack. Assets must be added in order of name, a name once.
+ */
+class twriter
+{
+public:
+	explicit twriter(const std::string& file);
+	~twriter();
+
+	bool valid() const { return fp_ != INVALID_FILE; }
+
+	/** @param root index of binary path in roots of finish(), that asset is read from. */
+	bool add(const std::string& name, uint32_t root, const void* data, uint32_t size, uint32_t format = RAW, uint32_t w = 0, uint32_t h = 0);
+
+	/**
+	 * write directory and header, pack can't be used before it.
+	 * @param roots packed binary paths, relative to data directory, i.e. data/core/.
+	 */
+	bool finish(const std::vector<std::string>& roots);
+
+private:
+	bool write(const void* data, uint32_t size);
+
+	std::string file_;
+	// written to temporary file, game may map file at the same time.
+	std::string tmp_;
+	posix_file_t fp_;
+	uint32_t offset_;
+	std::vector<tentry> entries_;
+	std::string names_;
+	std::string last_;
+};
+
+}
+
+#endif
@@ -15,6 +15,7 @@
 #define GETTEXT_DOMAIN "rose-lib"
 
 #include "base_instance.hpp"
+#include "asset_pack.hpp"
 #include "gettext.hpp"
 #include "builder.hpp"
 #include "language.hpp"
@@ -22,6 +23,7 @@
 #include "loadscreen.hpp"
 #include "cursor.hpp"
 #include "map.hpp"
+#include "task_graph.hpp"
 #include "gui/dialogs/message.hpp"
 #include "gui/dialogs/language_selection.hpp"
 #include "gui/dialogs/combo_box.hpp"
@@ -29,6 +31,8 @@
 #include <iostream>
 #include <clocale>
 
+#include <boost/bind.hpp>
+
 base_instance* instance = NULL;
 
 void base_instance::regenerate_heros(hero_map& heros, bool allow_empty)
@@ -90,6 +94,7 @@ base_instance::base_instance(int argc, char** argv, int sample_rate, size_t soun
 	, game_config_core_()
 	, old_defines_map_()
 	, cache_(game_config::config_cache::instance())
+	, load_threads_(0)
 {
 	// Sounds don't sound good on Windows unless the buffer size is 4k,
 	// but this seems to cause crashes on other systems...
@@ -102,6 +107,7 @@ base_instance::base_instance(int argc, char** argv, int sample_rate, size_t soun
 
 	bool no_music = false;
 	bool no_sound = false;
+	bool no_asset_pack = false;
 
 	// if allocate static, iOS may be not align 4! 
 	// it necessary to ensure align great equal than 4.
@@ -129,6 +135,13 @@ base_instance::base_instance(int argc, char** argv, int sample_rate, size_t soun
 		if (val == "--config-dir") {
 			if (argc <= ++ arg_)
 				break;
+		} else if (val == "--load-threads") {
+			if (argc <= ++ arg_)
+				break;
+			load_threads_ = lexical_cast_default<int>(argv[arg_], 0);
+		} else if (val == "--no-asset-pack") {
+			// use loose files only, i.e. when art is edited.
+			no_asset_pack = true;
 		} else {
 			std::cerr << "Overriding data directory with " << val << std::endl;
 #ifdef _WIN32
@@ -178,6 +191,10 @@ base_instance::base_instance(int argc, char** argv, int sample_rate, size_t soun
 	font_manager_.update_font_path();
 	heros_.set_path(game_config::path);
 
+	if (!no_asset_pack) {
+		asset_pack::open(game_config::path + "/" + ASSET_PACK_FILE);
+	}
+
 #if defined(_WIN32) && defined(_DEBUG)
 	// sound::init_sound make no memory leak output.
 	// By this time, I doesn't find what result it, to easy, don't call sound::init_sound. 
@@ -219,6 +236,8 @@ base_instance::~base_instance()
 	}
 	terrain_builder::release_heap();
 	sound::close_sound();
+	// music is streamed from pack, close it after music is freed.
+	asset_pack::close();
 
 	clear_anims();
 }
@@ -356,6 +375,23 @@ bool base_instance::init_config(const bool force)
 
 #define BASENAME_DATA		"data.bin"
 
+void base_instance::read_data_bin(config& cfg)
+{
+	wml_config_from_file(game_config::path + "/xwml/" + BASENAME_DATA, cfg);
+}
+
+void base_instance::fill_unit_anims(const config& cfg)
+{
+	anim2::fill_anims(cfg.child("units"));
+}
+
+void base_instance::fill_terrain_types(const config& cfg)
+{
+	BOOST_FOREACH (const config &t, cfg.child_range("terrain_type")) {
+		gamemap::terrain_types.add_child("terrain_type", t);
+	}
+}
+
 void base_instance::load_game_cfg(const bool force)
 {
 	// make sure that 'debug mode' symbol is set if command line parameter is selected
@@ -383,8 +419,7 @@ void base_instance::load_game_cfg(const bool force)
 		game_config::config_cache_transaction main_transaction;
 
 		config tmpcfg;
-		
-		wml_config_from_file(game_config::path + "/xwml/" + BASENAME_DATA, game_config_);
+
 		// once only duration one game running.
 		// game_config_.clear_children("card");
 		// game_config_.clear_children("card_anim");
@@ -392,13 +427,17 @@ void base_instance::load_game_cfg(const bool force)
 		// set_unit_data(game_config_.child("units"));
 		// game_config_.clear_children("units");
 
-		anim2::fill_anims(game_config_.child("units"));
-	
+		ttask_graph graph;
+		const int data = graph.add("data.bin", boost::bind(&base_instance::read_data_bin, boost::ref(game_config_)));
+		const int anims = graph.add("animations", boost::bind(&base_instance::fill_unit_anims, boost::cref(game_config_)));
+		graph.after(anims, data);
+		const int terrains = graph.add("terrain types", boost::bind(&base_instance::fill_terrain_types, boost::cref(game_config_)));
+		graph.after(terrains, data);
+		graph.run(load_threads_);
+
+		std::cerr << "\nload game config, ";
+		graph.timeline(std::cerr);
 
-		const config::const_child_itors& terrains = game_config_.child_range("terrain_type");
-		BOOST_FOREACH (const config &t, terrains) {
-			gamemap::terrain_types.add_child("terrain_type", t);
-		}
 		game_config_.clear_children("terrain_type");
 
 		// save this to game_config_core_
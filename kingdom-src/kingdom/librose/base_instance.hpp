@@ -40,6 +40,8 @@ public:
 	display& disp();
 	const config& game_config() const { return game_config_; }
 	bool is_loading() { return false; }
+	// 1 means load in caller's thread only, without background threads.
+	int load_threads() const { return load_threads_; }
 
 	bool change_language();
 	virtual int show_preferences_dialog(display& disp, bool first);
@@ -61,6 +63,11 @@ protected:
 	virtual void load_config2(const config& cfg) {}
 	virtual void load_game_cfg(const bool force);
 
+	// stages of load_game_cfg, they run in a ttask_graph.
+	static void read_data_bin(config& cfg);
+	static void fill_unit_anims(const config& cfg);
+	static void fill_terrain_types(const config& cfg);
+
 private:
 	virtual void app_init_locale(const std::string& intl_dir) {}
 
@@ -87,6 +94,8 @@ protected:
 	config game_config_core_;
 	preproc_map old_defines_map_;
 	game_config::config_cache& cache_;
+	// threads that load game config, 0 is number of cpus. --load-threads.
+	int load_threads_;
 
 	std::map<int, animation*> anims_;
 	std::multimap<std::string, const config> utype_anim_tpls_;
@@ -184,7 +184,6 @@ terrain_builder::terrain_builder(const config& cfg, uint32_t nfiles, uint32_t su
 {
 	const std::string& id = cfg["id"].str();
 	image::terrain_prefix = game_config::terrain::form_img_prefix(id);
-	image::precache_file_existence(image::terrain_prefix);
 	const std::string offmap_image = "off-map/alpha.png";
 
 	release_heap();
@@ -219,8 +218,6 @@ terrain_builder::terrain_builder(const std::string& id, const gamemap* m)
 		image::switch_tile(id);
 	}
 
-	image::precache_file_existence(image::terrain_prefix);
-
 	uint32_t start = SDL_GetTicks();
 
 	if (!building_rules_) {
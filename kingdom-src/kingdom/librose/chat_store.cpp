@@ -0,0 +1,919 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/**
+ * @file
+ * Segmented, append-only chat history.
+ */
+
+#include "global.hpp"
+
+#include "chat_store.hpp"
+#include "filesystem.hpp"
+#include "gettext.hpp"
+#include "lobby.hpp"
+#include "log.hpp"
+#include "util.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <zlib.h>
+
+static lg::log_domain log_chat_store("chat_store");
+#define ERR_CHAT LOG_STREAM(err, log_chat_store)
+#define LOG_CHAT LOG_STREAM(info, log_chat_store)
+
+namespace chat_logs {
+
+namespace {
+
+const uint32_t segment_fourcc = mmioFOURCC('C', 'L', 'G', '0');
+const uint32_t index_fourcc = mmioFOURCC('C', 'I', 'X', '0');
+
+struct tsegment_header {
+	uint32_t fourcc;
+	int id;
+	uint64_t created;
+};
+
+// crc covers from msg_size to end of message.
+struct trecord_header {
+	uint32_t crc;
+	uint32_t msg_size;
+	uint64_t t;
+	uint16_t peer_size;
+	uint16_t nick_size;
+	uint32_t reserve;
+};
+
+// crc covers everything after header.
+struct tindex_header {
+	uint32_t fourcc;
+	uint32_t crc;
+	uint32_t size;
+	int records;
+	uint64_t from;
+	uint64_t to;
+	int peers;
+	uint32_t reserve;
+};
+
+// followed by name and count offsets.
+struct tindex_peer {
+	uint16_t name_size;
+	uint16_t reserve;
+	int count;
+};
+
+const int segment_header_size = sizeof(tsegment_header);
+const int record_header_size = sizeof(trecord_header);
+const int day_seconds = 24 * 3600;
+
+uint32_t record_crc(const char* record, uint32_t size)
+{
+	return crc32(crc32(0, NULL, 0), (const Bytef*)record + sizeof(uint32_t), size - sizeof(uint32_t));
+}
+
+/**
+ * check record at pos of data.
+ * @return size of record, 0 if it is torn or corrupt.
+ */
+uint32_t parse_record(const char* data, uint32_t size, uint32_t pos, trecord_header& header)
+{
+	if (pos + record_header_size > size) {
+		return 0;
+	}
+	memcpy(&header, data + pos, record_header_size);
+	if (!header.peer_size || header.msg_size > size) {
+		return 0;
+	}
+	const uint32_t record_size = record_header_size + header.peer_size + header.nick_size + header.msg_size;
+	if (pos + record_size > size) {
+		return 0;
+	}
+	if (record_crc(data + pos, record_size) != header.crc) {
+		return 0;
+	}
+	return record_size;
+}
+
+bool read_file(const std::string& file, std::vector<char>& data, uint32_t max_size = 0)
+{
+	uint32_t fsizelow, fsizehigh, bytertd;
+
+	tfopen_lock lock(file, GENERIC_READ, OPEN_EXISTING);
+	if (!lock.valid()) {
+		return false;
+	}
+	posix_fsize(lock.fp, fsizelow, fsizehigh);
+	if (max_size && (fsizehigh || fsizelow > max_size)) {
+		fsizelow = max_size;
+	} else if (fsizehigh) {
+		// 4G or more, it isn't file of chat store.
+		return false;
+	}
+	data.resize(fsizelow);
+	if (!fsizelow) {
+		return true;
+	}
+	posix_fseek(lock.fp, 0, 0);
+	posix_fread(lock.fp, &data[0], fsizelow, bytertd);
+	return bytertd == fsizelow;
+}
+
+bool write_file(const std::string& file, const char* data, int size)
+{
+	uint32_t bytertd;
+
+	tfopen_lock lock(file, GENERIC_WRITE, CREATE_ALWAYS);
+	if (!lock.valid()) {
+		return false;
+	}
+	posix_fwrite(lock.fp, data, size, bytertd);
+	return (int)bytertd == size;
+}
+
+// replace target with temporary file.
+bool replace_file(const std::string& tmp, const std::string& file)
+{
+#ifdef _WIN32
+	// rename() doesn't replace existing file on windows.
+	remove(file.c_str());
+#endif
+	return rename(tmp.c_str(), file.c_str()) == 0;
+}
+
+}
+
+tstore::tstore()
+	: dir_()
+	, peers_()
+	, segments_()
+	, active_()
+	, active_fp_(INVALID_FILE)
+	, next_id_(1)
+	, buf_()
+	, expire_(0)
+	, mutex_()
+	, compact_thread_(NULL)
+{}
+
+tstore::~tstore()
+{
+	close();
+}
+
+std::string tstore::segment_file(int id, const char* ext) const
+{
+	std::stringstream ss;
+	ss << dir_ << std::hex << std::setw(8) << std::setfill('0') << id << ext;
+	return ss.str();
+}
+
+bool tstore::open(const std::string& dir)
+{
+	close();
+
+	if (get_dir(dir).empty()) {
+		return false;
+	}
+	dir_ = dir + "/";
+
+	std::vector<std::string> files;
+	get_files_in_dir(dir, &files);
+
+	std::vector<int> ids;
+	for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++ it) {
+		const std::string& file = *it;
+		if (file.size() == 12 && file.find(".log") == 8) {
+			ids.push_back(strtol(file.substr(0, 8).c_str(), NULL, 16));
+
+		} else if (file.size() == 16 && file.find(".log.tmp") == 8 && std::find(files.begin(), files.end(), file.substr(0, 12)) == files.end()) {
+			// merge was interrupted after merged segment was written, but before it
+			// replaced the first one. it is complete, its index is rebuilt by scanning.
+			if (!rename((dir_ + file).c_str(), (dir_ + file.substr(0, 12)).c_str())) {
+				ids.push_back(strtol(file.substr(0, 8).c_str(), NULL, 16));
+			}
+
+		} else if (file.find(".tmp") != std::string::npos) {
+			// compaction was interrupted.
+			remove((dir_ + file).c_str());
+		}
+	}
+	std::sort(ids.begin(), ids.end());
+
+	for (std::vector<int>::const_iterator it = ids.begin(); it != ids.end(); ++ it) {
+		tsegment segment(*it);
+		next_id_ = segment.id + 1;
+		if (load_index(segment)) {
+			segments_.push_back(segment);
+			continue;
+		}
+
+		std::map<std::string, std::vector<uint32_t> > offsets;
+		const bool intact = scan_segment(segment, offsets);
+		if (!segment.records) {
+			remove(segment_file(segment.id, ".log").c_str());
+			remove(segment_file(segment.id, ".idx").c_str());
+			continue;
+		}
+
+		if (intact && *it == ids.back()) {
+			// last segment of previous run, continue appending to it.
+			active_fp_ = INVALID_FILE;
+			posix_fopen(segment_file(segment.id, ".log").c_str(), GENERIC_READ | GENERIC_WRITE, OPEN_EXISTING, active_fp_);
+			if (active_fp_ != INVALID_FILE) {
+				posix_fseek(active_fp_, segment.size, 0);
+				active_ = segment;
+				for (std::map<std::string, std::vector<uint32_t> >::iterator it2 = offsets.begin(); it2 != offsets.end(); ++ it2) {
+					tpeer& peer = peers_[it2->first];
+					peer.active.swap(it2->second);
+					peer.count += peer.active.size();
+				}
+				continue;
+			}
+		}
+
+		// torn record at end, or index is lost. seal what is valid.
+		if (!intact) {
+			ERR_CHAT << "segment " << segment_file(segment.id, ".log") << " is torn at " << segment.size << ", sealed\n";
+		}
+		if (write_index(segment_file(segment.id, ".idx"), segment, offsets) && load_index(segment)) {
+			segments_.push_back(segment);
+		}
+	}
+	return true;
+}
+
+void tstore::close()
+{
+	wait_compact();
+
+	if (active_fp_ != INVALID_FILE) {
+		posix_fclose(active_fp_);
+		active_fp_ = INVALID_FILE;
+	}
+	dir_.clear();
+	peers_.clear();
+	segments_.clear();
+	active_ = tsegment();
+	next_id_ = 1;
+}
+
+bool tstore::load_index(tsegment& segment, std::map<std::string, std::vector<uint32_t> >* offsets)
+{
+	uint32_t fsizelow, fsizehigh;
+
+	std::vector<char> data;
+	if (!read_file(segment_file(segment.id, ".idx"), data) || data.size() < sizeof(tindex_header)) {
+		return false;
+	}
+	tindex_header header;
+	memcpy(&header, &data[0], sizeof(header));
+	if (header.fourcc != index_fourcc) {
+		return false;
+	}
+	if (crc32(crc32(0, NULL, 0), (const Bytef*)&data[0] + sizeof(header), data.size() - sizeof(header)) != header.crc) {
+		return false;
+	}
+	posix_fsize_byname(segment_file(segment.id, ".log").c_str(), fsizelow, fsizehigh);
+	if (fsizelow < header.size) {
+		return false;
+	}
+
+	// check whole index before spans are inserted.
+	const uint32_t size = data.size();
+	uint32_t pos = sizeof(header);
+	tindex_peer peer;
+	for (int n = 0; n < header.peers; n ++) {
+		if (pos + sizeof(peer) > size) {
+			return false;
+		}
+		memcpy(&peer, &data[pos], sizeof(peer));
+		pos += sizeof(peer) + peer.name_size + peer.count * sizeof(uint32_t);
+		if (peer.count < 0 || pos > size) {
+			return false;
+		}
+	}
+
+	segment.size = header.size;
+	segment.records = header.records;
+	segment.from = header.from;
+	segment.to = header.to;
+
+	pos = sizeof(header);
+	for (int n = 0; n < header.peers; n ++) {
+		memcpy(&peer, &data[pos], sizeof(peer));
+		const std::string name(&data[pos + sizeof(peer)], peer.name_size);
+		pos += sizeof(peer) + peer.name_size;
+
+		if (offsets) {
+			std::vector<uint32_t>& vec = (*offsets)[name];
+			vec.resize(peer.count);
+			if (peer.count) {
+				memcpy(&vec[0], &data[pos], peer.count * sizeof(uint32_t));
+			}
+
+		} else if (peer.count) {
+			tpeer& p = peers_[name];
+			tspan span(segment.id, pos);
+			span.count = peer.count;
+			// merged segment replaces older ones, keep spans ordered by segment.
+			std::vector<tspan>::iterator it = p.spans.begin();
+			while (it != p.spans.end() && it->segment < segment.id) {
+				++ it;
+			}
+			p.spans.insert(it, span);
+			p.count += peer.count;
+		}
+		pos += peer.count * sizeof(uint32_t);
+	}
+	return true;
+}
+
+bool tstore::scan_segment(tsegment& segment, std::map<std::string, std::vector<uint32_t> >& offsets) const
+{
+	std::vector<char> data;
+	segment.size = 0;
+	segment.records = 0;
+	if (!read_file(segment_file(segment.id, ".log"), data) || data.size() < (size_t)segment_header_size) {
+		return false;
+	}
+	tsegment_header header;
+	memcpy(&header, &data[0], segment_header_size);
+	if (header.fourcc != segment_fourcc) {
+		return false;
+	}
+
+	const uint32_t size = data.size();
+	uint32_t pos = segment_header_size;
+	trecord_header record;
+	while (pos < size) {
+		const uint32_t record_size = parse_record(&data[0], size, pos, record);
+		if (!record_size) {
+			break;
+		}
+		offsets[std::string(&data[pos + record_header_size], record.peer_size)].push_back(pos);
+		if (!segment.records) {
+			segment.from = record.t;
+		}
+		segment.to = record.t;
+		segment.records ++;
+		pos += record_size;
+	}
+	segment.size = pos;
+	return pos == size;
+}
+
+bool tstore::write_index(const std::string& file, const tsegment& segment, const std::map<std::string, std::vector<uint32_t> >& offsets) const
+{
+	std::vector<char> data(sizeof(tindex_header));
+	tindex_peer peer;
+	memset(&peer, 0, sizeof(peer));
+	int peers = 0;
+	for (std::map<std::string, std::vector<uint32_t> >::const_iterator it = offsets.begin(); it != offsets.end(); ++ it) {
+		const std::vector<uint32_t>& vec = it->second;
+		if (vec.empty()) {
+			continue;
+		}
+		peer.name_size = it->first.size();
+		peer.count = vec.size();
+		const char* ptr = (const char*)&peer;
+		data.insert(data.end(), ptr, ptr + sizeof(peer));
+		data.insert(data.end(), it->first.begin(), it->first.end());
+		ptr = (const char*)&vec[0];
+		data.insert(data.end(), ptr, ptr + vec.size() * sizeof(uint32_t));
+		peers ++;
+	}
+
+	tindex_header header;
+	memset(&header, 0, sizeof(header));
+	header.fourcc = index_fourcc;
+	header.size = segment.size;
+	header.records = segment.records;
+	header.from = segment.from;
+	header.to = segment.to;
+	header.peers = peers;
+	header.crc = crc32(crc32(0, NULL, 0), (const Bytef*)&data[0] + sizeof(header), data.size() - sizeof(header));
+	memcpy(&data[0], &header, sizeof(header));
+
+	// index appears complete or not at all.
+	const std::string tmp = file + ".tmp";
+	if (!write_file(tmp, &data[0], data.size()) || !replace_file(tmp, file)) {
+		ERR_CHAT << "cannot write index " << file << "\n";
+		return false;
+	}
+	return true;
+}
+
+void tstore::start_segment(time_t t)
+{
+	uint32_t bytertd;
+
+	active_ = tsegment(next_id_ ++);
+	posix_fopen(segment_file(active_.id, ".log").c_str(), GENERIC_WRITE, CREATE_ALWAYS, active_fp_);
+	if (active_fp_ == INVALID_FILE) {
+		ERR_CHAT << "cannot create segment " << segment_file(active_.id, ".log") << "\n";
+		return;
+	}
+	tsegment_header header;
+	memset(&header, 0, sizeof(header));
+	header.fourcc = segment_fourcc;
+	header.id = active_.id;
+	header.created = t;
+	posix_fwrite(active_fp_, &header, segment_header_size, bytertd);
+	if ((int)bytertd != segment_header_size) {
+		ERR_CHAT << "cannot write header of segment " << segment_file(active_.id, ".log") << "\n";
+		posix_fclose(active_fp_);
+		active_fp_ = INVALID_FILE;
+		return;
+	}
+	active_.size = segment_header_size;
+}
+
+void tstore::seal_active()
+{
+	if (active_fp_ == INVALID_FILE) {
+		return;
+	}
+	posix_fclose(active_fp_);
+	active_fp_ = INVALID_FILE;
+
+	std::map<std::string, std::vector<uint32_t> > offsets;
+	for (std::map<std::string, tpeer>::iterator it = peers_.begin(); it != peers_.end(); ++ it) {
+		tpeer& peer = it->second;
+		if (!peer.active.empty()) {
+			peer.count -= peer.active.size();
+			offsets[it->first].swap(peer.active);
+		}
+	}
+	if (write_index(segment_file(active_.id, ".idx"), active_, offsets) && load_index(active_)) {
+		segments_.push_back(active_);
+	}
+	// if index failed, messages of segment are back after next open().
+	active_ = tsegment();
+}
+
+void tstore::append(const std::string& peer, const tlog& log)
+{
+	uint32_t bytertd;
+
+	if (!valid() || peer.empty() || log.msg.empty()) {
+		return;
+	}
+	const threading::lock lock(mutex_);
+
+	if (active_fp_ != INVALID_FILE) {
+		if (active_.size >= (uint32_t)segment_size || (active_.records && active_.from / day_seconds != log.t / day_seconds)) {
+			seal_active();
+		}
+	}
+	if (active_fp_ == INVALID_FILE) {
+		start_segment(log.t);
+		if (active_fp_ == INVALID_FILE) {
+			return;
+		}
+	}
+
+	trecord_header header;
+	memset(&header, 0, sizeof(header));
+	header.msg_size = log.msg.size();
+	header.t = log.t;
+	header.peer_size = std::min<size_t>(peer.size(), 0xffff);
+	header.nick_size = std::min<size_t>(log.nick.size(), 0xffff);
+
+	const uint32_t record_size = record_header_size + header.peer_size + header.nick_size + header.msg_size;
+	buf_.resize(record_size);
+	char* ptr = &buf_[0] + record_header_size;
+	memcpy(ptr, peer.c_str(), header.peer_size);
+	ptr += header.peer_size;
+	memcpy(ptr, log.nick.c_str(), header.nick_size);
+	ptr += header.nick_size;
+	memcpy(ptr, log.msg.c_str(), header.msg_size);
+	memcpy(&buf_[0], &header, record_header_size);
+	header.crc = record_crc(&buf_[0], record_size);
+	memcpy(&buf_[0], &header.crc, sizeof(header.crc));
+
+	// one write per record, so a crash can tear only the last one.
+	posix_fwrite(active_fp_, &buf_[0], record_size, bytertd);
+	if (bytertd != record_size) {
+		ERR_CHAT << "cannot append to segment " << segment_file(active_.id, ".log") << "\n";
+		seal_active();
+		return;
+	}
+
+	tpeer& p = peers_[std::string(peer.c_str(), header.peer_size)];
+	p.active.push_back(active_.size);
+	p.count ++;
+	if (!active_.records) {
+		active_.from = log.t;
+	}
+	active_.to = log.t;
+	active_.records ++;
+	active_.size += record_size;
+}
+
+void tstore::flush()
+{
+	const threading::lock lock(mutex_);
+#ifndef _WIN32
+	// windows writes without buffer.
+	if (active_fp_ != INVALID_FILE) {
+		fflush(active_fp_);
+	}
+#endif
+}
+
+int tstore::count(const std::string& peer) const
+{
+	const threading::lock lock(mutex_);
+	std::map<std::string, tpeer>::const_iterator it = peers_.find(peer);
+	return it != peers_.end()? it->second.count: 0;
+}
+
+namespace {
+
+// placeholder of record that can't be read, page keeps the size that count() promised.
+void push_bad_records(int count, std::vector<tlog>& logs)
+{
+	for (int n = 0; n < count; n ++) {
+		logs.push_back(tlog(tlobby_user::npos, null_str, _("(message is damaged)"), 0));
+	}
+}
+
+void read_records(posix_file_t fp, const uint32_t* offsets, int count, std::vector<tlog>& logs)
+{
+	uint32_t bytertd;
+	trecord_header header;
+	std::vector<char> payload;
+
+	for (int n = 0; n < count; n ++) {
+		posix_fseek(fp, offsets[n], 0);
+		posix_fread(fp, &header, record_header_size, bytertd);
+		if (bytertd != (uint32_t)record_header_size) {
+			ERR_CHAT << "bad record at " << offsets[n] << "\n";
+			push_bad_records(1, logs);
+			continue;
+		}
+		const uint32_t size = header.peer_size + header.nick_size + header.msg_size;
+		payload.resize(record_header_size + size);
+		memcpy(&payload[0], &header, record_header_size);
+		posix_fread(fp, &payload[record_header_size], size, bytertd);
+		if (bytertd != size || record_crc(&payload[0], payload.size()) != header.crc) {
+			ERR_CHAT << "bad record at " << offsets[n] << "\n";
+			push_bad_records(1, logs);
+			continue;
+		}
+		const char* ptr = &payload[record_header_size] + header.peer_size;
+		logs.push_back(tlog(tlobby_user::npos, std::string(ptr, header.nick_size),
+			std::string(ptr + header.nick_size, header.msg_size), header.t));
+	}
+}
+
+}
+
+int tstore::load(const std::string& peer, int end, int n, std::vector<tlog>& logs) const
+{
+	uint32_t bytertd;
+
+	logs.clear();
+	const threading::lock lock(mutex_);
+	std::map<std::string, tpeer>::const_iterator find = peers_.find(peer);
+	if (find == peers_.end()) {
+		return 0;
+	}
+	const tpeer& p = find->second;
+	if (end > p.count) {
+		end = p.count;
+	}
+	const int start = std::max(0, end - n);
+
+	std::vector<uint32_t> offsets;
+	int base = 0;
+	for (std::vector<tspan>::const_iterator it = p.spans.begin(); it != p.spans.end() && base < end; ++ it) {
+		const tspan& span = *it;
+		if (base + span.count > start) {
+			const int first = std::max(start - base, 0);
+			const int last = std::min(end - base, span.count);
+
+			tfopen_lock idx(segment_file(span.segment, ".idx"), GENERIC_READ, OPEN_EXISTING);
+			tfopen_lock log(segment_file(span.segment, ".log"), GENERIC_READ, OPEN_EXISTING);
+			bool ok = false;
+			if (idx.valid() && log.valid()) {
+				offsets.resize(last - first);
+				posix_fseek(idx.fp, span.offsets + first * sizeof(uint32_t), 0);
+				posix_fread(idx.fp, &offsets[0], offsets.size() * sizeof(uint32_t), bytertd);
+				if (bytertd == offsets.size() * sizeof(uint32_t)) {
+					read_records(log.fp, &offsets[0], offsets.size(), logs);
+					ok = true;
+				}
+			}
+			if (!ok) {
+				ERR_CHAT << "cannot read segment " << segment_file(span.segment, ".log") << "\n";
+				push_bad_records(last - first, logs);
+			}
+		}
+		base += span.count;
+	}
+
+	if (base < end && !p.active.empty()) {
+		const int first = std::max(start - base, 0);
+		const int last = end - base;
+#ifndef _WIN32
+		fflush(active_fp_);
+#endif
+		tfopen_lock log(segment_file(active_.id, ".log"), GENERIC_READ, OPEN_EXISTING);
+		if (log.valid()) {
+			read_records(log.fp, &p.active[first], last - first, logs);
+		} else {
+			push_bad_records(last - first, logs);
+		}
+	}
+	return start;
+}
+
+void tstore::erase_segment_spans(int id)
+{
+	for (std::map<std::string, tpeer>::iterator it = peers_.begin(); it != peers_.end(); ) {
+		tpeer& peer = it->second;
+		for (std::vector<tspan>::iterator it2 = peer.spans.begin(); it2 != peer.spans.end(); ) {
+			if (it2->segment == id) {
+				peer.count -= it2->count;
+				it2 = peer.spans.erase(it2);
+			} else {
+				++ it2;
+			}
+		}
+		if (!peer.count) {
+			peers_.erase(it ++);
+		} else {
+			++ it;
+		}
+	}
+}
+
+void tstore::compact(time_t expire)
+{
+	if (!valid() || compact_thread_) {
+		return;
+	}
+	expire_ = expire;
+	compact_thread_ = new threading::thread(compact_main, this);
+}
+
+void tstore::wait_compact()
+{
+	if (compact_thread_) {
+		// destructor joins it.
+		delete compact_thread_;
+		compact_thread_ = NULL;
+	}
+}
+
+int tstore::compact_main(void* data)
+{
+	static_cast<tstore*>(data)->run_compact();
+	return 0;
+}
+
+void tstore::run_compact()
+{
+	const Uint32 start = SDL_GetTicks();
+	std::vector<tsegment> segments;
+	{
+		const threading::lock lock(mutex_);
+		segments = segments_;
+	}
+
+	// segments are never appended to after sealed, so only compaction changes them,
+	// it reads them without lock.
+	std::vector<tsegment> live;
+	int expired = 0;
+	for (std::vector<tsegment>::const_iterator it = segments.begin(); it != segments.end(); ++ it) {
+		const tsegment& segment = *it;
+		if (segment.to >= expire_) {
+			live.push_back(segment);
+			continue;
+		}
+		const threading::lock lock(mutex_);
+		erase_segment_spans(segment.id);
+		for (std::vector<tsegment>::iterator it2 = segments_.begin(); it2 != segments_.end(); ++ it2) {
+			if (it2->id == segment.id) {
+				segments_.erase(it2);
+				break;
+			}
+		}
+		// remove index first, a segment without index would be scanned and come back.
+		remove(segment_file(segment.id, ".idx").c_str());
+		remove(segment_file(segment.id, ".log").c_str());
+		expired ++;
+	}
+
+	// merge runs of adjacent small segments, i.e. quiet days and sessions that crashed.
+	int merged = 0;
+	size_t first = 0;
+	while (first < live.size()) {
+		size_t last = first;
+		uint32_t size = live[first].size;
+		while (last + 1 < live.size() && size + live[last + 1].size - segment_header_size <= (uint32_t)segment_size) {
+			last ++;
+			size += live[last].size - segment_header_size;
+		}
+		if (last > first) {
+			std::vector<tsegment> run(live.begin() + first, live.begin() + last + 1);
+			if (merge_segments(run)) {
+				merged += run.size();
+			}
+		}
+		first = last + 1;
+	}
+
+	LOG_CHAT << "compaction removed " << expired << " segments, merged " << merged << " segments in "
+		<< SDL_GetTicks() - start << " ms\n";
+}
+
+bool tstore::merge_segments(const std::vector<tsegment>& segments)
+{
+	tsegment result(segments.front().id);
+	result.from = segments.front().from;
+	result.to = segments.back().to;
+
+	std::vector<char> data(segment_header_size);
+	tsegment_header header;
+	memset(&header, 0, sizeof(header));
+	header.fourcc = segment_fourcc;
+	header.id = result.id;
+	header.created = result.from;
+	memcpy(&data[0], &header, segment_header_size);
+
+	std::map<std::string, std::vector<uint32_t> > offsets;
+	std::vector<char> src;
+	trecord_header record;
+	for (std::vector<tsegment>::const_iterator it = segments.begin(); it != segments.end(); ++ it) {
+		if (!read_file(segment_file(it->id, ".log"), src, it->size) || src.size() != it->size) {
+			return false;
+		}
+		uint32_t pos = segment_header_size;
+		while (pos < it->size) {
+			const uint32_t record_size = parse_record(&src[0], it->size, pos, record);
+			if (!record_size) {
+				break;
+			}
+			offsets[std::string(&src[pos + record_header_size], record.peer_size)].push_back(data.size());
+			data.insert(data.end(), src.begin() + pos, src.begin() + pos + record_size);
+			result.records ++;
+			pos += record_size;
+		}
+	}
+	result.size = data.size();
+
+	const std::string log_tmp = segment_file(result.id, ".log.tmp");
+	const std::string idx_tmp = segment_file(result.id, ".idx.tmp");
+	if (!write_file(log_tmp, &data[0], data.size()) || !write_index(idx_tmp, result, offsets)) {
+		remove(log_tmp.c_str());
+		return false;
+	}
+	// write_index renamed its temporary file to idx_tmp.
+
+	const threading::lock lock(mutex_);
+	// without index, first segment is scanned on next open. if it is interrupted
+	// after first one is replaced, messages of others may be there twice, but not lost.
+	remove(segment_file(result.id, ".idx").c_str());
+	replace_file(log_tmp, segment_file(result.id, ".log"));
+	replace_file(idx_tmp, segment_file(result.id, ".idx"));
+	for (std::vector<tsegment>::const_iterator it = segments.begin(); it != segments.end(); ++ it) {
+		erase_segment_spans(it->id);
+		if (it != segments.begin()) {
+			remove(segment_file(it->id, ".idx").c_str());
+			remove(segment_file(it->id, ".log").c_str());
+		}
+		for (std::vector<tsegment>::iterator it2 = segments_.begin(); it2 != segments_.end(); ++ it2) {
+			if (it2->id == it->id) {
+				segments_.erase(it2);
+				break;
+			}
+		}
+	}
+	if (load_index(result)) {
+		std::vector<tsegment>::iterator it = segments_.begin();
+		while (it != segments_.end() && it->id < result.id) {
+			++ it;
+		}
+		segments_.insert(it, result);
+	}
+	return true;
+}
+
+int tstore::verify(std::ostream& out)
+{
+	const threading::lock lock(mutex_);
+	int errors = 0;
+	std::vector<tsegment> segments = segments_;
+	if (active_.id) {
+		segments.push_back(active_);
+	}
+	for (std::vector<tsegment>::const_iterator it = segments.begin(); it != segments.end(); ++ it) {
+		tsegment scanned(it->id);
+		std::map<std::string, std::vector<uint32_t> > records;
+		if (!scan_segment(scanned, records) && scanned.size != it->size) {
+			out << segment_file(it->id, ".log") << ": bad record at " << scanned.size << "\n";
+			errors ++;
+		}
+		if (it->id == active_.id) {
+			continue;
+		}
+		tsegment indexed(it->id);
+		std::map<std::string, std::vector<uint32_t> > offsets;
+		if (!load_index(indexed, &offsets)) {
+			out << segment_file(it->id, ".idx") << ": corrupt index\n";
+			errors ++;
+		} else if (offsets != records) {
+			out << segment_file(it->id, ".idx") << ": index doesn't match records\n";
+			errors ++;
+		}
+	}
+	return errors;
+}
+
+namespace {
+
+Uint64 elapsed_us(Uint64 start)
+{
+	return (SDL_GetPerformanceCounter() - start) * 1000000 / SDL_GetPerformanceFrequency();
+}
+
+}
+
+void tstore::benchmark(std::ostream& out, const std::string& dir, int messages)
+{
+	const int peers = 200;
+	const int page = 50;
+	// messages are spread over 60 days, compaction drops the older half.
+	const time_t now = time(NULL);
+	const time_t first = now - 60 * day_seconds;
+
+	delete_directory(dir);
+	out << messages << " messages, " << peers << " peers, " << page << " messages per page\n";
+
+	tstore store;
+	Uint64 start = SDL_GetPerformanceCounter();
+	store.open(dir);
+	for (int n = 0; n < messages; n ++) {
+		const std::string peer = n % 10? "player" + str_cast(n % peers): "#channel" + str_cast(n % 7);
+		tlog log(tlobby_user::npos, "player" + str_cast(n % 37), "message " + str_cast(n) + " of benchmark, hello world!",
+			first + (time_t)((int64_t)60 * day_seconds * n / messages));
+		store.append(peer, log);
+	}
+	store.flush();
+	out << std::setw(20) << "append" << std::setw(12) << elapsed_us(start) << " us\n";
+	store.close();
+
+	start = SDL_GetPerformanceCounter();
+	store.open(dir);
+	out << std::setw(20) << "open" << std::setw(12) << elapsed_us(start) << " us, "
+		<< store.segments_.size() << " segments\n";
+
+	std::vector<tlog> logs;
+	const std::string peer = "player1";
+	const int total = store.count(peer);
+	start = SDL_GetPerformanceCounter();
+	store.load(peer, total, page, logs);
+	out << std::setw(20) << "last page" << std::setw(12) << elapsed_us(start) << " us, "
+		<< total << " messages of " << peer << "\n";
+
+	start = SDL_GetPerformanceCounter();
+	int pages = 0;
+	for (int end = total; end > 0; end -= page, pages ++) {
+		store.load(peer, end, page, logs);
+	}
+	out << std::setw(20) << "scroll to oldest" << std::setw(12) << elapsed_us(start) << " us, "
+		<< pages << " pages\n";
+
+	start = SDL_GetPerformanceCounter();
+	store.compact(now - 30 * day_seconds);
+	store.wait_compact();
+	out << std::setw(20) << "compact" << std::setw(12) << elapsed_us(start) << " us, "
+		<< store.segments_.size() << " segments, " << store.count(peer) << " messages of " << peer << " left\n";
+
+	start = SDL_GetPerformanceCounter();
+	const int errors = store.verify(out);
+	out << std::setw(20) << "verify" << std::setw(12) << elapsed_us(start) << " us, "
+		<< errors << " errors\n";
+
+	store.close();
+	delete_directory(dir);
+}
+
+}
@@ -0,0 +1,178 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/** @file */
+
+#ifndef LIBROSE_CHAT_STORE_HPP_INCLUDED
+#define LIBROSE_CHAT_STORE_HPP_INCLUDED
+
+#include "posix.h"
+#include "thread.hpp"
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace chat_logs {
+
+struct tlog;
+
+/**
+ * Append-only chat history, one directory of segments.
+ *
+ * - <id>.log: segment, records of all peers in the order they are appended.
+ *   Every record has a crc, a torn record at the end (crash while writing)
+ *   ends segment there.
+ * - <id>.idx: written when segment is sealed, offsets of records grouped by
+ *   peer. Only the last segment has no index, it is scanned on open() and
+ *   is at most segment_size.
+ *
+ * Memory keeps one span per peer and sealed segment, offsets of a span are
+ * read from its index when a page of it is loaded. So open() and load() don't
+ * depend on how many messages were stored.
+ *
+ * Compaction runs on a background thread: it deletes sealed segments that are
+ * older than the expire time, and merges adjacent small ones.
+ */
+class tstore
+{
+public:
+	// active segment is sealed when it is bigger than it, or at next day.
+	static const int segment_size = 1024 * 1024;
+
+	tstore();
+	~tstore();
+
+	/**
+	 * open directory, it is created if it doesn't exist.
+	 * @return false if directory can't be created.
+	 */
+	bool open(const std::string& dir);
+	void close();
+	bool valid() const { return !dir_.empty(); }
+
+	/** append one message of peer (user nick or channel). */
+	void append(const std::string& peer, const tlog& log);
+	/** push appended records to file. */
+	void flush();
+
+	/** messages of peer in store. */
+	int count(const std::string& peer) const;
+
+	/**
+	 * load messages [end - n, end) of peer, oldest first. index 0 is the oldest message.
+	 * A message that can't be read is loaded as placeholder, so logs has every
+	 * message of the range.
+	 * @return index of the first loaded message.
+	 */
+	int load(const std::string& peer, int end, int n, std::vector<tlog>& logs) const;
+
+	/** start background compaction, messages before expire are dropped. */
+	void compact(time_t expire);
+	/** wait until background compaction ends. */
+	void wait_compact();
+
+	/**
+	 * read every record of every segment and check it.
+	 * @return number of bad records or index entries.
+	 */
+	int verify(std::ostream& out);
+
+	/** time open, append, paging and compaction of messages in dir, then delete dir. */
+	static void benchmark(std::ostream& out, const std::string& dir, int messages);
+
+private:
+	struct tspan {
+		tspan(int segment, uint32_t offsets)
+			: segment(segment)
+			, offsets(offsets)
+			, count(0)
+		{}
+
+		int segment;
+		// position of offsets array in index, active segment has them in memory.
+		uint32_t offsets;
+		int count;
+	};
+
+	struct tpeer {
+		tpeer()
+			: spans()
+			, active()
+			, count(0)
+		{}
+
+		std::vector<tspan> spans;
+		// record offsets in active segment.
+		std::vector<uint32_t> active;
+		int count;
+	};
+
+	struct tsegment {
+		tsegment(int id = 0)
+			: id(id)
+			, size(0)
+			, records(0)
+			, from(0)
+			, to(0)
+		{}
+
+		int id;
+		uint32_t size;
+		int records;
+		time_t from;
+		time_t to;
+	};
+
+	std::string segment_file(int id, const char* ext) const;
+
+	/**
+	 * read index of sealed segment, false if it is missing or corrupt.
+	 * spans are inserted to peers, or offsets are returned if it isn't NULL.
+	 */
+	bool load_index(tsegment& segment, std::map<std::string, std::vector<uint32_t> >* offsets = NULL);
+	/**
+	 * read records of segment, until end or first bad record.
+	 * @return true if every record is valid.
+	 */
+	bool scan_segment(tsegment& segment, std::map<std::string, std::vector<uint32_t> >& offsets) const;
+	/** write index of segment to file, offsets are grouped by peer. */
+	bool write_index(const std::string& file, const tsegment& segment, const std::map<std::string, std::vector<uint32_t> >& offsets) const;
+	void seal_active();
+	void start_segment(time_t t);
+	void erase_segment_spans(int id);
+	bool merge_segments(const std::vector<tsegment>& segments);
+
+	static int compact_main(void* data);
+	void run_compact();
+
+	std::string dir_;
+	std::map<std::string, tpeer> peers_;
+	// sealed segments, ordered by id.
+	std::vector<tsegment> segments_;
+	tsegment active_;
+	posix_file_t active_fp_;
+	int next_id_;
+	std::vector<char> buf_;
+	time_t expire_;
+
+	// protects all above when compaction is running.
+	mutable threading::mutex mutex_;
+	threading::thread* compact_thread_;
+};
+
+}
+
+#endif
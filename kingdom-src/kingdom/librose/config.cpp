@@ -38,6 +38,13 @@ static lg::log_domain log_config("config");
 #define ERR_CF LOG_STREAM(err, log_config)
 #define DBG_CF LOG_STREAM(debug, log_config)
 
+namespace {
+// not function local statics, their first use may be from two threads at the same time.
+config::child_list empty_children;
+const config::attribute_value empty_attribute;
+const std::string s_yes("yes"), s_no("no");
+}
+
 struct tconfig_implementation
 {
 	/**
@@ -212,7 +219,6 @@ struct config_attribute_str_visitor : boost::static_visitor<std::string>
 	{ return std::string(); }
 	std::string operator()(bool b) const
 	{
-		static std::string s_yes("yes"), s_no("no");
 		return b ? s_yes : s_no;
 	}
 	std::string operator()(double d) const
@@ -417,8 +423,7 @@ config::child_itors config::child_range(const std::string& key)
 	check_valid();
 
 	child_map::iterator i = children.find(key);
-	static child_list dummy;
-	child_list *p = &dummy;
+	child_list *p = &empty_children;
 	if (i != children.end()) p = &i->second;
 	return child_itors(child_iterator(p->begin()), child_iterator(p->end()));
 }
@@ -428,8 +433,7 @@ config::const_child_itors config::child_range(const std::string& key) const
 	check_valid();
 
 	child_map::const_iterator i = children.find(key);
-	static child_list dummy;
-	const child_list *p = &dummy;
+	const child_list *p = &empty_children;
 	if (i != children.end()) p = &i->second;
 	return const_child_itors(const_child_iterator(p->begin()), const_child_iterator(p->end()));
 }
@@ -686,7 +690,6 @@ const config::attribute_value &config::operator[](const std::string &key) const
 
 	const attribute_map::const_iterator i = values.find(key);
 	if (i != values.end()) return i->second;
-	static const attribute_value empty_attribute;
 	return empty_attribute;
 }
 
@@ -718,7 +721,6 @@ const config::attribute_value &config::get_old_attribute(const std::string &key,
 		return i->second;
 	}
 
-	static const attribute_value empty_attribute;
 	return empty_attribute;
 }
 
@@ -24,6 +24,7 @@
 #include "sha1.hpp"
 #include "serialization/binary_or_text.hpp"
 #include "serialization/parser.hpp"
+#include "serialization/preproc_cache.hpp"
 
 #include <boost/foreach.hpp>
 #include <boost/algorithm/string/replace.hpp>
@@ -137,6 +138,12 @@ namespace game_config {
 		//read the file and then write to the cache
 		scoped_istream stream = preprocess_file(path, &defines_map);
 		read(cfg, *stream);
+
+		if (!preprocessor_cache().empty()) {
+			const preproc_cache::tstats& stats = preproc_cache::stats();
+			DBG_CACHE << "preprocessor cache: " << stats.hits << " hits (" << stats.hit_bytes << " bytes), "
+				<< stats.misses << " misses, " << stats.stored << " stored\n";
+		}
 	}
 
 	void config_cache::read_defines_file(const std::string& path)
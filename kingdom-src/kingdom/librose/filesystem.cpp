@@ -39,6 +39,11 @@
 #include <libgen.h>
 #include <sys/param.h> // statfs 
 #include <sys/mount.h> // statfs
+#ifdef __linux__
+#include <sys/vfs.h> // statfs
+#endif
+#include <sys/mman.h> // mmap
+#include <fcntl.h>
 #endif /* !_WIN32 */
 
 // for getenv
@@ -61,9 +66,13 @@
 #include "formula_string_utils.hpp"
 #include "posix.h"
 #include "saes.hpp"
+#include "thread.hpp"
 #include "wml_exception.hpp"
 
 #include <boost/foreach.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
 
 static lg::log_domain log_filesystem("filesystem");
 #define DBG_FS LOG_STREAM(debug, log_filesystem)
@@ -1147,6 +1156,70 @@ std::vector<std::string> binary_paths;
 typedef std::map<std::string,std::vector<std::string> > paths_map;
 paths_map binary_paths_cache;
 
+// where files and directories of one type are, from one walk of its binary paths.
+struct tbinary_index
+{
+	struct tlocation
+	{
+		tlocation(const std::string& name, size_t priority, const std::string& path)
+			: name(name)
+			, priority(priority)
+			, path(path)
+		{}
+
+		// relative to binary path.
+		std::string name;
+		// index in binary paths, lower is first.
+		size_t priority;
+		std::string path;
+	};
+	typedef boost::multi_index_container<
+		tlocation,
+		boost::multi_index::indexed_by<
+			boost::multi_index::hashed_unique<
+				BOOST_MULTI_INDEX_MEMBER(tlocation, std::string, name)
+			>
+		>
+	> tlocation_map;
+
+	// top of user data and game data, they aren't walked, only names in them are kept.
+	struct troot
+	{
+		troot(size_t priority, const std::string& path)
+			: priority(priority)
+			, path(path)
+			, files()
+			, dirs()
+		{}
+
+		size_t priority;
+		std::string path;
+		std::set<std::string> files;
+		std::set<std::string> dirs;
+	};
+
+	tbinary_index()
+		: files()
+		, dirs()
+		, roots()
+		, paths(0)
+	{}
+
+	tlocation_map files;
+	tlocation_map dirs;
+	std::vector<troot> roots;
+	// how many binary paths, lookup without index checks all of them.
+	size_t paths;
+};
+
+typedef std::map<std::string, tbinary_index> binary_index_map;
+binary_index_map binary_index_cache;
+tbinary_index_stats binary_stats;
+
+// binary paths are looked up by background threads too, i.e. prewarm of unit
+// types. SDL_mutex is recursive, locked functions can call each other.
+threading::mutex binary_paths_mutex;
+
 }
 
 static void init_binary_paths()
@@ -1174,6 +1247,7 @@ binary_paths_manager::~binary_paths_manager()
 
 void binary_paths_manager::set_paths(const config& cfg)
 {
+	const threading::lock lock(binary_paths_mutex);
 	cleanup();
 	init_binary_paths();
 
@@ -1203,7 +1277,9 @@ void binary_paths_manager::set_paths(const config& cfg)
 
 void binary_paths_manager::cleanup()
 {
+	const threading::lock lock(binary_paths_mutex);
 	binary_paths_cache.clear();
+	binary_index_cache.clear();
 
 	for (std::vector<std::string>::const_iterator i = paths_.begin(); i != paths_.end(); ++i) {
 		std::vector<std::string>::iterator it2 = std::find(binary_paths.begin(), binary_paths.end(), *i);
@@ -1214,11 +1290,20 @@ void binary_paths_manager::cleanup()
 
 void clear_binary_paths_cache()
 {
+	const threading::lock lock(binary_paths_mutex);
 	binary_paths_cache.clear();
+	binary_index_cache.clear();
+}
+
+tbinary_index_stats binary_index_stats()
+{
+	const threading::lock lock(binary_paths_mutex);
+	return binary_stats;
 }
 
 const std::vector<std::string>& get_binary_paths(const std::string& type)
 {
+	const threading::lock lock(binary_paths_mutex);
 	const paths_map::const_iterator itor = binary_paths_cache.find(type);
 	if(itor != binary_paths_cache.end()) {
 		return itor->second;
@@ -1248,6 +1333,122 @@ const std::vector<std::string>& get_binary_paths(const std::string& type)
 	return res;
 }
 
+static std::string binary_index_key(const std::string& name)
+{
+#ifdef _WIN32
+	// names on windows aren't case sensitive.
+	return utils::lowercase(name);
+#else
+	return name;
+#endif
+}
+
+static void walk_binary_path(tbinary_index& index, size_t priority, const std::string& path, const std::string& subdir)
+{
+	std::vector<std::string> files, dirs;
+	get_files_in_dir(path + subdir, &files, &dirs, FILE_NAME_ONLY, NO_FILTER, DONT_REORDER);
+	// opendir, and stat of every name.
+	binary_stats.walk_syscalls += 1 + files.size() + dirs.size();
+
+	for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++ it) {
+		const std::string name = subdir + *it;
+		index.files.insert(tbinary_index::tlocation(binary_index_key(name), priority, path + name));
+	}
+	for (std::vector<std::string>::const_iterator it = dirs.begin(); it != dirs.end(); ++ it) {
+		const std::string name = subdir + *it;
+		const tbinary_index::tlocation location(binary_index_key(name), priority, path + name);
+		// file_exists is true for directory too.
+		index.files.insert(location);
+		index.dirs.insert(location);
+		walk_binary_path(index, priority, path, name + "/");
+	}
+}
+
+static tbinary_index& binary_index(const std::string& type)
+{
+	binary_index_map::iterator find = binary_index_cache.find(type);
+	if (find != binary_index_cache.end()) {
+		return find->second;
+	}
+
+	tbinary_index& index = binary_index_cache[type];
+	const std::vector<std::string>& paths = get_binary_paths(type);
+	const std::string user_root = get_user_data_dir() + "/";
+	const std::string game_root = game_config::path + "/";
+
+	index.paths = paths.size();
+	// first path of a name wins, so walk them in order.
+	for (size_t n = 0; n < paths.size(); n ++) {
+		const std::string& path = paths[n];
+		if (path == user_root || path == game_root) {
+			tbinary_index::troot root(n, path);
+			std::vector<std::string> files, dirs;
+			get_files_in_dir(path, &files, &dirs, FILE_NAME_ONLY, NO_FILTER, DONT_REORDER);
+			binary_stats.walk_syscalls += 1 + files.size() + dirs.size();
+			for (std::vector<std::string>::const_iterator it = files.begin(); it != files.end(); ++ it) {
+				root.files.insert(binary_index_key(*it));
+			}
+			for (std::vector<std::string>::const_iterator it = dirs.begin(); it != dirs.end(); ++ it) {
+				root.files.insert(binary_index_key(*it));
+				root.dirs.insert(binary_index_key(*it));
+			}
+			index.roots.push_back(root);
+		} else {
+			walk_binary_path(index, n, path, null_str);
+		}
+	}
+	DBG_FS << "binary index of " << type << ", " << index.files.size() << " files, "
+		<< index.dirs.size() << " directories\n";
+	return index;
+}
+
+/**
+ * Location of file or directory in binary paths of type, same as checking
+ * binary paths one by one. Files under user data and game data, that aren't
+ * in a directory of type, still need one stat.
+ */
+static std::string find_in_binary_index(const std::string& type, const std::string& filename, bool dir)
+{
+	const threading::lock lock(binary_paths_mutex);
+	const tbinary_index& index = binary_index(type);
+	const std::string key = binary_index_key(filename);
+	const tbinary_index::tlocation_map& locations = dir? index.dirs: index.files;
+	const tbinary_index::tlocation_map::const_iterator find = locations.find(key);
+
+	std::string result;
+	size_t priority = find != locations.end()? find->priority: index.paths;
+	int syscalls = 0;
+	for (std::vector<tbinary_index::troot>::const_iterator it = index.roots.begin(); it != index.roots.end() && it->priority < priority; ++ it) {
+		const tbinary_index::troot& root = *it;
+		const size_t slash = key.find('/');
+		if (slash == std::string::npos) {
+			if ((dir? root.dirs: root.files).count(key)) {
+				result = root.path + filename;
+				priority = root.priority;
+				break;
+			}
+		} else if (root.dirs.count(key.substr(0, slash))) {
+			const std::string file = root.path + filename;
+			syscalls ++;
+			if (dir? is_directory(file): file_exists(file)) {
+				result = file;
+				priority = root.priority;
+				break;
+			}
+		}
+	}
+	if (result.empty() && find != locations.end()) {
+		result = find->path;
+	}
+
+	// without index, every path till where it is found is checked.
+	tbinary_index_stats& stats = binary_stats;
+	stats.lookups ++;
+	stats.lookup_syscalls += syscalls;
+	stats.saved_syscalls += (result.empty()? index.paths: priority + 1) - syscalls;
+	return result;
+}
+
 std::string get_binary_file_location(const std::string& type, const std::string& filename)
 {
 	DBG_FS << "Looking for '" << filename << "'.\n";
@@ -1271,18 +1472,13 @@ std::string get_binary_file_location(const std::string& type, const std::string&
 		return std::string();
 	}
 
-	BOOST_FOREACH (const std::string &path, get_binary_paths(type))
-	{
-		const std::string file = path + filename;
-		DBG_FS << "  checking '" << path << "'\n";
-		if(file_exists(file)) {
-			DBG_FS << "  found at '" << file << "'\n";
-			return file;
-		}
+	const std::string file = find_in_binary_index(type, filename, false);
+	if (!file.empty()) {
+		DBG_FS << "  found at '" << file << "'\n";
+	} else {
+		DBG_FS << "  not found\n";
 	}
-
-	DBG_FS << "  not found\n";
-	return std::string();
+	return file;
 }
 
 std::string get_binary_dir_location(const std::string &type, const std::string &filename)
@@ -1299,18 +1495,13 @@ std::string get_binary_dir_location(const std::string &type, const std::string &
 		return std::string();
 	}
 
-	BOOST_FOREACH (const std::string &path, get_binary_paths(type))
-	{
-		const std::string file = path + filename;
-		DBG_FS << "  checking '" << path << "'\n";
-		if (is_directory(file)) {
-			DBG_FS << "  found at '" << file << "'\n";
-			return file;
-		}
+	const std::string dir = find_in_binary_index(type, filename, true);
+	if (!dir.empty()) {
+		DBG_FS << "  found at '" << dir << "'\n";
+	} else {
+		DBG_FS << "  not found\n";
 	}
-
-	DBG_FS << "  not found\n";
-	return std::string();
+	return dir;
 }
 
 std::string get_wml_location(const std::string &filename, const std::string &current_dir)
@@ -1949,4 +2140,82 @@ void tfopen_lock::move(int64_t from, int64_t to, int size)
 			to += once_read;
 		}
 	}
-}
\ No newline at end of file
+}
+
+tmapped_file::tmapped_file(const std::string& file)
+	: data(NULL)
+	, size(0)
+#ifdef _WIN32
+	, file_(INVALID_HANDLE_VALUE)
+	, mapping_(NULL)
+#else
+	, fd_(-1)
+#endif
+{
+#ifdef _WIN32
+	// utf8 ---> utf16
+	int wlen = MultiByteToWideChar(CP_UTF8, 0, file.c_str(), -1, NULL, 0);
+	WCHAR *wc = new WCHAR[wlen];
+	MultiByteToWideChar(CP_UTF8, 0, file.c_str(), -1, wc, wlen);
+	file_ = CreateFileW(wc, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+	delete [] wc;
+	if (file_ == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	DWORD fsizehigh;
+	DWORD fsizelow = GetFileSize(file_, &fsizehigh);
+	if (fsizehigh || !fsizelow) {
+		return;
+	}
+	mapping_ = CreateFileMapping(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping_) {
+		return;
+	}
+	data = (const uint8_t*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+	if (data) {
+		size = fsizelow;
+	}
+#else
+	fd_ = open(file.c_str(), O_RDONLY);
+	if (fd_ == -1) {
+		return;
+	}
+	struct stat st;
+	if (fstat(fd_, &st) || !st.st_size || st.st_size > INT_MAX) {
+		return;
+	}
+	void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd_, 0);
+	if (addr == MAP_FAILED) {
+		return;
+	}
+	data = (const uint8_t*)addr;
+	size = st.st_size;
+#endif
+}
+
+void tmapped_file::close()
+{
+#ifdef _WIN32
+	if (data) {
+		UnmapViewOfFile(data);
+	}
+	if (mapping_) {
+		CloseHandle(mapping_);
+		mapping_ = NULL;
+	}
+	if (file_ != INVALID_HANDLE_VALUE) {
+		CloseHandle(file_);
+		file_ = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (data) {
+		munmap((void*)data, size);
+	}
+	if (fd_ != -1) {
+		::close(fd_);
+		fd_ = -1;
+	}
+#endif
+	data = NULL;
+	size = 0;
+}
@@ -211,8 +211,36 @@ private:
 	std::vector<std::string> paths_;
 };
 
+/**
+ * Clears binary paths and index of files in them, i.e. after add-ons are
+ * installed or removed.
+ */
 void clear_binary_paths_cache();
 
+/**
+ * get_binary_file_location and get_binary_dir_location look up index of
+ * files in binary paths, it is built by one walk of them.
+ */
+struct tbinary_index_stats
+{
+	tbinary_index_stats()
+		: lookups(0)
+		, walk_syscalls(0)
+		, lookup_syscalls(0)
+		, saved_syscalls(0)
+	{}
+
+	int lookups;
+	// opendir and stat of walk.
+	int walk_syscalls;
+	// stat of lookups, names under user data and game data.
+	int lookup_syscalls;
+	// stat that checking binary paths one by one would do more.
+	int saved_syscalls;
+};
+
+tbinary_index_stats binary_index_stats();
+
 /**
  * Returns a vector with all possible paths to a given type of binary,
  * e.g. 'images', 'sounds', etc,
@@ -360,4 +388,35 @@ public:
 	int data_size;
 };
 
+/**
+ * Read-only memory mapped file. data is NULL if file doesn't exist or is empty.
+ */
+struct tmapped_file
+{
+	explicit tmapped_file(const std::string& file);
+	~tmapped_file()
+	{
+		close();
+	}
+
+	bool valid() const { return data != NULL; }
+	void close();
+
+public:
+	const uint8_t* data;
+	int size;
+
+private:
+	// owns mapping, it isn't copyable.
+	tmapped_file(const tmapped_file&);
+	tmapped_file& operator=(const tmapped_file&);
+
+#ifdef _WIN32
+	HANDLE file_;
+	HANDLE mapping_;
+#else
+	int fd_;
+#endif
+};
+
 #endif
@@ -180,26 +180,22 @@ int tchat_::tsession::logs_per_page = 50;
 
 tchat_::tsession::tsession(chat_logs::treceiver& receiver)
 	: receiver(&receiver)
+	, history()
+	, history_start(0)
 	, current_page(0)
 {
-	const chat_logs::thistory_log* choice = NULL;
-	for (std::set<chat_logs::thistory_log>::const_iterator it = chat_logs::history_logs.begin(); it != chat_logs::history_logs.end(); ++ it) {
-		const chat_logs::thistory_log& logs = *it;
-		if (logs.nick == receiver.nick) {
-			choice = &logs;
-			break;
-		}
-	}
-	if (!choice) {
-		return;
-	}
-	chat_logs::user_from_logfile(*choice, history);
+}
+
+int tchat_::tsession::history_size() const
+{
+	// stored logs of this run are in receiver->logs too.
+	return chat_logs::store().count(receiver->nick) - receiver->stored;
 }
 
 int tchat_::tsession::current_logs(std::vector<chat_logs::tlog>& logs) const
 {
 	logs.clear();
-	int history_size = history.size();
+	int history_size = this->history_size();
 	int size = history_size + receiver->logs.size();
 	if (!size) {
 		return twidget::npos;
@@ -237,11 +233,11 @@ int tchat_::tsession::current_logs(std::vector<chat_logs::tlog>& logs) const
 	std::vector<chat_logs::tlog>::const_iterator begin_it;
 	std::vector<chat_logs::tlog>::const_iterator end_it;
 	if (history_start != -1) {
-		begin_it = history.begin();
-		std::advance(begin_it, history_start);
-		end_it = history.begin();
-		std::advance(end_it, history_end + 1);
-		std::copy(begin_it, end_it, std::back_inserter(logs));
+		// only this page is read from store.
+		if (history_start != this->history_start || history_end - history_start + 1 != (int)history.size()) {
+			this->history_start = chat_logs::store().load(receiver->nick, history_end + 1, history_end - history_start + 1, history);
+		}
+		std::copy(history.begin(), history.end(), std::back_inserter(logs));
 	}
 	if (now_start != -1) {
 		begin_it = receiver->logs.begin();
@@ -256,7 +252,7 @@ int tchat_::tsession::current_logs(std::vector<chat_logs::tlog>& logs) const
 
 int tchat_::tsession::pages() const
 {
-	return ceil(1.0 * (history.size() + receiver->logs.size()) / logs_per_page);
+	return ceil(1.0 * (history_size() + receiver->logs.size()) / logs_per_page);
 }
 
 bool tchat_::tsession::can_previous() const 
@@ -274,9 +270,11 @@ bool tchat_::tsession::can_next() const
 const chat_logs::tlog& tchat_::tsession::log(int at) const
 {
 	const chat_logs::tlog* log = NULL;
-	int history_size = (int)history.size();
+	int history_size = this->history_size();
 	if (at < history_size) {
-		log = &history[at];
+		// at is in page that current_logs() returned.
+		VALIDATE(at >= history_start && at < history_start + (int)history.size(), "log isn't in current page!");
+		log = &history[at - history_start];
 	} else {
 		log = &receiver->logs[at - history_size];
 	}
@@ -909,10 +907,10 @@ void tchat_::refresh_toolbar(int type, int id)
 		bool active = true;
 		toolbar_->set_child_visible(n, func.type & type);
 		if (func.id == f_copy) {
-			active = current_session_ && (!current_session_->history.empty() || !current_session_->receiver->logs.empty());
+			active = current_session_ && current_session_->pages();
 
 		} else if (func.id == f_reply) {
-			active = current_session_ && (!current_session_->history.empty() || !current_session_->receiver->logs.empty());
+			active = current_session_ && current_session_->pages();
 			if (active) {
 				const std::string& my_nick = lobby->chat->me? lobby->chat->me->nick: lobby->nick();
 				twidget* panel = history_->get_row_panel(history_->get_selected_row());
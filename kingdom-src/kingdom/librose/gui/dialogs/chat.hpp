@@ -97,9 +97,13 @@ public:
 		bool can_previous() const;
 		bool can_next() const;
 		const chat_logs::tlog& log(int at) const;
+		// messages in store before this run.
+		int history_size() const;
 
 		chat_logs::treceiver* receiver;
-		std::vector<chat_logs::tlog> history;
+		// page of store that is shown, it is loaded when page changes.
+		mutable std::vector<chat_logs::tlog> history;
+		mutable int history_start;
 		int current_page;
 	};
 
@@ -22,6 +22,7 @@
 
 #include "global.hpp"
 
+#include "asset_pack.hpp"
 #include "color_range.hpp"
 #include "config.hpp"
 #include "filesystem.hpp"
@@ -325,9 +326,6 @@ image::bool_cache is_empty_hex_;
 
 std::map<std::string,bool> image_existence_map;
 
-// directories where we already cached file existence
-std::set<std::string> precached_dirs;
-
 std::map<surface, surface> reversed_images_;
 
 int red_adjust = 0, green_adjust = 0, blue_adjust = 0;
@@ -368,7 +366,6 @@ void flush_cache(bool force)
 	mini_fogged_terrain_cache.clear();
 	reversed_images_.clear();
 	image_existence_map.clear();
-	precached_dirs.clear();
 }
 
 bool locator::operator==(const locator &a) const 
@@ -587,17 +584,43 @@ static std::string get_localized_path (const std::string& file, const std::strin
 	langs.push_back("en_US");
 	BOOST_FOREACH (const std::string &lang, langs) {
 		std::string loc_file = dir + "l10n" + "/" + lang + "/" + loc_base;
-		if (file_exists(loc_file) && localized_file_uptodate(loc_file)) {
+		// l10n track has files of data tree, not packed locations.
+		if ((asset_pack::find(loc_file) || file_exists(loc_file)) && localized_file_uptodate(asset_pack::disk_location(loc_file))) {
 			return loc_file;
 		}
 	}
 	return "";
 }
 
+// Load image of location, packed pixels are copied without decoding.
+static surface load_location(const std::string& location)
+{
+	const asset_pack::tentry* entry = asset_pack::find(location);
+	if (!entry) {
+		return IMG_Load(location.c_str());
+	}
+	if (entry->format != asset_pack::PIXELS) {
+		const size_t pos = location.rfind('.');
+		return IMG_LoadTyped_RW(asset_pack::open_rw(location), 1, pos != std::string::npos? location.c_str() + pos + 1: NULL);
+	}
+
+	surface res = create_neutral_surface(entry->w, entry->h);
+	if (res.null()) {
+		return res;
+	}
+	const uint8_t* src = asset_pack::data(*entry);
+	surface_lock lock(res);
+	uint8_t* dst = reinterpret_cast<uint8_t*>(lock.pixels());
+	for (uint32_t row = 0; row < entry->h; row ++) {
+		memcpy(dst + row * res->pitch, src + row * entry->w * 4, entry->w * 4);
+	}
+	return res;
+}
+
 // Load overlay image and compose it with the original surface.
 static void add_localized_overlay (const std::string& ovr_file, surface &orig_surf)
 {
-	surface ovr_surf = IMG_Load(ovr_file.c_str());
+	surface ovr_surf = load_location(ovr_file);
 	if (ovr_surf.null()) {
 		return;
 	}
@@ -627,7 +650,7 @@ surface locator::load_image_file() const
 		// IMG_Load need utf8 format filename, don't transcode.		
 		location = val_.filename_;
 	} else {
-		location = get_binary_file_location("images", val_.filename_);
+		location = asset_pack::location("images", val_.filename_);
 	}
 
 	{
@@ -637,7 +660,7 @@ surface locator::load_image_file() const
 			if (!loc_location.empty()) {
 				location = loc_location;
 			}
-			res = IMG_Load(location.c_str());
+			res = load_location(location);
 			// If there was no standalone localized image, check if there is an overlay.
 			if (!res.null() && loc_location.empty()) {
 				const std::string ovr_location = get_localized_path(location, "--overlay");
@@ -1054,7 +1077,7 @@ surface locator::load_image_sub_file() const
 
 bool locator::file_exists()
 {
-	return !get_binary_file_location("images", val_.filename_).empty();
+	return !asset_pack::location("images", val_.filename_).empty();
 }
 
 surface locator::load_from_disk() const
@@ -1427,52 +1450,14 @@ bool exists(const image::locator& i_locator)
 		it = image_existence_map.insert(std::make_pair(i_locator.get_filename(), false));
 	bool &cache = it.first->second;
 	if (it.second)
-		cache = !get_binary_file_location("images", i_locator.get_filename()).empty();
+		cache = !asset_pack::location("images", i_locator.get_filename()).empty();
 	return cache;
 }
 
-static void precache_file_existence_internal(const std::string& dir, const std::string& subdir)
-{
-	const std::string checked_dir = dir + "/" + subdir;
-	if (precached_dirs.find(checked_dir) != precached_dirs.end())
-		return;
-	precached_dirs.insert(checked_dir);
-
-	std::vector<std::string> files_found;
-	std::vector<std::string> dirs_found;
-	get_files_in_dir(checked_dir, &files_found, &dirs_found,
-			FILE_NAME_ONLY, NO_FILTER, DONT_REORDER);
-
-	for(std::vector<std::string>::const_iterator f = files_found.begin();
-			f != files_found.end(); ++f) {
-		image_existence_map[subdir + *f] = true;
-	}
-
-	for(std::vector<std::string>::const_iterator d = dirs_found.begin();
-			d != dirs_found.end(); ++d) {
-		precache_file_existence_internal(dir, subdir + *d + "/");
-	}
-}
-
-void precache_file_existence(const std::string& subdir)
-{
-	const std::vector<std::string>& paths = get_binary_paths("images");
-
-	for (std::vector<std::string>::const_iterator p = paths.begin();
-			 p != paths.end(); ++p) {
-
-		const std::string dir = *p + "/" + subdir;
-		precache_file_existence_internal(*p, subdir);
-	}
-}
-
 bool precached_file_exists(const std::string& file)
 {
-	std::map<std::string, bool>::const_iterator b =  image_existence_map.find(file);
-	if (b != image_existence_map.end())
-		return b->second;
-	else
-		return false;
+	// index of binary paths and pack have every file, lookup doesn't touch disk.
+	return !asset_pack::location("images", file).empty();
 }
 
 } // end namespace image
@@ -227,8 +227,7 @@ surface reverse_image(const surface &surf);
 ///returns true if the given image actually exists, without loading it.
 bool exists(const locator& i_locator);
 
-/// precache the existence of files in the subdir (ex: "terrain/")
-void precache_file_existence(const std::string& subdir = "");
+/// existence of file from index of binary paths, without stat.
 bool precached_file_exists(const std::string& file);
 }
 
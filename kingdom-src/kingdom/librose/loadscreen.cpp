@@ -33,6 +33,7 @@
 
 #include <SDL_events.h>
 #include <SDL_image.h>
+#include <SDL_thread.h>
 
 #include <cassert>
 
@@ -43,11 +44,15 @@ static lg::log_domain log_loadscreen("loadscreen");
 
 loadscreen::global_loadscreen_manager* loadscreen::global_loadscreen_manager::manager = 0;
 
+// only this thread draws, other threads run stages of ttask_graph.
+static SDL_threadID loadscreen_thread = 0;
+
 loadscreen::global_loadscreen_manager::global_loadscreen_manager(CVideo& screen)
   : owns(global_loadscreen == 0)
 {
 	if(owns) {
 		manager = this;
+		loadscreen_thread = SDL_ThreadID();
 		global_loadscreen = new loadscreen(screen);
 		global_loadscreen->clear_screen();
 	}
@@ -294,7 +299,7 @@ void loadscreen::start_stage(char const *id)
 
 void loadscreen::increment_progress()
 {
-	if (!global_loadscreen) return;
+	if (!global_loadscreen || SDL_ThreadID() != loadscreen_thread) return;
 
 	int v = ++stage_counter[current_stage];
 	int m = stages[current_stage].max_count;
@@ -22,6 +22,7 @@
 #include "help.hpp"
 #include "filesystem.hpp"
 #include "serialization/string_utils.hpp"
+#include "serialization/binary_wml.hpp"
 #include "formula_string_utils.hpp"
 #include "wml_exception.hpp"
 #include "preferences.hpp"
@@ -105,6 +106,7 @@ tsock::tsock(int at)
 	, raw_data_vsize_(0)
 	, raw_data_only(true)
 	, require_stats(true)
+	, wire_binary(false)
 	, connected_at_(0)
 	, msg_send_time(0)
 	, msg_send_gap(0)
@@ -127,6 +129,7 @@ tsock::tsock(const tsock& that)
 	, data_(that.data_)
 	, raw_data_only(that.raw_data_only)
 	, require_stats(that.require_stats)
+	, wire_binary(that.wire_binary)
 	, connected_at_(that.connected_at_)
 	, error_(that.error_)
 {
@@ -226,6 +229,7 @@ void tsock::post_disconnect()
 	sock2_ = NULL;
 	connected_at_ = 0;
 	conn_ = network::null_connection;
+	wire_binary = false;
 }
 
 void tsock::set_connect_result(const std::string& error)
@@ -336,8 +340,9 @@ size_t tsock::queue_raw_data(const char* buf, int len)
 size_t tsock::queue_data(const config& buf, const std::string& packet_type)
 {
 	network::buffer* queued_buf = new network::buffer(sock2_);
-	network::output_to_buffer(sock2_, buf, queued_buf->stream);
+	network::output_to_buffer(sock2_, buf, queued_buf->stream, wire_binary);
 	const size_t size = queued_buf->stream.str().size();
+	binary_wml::compare(packet_type, buf);
 
 	network::add_bandwidth_out(packet_type, size);
 	network::queue_buffer(sock2_, queued_buf);
@@ -521,10 +526,32 @@ void add(int id, bool channel, const tlobby_user& sender, const std::string& msg
 		}
 	}
 	receiver.insert_log(sender.uid, sender.nick, msg, t);
+	// previous log can't be changed any more.
+	save_logs(receiver, false);
 }
 
+tstore& store()
+{
+	static tstore s;
+	return s;
+}
+
+void save_logs(treceiver& receiver, bool all)
+{
+	const size_t end = all? receiver.logs.size(): receiver.logs.size() - 1;
+	if (receiver.logs.empty() || receiver.stored >= end) {
+		return;
+	}
+	for (; receiver.stored < end; receiver.stored ++) {
+		store().append(receiver.nick, receiver.logs[receiver.stored]);
+	}
+	store().flush();
+}
+
+// before chat_store, history was in history.log, and logs of last session in __temp.log.
 const std::string history_log = "history.log";
 const std::string temp_log = "__temp.log";
+const int log_days = 30;
 #define LOGFILE_HEADER_SIZE		48
 #define LOGFILE_INDEX_SIZE		56
 #define LOGFILE_DATA_PREFIX_SIZE	16
@@ -552,8 +579,6 @@ struct tlogfile_index {
 	char nick[LOGFILE_INDEX_SIZE - 28];
 };
 
-std::set<thistory_log> history_logs;
-
 bool valid_logfile(tfopen_lock& lock, int* index_offset, int* index_size)
 {
 	uint32_t fsizelow, fsizehigh, bytertd;
@@ -588,406 +613,92 @@ bool valid_logfile(tfopen_lock& lock, int* index_offset, int* index_size)
 	return true;
 }
 
-void indexs_from_mem(const char* data, int data_size, std::set<thistory_log>& logs)
-{
-	logs.clear();
-	if (data_size <= 0) {
-		return;
-	}
-	tlogfile_index* index;
-	int pos = 0;
-	do {
-		index = (tlogfile_index*)(data + pos);
-		logs.insert(thistory_log(tlobby_user::npos, index->nick, index->from, index->to, index->offset, index->size));
-		pos += LOGFILE_INDEX_SIZE;
-		
-	} while (pos < data_size);
-}
-
-void verify_logfile_data(const std::string& ansifile)
+bool log_time_less(const std::pair<std::string, tlog>& a, const std::pair<std::string, tlog>& b)
 {
-	uint32_t bytertd;
-	int index_offset, index_size;
-
-	tfopen_lock lock(ansifile, GENERIC_READ, OPEN_EXISTING);
-	bool ret = valid_logfile(lock, &index_offset, &index_size);
-	if (!ret) {
-		return;
-	}
-
-	lock.resize_data(index_size);
-	posix_fseek(lock.fp, index_offset, 0);
-	posix_fread(lock.fp, lock.data, index_size, bytertd);
-
-	std::set<thistory_log> history2_logs;
-	indexs_from_mem(lock.data, index_size, history2_logs);
-
-	std::string nick, msg;
-	tlogfile_data data;
-	for (std::set<thistory_log>::const_iterator it = history2_logs.begin(); it != history2_logs.end(); ++ it) {
-		const thistory_log& user = *it;
-
-		lock.resize_data(user.size);
-		posix_fseek(lock.fp, user.offset, 0);
-		posix_fread(lock.fp, lock.data, user.size, bytertd);
-
-		int pos = 0;
-		do {
-			memcpy(&data, lock.data + pos, sizeof(data));
-			VALIDATE(data.nick_size > 0 && data.nick_size < user.size, "nick size!");
-			VALIDATE(data.msg_size > 0 && data.msg_size < user.size, "msg size!");
-
-			nick.assign(lock.data + pos + LOGFILE_DATA_PREFIX_SIZE, data.nick_size);
-			msg.assign(lock.data + pos + LOGFILE_DATA_PREFIX_SIZE + data.nick_size, data.msg_size);
-			VALIDATE(!msg.empty() && utils::is_utf8str(msg), "msg string!");
-			pos += LOGFILE_DATA_PREFIX_SIZE + data.nick_size + data.msg_size;
-			
-		} while (pos < user.size);
-	}
+	return a.second.t < b.second.t;
 }
 
-void restore_from_logfile()
+// move messages of old log file to store, then delete it.
+void import_logfile(const std::string& name)
 {
 	uint32_t bytertd;
 	int index_offset, index_size;
 
-	std::string file = get_user_data_dir_utf8() + "/data/" + history_log;
+	std::string file = get_user_data_dir_utf8() + "/data/" + name;
 	conv_ansi_utf8(file, false);
 
 	tfopen_lock lock(file, GENERIC_READ, OPEN_EXISTING);
-	if (!valid_logfile(lock, &index_offset, &index_size)) {
-		return;
-	}
-
-	lock.resize_data(index_size);
-	posix_fseek(lock.fp, index_offset, 0);
-	posix_fread(lock.fp, lock.data, index_size, bytertd);
-
-	indexs_from_mem(lock.data, index_size, history_logs);
-}
-
-void user_from_logfile(const thistory_log& user, std::vector<tlog>& logs)
-{
-	uint32_t bytertd;
-
-	std::string file = get_user_data_dir_utf8() + "/data/" + history_log;
-	conv_ansi_utf8(file, false);
-
-	tfopen_lock lock(file, GENERIC_READ, OPEN_EXISTING);
-	if (!valid_logfile(lock, NULL, NULL)) {
+	if (!lock.valid()) {
 		return;
 	}
-
-	lock.resize_data(user.size);
-	posix_fseek(lock.fp, user.offset, 0);
-	posix_fread(lock.fp, lock.data, user.size, bytertd);
-
-	std::string nick, msg;
-	tlogfile_data data;
-	int pos = 0;
-	do {
-		memcpy(&data, lock.data + pos, sizeof(data));
-		if (data.nick_size < 0 || data.nick_size >= user.size) {
-			return;
-		}
-		if (data.msg_size < 0 || data.msg_size >= user.size) {
-			return;
-		}
-		nick.assign(lock.data + pos + LOGFILE_DATA_PREFIX_SIZE, data.nick_size);
-		msg.assign(lock.data + pos + LOGFILE_DATA_PREFIX_SIZE + data.nick_size, data.msg_size);
-		logs.push_back(tlog(tlobby_user::npos, nick, msg, data.t));
-		pos += LOGFILE_DATA_PREFIX_SIZE + data.nick_size + data.msg_size;
-		
-	} while (pos < user.size);
-}
-
-void save_temp_logfile()
-{
-	uint32_t bytertd;
-
-	// if no chat, do nothing;
-	int has_log_receivers = 0;
-	for (std::map<int, treceiver>::const_iterator it = receivers.begin(); it != receivers.end(); ++ it) {
-		const treceiver& receiver = it->second;
-		if (!receiver.logs.empty()) {
-			has_log_receivers ++;
-		}
-	}
-	if (!has_log_receivers) {
+	if (!valid_logfile(lock, &index_offset, &index_size)) {
+		lock.close();
+		remove(file.c_str());
 		return;
 	}
 
-	std::string file = get_user_data_dir_utf8() + "/data/" + temp_log;
-	conv_ansi_utf8(file, false);
-
-	tfopen_lock lock(file, GENERIC_WRITE, CREATE_ALWAYS);
-	if (!lock.valid()) {
-		return;
+	std::vector<tlogfile_index> indexs(index_size / LOGFILE_INDEX_SIZE);
+	if (!indexs.empty()) {
+		posix_fseek(lock.fp, index_offset, 0);
+		posix_fread(lock.fp, &indexs[0], indexs.size() * LOGFILE_INDEX_SIZE, bytertd);
 	}
 
-	tlogfile_header header;
+	// file is grouped by peer, store wants time order.
+	std::vector<std::pair<std::string, tlog> > logs;
 	tlogfile_data data;
-
-	memset(&header, 0, sizeof(header));
-	header.fourcc = mmioFOURCC('L', 'O', 'G', '0');
-	
-	int index_size = has_log_receivers * LOGFILE_INDEX_SIZE;
-	header.index_size = index_size;
-	// last will update it. here is move file pointer.
-	posix_fwrite(lock.fp, &header, sizeof(header), bytertd);
-	
-	lock.resize_data(128 * 1024);
-	VALIDATE(lock.data_size > index_size, "more users!");
-	memset(lock.data, 0, index_size);
-
-	int data_size = 0;
-	char* ptr;
-	int n = 0;
-	int fpos = LOGFILE_HEADER_SIZE;
-
-
-	for (std::map<int, treceiver>::const_iterator it = receivers.begin(); it != receivers.end(); ++ it) {
-		const treceiver& receiver = it->second;
-		if (receiver.logs.empty()) {
+	for (std::vector<tlogfile_index>::const_iterator it = indexs.begin(); it != indexs.end(); ++ it) {
+		const tlogfile_index& index = *it;
+		const std::string peer(index.nick, strnlen(index.nick, sizeof(index.nick)));
+		if (index.size <= 0) {
 			continue;
 		}
+		lock.resize_data(index.size);
+		posix_fseek(lock.fp, index.offset, 0);
+		posix_fread(lock.fp, lock.data, index.size, bytertd);
 
-		tlogfile_index* index = (tlogfile_index*)(lock.data + n * LOGFILE_INDEX_SIZE);
-		index->from = receiver.logs.front().t;
-		index->to = receiver.logs.back().t;
-		index->offset = fpos;
-		memcpy(index->nick, receiver.nick.c_str(), receiver.nick.size());
-		data_size = 0;
-		for (std::vector<tlog>::const_iterator it2 = receiver.logs.begin(); it2 != receiver.logs.end(); ++ it2) {
-			const tlog& log = *it2;
-			data_size += 8 + 4 + 4 + log.nick.size() + log.msg.size();
-		}
-		index->size = data_size;
-		index->flag = 0;
-
-		lock.resize_data(index_size + data_size);
-		ptr = lock.data + index_size;
-		for (std::vector<tlog>::const_iterator it2 = receiver.logs.begin(); it2 != receiver.logs.end(); ++ it2) {
-			const tlog& log = *it2;
-			data.t = log.t;
-			data.nick_size = log.nick.size();
-			data.msg_size = log.msg.size();
-			
-			memcpy(ptr, &data, sizeof(data));
-			ptr += sizeof(data);
-			memcpy(ptr, log.nick.c_str(), data.nick_size);
-			ptr += data.nick_size;
-			memcpy(ptr, log.msg.c_str(), data.msg_size);
-			ptr += data.msg_size;
-		}
-		posix_fwrite(lock.fp, lock.data + index_size, data_size, bytertd);
-		fpos += data_size;
-		n ++;
-	}
-
-	// align 4
-	int fpos2 = (fpos + 3) & ~3;
-	if (fpos2 != fpos) {
-		posix_fwrite(lock.fp, lock.data + index_size, fpos2 - fpos, bytertd);
-	}
-
-	// sequence wirte.
-	posix_fwrite(lock.fp, lock.data, index_size, bytertd);
-
-	header.index_offset = fpos2;
-	posix_fseek(lock.fp, 0, 0);
-	posix_fwrite(lock.fp, &header, sizeof(header), bytertd);
-}
-
-bool can_combine_logfile(const std::set<thistory_log>& temps, const std::set<thistory_log>& historys)
-{
-	std::set<thistory_log>::const_iterator temp_it;
-	for (std::set<thistory_log>::const_iterator it = historys.begin(); it != historys.end(); ++ it) {
-		const thistory_log& history = *it;
-		temp_it = temps.find(history);
-		if (temp_it != temps.end()) {
-			return history.to < temp_it->from;
+		int pos = 0;
+		while (pos + LOGFILE_DATA_PREFIX_SIZE <= index.size) {
+			memcpy(&data, lock.data + pos, sizeof(data));
+			if (data.nick_size < 0 || data.msg_size < 0 || pos + LOGFILE_DATA_PREFIX_SIZE + data.nick_size + data.msg_size > index.size) {
+				break;
+			}
+			const char* ptr = lock.data + pos + LOGFILE_DATA_PREFIX_SIZE;
+			logs.push_back(std::make_pair(peer, tlog(tlobby_user::npos,
+				std::string(ptr, data.nick_size), std::string(ptr + data.nick_size, data.msg_size), data.t)));
+			pos += LOGFILE_DATA_PREFIX_SIZE + data.nick_size + data.msg_size;
 		}
 	}
-	return true;
-}
-
-int skip_log(uint64_t min_log_time, const char* data, int size)
-{
-	int pos = 0;
-	tlogfile_data log;
+	lock.close();
 
-	do {
-		memcpy(&log, data + pos, sizeof(log));
-		if (log.t >= min_log_time) {
-			break;
-		}
-		pos += LOGFILE_DATA_PREFIX_SIZE + log.nick_size + log.msg_size;
-		
-	} while (pos < size);
-	return pos;
+	std::stable_sort(logs.begin(), logs.end(), log_time_less);
+	for (std::vector<std::pair<std::string, tlog> >::const_iterator it = logs.begin(); it != logs.end(); ++ it) {
+		store().append(it->first, it->second);
+	}
+	store().flush();
+	remove(file.c_str());
 }
 
-// combine temp_log and history_log to history_log.
-void combine_logfile()
+void open_store()
 {
-	const size_t log_days = 30;
-	std::string temp_file = get_user_data_dir_utf8() + "/data/" + temp_log;
-	std::string history_file = get_user_data_dir_utf8() + "/data/" + history_log;
-	std::string result_file = get_user_data_dir_utf8() + "/data/" + "result.log";
-
-	uint32_t bytertd;
-	int temp_index_offset, temp_index_size, history_index_offset, history_index_size;
-
-	conv_ansi_utf8(temp_file, false);
-	tfopen_lock temp(temp_file, GENERIC_READ, OPEN_EXISTING);
-	if (!valid_logfile(temp, &temp_index_offset, &temp_index_size)) {
-		return;
-	}
-
-	std::set<thistory_log> temp_logs;
-	temp.resize_data(temp_index_size);
-	posix_fseek(temp.fp, temp_index_offset, 0);
-	posix_fread(temp.fp, temp.data, temp_index_size, bytertd);
-	indexs_from_mem(temp.data, temp_index_size, temp_logs);
-	
-	// open previous history.log for read
-	std::set<thistory_log> history_logs2;
-	conv_ansi_utf8(history_file, false);
-	tfopen_lock history(history_file, GENERIC_READ, OPEN_EXISTING);
-	if (valid_logfile(history, &history_index_offset, &history_index_size)) {
-		history.resize_data(history_index_size);
-		posix_fseek(history.fp, history_index_offset, 0);
-		posix_fread(history.fp, history.data, history_index_size, bytertd);
-
-		indexs_from_mem(history.data, history_index_size, history_logs2);
-
-		if (!can_combine_logfile(temp_logs, history_logs2)) {
-			temp.close();
-			remove(temp_file.c_str());
-			return;
-		}
-		// re-position history to data area.
-		posix_fseek(history.fp, LOGFILE_HEADER_SIZE, 0);
-	} else {
-		// history_log is invalid. simple comform delete it and rename temp_log to it.
-		temp.close();
-		history.close();
-
-		remove(history_file.c_str());
-		rename(temp_file.c_str(), history_file.c_str());
+	std::string dir = get_user_data_dir_utf8() + "/data/chat";
+	conv_ansi_utf8(dir, false);
+	if (!store().open(dir)) {
 		return;
 	}
+	import_logfile(history_log);
+	import_logfile(temp_log);
 
-	// create result.log for write
-	conv_ansi_utf8(result_file, false);
-	tfopen_lock result(result_file, GENERIC_WRITE, CREATE_ALWAYS);
-	if (!result.valid()) {
-		return;
-	}
-	// last will update it. here is move file pointer.
-	posix_fwrite(result.fp, temp.data, LOGFILE_HEADER_SIZE, bytertd);
-	int fpos = LOGFILE_HEADER_SIZE;
-
-	// of course, history_logs2 maybe overlap temp_logs, must a think memory is little, needn't allocat more time.
-	result.resize_data((history_logs2.size() + temp_logs.size()) * LOGFILE_INDEX_SIZE);
-	memset(result.data, 0, (history_logs2.size() + temp_logs.size()) * LOGFILE_INDEX_SIZE);
-
-	int skip_size;
-	time_t min_log_time = time(NULL) - log_days * 24 * 3600;
-	min_log_time -= min_log_time % (24 * 3600);
-	std::set<thistory_log>::iterator temp_it;
-	int n = 0;
-	// users order in history_logs2 is different from history.log's order!
-	// history_logs2 order is order by nick.
-	// history.log's order is no rule. In general, it is decided by receivers(std::map<int, treceiver>).
-	for (std::set<thistory_log>::const_iterator it = history_logs2.begin(); it != history_logs2.end(); ++ it) {
-		const thistory_log& history_log = *it;
-
-		tlogfile_index* index = (tlogfile_index*)(result.data + n * LOGFILE_INDEX_SIZE);
-		index->from = history_log.from;
-		index->to = history_log.to;
-		index->offset = fpos;
-		index->size = history_log.size;
-		index->flag = 0;
-		memcpy(index->nick, history_log.nick.c_str(), history_log.nick.size());
-
-		// users order in history_logs2 is different from history.log's order. re-seek!
-		posix_fseek(history.fp, history_log.offset, 0);
-		history.resize_data(history_log.size);
-		posix_fread(history.fp, history.data, history_log.size, bytertd);
-		skip_size = skip_log(min_log_time, history.data, history_log.size);
-		if (skip_size < history_log.size) {
-			index->size = history_log.size - skip_size;
-			posix_fwrite(result.fp, history.data + skip_size, index->size, bytertd);
-			fpos += index->size;
-		} else {
-			index->size = 0;
-		}
-
-		temp_it = temp_logs.find(history_log);
-		if (temp_it != temp_logs.end()) {
-			const thistory_log& temp_log = *temp_it;
-			posix_fseek(temp.fp, temp_log.offset, 0);
-			temp.resize_data(temp_log.size);
-			posix_fread(temp.fp, temp.data, temp_log.size, bytertd);
-			posix_fwrite(result.fp, temp.data, temp_log.size, bytertd);
-			fpos += temp_log.size;
-
-			// update to time.
-			index->to = temp_log.to;
-			index->size += temp_log.size;
-
-			temp_logs.erase(temp_it);
-		}
-		if (index->size) {
-			n ++;
-		}
-	}
-	for (std::set<thistory_log>::const_iterator it = temp_logs.begin(); it != temp_logs.end(); ++ it, n ++) {
-		const thistory_log& temp_log = *it;
-
-		tlogfile_index* index = (tlogfile_index*)(result.data + n * LOGFILE_INDEX_SIZE);
-		index->from = temp_log.from;
-		index->to = temp_log.to;
-		index->offset = fpos;
-		index->size = temp_log.size;
-		index->flag = 0;
-		memcpy(index->nick, temp_log.nick.c_str(), temp_log.nick.size());
-
-		posix_fseek(temp.fp, temp_log.offset, 0);
-		temp.resize_data(temp_log.size);
-		posix_fread(temp.fp, temp.data, temp_log.size, bytertd);
-		posix_fwrite(result.fp, temp.data, temp_log.size, bytertd);
-
-		fpos += temp_log.size;
-	}
+	time_t expire = time(NULL) - log_days * 24 * 3600;
+	expire -= expire % (24 * 3600);
+	store().compact(expire);
+}
 
-	// align 4
-	int fpos2 = (fpos + 3) & ~3;
-	if (fpos2 != fpos) {
-		// temp.data must allocatable, use it as memory buffer.
-		posix_fwrite(result.fp, temp.data, fpos2 - fpos, bytertd);
+void close_store()
+{
+	for (std::map<int, treceiver>::iterator it = receivers.begin(); it != receivers.end(); ++ it) {
+		save_logs(it->second, true);
 	}
-
-	// sequence wirte.
-	posix_fwrite(result.fp, result.data, n * LOGFILE_INDEX_SIZE, bytertd);
-
-	tlogfile_header* header = (tlogfile_header*)result.data;
-	memset(header, 0, sizeof(tlogfile_header));
-	header->fourcc = mmioFOURCC('L', 'O', 'G', '0');
-	header->index_offset = fpos2;
-	header->index_size = n * LOGFILE_INDEX_SIZE;
-	posix_fseek(result.fp, 0, 0);
-	posix_fwrite(result.fp, header, sizeof(tlogfile_header), bytertd);
-
-	temp.close();
-	history.close();
-	result.close();
-
-	remove(temp_file.c_str());
-	remove(history_file.c_str());
-	rename(result_file.c_str(), history_file.c_str());
+	store().close();
 }
 
 }
@@ -1009,7 +720,7 @@ tlobby::tchat_sock::tchat_sock()
 	// shinken reconnect delay to 5 sec.
 	reconnect_prohabit_ = 5000;
 
-	chat_logs::restore_from_logfile();
+	chat_logs::open_store();
 }
 
 tlobby::tchat_sock::tchat_sock(const tlobby::tchat_sock& that)
@@ -1028,8 +739,7 @@ tlobby::tchat_sock::~tchat_sock()
 		free(line_);
 	}
 
-	chat_logs::save_temp_logfile();
-	chat_logs::combine_logfile();
+	chat_logs::close_store();
 	save_preferences();
 }
 
@@ -2289,9 +1999,10 @@ bool tlobby::ttransit_sock::connect(TCPsocket sock, const std::string& host, int
 {
 	tsock::connect(sock, host, port);
 
-	// Send data telling the remote host that this is a new connection
+	// Send data telling the remote host that this is a new connection,
+	// and that binary WML can be used.
 	char buf[4] ALIGN_4;
-	SDLNet_Write32(0, reinterpret_cast<void*>(buf));
+	SDLNet_Write32(binary_wml::handshake(), reinterpret_cast<void*>(buf));
 	const int nbytes = SDLNet_TCP_Send(sock, buf, 4);
 	if (nbytes != 4) {
 		return false;
@@ -2313,7 +2024,7 @@ void tlobby::ttransit_sock::post_disconnect()
 size_t tlobby::ttransit_sock::queue_raw_data(const char* buf, int len)
 {
 	network::buffer* queued_buf = new network::buffer(sock2_);
-	assert(*buf == 31);
+	assert(*buf == 31 || binary_wml::is_binary(buf, len));
 	network::make_network_buffer(buf, len, queued_buf->raw_buffer);
 	network::queue_buffer(sock2_, queued_buf);
 	return 4 + len;
@@ -2364,8 +2075,10 @@ bool tlobby::ttransit_sock::receive_probed()
 		if (len != 4) {
 			throw network::error("Remote host disconnected", conn_);
 		}
-		const int remote_handle = SDLNet_Read32(reinterpret_cast<void*>(buf));
-		remote_handle_ = remote_handle;
+		const uint32_t remote_handle = SDLNet_Read32(reinterpret_cast<void*>(buf));
+		// old server doesn't set flag, it receives gzip text WML.
+		wire_binary = (remote_handle & binary_wml::handshake_accepted) != 0;
+		remote_handle_ = remote_handle & ~binary_wml::handshake_accepted;
 
 		return false;
 	}
@@ -2450,6 +2163,17 @@ tsock& tlobby::get_connection_details(network::connection conn) const
 	return null_sock;
 }
 
+tsock* tlobby::find_connection(network::connection conn) const
+{
+	for (std::vector<tsock*>::const_iterator it = socks_.begin(); it != socks_.end(); ++ it) {
+		tsock* s = *it;
+		if (s->conn_ == conn) {
+			return s;
+		}
+	}
+	return NULL;
+}
+
 tsock& tlobby::get_connection_details2(TCPsocket sock) const
 {
 	VALIDATE(sock, null_str);
@@ -21,6 +21,7 @@
 #include "config.hpp"
 #include <time.h>
 #include "ichat.hpp"
+#include "chat_store.hpp"
 
 namespace irc {
 struct ircnet;
@@ -100,6 +101,8 @@ protected:
 public:
 	bool raw_data_only;
 	bool require_stats;
+	// peer accepted binary WML at handshake.
+	bool wire_binary;
 	int connected_at_;
 	std::string error_;
 	Uint32 msg_send_time;
@@ -225,6 +228,9 @@ struct treceiver {
 	treceiver(int id = tlobby_channel::npos, bool channel = true)
 		: id(id)
 		, channel(channel)
+		, nick()
+		, logs()
+		, stored(0)
 	{
 		if (id != tlobby_channel::npos) {
 			nick = channel? tlobby_channel::get_nick(id): tlobby_user::get_nick(id);
@@ -241,39 +247,19 @@ struct treceiver {
 	bool channel;
 	std::string nick;
 	std::vector<tlog> logs;
+	// logs before it are in store. last log isn't stored until next one,
+	// a message in 5 seconds is appended to it.
+	size_t stored;
 };
 
-struct thistory_log {
-	thistory_log(int uid, const std::string& nick, time_t from, time_t to, int offset, int size)
-		: uid(uid)
-		, nick(nick)
-		, from(from)
-		, to(to)
-		, offset(offset)
-		, size(size)
-	{}
-
-	bool operator==(const thistory_log& that) const { return nick == that.nick; }
-	bool operator!=(const thistory_log& that) const { return !operator==(that); }
-
-	bool operator<(const thistory_log& that) const { return nick < that.nick; }
-
-	int uid;
-	std::string nick;
-	time_t from;
-	time_t to;
-	int offset;
-	int size;
-};
-extern std::set<thistory_log> history_logs;
-
 treceiver& find_receiver(int id, bool channel, bool allow_create = false);
 void add(int id, bool channel, const tlobby_user& sender, const std::string& msg);
 
-void restore_from_logfile();
-void user_from_logfile(const thistory_log& user, std::vector<tlog>& logs);
-void save_temp_logfile();
-void combine_logfile();
+// chat history of all sessions.
+tstore& store();
+void open_store();
+void save_logs(treceiver& receiver, bool all);
+void close_store();
 
 }
 
@@ -469,6 +455,8 @@ public:
 
 	tsock& get_connection_details(network::connection conn) const;
 	tsock& get_connection_details2(TCPsocket sock) const;
+	// NULL if conn doesn't exist.
+	tsock* find_connection(network::connection conn) const;
 	void pre_disconnect(network::connection conn);
 	void post_disconnect(network::connection conn);
 
@@ -141,8 +141,16 @@ struct partial_buffer {
 TCPsocket server_socket;
 
 std::deque<network::connection> disconnection_queue;
+// game executors of server send from their threads.
+threading::mutex bad_sockets_mutex;
 std::set<network::connection> bad_sockets;
 
+bool is_bad_socket(network::connection connection_num)
+{
+	const threading::lock lock(bad_sockets_mutex);
+	return bad_sockets.count(connection_num) || bad_sockets.count(0);
+}
+
 network_worker_pool::manager* worker_pool_man = NULL;
 
 } // end anon namespace
@@ -172,6 +180,7 @@ connection_stats get_connection_stats(connection connection_num)
 error::error(const std::string& msg, connection sock) : game::error(msg), socket(sock)
 {
 	if(socket) {
+		const threading::lock lock(bad_sockets_mutex);
 		bad_sockets.insert(socket);
 	}
 }
@@ -659,7 +668,10 @@ bool disconnect(connection s)
 		network_worker_pool::close_socket(info.sock());
 	}
 
-	bad_sockets.erase(s);
+	{
+		const threading::lock lock(bad_sockets_mutex);
+		bad_sockets.erase(s);
+	}
 
 	std::deque<network::connection>::iterator dqi = std::find(disconnection_queue.begin(),disconnection_queue.end(),s);
 	if (dqi != disconnection_queue.end()) {
@@ -726,7 +738,7 @@ connection receive_data(config& cfg, connection connection_num, bandwidth_in_ptr
 		throw error("",sock);
 	}
 
-	if(bad_sockets.count(connection_num) || bad_sockets.count(0)) {
+	if(is_bad_socket(connection_num)) {
 		return 0;
 	}
 
@@ -817,7 +829,7 @@ connection receive_data(std::vector<char>& buf, connection connection_num, bandw
 		throw error("",sock);
 	}
 
-	if(bad_sockets.count(0)) {
+	if(is_bad_socket(0)) {
 		return 0;
 	}
 
@@ -843,7 +855,8 @@ connection receive_data(std::vector<char>& buf, connection connection_num, bandw
 	}
 
 	TCPsocket sock = connection_num == 0 ? 0 : get_socket(connection_num);
-	sock = network_worker_pool::get_received_data(sock, buf);
+	Uint64 received_at = 0;
+	sock = network_worker_pool::get_received_data(sock, buf, &received_at);
 	if (sock == NULL) {
 		return 0;
 	}
@@ -855,7 +868,7 @@ connection receive_data(std::vector<char>& buf, connection connection_num, bandw
 			bandwidth_in = &temp;
 		}
 		const int headers = 4;
-		bandwidth_in->reset(new network::bandwidth_in(buf.size() + headers));
+		bandwidth_in->reset(new network::bandwidth_in(buf.size() + headers, received_at));
 	}
 
 	int set_res = SDLNet_TCP_AddSocket(socket_set,sock);
@@ -896,6 +909,7 @@ struct bandwidth_stats {
 typedef std::map<const std::string, bandwidth_stats> bandwidth_map;
 typedef std::vector<bandwidth_map> hour_stats_vector;
 hour_stats_vector hour_stats(24);
+threading::mutex hour_stats_mutex;
 
 
 
@@ -970,6 +984,7 @@ std::string get_bandwidth_stats(int hour)
 {
 	assert(hour < 24 && hour >= 0);
 	std::stringstream ss;
+	const threading::lock lock(hour_stats_mutex);
 
 	ss << "Hour stat starting from " << hour << "\n " << std::left << std::setw(bandwidth_stats::type_width) <<  "Type of packet" << "| "
 		<< std::setw(bandwidth_stats::packet_width)<< "out #"  << "| "
@@ -984,8 +999,14 @@ std::string get_bandwidth_stats(int hour)
 	return ss.str();
 }
 
+void (*bandwidth_out_observer)(const std::string& packet_type, size_t len) = NULL;
+
 void add_bandwidth_out(const std::string& packet_type, size_t len)
 {
+	if (bandwidth_out_observer) {
+		bandwidth_out_observer(packet_type, len);
+	}
+	const threading::lock lock(hour_stats_mutex);
 	bandwidth_map::iterator itor = add_bandwidth_entry(packet_type);
 	itor->second.out_bytes += len;
 	++(itor->second.out_packets);
@@ -993,6 +1014,7 @@ void add_bandwidth_out(const std::string& packet_type, size_t len)
 
 void add_bandwidth_in(const std::string& packet_type, size_t len)
 {
+	const threading::lock lock(hour_stats_mutex);
 	bandwidth_map::iterator itor = add_bandwidth_entry(packet_type);
 	itor->second.in_bytes += len;
 	++(itor->second.in_packets);
@@ -1006,7 +1028,7 @@ void add_bandwidth_in(const std::string& packet_type, size_t len)
 void send_file(const std::string& filename, connection connection_num, const std::string& packet_type)
 {
 	assert(connection_num > 0);
-	if(bad_sockets.count(connection_num) || bad_sockets.count(0)) {
+	if(is_bad_socket(connection_num)) {
 		return;
 	}
 
@@ -1031,7 +1053,7 @@ size_t send_data(tsock& info, const config& cfg, const std::string& packet_type)
 		return 0;
 	}
 
-	if (bad_sockets.count(connection_num) || bad_sockets.count(0)) {
+	if (is_bad_socket(connection_num)) {
 		return 0;
 	}
 /*
@@ -1055,7 +1077,7 @@ void send_raw_data(const char* buf, int len, connection connection_num, const st
 		return;
 	}
 
-	if(bad_sockets.count(connection_num) || bad_sockets.count(0)) {
+	if(is_bad_socket(connection_num)) {
 		return;
 	}
 
@@ -196,7 +196,7 @@ std::string get_bandwidth_stats(int hour);
 void add_bandwidth_out(const std::string& packet_type, size_t len);
 void add_bandwidth_in(const std::string& packet_type, size_t len);
 struct bandwidth_in {
-	bandwidth_in(int len) : len_(len), type_("unknown") {}
+	bandwidth_in(int len, Uint64 received_at = 0) : len_(len), type_("unknown"), received_at_(received_at) {}
 	~bandwidth_in();
 
 	void set_type(const std::string& type)
@@ -204,11 +204,18 @@ struct bandwidth_in {
 		type_ = type;
 	}
 
+	/** performance counter when worker thread received this packet. */
+	Uint64 received_at() const { return received_at_; }
+
 	private:
 	int len_;
 	std::string type_;
+	Uint64 received_at_;
 };
 
+/** called with every packet queued to send, server uses it to collect metrics per type. */
+extern void (*bandwidth_out_observer)(const std::string& packet_type, size_t len);
+
 typedef boost::shared_ptr<bandwidth_in> bandwidth_in_ptr;
 
 /**
@@ -307,7 +314,8 @@ struct buffer {
 		config_buf(),
 		config_error(""),
 		stream(),
-		raw_buffer()
+		raw_buffer(),
+		received_at(SDL_GetPerformanceCounter())
 		{}
 
 	TCPsocket sock;
@@ -321,6 +329,9 @@ struct buffer {
 	 * sent.
 	 */
 	std::vector<char> raw_buffer;
+
+	// performance counter when it is created, it is queue time of received buffer.
+	Uint64 received_at;
 };
 
 /** Amount of seconds after the last server ping when we assume to have timed out. */
@@ -336,7 +347,8 @@ bool receive_with_timeout(tsock& info, char* buf, size_t nbytes,
 		bool update_stats=false, int idle_timeout_ms=30000,
 		int total_timeout_ms=300000, int* ret_size = NULL);
 
-void output_to_buffer(TCPsocket /*sock*/, const config& cfg, std::ostringstream& compressor);
+// binary: use binary WML, otherwise gzip text WML.
+void output_to_buffer(TCPsocket /*sock*/, const config& cfg, std::ostringstream& compressor, bool binary = false);
 void make_network_buffer(const char* input, int len, std::vector<char>& buf);
 void queue_buffer(TCPsocket sock, network::buffer* queued_buf);
 
@@ -29,6 +29,7 @@
 #include "filesystem.hpp"
 #include "thread.hpp"
 #include "serialization/binary_or_text.hpp"
+#include "serialization/binary_wml.hpp"
 #include "serialization/parser.hpp"
 #include "util.hpp"
 #include "lobby.hpp"
@@ -328,8 +329,14 @@ bool receive_with_timeout(tsock& info, char* buf, size_t nbytes,
 /**
  * @todo See if the TCPsocket argument should be removed.
  */
-void output_to_buffer(TCPsocket /*sock*/, const config& cfg, std::ostringstream& compressor)
+void output_to_buffer(TCPsocket /*sock*/, const config& cfg, std::ostringstream& compressor, bool binary)
 {
+	if (binary) {
+		std::string out;
+		binary_wml::write(out, cfg);
+		compressor.write(out.data(), out.size());
+		return;
+	}
 	config_writer writer(compressor, true);
 	writer.write(cfg);
 }
@@ -745,6 +752,12 @@ static int process_queue(void* shard_num)
 			received_data->raw_buffer.resize(buf.vsize);
 			memcpy(&received_data->raw_buffer[0], buf.data, buf.vsize);
 			// received_data->raw_buffer.swap(buf);
+		} else if (binary_wml::is_binary(buf.data, buf.vsize)) {
+			try {
+				binary_wml::read(received_data->config_buf, buf.data, buf.vsize);
+			} catch(config::error &e) {
+				received_data->config_error = e.message;
+			}
 		} else {
 			std::stringstream gangplank;
 			std::iostream stream(gangplank.rdbuf());
@@ -917,14 +930,14 @@ TCPsocket get_received_data(TCPsocket sock, config& cfg, network::bandwidth_in_p
 		cfg.swap((*itor)->config_buf);
 		const TCPsocket res = (*itor)->sock;
 		network::buffer* buf = *itor;
-		bandwidth_in.reset(new network::bandwidth_in((*itor)->raw_buffer.size()));
+		bandwidth_in.reset(new network::bandwidth_in((*itor)->raw_buffer.size(), (*itor)->received_at));
 		received_data_queue.erase(itor);
 		delete buf;
 		return res;
 	}
 }
 
-TCPsocket get_received_data(TCPsocket sock, std::vector<char>& out)
+TCPsocket get_received_data(TCPsocket sock, std::vector<char>& out, Uint64* received_at)
 {
 	assert(sock);
 	const threading::lock lock_received(*received_mutex);
@@ -950,6 +963,9 @@ TCPsocket get_received_data(TCPsocket sock, std::vector<char>& out)
 	network::buffer* buf = *itor;
 	received_data_queue.erase(itor);
 	out.swap(buf->raw_buffer);
+	if (received_at) {
+		*received_at = buf->received_at;
+	}
 	const TCPsocket res = buf->sock;
 	delete buf;
 	return res;
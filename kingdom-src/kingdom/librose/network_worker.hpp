@@ -99,7 +99,7 @@ void receive_data(TCPsocket sock);
 
 TCPsocket get_received_data(TCPsocket sock, config& cfg, network::bandwidth_in_ptr&);
 
-TCPsocket get_received_data(TCPsocket sock, std::vector<char>& buf);
+TCPsocket get_received_data(TCPsocket sock, std::vector<char>& buf, Uint64* received_at = NULL);
 
 void queue_file(TCPsocket sock, const std::string&);
 
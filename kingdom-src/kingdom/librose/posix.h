@@ -223,11 +223,11 @@ typedef FILE*			posix_file_t;
         __mode[__mode_pos ++] = '+';	\
     } else {	\
 		__mode[__mode_pos ++] = 'r';	\
-        if (desired_access & GENERIC_WRITE) {    \
+        if ((desired_access) & GENERIC_WRITE) {    \
             __mode[__mode_pos ++] = '+';	\
         }   \
 	}	\
-	if (!(desired_access & CONTENT_TXT)) {	\
+	if (!((desired_access) & CONTENT_TXT)) {	\
 		__mode[__mode_pos ++] = 'b';	\
 	}	\
 	__mode[__mode_pos] = 0;	\
@@ -0,0 +1,490 @@
+/**
+ * @file
+ * Compact binary WML for network messages.
+ */
+
+#include "global.hpp"
+
+#include "serialization/binary_wml.hpp"
+#include "serialization/binary_or_text.hpp"
+#include "serialization/parser.hpp"
+#include "config.hpp"
+#include "thread.hpp"
+#include "posix.h"
+
+#include "SDL_atomic.h"
+#include "SDL_timer.h"
+#include <boost/foreach.hpp>
+#include <iomanip>
+#include <map>
+#include <zlib.h>
+
+namespace binary_wml {
+
+int compress_threshold = 512;
+int compare_interval = 0;
+
+// names of frequent tags and keys. append only, and increase version if it is changed.
+static const char* dictionary_names[] = {
+	// server and lobby
+	"message", "sender", "receiver", "whisper", "room", "user", "name", "game", "gamelist", "gamelist_diff",
+	"insert_child", "delete_child", "change_child", "index", "id", "ping", "version", "login", "username",
+	"password", "join_lobby", "join", "leave_game", "observer", "observe", "available", "location", "status",
+	"error", "info", "side_drop", "controller", "team_name", "side", "turn", "time", "mp_scenario",
+	"mp_era", "human_sides", "slots", "vacant_slots", "registered", "moderator", "game_id", "start_game",
+	"store_next_scenario", "next_scenario", "data", "type", "value", "player", "current_player",
+	// replay commands
+	"command", "random", "results", "choose", "hits", "dies", "damage", "chance", "unit_hit",
+	"speak", "move", "attack", "recruit", "end_turn", "init_side", "post_unit", "expedite", "start",
+	"destination", "source", "x", "y", "from", "to", "heros", "cost", "human", "city", "sub", "checksum",
+	"verify", "label", "text", "color", "fire_event", "input", "countdown_update", "cast_tactic",
+	"build", "disband", "armory", "move_heros", "interior", "diplomatism", "employ", "event", "state",
+	NULL
+};
+
+int dictionary_version()
+{
+	return 1;
+}
+
+namespace {
+// built at static initialization, so network threads can use it without lock.
+struct tdictionary
+{
+	tdictionary()
+		: names()
+		, index()
+	{
+		for (int i = 0; dictionary_names[i]; i ++) {
+			names.push_back(dictionary_names[i]);
+			index[names.back()] = i;
+		}
+	}
+
+	std::vector<std::string> names;
+	std::map<std::string, int> index;
+};
+const tdictionary dictionary;
+}
+
+uint32_t handshake()
+{
+	return mmioFOURCC(dictionary_version(), 0, 'W', 'B');
+}
+
+bool is_handshake(uint32_t value)
+{
+	return value == handshake();
+}
+
+bool is_binary(const char* data, int len)
+{
+	return len >= 2 && (uint8_t)data[0] == MAGIC;
+}
+
+tencoder::tencoder()
+	: body_()
+	, names_()
+{}
+
+void tencoder::write_varint(uint32_t value)
+{
+	while (value >= 0x80) {
+		body_.push_back((char)((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+	body_.push_back((char)value);
+}
+
+void tencoder::write_name(int kind, const char* name, int len)
+{
+	const std::string key(name, len);
+	const std::map<std::string, int>& dict = dictionary.index;
+	std::map<std::string, int>::const_iterator it = dict.find(key);
+	if (it != dict.end()) {
+		write_varint(((it->second + 1) << 2) | kind);
+		return;
+	}
+	std::map<std::string, int>::const_iterator it2 = names_.find(key);
+	if (it2 != names_.end()) {
+		write_varint(((it2->second + 1) << 2) | kind);
+		return;
+	}
+	names_.insert(std::make_pair(key, (int)(dict.size() + names_.size())));
+	write_varint(kind);
+	write_varint(len);
+	body_.append(name, len);
+}
+
+void tencoder::open_child(const char* name, int len)
+{
+	write_name(2, name, len);
+}
+
+void tencoder::close_child()
+{
+	body_.push_back(0);
+}
+
+void tencoder::attribute(const char* name, int name_len, const char* value, int value_len)
+{
+	write_name(1, name, name_len);
+	write_varint(value_len);
+	body_.append(value, value_len);
+}
+
+void tencoder::finish(std::string& out)
+{
+	out.clear();
+	out.push_back((char)MAGIC);
+	if ((int)body_.size() <= compress_threshold) {
+		out.push_back(0);
+		out.append(body_);
+		return;
+	}
+
+	uLongf size = compressBound(body_.size());
+	std::vector<Bytef> deflated(size);
+	if (compress2(&deflated[0], &size, (const Bytef*)body_.data(), body_.size(), Z_BEST_SPEED) != Z_OK || size >= body_.size()) {
+		out.push_back(0);
+		out.append(body_);
+		return;
+	}
+	out.push_back((char)FLAG_DEFLATE);
+	uint32_t value = body_.size();
+	while (value >= 0x80) {
+		out.push_back((char)((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+	out.push_back((char)value);
+	out.append((const char*)&deflated[0], size);
+}
+
+static void write_config(tencoder& encoder, const config& cfg)
+{
+	BOOST_FOREACH (const config::attribute& attr, cfg.attribute_range()) {
+		const std::string& value = attr.second.str();
+		encoder.attribute(attr.first.c_str(), attr.first.size(), value.c_str(), value.size());
+	}
+	BOOST_FOREACH (const config::any_child& child, cfg.all_children_range()) {
+		encoder.open_child(child.key.c_str(), child.key.size());
+		write_config(encoder, child.cfg);
+		encoder.close_child();
+	}
+}
+
+void write(std::string& out, const config& cfg)
+{
+	tencoder encoder;
+	write_config(encoder, cfg);
+	encoder.finish(out);
+}
+
+namespace {
+
+// receives items of body in order.
+class thandler
+{
+public:
+	virtual ~thandler() {}
+	virtual void open_child(const std::string& name) = 0;
+	virtual void close_child(const std::string& name) = 0;
+	virtual void attribute(const std::string& name, const char* value, int len) = 0;
+};
+
+class tdecoder
+{
+public:
+	tdecoder(const char* data, int len)
+		: body_()
+		, p_(NULL)
+		, end_(NULL)
+		, names_(dictionary.names)
+	{
+		if (!is_binary(data, len)) {
+			throw config::error("invalid binary WML");
+		}
+		const uint8_t* p = (const uint8_t*)data + 2;
+		const uint8_t* end = (const uint8_t*)data + len;
+		if (data[1] & FLAG_DEFLATE) {
+			p_ = p;
+			end_ = end;
+			uLongf size = read_varint();
+			if (size > 40000000) {
+				throw config::error("binary WML exceeds 40MB limit");
+			}
+			body_.resize(size);
+			if (size && uncompress((Bytef*)&body_[0], &size, p_, end_ - p_) != Z_OK) {
+				throw config::error("failed to inflate binary WML");
+			}
+			p_ = (const uint8_t*)body_.data();
+			end_ = p_ + size;
+		} else {
+			p_ = p;
+			end_ = end;
+		}
+	}
+
+	void decode(thandler& handler)
+	{
+		std::vector<std::string> stack;
+		while (p_ < end_) {
+			const uint32_t header = read_varint();
+			const int kind = header & 0x3;
+			if (!header) {
+				if (stack.empty()) {
+					throw config::error("unexpected end of child in binary WML");
+				}
+				handler.close_child(stack.back());
+				stack.pop_back();
+				continue;
+			}
+			const std::string& name = read_name(header >> 2);
+			if (kind == 1) {
+				const uint32_t len = read_varint();
+				if (len > (uint32_t)(end_ - p_)) {
+					throw config::error("truncated binary WML");
+				}
+				handler.attribute(name, (const char*)p_, len);
+				p_ += len;
+
+			} else if (kind == 2) {
+				if (stack.size() >= 1000) {
+					throw config::error("elements nested too deep");
+				}
+				stack.push_back(name);
+				handler.open_child(name);
+
+			} else {
+				throw config::error("invalid item in binary WML");
+			}
+		}
+		if (!stack.empty()) {
+			throw config::error("unterminated child in binary WML");
+		}
+	}
+
+private:
+	uint32_t read_varint()
+	{
+		uint32_t value = 0;
+		for (int shift = 0; shift < 35; shift += 7) {
+			if (p_ >= end_) {
+				throw config::error("truncated binary WML");
+			}
+			const uint8_t byte = *p_ ++;
+			value |= (uint32_t)(byte & 0x7f) << shift;
+			if (!(byte & 0x80)) {
+				return value;
+			}
+		}
+		throw config::error("invalid varint in binary WML");
+	}
+
+	const std::string& read_name(uint32_t ref)
+	{
+		if (ref) {
+			if (ref > names_.size()) {
+				throw config::error("invalid name in binary WML");
+			}
+			return names_[ref - 1];
+		}
+		const uint32_t len = read_varint();
+		if (len > (uint32_t)(end_ - p_)) {
+			throw config::error("truncated binary WML");
+		}
+		names_.push_back(std::string((const char*)p_, len));
+		p_ += len;
+		return names_.back();
+	}
+
+	std::string body_;
+	const uint8_t* p_;
+	const uint8_t* end_;
+	std::vector<std::string> names_;
+};
+
+class tconfig_handler: public thandler
+{
+public:
+	tconfig_handler(config& cfg)
+		: stack_(1, &cfg)
+	{}
+
+	void open_child(const std::string& name) { stack_.push_back(&stack_.back()->add_child(name)); }
+	void close_child(const std::string&) { stack_.pop_back(); }
+	void attribute(const std::string& name, const char* value, int len) { (*stack_.back())[name] = std::string(value, len); }
+
+private:
+	std::vector<config*> stack_;
+};
+
+class ttext_handler: public thandler
+{
+public:
+	ttext_handler(std::string& out)
+		: out_(out)
+	{}
+
+	void open_child(const std::string& name)
+	{
+		out_ += "[";
+		out_ += name;
+		out_ += "]\n";
+	}
+	void close_child(const std::string& name)
+	{
+		out_ += "[/";
+		out_ += name;
+		out_ += "]\n";
+	}
+	void attribute(const std::string& name, const char* value, int len)
+	{
+		out_ += name;
+		out_ += "=\"";
+		for (int i = 0; i < len; i ++) {
+			if (value[i] == '"') {
+				out_.push_back('"');
+			}
+			out_.push_back(value[i]);
+		}
+		out_ += "\"\n";
+	}
+
+private:
+	std::string& out_;
+};
+
+}
+
+void read(config& cfg, const char* data, int len)
+{
+	cfg.clear();
+	tdecoder decoder(data, len);
+	tconfig_handler handler(cfg);
+	decoder.decode(handler);
+}
+
+void read_text(std::string& out, const char* data, int len)
+{
+	out.clear();
+	tdecoder decoder(data, len);
+	ttext_handler handler(out);
+	decoder.decode(handler);
+}
+
+namespace {
+struct tstats
+{
+	tstats()
+		: count(0)
+		, text_size(0)
+		, binary_size(0)
+		, text_encode(0)
+		, text_decode(0)
+		, binary_encode(0)
+		, binary_decode(0)
+	{}
+
+	int count;
+	Uint64 text_size;
+	Uint64 binary_size;
+	Uint64 text_encode;
+	Uint64 text_decode;
+	Uint64 binary_encode;
+	Uint64 binary_decode;
+};
+
+// network threads compare too.
+threading::mutex stats_mutex;
+std::map<std::string, tstats> stats;
+SDL_atomic_t compare_counter;
+}
+
+bool compare_due()
+{
+	// it is called for every message, disabled costs neither lock nor atomic.
+	const int interval = compare_interval;
+	if (!interval) {
+		return false;
+	}
+	return !((SDL_AtomicAdd(&compare_counter, 1) + 1) % interval);
+}
+
+void compare(const std::string& type, const config& cfg)
+{
+	if (!compare_due()) {
+		return;
+	}
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	std::ostringstream text;
+	{
+		config_writer writer(text, true);
+		writer.write(cfg);
+	}
+	const std::string text_str = text.str();
+	const Uint64 text_encode = SDL_GetPerformanceCounter() - start;
+
+	start = SDL_GetPerformanceCounter();
+	{
+		config tmp;
+		std::istringstream stream(text_str);
+		read_gz(tmp, stream);
+	}
+	const Uint64 text_decode = SDL_GetPerformanceCounter() - start;
+
+	start = SDL_GetPerformanceCounter();
+	std::string binary;
+	write(binary, cfg);
+	const Uint64 binary_encode = SDL_GetPerformanceCounter() - start;
+
+	start = SDL_GetPerformanceCounter();
+	{
+		config tmp;
+		read(tmp, binary.data(), binary.size());
+	}
+	const Uint64 binary_decode = SDL_GetPerformanceCounter() - start;
+
+	record(type, text_str.size(), binary.size(), text_encode, text_decode, binary_encode, binary_decode);
+}
+
+void record(const std::string& type, size_t text_size, size_t binary_size, Uint64 text_encode, Uint64 text_decode, Uint64 binary_encode, Uint64 binary_decode)
+{
+	const threading::lock lock(stats_mutex);
+	tstats& s = stats[type];
+	s.count ++;
+	s.text_size += text_size;
+	s.binary_size += binary_size;
+	s.text_encode += text_encode;
+	s.text_decode += text_decode;
+	s.binary_encode += binary_encode;
+	s.binary_decode += binary_decode;
+}
+
+std::string stats_report()
+{
+	const threading::lock lock(stats_mutex);
+	if (stats.empty()) {
+		return compare_interval? "No message is compared yet.\n": "Comparison of wire format is disabled.\n";
+	}
+
+	// average per message, time is in microsecond.
+	const Uint64 freq = SDL_GetPerformanceFrequency() / 1000000? SDL_GetPerformanceFrequency() / 1000000: 1;
+	std::stringstream strstr;
+	strstr << "Wire format, average per message (size in bytes, time in us):\n";
+	strstr << std::setw(20) << "type" << std::setw(8) << "count"
+		<< std::setw(10) << "text" << std::setw(10) << "binary"
+		<< std::setw(10) << "t.enc" << std::setw(10) << "t.dec"
+		<< std::setw(10) << "b.enc" << std::setw(10) << "b.dec" << "\n";
+	for (std::map<std::string, tstats>::const_iterator it = stats.begin(); it != stats.end(); ++ it) {
+		const tstats& s = it->second;
+		strstr << std::setw(20) << it->first << std::setw(8) << s.count
+			<< std::setw(10) << s.text_size / s.count << std::setw(10) << s.binary_size / s.count
+			<< std::setw(10) << s.text_encode / freq / s.count << std::setw(10) << s.text_decode / freq / s.count
+			<< std::setw(10) << s.binary_encode / freq / s.count << std::setw(10) << s.binary_decode / freq / s.count << "\n";
+	}
+	return strstr.str();
+}
+
+}
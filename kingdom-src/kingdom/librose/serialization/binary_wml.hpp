@@ -0,0 +1,96 @@
+/** @file */
+
+#ifndef SERIALIZATION_BINARY_WML_HPP_INCLUDED
+#define SERIALIZATION_BINARY_WML_HPP_INCLUDED
+
+#include "SDL_types.h"
+#include <map>
+#include <string>
+
+class config;
+
+/**
+ * Compact binary WML for network messages.
+ *
+ * message: {magic}{flags}[{varint raw size}]{body}, body is deflated if
+ * FLAG_DEFLATE is set. That is done only when body is larger than threshold.
+ *
+ * body is a stream of items, header of every item is a varint: (name << 2) | kind.
+ * - kind 0: end of current child, header is 0.
+ * - kind 1: attribute, value follows as {varint length}{bytes}.
+ * - kind 2: open child.
+ * name is index + 1 into names of this message, names begin with the shared
+ * dictionary. name 0 means name follows as {varint length}{bytes}, and it is
+ * appended to names, so the second use of it is an index too.
+ *
+ * Both sides must have the same dictionary, its version is exchanged at
+ * handshake. Peer that doesn't announce it receives gzip text WML.
+ * First byte of gzip is 31, so receiver can recognize format of every message.
+ */
+namespace binary_wml {
+
+enum {MAGIC = 0xb7};
+enum {FLAG_DEFLATE = 0x1};
+
+// body larger than this will be deflated.
+extern int compress_threshold;
+
+/** version of dictionary. it is changed whenever dictionary is changed. */
+int dictionary_version();
+
+/** 4 bytes value that client sends at connect to announce binary WML. */
+uint32_t handshake();
+bool is_handshake(uint32_t value);
+
+// server adds it to connection number it replies when binary WML is accepted.
+static const uint32_t handshake_accepted = 0x40000000;
+
+bool is_binary(const char* data, int len);
+
+class tencoder
+{
+public:
+	tencoder();
+
+	void open_child(const char* name, int len);
+	void close_child();
+	void attribute(const char* name, int name_len, const char* value, int value_len);
+
+	/** seal body into message, it is deflated if body is larger than compress_threshold. */
+	void finish(std::string& out);
+
+private:
+	void write_name(int kind, const char* name, int len);
+	void write_varint(uint32_t value);
+
+	std::string body_;
+	// names of this message that aren't in dictionary.
+	std::map<std::string, int> names_;
+};
+
+/** config to message. */
+void write(std::string& out, const config& cfg);
+
+/** message to config, throws config::error if message is invalid. */
+void read(config& cfg, const char* data, int len);
+
+/** message to text WML, simple_wml of server parses it. */
+void read_text(std::string& out, const char* data, int len);
+
+/**
+ * size and time of both encodings, per message type.
+ * compare_interval: every Nth message is encoded both ways, 0 disables it.
+ */
+extern int compare_interval;
+
+/** count one message, true if it should be compared. */
+bool compare_due();
+
+/** compare two encodings of cfg, if it is time to. */
+void compare(const std::string& type, const config& cfg);
+void record(const std::string& type, size_t text_size, size_t binary_size, Uint64 text_encode, Uint64 text_decode, Uint64 binary_encode, Uint64 binary_decode);
+std::string stats_report();
+
+}
+
+#endif
@@ -49,13 +49,18 @@ static const size_t max_recursion_levels = 1000;
 
 namespace {
 
+unsigned char first_char(const token& tok)
+{
+	return tok.value.empty()? 0: static_cast<unsigned char>(tok.value[0]);
+}
+
 class parser
 {
 	parser();
 	parser(const parser&);
 	parser& operator=(const parser&);
 public:
-	parser(config& cfg, std::istream& in);
+	parser(config& cfg, const char* data, size_t size);
 	~parser();
 	void operator()();
 
@@ -84,9 +89,9 @@ private:
 	std::stack<element> elements;
 };
 
-parser::parser(config &cfg, std::istream &in) :
+parser::parser(config &cfg, const char* data, size_t size) :
 		cfg_(cfg),
-		tok_(new tokenizer(in)),
+		tok_(new tokenizer(data, size)),
 		elements()
 {
 }
@@ -115,9 +120,9 @@ void parser::operator()()
 			parse_variable();
 			break;
 		default:
-			if (static_cast<unsigned char>(tok_->current_token().value[0]) == 0xEF &&
-			    static_cast<unsigned char>(tok_->next_token().value[0])    == 0xBB &&
-			    static_cast<unsigned char>(tok_->next_token().value[0])    == 0xBF)
+			if (first_char(tok_->current_token()) == 0xEF &&
+			    first_char(tok_->next_token())    == 0xBB &&
+			    first_char(tok_->next_token())    == 0xBF)
 			{
 				ERR_CF << "Skipping over a utf8 BOM\n";
 			} else {
@@ -151,7 +156,7 @@ void parser::parse_element()
 
 	switch(tok_->current_token().type) {
 	case token::STRING: // [element]
-		elname = tok_->current_token().value;
+		elname.assign(tok_->current_token().value.data(), tok_->current_token().value.size());
 		if (tok_->next_token().type != ']')
 			error(_("Unterminated [element] tag"));
 
@@ -163,7 +168,7 @@ void parser::parse_element()
 	case '+': // [+element]
 		if (tok_->next_token().type != token::STRING)
 			error(_("Invalid tag name"));
-		elname = tok_->current_token().value;
+		elname.assign(tok_->current_token().value.data(), tok_->current_token().value.size());
 		if (tok_->next_token().type != ']')
 			error(_("Unterminated [+element] tag"));
 
@@ -180,7 +185,7 @@ void parser::parse_element()
 	case '/': // [/element]
 		if(tok_->next_token().type != token::STRING)
 			error(_("Invalid closing tag name"));
-		elname = tok_->current_token().value;
+		elname.assign(tok_->current_token().value.data(), tok_->current_token().value.size());
 		if(tok_->next_token().type != ']')
 			error(_("Unterminated closing tag"));
 		if(elements.size() <= 1)
@@ -213,7 +218,7 @@ void parser::parse_variable()
 		case token::STRING:
 			if(!variables.back().empty())
 				variables.back() += ' ';
-			variables.back() += tok_->current_token().value;
+			variables.back().append(tok_->current_token().value.data(), tok_->current_token().value.size());
 			break;
 		case ',':
 			if(variables.back().empty()) {
@@ -232,6 +237,9 @@ void parser::parse_variable()
 		error(_("Empty variable name"));
 
 	t_string_base buffer;
+	// most values are one token, it is stored to config without t_string_base.
+	boost::string_ref pending;
+	bool has_pending = false, empty = true;
 
 	std::vector<std::string>::const_iterator curvar = variables.begin();
 
@@ -240,7 +248,18 @@ void parser::parse_variable()
 		tok_->next_token();
 		assert(curvar != variables.end());
 
-		switch (tok_->current_token().type) {
+		const token& tok = tok_->current_token();
+		if (has_pending) {
+			if (tok.type == token::END || (tok.type == token::LF && !ignore_next_newlines)) {
+				goto finish;
+			}
+			// tokenizer keeps previous token valid.
+			buffer += pending.to_string();
+			has_pending = false;
+			empty = false;
+		}
+
+		switch (tok.type) {
 		case ',':
 			if ((curvar+1) != variables.end()) {
 				if (buffer.translatable())
@@ -248,6 +267,7 @@ void parser::parse_variable()
 				else
 					cfg[*curvar] = buffer.value();
 				buffer = t_string_base();
+				empty = true;
 				++curvar;
 			} else {
 				buffer += ",";
@@ -260,11 +280,11 @@ void parser::parse_variable()
 				error(_("Unterminated quoted string"));
 				break;
 			case token::QSTRING:
-				buffer += t_string_base(tok_->current_token().value, tok_->textdomain());
+				buffer += t_string_base(tok_->current_token().value.to_string(), tok_->textdomain());
 				break;
 			default:
 				buffer += "_";
-				buffer += tok_->current_token().value;
+				buffer += tok_->current_token().value.to_string();
 				break;
 			case token::END:
 			case token::LF:
@@ -279,10 +299,15 @@ void parser::parse_variable()
 			if (previous_string) buffer += " ";
 			//nobreak
 		default:
-			buffer += tok_->current_token().value;
+			buffer += tok.value.to_string();
 			break;
 		case token::QSTRING:
-			buffer += tok_->current_token().value;
+			if (empty) {
+				pending = tok.value;
+				has_pending = true;
+			} else {
+				buffer += tok.value.to_string();
+			}
 			break;
 		case token::UNTERMINATED_QSTRING:
 			error(_("Unterminated quoted string"));
@@ -294,12 +319,15 @@ void parser::parse_variable()
 			goto finish;
 		}
 
-		previous_string = tok_->current_token().type == token::STRING;
+		previous_string = tok.type == token::STRING;
 		ignore_next_newlines = false;
+		empty = false;
 	}
 
 	finish:
-	if (buffer.translatable())
+	if (has_pending)
+		cfg[*curvar] = pending.to_string();
+	else if (buffer.translatable())
 		cfg[*curvar] = t_string(buffer);
 	else
 		cfg[*curvar] = buffer.value();
@@ -325,7 +353,7 @@ void parser::error(const std::string& error_type)
 {
 	utils::string_map i18n_symbols;
 	i18n_symbols["error"] = error_type;
-	i18n_symbols["value"] = tok_->current_token().value;
+	i18n_symbols["value"] = tok_->current_token().value.to_string();
 	std::stringstream ss;
 	ss << tok_->get_start_line() << " " << tok_->get_file();
 
@@ -334,15 +362,47 @@ void parser::error(const std::string& error_type)
 
 } // end anon namespace
 
+void read(config &cfg, const char* data, size_t size)
+{
+	parser(cfg, data, size)();
+}
+
+namespace {
+
+// tokenizer wants whole input in one buffer.
+void read_stream(std::istream &in, std::vector<char> &buf)
+{
+	const size_t block_size = 64 * 1024;
+	in.exceptions(std::ios_base::badbit);
+	try {
+		size_t size = 0;
+		do {
+			buf.resize(size + block_size);
+			in.read(&buf[size], block_size);
+			size += in.gcount();
+		} while (in.good());
+		buf.resize(size);
+	} catch (...) {
+		in.clear(std::ios_base::goodbit);
+		in.exceptions(std::ios_base::goodbit);
+		throw;
+	}
+	in.clear(std::ios_base::goodbit);
+	in.exceptions(std::ios_base::goodbit);
+}
+
+}
+
 void read(config &cfg, std::istream &in)
 {
-	parser(cfg, in)();
+	std::vector<char> buf;
+	read_stream(in, buf);
+	read(cfg, buf.empty()? NULL: &buf[0], buf.size());
 }
 
 void read(config &cfg, const std::string &in)
 {
-	std::istringstream ss(in);
-	parser(cfg, ss)();
+	read(cfg, in.c_str(), in.size());
 }
 
 void read_gz(config &cfg, std::istream &file)
@@ -356,7 +416,9 @@ void read_gz(config &cfg, std::istream &file)
 	filter.push(boost::iostreams::gzip_decompressor());
 	filter.push(file);
 
-	parser(cfg, filter)();
+	std::vector<char> buf;
+	read_stream(filter, buf);
+	read(cfg, buf.empty()? NULL: &buf[0], buf.size());
 }
 
 static std::string escaped_string(const std::string &value)
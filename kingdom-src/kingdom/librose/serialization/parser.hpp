@@ -23,6 +23,9 @@
 #include "config.hpp"
 
 // Read data in, clobbering existing data.
+// data is parsed in place, values are copied only when they are stored to cfg.
+void read(config &cfg, const char* data, size_t size); 	// Throws config::error
+// istream is read to a buffer first.
 void read(config &cfg, std::istream &in); 	// Throws config::error
 void read(config &cfg, const std::string &in); 	// Throws config::error
 void read_gz(config &cfg, std::istream &in);
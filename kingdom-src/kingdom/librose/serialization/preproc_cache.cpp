@@ -0,0 +1,326 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/**
+ * @file
+ * Persistent entries of preprocessor cache.
+ */
+
+#include "global.hpp"
+
+#include "serialization/preproc_cache.hpp"
+#include "filesystem.hpp"
+#include "log.hpp"
+#include "sha1.hpp"
+
+#include <cstring>
+#include <sstream>
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+static lg::log_domain log_preprocessor("preprocessor");
+#define ERR_PREPROC LOG_STREAM(err, log_preprocessor)
+
+namespace preproc_cache {
+
+namespace {
+
+const uint32_t entry_fourcc = mmioFOURCC('P', 'P', 'C', '0');
+// different define sets of one file, i.e. campaigns, that are kept.
+const size_t max_entries = 8;
+
+// crc covers everything after header.
+struct tfile_header {
+	uint32_t fourcc;
+	uint32_t crc;
+	uint32_t size;
+	int entries;
+};
+
+void put_int(std::string& buf, uint32_t n)
+{
+	buf.append((const char*)&n, sizeof(n));
+}
+
+void put_string(std::string& buf, const std::string& str)
+{
+	put_int(buf, str.size());
+	buf.append(str);
+}
+
+void put_define(std::string& buf, const preproc_define& define)
+{
+	put_string(buf, define.value);
+	put_int(buf, define.arguments.size());
+	for (std::vector<std::string>::const_iterator it = define.arguments.begin(); it != define.arguments.end(); ++ it) {
+		put_string(buf, *it);
+	}
+	put_string(buf, define.textdomain);
+	put_int(buf, define.linenum);
+	put_string(buf, define.location);
+}
+
+void put_entry(std::string& buf, const tentry& entry)
+{
+	put_string(buf, entry.hash);
+	put_int(buf, entry.unicode? 1: 0);
+	put_int(buf, entry.nested? 1: 0);
+	put_string(buf, entry.textdomain);
+
+	put_int(buf, entry.names.size());
+	for (std::vector<std::string>::const_iterator it = entry.names.begin(); it != entry.names.end(); ++ it) {
+		put_string(buf, *it);
+	}
+	put_int(buf, entry.uses.size());
+	for (std::vector<std::pair<std::string, std::string> >::const_iterator it = entry.uses.begin(); it != entry.uses.end(); ++ it) {
+		put_string(buf, it->first);
+		put_string(buf, it->second);
+	}
+	put_int(buf, entry.files.size());
+	for (std::vector<std::pair<std::string, std::string> >::const_iterator it = entry.files.begin(); it != entry.files.end(); ++ it) {
+		put_string(buf, it->first);
+		put_string(buf, it->second);
+	}
+	put_int(buf, entry.defines.size());
+	for (std::vector<std::pair<std::string, preproc_define> >::const_iterator it = entry.defines.begin(); it != entry.defines.end(); ++ it) {
+		put_string(buf, it->first);
+		put_define(buf, it->second);
+	}
+	put_int(buf, entry.undefs.size());
+	for (std::vector<std::string>::const_iterator it = entry.undefs.begin(); it != entry.undefs.end(); ++ it) {
+		put_string(buf, *it);
+	}
+	put_string(buf, entry.output);
+}
+
+class treader
+{
+public:
+	treader(const char* data, size_t size)
+		: pos_(data)
+		, end_(data + size)
+		, valid_(true)
+	{}
+
+	bool valid() const { return valid_; }
+
+	uint32_t get_int()
+	{
+		uint32_t n = 0;
+		if (end_ - pos_ < (int)sizeof(n)) {
+			valid_ = false;
+			return 0;
+		}
+		memcpy(&n, pos_, sizeof(n));
+		pos_ += sizeof(n);
+		return n;
+	}
+
+	void get_string(std::string& str)
+	{
+		const uint32_t size = get_int();
+		if ((uint32_t)(end_ - pos_) < size) {
+			valid_ = false;
+			return;
+		}
+		str.assign(pos_, size);
+		pos_ += size;
+	}
+
+	void get_define(preproc_define& define)
+	{
+		get_string(define.value);
+		define.arguments.resize(get_count());
+		for (std::vector<std::string>::iterator it = define.arguments.begin(); it != define.arguments.end(); ++ it) {
+			get_string(*it);
+		}
+		get_string(define.textdomain);
+		define.linenum = get_int();
+		get_string(define.location);
+	}
+
+	void get_entry(tentry& entry)
+	{
+		get_string(entry.hash);
+		entry.unicode = get_int()? true: false;
+		entry.nested = get_int()? true: false;
+		get_string(entry.textdomain);
+
+		entry.names.resize(get_count());
+		for (std::vector<std::string>::iterator it = entry.names.begin(); it != entry.names.end(); ++ it) {
+			get_string(*it);
+		}
+		entry.uses.resize(get_count());
+		for (std::vector<std::pair<std::string, std::string> >::iterator it = entry.uses.begin(); it != entry.uses.end(); ++ it) {
+			get_string(it->first);
+			get_string(it->second);
+		}
+		entry.files.resize(get_count());
+		for (std::vector<std::pair<std::string, std::string> >::iterator it = entry.files.begin(); it != entry.files.end(); ++ it) {
+			get_string(it->first);
+			get_string(it->second);
+		}
+		entry.defines.resize(get_count());
+		for (std::vector<std::pair<std::string, preproc_define> >::iterator it = entry.defines.begin(); it != entry.defines.end(); ++ it) {
+			get_string(it->first);
+			get_define(it->second);
+		}
+		entry.undefs.resize(get_count());
+		for (std::vector<std::string>::iterator it = entry.undefs.begin(); it != entry.undefs.end(); ++ it) {
+			get_string(*it);
+		}
+		get_string(entry.output);
+	}
+
+private:
+	// every item takes at least 4 bytes, so a bad count can't allocate much.
+	uint32_t get_count()
+	{
+		const uint32_t count = get_int();
+		if (count > (uint32_t)(end_ - pos_) / sizeof(uint32_t)) {
+			valid_ = false;
+			return 0;
+		}
+		return count;
+	}
+
+	const char* pos_;
+	const char* end_;
+	bool valid_;
+};
+
+bool same_dependencies(const tentry& a, const tentry& b)
+{
+	return a.unicode == b.unicode && a.nested == b.nested && a.textdomain == b.textdomain && a.uses == b.uses && a.files == b.files;
+}
+
+}
+
+std::string entry_file(const std::string& dir, const std::string& file)
+{
+	return dir + "/" + sha1_hash(file).display() + ".pp";
+}
+
+bool load(const std::string& dir, const std::string& file, std::vector<tentry>& entries)
+{
+	uint32_t fsizelow, fsizehigh, bytertd;
+
+	entries.clear();
+
+	tfopen_lock lock(entry_file(dir, file), GENERIC_READ, OPEN_EXISTING);
+	if (!lock.valid()) {
+		return false;
+	}
+	posix_fsize(lock.fp, fsizelow, fsizehigh);
+	if (fsizehigh || fsizelow < sizeof(tfile_header)) {
+		return false;
+	}
+	std::vector<char> data(fsizelow);
+	posix_fseek(lock.fp, 0, 0);
+	posix_fread(lock.fp, &data[0], fsizelow, bytertd);
+	if (bytertd != fsizelow) {
+		return false;
+	}
+
+	tfile_header header;
+	memcpy(&header, &data[0], sizeof(header));
+	const char* payload = &data[0] + sizeof(header);
+	if (header.fourcc != entry_fourcc || header.size != fsizelow - sizeof(header)
+		|| header.crc != crc32(crc32(0, NULL, 0), (const Bytef*)payload, header.size)) {
+		ERR_PREPROC << "preprocessor cache of " << file << " is corrupt, ignore it\n";
+		return false;
+	}
+
+	treader reader(payload, header.size);
+	entries.resize(header.entries);
+	for (std::vector<tentry>::iterator it = entries.begin(); it != entries.end() && reader.valid(); ++ it) {
+		reader.get_entry(*it);
+	}
+	if (!reader.valid()) {
+		entries.clear();
+		return false;
+	}
+	return true;
+}
+
+void store(const std::string& dir, const std::string& file, const tentry& entry)
+{
+	std::vector<tentry> entries;
+	load(dir, file, entries);
+
+	for (std::vector<tentry>::iterator it = entries.begin(); it != entries.end(); ) {
+		if (it->hash != entry.hash || same_dependencies(*it, entry)) {
+			it = entries.erase(it);
+		} else {
+			++ it;
+		}
+	}
+	if (entries.size() >= max_entries) {
+		entries.erase(entries.begin(), entries.begin() + entries.size() - max_entries + 1);
+	}
+	entries.push_back(entry);
+
+	std::string payload;
+	for (std::vector<tentry>::const_iterator it = entries.begin(); it != entries.end(); ++ it) {
+		put_entry(payload, *it);
+	}
+	tfile_header header;
+	header.fourcc = entry_fourcc;
+	header.size = payload.size();
+	header.crc = crc32(crc32(0, NULL, 0), (const Bytef*)payload.data(), payload.size());
+	header.entries = entries.size();
+	payload.insert(0, (const char*)&header, sizeof(header));
+
+	// other instance may read or write it at the same time, write to temporary file and rename.
+	const std::string dst = entry_file(dir, file);
+	std::stringstream tmp_ss;
+	tmp_ss << dst << "." << getpid() << ".tmp";
+	const std::string tmp = tmp_ss.str();
+	uint32_t bytertd = 0;
+	{
+		tfopen_lock lock(tmp, GENERIC_WRITE, CREATE_ALWAYS);
+		if (!lock.valid()) {
+			ERR_PREPROC << "can not write preprocessor cache " << tmp << "\n";
+			return;
+		}
+		posix_fwrite(lock.fp, payload.data(), payload.size(), bytertd);
+	}
+	if (bytertd != payload.size()) {
+		// i.e. disk is full, don't leave partial file of this pid behind.
+		ERR_PREPROC << "can not write preprocessor cache " << tmp << "\n";
+		remove(tmp.c_str());
+		return;
+	}
+	// rename() doesn't replace existing file on windows.
+	remove(dst.c_str());
+	if (rename(tmp.c_str(), dst.c_str())) {
+		ERR_PREPROC << "can not rename " << tmp << " to " << dst << "\n";
+		return;
+	}
+	stats().stored ++;
+}
+
+tstats& stats()
+{
+	static tstats s;
+	return s;
+}
+
+}
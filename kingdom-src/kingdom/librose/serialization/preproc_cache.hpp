@@ -0,0 +1,103 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/** @file */
+
+#ifndef SERIALIZATION_PREPROC_CACHE_HPP_INCLUDED
+#define SERIALIZATION_PREPROC_CACHE_HPP_INCLUDED
+
+#include "posix.h"
+#include "serialization/preprocessor.hpp"
+
+#include <string>
+#include <vector>
+
+namespace preproc_cache {
+
+/**
+ * Preprocessed output of one .cfg file, and what it depends on.
+ *
+ * Locations in output and in defines don't use file codes of this run, file
+ * names are in names, and location of including file is replaced by '@'.
+ * So entry can be used from another run and from another including line.
+ */
+struct tentry
+{
+	tentry()
+		: hash()
+		, unicode(false)
+		, nested(false)
+		, textdomain()
+		, names()
+		, uses()
+		, files()
+		, defines()
+		, undefs()
+		, output()
+	{}
+
+	// sha1 of file content.
+	std::string hash;
+	bool unicode;
+	// file was included by another file.
+	bool nested;
+	// textdomain when file was included.
+	std::string textdomain;
+
+	std::vector<std::string> names;
+	// macros that file used before it defined them, with their fingerprint. "" is undefined.
+	std::vector<std::pair<std::string, std::string> > uses;
+	// included files with their sha1.
+	std::vector<std::pair<std::string, std::string> > files;
+	// macros that are defined or undefined when file ends.
+	std::vector<std::pair<std::string, preproc_define> > defines;
+	std::vector<std::string> undefs;
+	std::string output;
+};
+
+/** file that keeps entries of one .cfg file in dir. */
+std::string entry_file(const std::string& dir, const std::string& file);
+
+/**
+ * read entries of file, newest last.
+ * @return false if there is no entry or it is corrupt.
+ */
+bool load(const std::string& dir, const std::string& file, std::vector<tentry>& entries);
+
+/**
+ * add entry of file. Entries of other content are dropped, and an entry of same
+ * dependencies is replaced.
+ */
+void store(const std::string& dir, const std::string& file, const tentry& entry);
+
+struct tstats
+{
+	tstats()
+		: hits(0)
+		, misses(0)
+		, stored(0)
+		, hit_bytes(0)
+	{}
+
+	int hits;
+	int misses;
+	int stored;
+	int64_t hit_bytes;
+};
+
+tstats& stats();
+
+}
+
+#endif
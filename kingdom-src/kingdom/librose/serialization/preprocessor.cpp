@@ -28,11 +28,15 @@
 #include "serialization/binary_or_text.hpp"
 #include "serialization/string_utils.hpp"
 #include "serialization/parser.hpp"
+#include "serialization/preproc_cache.hpp"
 #include "filesystem.hpp"
+#include "sha1.hpp"
 #include "util.hpp"
 #include "wml_exception.hpp"
 
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
+#include <set>
 #include <stdexcept>
 
 static lg::log_domain log_config("config");
@@ -50,9 +54,14 @@ using std::streambuf;
 // map associating each filename encountered to a number
 typedef std::map<std::string, int> t_file_number_map;
 static t_file_number_map file_number_map;
+// filename of code n is file_names[n - 1].
+static std::vector<std::string> file_names;
 
 static bool encode_filename = true;
 
+// directory of preprocessor cache, empty if it is disabled.
+static std::string cache_dir;
+
 // get filename associated to this code
 static std::string get_filename(const std::string& file_code){
 	if(!encode_filename)
@@ -63,28 +72,32 @@ static std::string get_filename(const std::string& file_code){
 	int n = 0;
 	s >> std::hex >> n;
 
-	BOOST_FOREACH (const t_file_number_map::value_type& p, file_number_map){
-		if(p.second == n)
-			return p.first;
+	if (n > 0 && n <= (int)file_names.size()) {
+		return file_names[n - 1];
 	}
 	return "<unknown>";
 }
 
+// get code associated to this escaped filename
+static std::string get_escaped_file_code(const std::string& escaped)
+{
+	int& fnum = file_number_map[escaped];
+	if (fnum == 0) {
+		file_names.push_back(escaped);
+		fnum = file_names.size();
+	}
+
+	std::ostringstream shex;
+	shex << std::hex << fnum;
+	return shex.str();
+}
+
 // get code associated to this filename
 static std::string get_file_code(const std::string& filename){
 	if(!encode_filename)
 		return filename;
 
-	// current number of encountered filenames
-	static int current_file_number = 0;
-
-	int& fnum = file_number_map[utils::escape(filename, " \\")];
-	if(fnum == 0)
-		fnum = ++current_file_number;
-
-	std::ostringstream shex;
-	shex << std::hex << fnum;
-	return shex.str();
+	return get_escaped_file_code(utils::escape(filename, " \\"));
 }
 
 // decode the filenames placed in a location
@@ -106,6 +119,169 @@ static std::string get_location(const std::string& loc)
 	return res;
 }
 
+/**
+ * Location in cache doesn't depend on file codes of this run, and on where file
+ * is included. ctx is "<line> <location>" of including file, empty if file
+ * isn't included.
+ *
+ * payload is "<line> <code> <line> <code>...", as after \376line. Codes are
+ * replaced with index of filename in names, and ctx at end with '@'.
+ */
+static std::string portable_location(const std::string& payload, const std::string& ctx
+		, std::map<std::string, int>* indexes, std::vector<std::string>* names)
+{
+	size_t size = payload.size();
+	bool in_ctx = false;
+	if (!ctx.empty()) {
+		if (payload == ctx) {
+			size = 0;
+			in_ctx = true;
+		} else if (size > ctx.size() && payload[size - ctx.size() - 1] == ' ' && !payload.compare(size - ctx.size(), ctx.size(), ctx)) {
+			size -= ctx.size() + 1;
+			in_ctx = true;
+		}
+	}
+
+	std::string res;
+	size_t pos = 0;
+	for (int n = 0; pos < size; n ++) {
+		size_t end = payload.find(' ', pos);
+		if (end == std::string::npos || end > size) {
+			end = size;
+		}
+		if (!res.empty()) {
+			res += ' ';
+		}
+		if (n & 1) {
+			const std::string name = get_filename(payload.substr(pos, end - pos));
+			std::map<std::string, int>::const_iterator it = indexes->find(name);
+			if (it == indexes->end()) {
+				it = indexes->insert(std::make_pair(name, (int)names->size())).first;
+				names->push_back(name);
+			}
+			res += lexical_cast<std::string>(it->second);
+		} else {
+			res.append(payload, pos, end - pos);
+		}
+		pos = end + 1;
+	}
+	if (in_ctx) {
+		res += res.empty()? "@": " @";
+	}
+	return res;
+}
+
+/** reverse of portable_location, at ctx. codes are file codes of names in this run. */
+static std::string current_location(const std::string& portable, const std::string& ctx, const std::vector<std::string>* codes)
+{
+	std::string res;
+	res.reserve(portable.size() + ctx.size());
+	size_t pos = 0;
+	for (int n = 0; pos < portable.size(); n ++) {
+		size_t end = portable.find(' ', pos);
+		if (end == std::string::npos) {
+			end = portable.size();
+		}
+		if (!res.empty()) {
+			res += ' ';
+		}
+		// it is called for every directive of replayed output, don't use lexical_cast.
+		if (end - pos == 1 && portable[pos] == '@') {
+			res += ctx;
+		} else if (n & 1) {
+			char* stop;
+			const size_t index = strtoul(portable.c_str() + pos, &stop, 10);
+			if (stop == portable.c_str() + end && index < codes->size()) {
+				res += (*codes)[index];
+			} else {
+				res.append(portable, pos, end - pos);
+			}
+		} else {
+			res.append(portable, pos, end - pos);
+		}
+		pos = end + 1;
+	}
+	return res;
+}
+
+/** replace payload of every \376line directive in str. */
+template <typename T>
+static std::string convert_locations(const std::string& str, T convert)
+{
+	static const std::string directive = "\376line ";
+
+	std::string res;
+	res.reserve(str.size());
+	size_t pos = 0;
+	for (;;) {
+		size_t start = str.find(directive, pos);
+		if (start == std::string::npos) {
+			break;
+		}
+		start += directive.size();
+		size_t end = str.find('\n', start);
+		if (end == std::string::npos) {
+			end = str.size();
+		}
+		res.append(str, pos, start - pos);
+		res += convert(str.substr(start, end - start));
+		pos = end;
+	}
+	res.append(str, pos, std::string::npos);
+	return res;
+}
+
+// same macros are used by many files, fingerprint is kept until macro changes.
+typedef std::map<std::pair<const preproc_map*, std::string>, std::string> t_fingerprint_map;
+static t_fingerprint_map fingerprints;
+
+/**
+ * Macros are compared by it, so a file has to be preprocessed again when
+ * value, or location that goes to its output changes.
+ * @return empty if symbol isn't defined.
+ */
+static const std::string& define_fingerprint(const preproc_map& defines, const std::string& symbol)
+{
+	static const std::string undefined;
+
+	preproc_map::const_iterator it = defines.find(symbol);
+	if (it == defines.end()) {
+		return undefined;
+	}
+	std::string& fingerprint = fingerprints[std::make_pair(&defines, symbol)];
+	if (fingerprint.empty()) {
+		const preproc_define& def = it->second;
+		std::ostringstream s;
+		s << def.value << '\0' << utils::join(def.arguments) << '\0' << def.textdomain << '\0'
+			<< def.linenum << '\0' << get_location(def.location);
+		fingerprint = sha1_hash(s.str()).display();
+	}
+	return fingerprint;
+}
+
+/** sha1 of files that are included from a directory, they may be added or removed. */
+static std::string listing_hash(const std::vector<std::string>& files)
+{
+	return sha1_hash(utils::join(files, "\n")).display();
+}
+
+/** @return sha1 of file content, or listing of directory, empty if it can't be read. */
+static std::string file_hash(const std::string& file)
+{
+	if (is_directory(file)) {
+		std::vector<std::string> files;
+		get_files_in_dir(file, &files, NULL, ENTIRE_FILE_PATH, SKIP_MEDIA_DIR, DO_REORDER);
+		return listing_hash(files);
+	}
+	scoped_istream stream = istream_file(file);
+	if (!stream->good()) {
+		return null_str;
+	}
+	std::stringstream content;
+	content << stream->rdbuf();
+	return sha1_hash(content.str()).display();
+}
+
 bool preproc_define::operator==(preproc_define const &v) const {
 	return value == v.value && arguments == v.arguments;
 }
@@ -186,6 +362,56 @@ class preprocessor_data;
 class preprocessor_streambuf;
 struct preprocessor_deleter;
 
+/**
+ * Output of a .cfg file, and macros and files it uses while it is
+ * preprocessed, stored to cache when file ends. Recorders of included files
+ * are chained to recorder of including file, what included file uses is used
+ * by including file too. A file that includes a directory, or tests for
+ * files, isn't stored.
+ */
+struct preprocessor_recorder
+{
+	preprocessor_recorder(preprocessor_recorder* parent, const std::string& file, const std::string& hash
+			, const std::string& ctx, const std::string& textdomain, bool unicode)
+		: parent(parent)
+		, file(file)
+		, hash(hash)
+		, ctx(ctx)
+		, textdomain(textdomain)
+		, unicode(unicode)
+		, start(0)
+		, aborted(false)
+		, touched()
+		, uses()
+		, files()
+		, output()
+	{}
+
+	/** first use of symbol, if file didn't define it before. */
+	void use(const std::string& symbol, const std::string& fingerprint)
+	{
+		if (!touched.count(symbol) && !uses.count(symbol)) {
+			uses[symbol] = fingerprint;
+		}
+	}
+
+	preprocessor_recorder* parent;
+	std::string file;
+	std::string hash;
+	std::string ctx;
+	std::string textdomain;
+	bool unicode;
+	// output of file in preprocessor_streambuf::buffer_ starts from it.
+	size_t start;
+	bool aborted;
+	// macros that file defined or undefined.
+	std::set<std::string> touched;
+	std::map<std::string, std::string> uses;
+	// included files and their hash.
+	std::map<std::string, std::string> files;
+	std::string output;
+};
+
 /**
  * Base class for preprocessing an input.
  */
@@ -228,11 +454,34 @@ class preprocessor_streambuf: public streambuf
 	 * Deeper-nested preprocessors are then forbidden to.
 	 */
 	bool quoted_;
+	/**
+	 * Recorder of file that is preprocessed. Streambuf that substitutes a macro
+	 * to a string shares it, but only root streambuf records output.
+	 */
+	preprocessor_recorder *recorder_;
+	bool root_;
 	friend class preprocessor;
 	friend class preprocessor_file;
 	friend class preprocessor_data;
 	friend struct preprocessor_deleter;
 	preprocessor_streambuf(preprocessor_streambuf const &);
+
+	bool cacheable() const { return root_ && !cache_dir.empty() && encode_filename && !quoted_; }
+	std::string context() const;
+	/** find macro, files that are recorded depend on it. */
+	preproc_map::const_iterator find_define(const std::string& symbol);
+	/** macro is defined or undefined. */
+	void touch_define(const std::string& symbol);
+	/** file is included, files that are recorded depend on its content. */
+	void include_file(const std::string& file, const std::string& hash);
+	/** result depends on something other than macros and files, recorded files can't be stored. */
+	void uncacheable();
+	/**
+	 * output entry when it matches file with hash, and current macros.
+	 * @return false if it doesn't match.
+	 */
+	bool replay(const preproc_cache::tentry& entry, const std::string& hash);
+	void store(preprocessor_recorder& recorder);
 public:
 	preprocessor_streambuf(preproc_map *);
 	void error(const std::string &, int);
@@ -249,7 +498,9 @@ preprocessor_streambuf::preprocessor_streambuf(preproc_map *def) :
 	location_(""),
 	linenum_(0),
 	depth_(0),
-	quoted_(false)
+	quoted_(false),
+	recorder_(NULL),
+	root_(true)
 {
 }
 
@@ -264,7 +515,9 @@ preprocessor_streambuf::preprocessor_streambuf(preprocessor_streambuf const &t)
 	location_(""),
 	linenum_(0),
 	depth_(t.depth_),
-	quoted_(t.quoted_)
+	quoted_(t.quoted_),
+	recorder_(t.recorder_),
+	root_(false)
 {
 }
 
@@ -295,6 +548,10 @@ int preprocessor_streambuf::underflow()
 		{
 			buffer_ << out_buffer_;
 		}
+		for (preprocessor_recorder* r = root_? recorder_: NULL; r; r = r->parent) {
+			// kept characters are recorded already.
+			r->start = sz;
+		}
 	} else {
 		// The internal get-data pointer is null
 	}
@@ -309,6 +566,12 @@ int preprocessor_streambuf::underflow()
 	}
 	// Update the internal state and data pointers
 	out_buffer_ = buffer_.str();
+	for (preprocessor_recorder* r = root_? recorder_: NULL; r; r = r->parent) {
+		if (!r->aborted) {
+			r->output.append(out_buffer_, r->start, std::string::npos);
+		}
+		r->start = out_buffer_.size();
+	}
 	char *begin = &*out_buffer_.begin();
 	unsigned bs = out_buffer_.size();
 	setg(begin, begin + sz, begin + bs);
@@ -396,8 +659,17 @@ class preprocessor_file: preprocessor
 {
 	std::vector< std::string > files_;
 	std::vector< std::string >::const_iterator pos_, end_;
+	preprocessor_recorder *recorder_;
+	preprocessor_recorder *old_recorder_;
+
+	/**
+	 * replay file from cache, or start to record it.
+	 * @return stream of file content, NULL if it is replayed.
+	 */
+	std::istream *open_cached(std::string const &name, std::istream *file_stream, bool cacheable);
 public:
 	preprocessor_file(preprocessor_streambuf &, std::string const &);
+	~preprocessor_file();
 	virtual bool get_chunk();
 
 	static bool open_unicode;
@@ -509,19 +781,26 @@ preprocessor_file::preprocessor_file(preprocessor_streambuf &t, std::string cons
 	preprocessor(t),
 	files_(),
 	pos_(),
-	end_()
+	end_(),
+	recorder_(NULL),
+	old_recorder_(t.recorder_)
 {
 	if (is_directory(name)) {
 		increment_preprocessor_progress(name, false);
 		get_files_in_dir(name, &files_, NULL, ENTIRE_FILE_PATH, SKIP_MEDIA_DIR, DO_REORDER);
+		// files in directory may be added or removed, listing is recorded like content of a file.
+		t.include_file(name, listing_hash(files_));
 	} else {
 		increment_preprocessor_progress(name, true);
 		std::istream * file_stream = istream_file(name, open_unicode);
 		if (!file_stream->good()) {
 			ERR_CF << "Could not open file " << name << "\n";
 			delete file_stream;
+			file_stream = NULL;
+		} else if (t.cacheable() || t.recorder_) {
+			file_stream = open_cached(name, file_stream, t.cacheable());
 		}
-		else
+		if (file_stream)
 			new preprocessor_data(t, file_stream, "", get_short_wml_path(name),
 				1, directory_name(name), t.textdomain_, NULL);
 	}
@@ -529,6 +808,167 @@ preprocessor_file::preprocessor_file(preprocessor_streambuf &t, std::string cons
 	end_ = files_.end();
 }
 
+preprocessor_file::~preprocessor_file()
+{
+	if (recorder_) {
+		if (!recorder_->aborted && !target_.quoted_) {
+			target_.store(*recorder_);
+		}
+		delete recorder_;
+	}
+	target_.recorder_ = old_recorder_;
+}
+
+std::istream *preprocessor_file::open_cached(std::string const &name, std::istream *file_stream, bool cacheable)
+{
+	std::stringstream content;
+	content << file_stream->rdbuf();
+	delete file_stream;
+	const std::string data = content.str();
+	const std::string hash = sha1_hash(data).display();
+
+	target_.include_file(name, hash);
+	if (!cacheable) {
+		return new std::istringstream(data);
+	}
+
+	preproc_cache::tstats& stats = preproc_cache::stats();
+	std::vector<preproc_cache::tentry> entries;
+	preproc_cache::load(cache_dir, name, entries);
+	for (std::vector<preproc_cache::tentry>::const_reverse_iterator it = entries.rbegin(); it != entries.rend(); ++ it) {
+		if (target_.replay(*it, hash)) {
+			stats.hits ++;
+			stats.hit_bytes += data.size();
+			return NULL;
+		}
+	}
+	stats.misses ++;
+
+	recorder_ = new preprocessor_recorder(target_.recorder_, name, hash, target_.context(), target_.textdomain_, open_unicode);
+	recorder_->start = target_.buffer_.str().size();
+	target_.recorder_ = recorder_;
+	return new std::istringstream(data);
+}
+
+std::string preprocessor_streambuf::context() const
+{
+	if (location_.empty()) {
+		return null_str;
+	}
+	std::ostringstream s;
+	s << linenum_ << ' ' << location_;
+	return s.str();
+}
+
+preproc_map::const_iterator preprocessor_streambuf::find_define(const std::string& symbol)
+{
+	for (preprocessor_recorder* r = recorder_; r; r = r->parent) {
+		r->use(symbol, define_fingerprint(*defines_, symbol));
+	}
+	return defines_->find(symbol);
+}
+
+void preprocessor_streambuf::touch_define(const std::string& symbol)
+{
+	fingerprints.erase(std::make_pair(defines_, symbol));
+	for (preprocessor_recorder* r = recorder_; r; r = r->parent) {
+		r->touched.insert(symbol);
+	}
+}
+
+void preprocessor_streambuf::include_file(const std::string& file, const std::string& hash)
+{
+	for (preprocessor_recorder* r = recorder_; r; r = r->parent) {
+		r->files.insert(std::make_pair(file, hash));
+	}
+}
+
+void preprocessor_streambuf::uncacheable()
+{
+	for (preprocessor_recorder* r = recorder_; r; r = r->parent) {
+		r->aborted = true;
+	}
+}
+
+bool preprocessor_streambuf::replay(const preproc_cache::tentry& entry, const std::string& hash)
+{
+	if (entry.hash != hash || entry.unicode != preprocessor_file::open_unicode
+		|| entry.nested == location_.empty() || entry.textdomain != textdomain_) {
+		return false;
+	}
+	for (std::vector<std::pair<std::string, std::string> >::const_iterator it = entry.uses.begin(); it != entry.uses.end(); ++ it) {
+		if (define_fingerprint(*defines_, it->first) != it->second) {
+			return false;
+		}
+	}
+	for (std::vector<std::pair<std::string, std::string> >::const_iterator it = entry.files.begin(); it != entry.files.end(); ++ it) {
+		if (file_hash(it->first) != it->second) {
+			return false;
+		}
+	}
+
+	// file that includes this one uses same macros and files.
+	for (preprocessor_recorder* r = recorder_; r; r = r->parent) {
+		for (std::vector<std::pair<std::string, std::string> >::const_iterator it = entry.uses.begin(); it != entry.uses.end(); ++ it) {
+			r->use(it->first, it->second);
+		}
+		r->files.insert(entry.files.begin(), entry.files.end());
+	}
+	// they aren't opened, but who counts opened files wants them.
+	for (std::vector<std::pair<std::string, std::string> >::const_iterator it = entry.files.begin(); it != entry.files.end(); ++ it) {
+		increment_preprocessor_progress(it->first, !is_directory(it->first));
+	}
+
+	const std::string ctx = context();
+	std::vector<std::string> codes;
+	for (std::vector<std::string>::const_iterator it = entry.names.begin(); it != entry.names.end(); ++ it) {
+		codes.push_back(get_escaped_file_code(*it));
+	}
+	buffer_ << convert_locations(entry.output, boost::bind(&current_location, _1, boost::cref(ctx), &codes));
+
+	for (std::vector<std::pair<std::string, preproc_define> >::const_iterator it = entry.defines.begin(); it != entry.defines.end(); ++ it) {
+		preproc_define& def = (*defines_)[it->first];
+		def = it->second;
+		// location has no line, add one to convert it as \376line.
+		def.location = current_location("0 " + def.location, ctx, &codes).substr(2);
+		touch_define(it->first);
+	}
+	for (std::vector<std::string>::const_iterator it = entry.undefs.begin(); it != entry.undefs.end(); ++ it) {
+		defines_->erase(*it);
+		touch_define(*it);
+	}
+	return true;
+}
+
+void preprocessor_streambuf::store(preprocessor_recorder& recorder)
+{
+	recorder.output.append(buffer_.str(), recorder.start, std::string::npos);
+
+	preproc_cache::tentry entry;
+	entry.hash = recorder.hash;
+	entry.unicode = recorder.unicode;
+	entry.nested = !recorder.ctx.empty();
+	entry.textdomain = recorder.textdomain;
+
+	std::map<std::string, int> indexes;
+	entry.output = convert_locations(recorder.output, boost::bind(&portable_location, _1, boost::cref(recorder.ctx), &indexes, &entry.names));
+	entry.uses.assign(recorder.uses.begin(), recorder.uses.end());
+	entry.files.assign(recorder.files.begin(), recorder.files.end());
+
+	for (std::set<std::string>::const_iterator it = recorder.touched.begin(); it != recorder.touched.end(); ++ it) {
+		preproc_map::const_iterator def = defines_->find(*it);
+		if (def == defines_->end()) {
+			entry.undefs.push_back(*it);
+			continue;
+		}
+		entry.defines.push_back(std::make_pair(*it, def->second));
+		std::string& location = entry.defines.back().second.location;
+		location = portable_location("0 " + location, recorder.ctx, &indexes, &entry.names).substr(2);
+	}
+
+	preproc_cache::store(cache_dir, recorder.file, entry);
+}
+
 /**
  * preprocessor_file::get_chunk()
  *
@@ -860,19 +1300,20 @@ bool preprocessor_data::get_chunk()
 				buffer.erase(buffer.end() - 7, buffer.end());
 				(*target_.defines_)[symbol] = preproc_define(buffer, items, target_.textdomain_,
 					                       linenum + 1, target_.location_);
+				target_.touch_define(symbol);
 				LOG_CF << "defining macro " << symbol << " (location " << get_location(target_.location_) << ")\n";
 			}
 		} else if (command == "ifdef") {
 			skip_spaces();
 			std::string const &symbol = read_word();
-			bool found = target_.defines_->count(symbol) != 0;
+			bool found = target_.find_define(symbol) != target_.defines_->end();
 			DBG_CF << "testing for macro " << symbol << ": "
 				<< (found ? "defined" : "not defined") << '\n';
 			conditional_skip(!found);
 		} else if (command == "ifndef") {
 			skip_spaces();
 			std::string const &symbol = read_word();
-			bool found = target_.defines_->count(symbol) != 0;
+			bool found = target_.find_define(symbol) != target_.defines_->end();
 			DBG_CF << "testing for macro " << symbol << ": "
 				<< (found ? "defined" : "not defined") << '\n';
 			conditional_skip(found);
@@ -880,6 +1321,7 @@ bool preprocessor_data::get_chunk()
 			skip_spaces();
 			std::string const &symbol = read_word();
 			bool found = !get_wml_location(symbol, directory_).empty();
+			target_.uncacheable();
 			DBG_CF << "testing for file or directory " << symbol << ": "
 				<< (found ? "found" : "not found") << '\n';
 			conditional_skip(!found);
@@ -887,6 +1329,7 @@ bool preprocessor_data::get_chunk()
 			skip_spaces();
 			std::string const &symbol = read_word();
 			bool found = !get_wml_location(symbol, directory_).empty();
+			target_.uncacheable();
 			DBG_CF << "testing for file or directory " << symbol << ": "
 				<< (found ? "found" : "not found") << '\n';
 			conditional_skip(found);
@@ -928,6 +1371,7 @@ bool preprocessor_data::get_chunk()
 			std::string const &symbol = read_word();
 			if (!skipping_) {
 				target_.defines_->erase(symbol);
+				target_.touch_define(symbol);
 				LOG_CF << "undefine macro " << symbol << " (location " << get_location(target_.location_) << ")\n";
 			}
 		} else if (command == "error") {
@@ -1003,7 +1447,7 @@ bool preprocessor_data::get_chunk()
 				pop_token();
 				put(v.str());
 			}
-			else if ((macro = target_.defines_->find(symbol)) != target_.defines_->end())
+			else if ((macro = target_.find_define(symbol)) != target_.defines_->end())
 			{
 				preproc_define const &val = macro->second;
 				size_t nb_arg = strings_.size() - token.stack_pos - 1;
@@ -1122,11 +1566,30 @@ std::istream *preprocess_file(std::string const &fname, preproc_map *defines)
 		owned_defines = new preproc_map;
 		defines = owned_defines;
 	}
+	// maps of last preprocessing may be freed. Fingerprints are used by cache only.
+	if (!cache_dir.empty()) {
+		fingerprints.clear();
+	}
 	preprocessor_streambuf *buf = new preprocessor_streambuf(defines);
 	new preprocessor_file(*buf, fname);
 	return new preprocessor_deleter(buf, owned_defines);
 }
 
+void set_preprocessor_cache(const std::string& dir)
+{
+	if (dir.empty() || create_directory_if_missing_recursive(dir)) {
+		cache_dir = dir;
+	} else {
+		ERR_CF << "Could not create preprocessor cache " << dir << ", disable it\n";
+		cache_dir.clear();
+	}
+}
+
+const std::string& preprocessor_cache()
+{
+	return cache_dir;
+}
+
 void preprocess_resource(const std::string& res_name, preproc_map *defines_map,
 			 bool write_cfg, bool write_plain_cfg,std::string target_directory)
 {
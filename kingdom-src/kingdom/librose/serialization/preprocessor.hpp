@@ -74,6 +74,14 @@ std::ostream& operator<<(std::ostream& stream, const preproc_map::value_type& de
  */
 std::istream *preprocess_file(std::string const &fname, preproc_map *defines = NULL);
 
+/**
+ * Keep preprocessed output of every .cfg file in dir, with macros that it used
+ * and defined. A file is preprocessed again only when its content, or a macro
+ * that it used, changed. Empty dir disables cache.
+ */
+void set_preprocessor_cache(const std::string& dir);
+const std::string& preprocessor_cache();
+
 void preprocess_resource(const std::string& res_name, preproc_map *defines_map,
 			bool write_cfg=false, bool write_plain_cfg=false, std::string target_directory="");
 
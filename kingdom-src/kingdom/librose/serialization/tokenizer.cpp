@@ -21,14 +21,22 @@
 #include "serialization/tokenizer.hpp"
 #include "rose_config.hpp"
 
-tokenizer::tokenizer(std::istream& in) :
+#include <algorithm>
+#include <cstring>
+
+tokenizer::tokenizer(const char* data, size_t size) :
 	current_(EOF),
 	lineno_(1),
 	startlineno_(0),
 	textdomain_("rose-lib"),
 	file_(),
 	token_(),
-	in_(in)
+	pos_(data),
+	end_(data + size),
+	value_begin_(NULL),
+	value_size_(0),
+	copied_(false),
+	unescaped_at_(0)
 {
 	for (int c = 0; c < 128; ++c)
 	{
@@ -42,14 +50,24 @@ tokenizer::tokenizer(std::istream& in) :
 		}
 		char_types_[c] = t;
 	}
-	in_.exceptions(std::ios_base::badbit);
 	next_char_fast();
 }
 
-tokenizer::~tokenizer()
+void tokenizer::copy_value()
+{
+	unescaped_at_ ^= 1;
+	unescaped_[unescaped_at_].assign(value_begin_, value_size_);
+	copied_ = true;
+}
+
+void tokenizer::end_value()
 {
-	in_.clear(std::ios_base::goodbit);
-	in_.exceptions(std::ios_base::goodbit);
+	if (copied_) {
+		const std::string& value = unescaped_[unescaped_at_];
+		token_.value = boost::string_ref(value.c_str(), value.size());
+	} else {
+		token_.value = boost::string_ref(value_begin_, value_size_);
+	}
 }
 
 const token &tokenizer::next_token()
@@ -57,7 +75,9 @@ const token &tokenizer::next_token()
 #if DEBUG
 	previous_token_ = token_;
 #endif
-	token_.value.clear();
+	value_begin_ = pos_;
+	value_size_ = 0;
+	copied_ = false;
 
 	// Dump spaces and inlined comments
 	for(;;)
@@ -86,13 +106,15 @@ const token &tokenizer::next_token()
 	case '<':
 		if (peek_char() != '<') {
 			token_.type = token::MISC;
-			token_.value += current_;
+			begin_value();
+			push_value();
 			break;
 		}
 		token_.type = token::QSTRING;
 		next_char_fast();
+		next_char();
+		begin_value();
 		for (;;) {
-			next_char();
 			if (current_ == EOF) {
 				token_.type = token::UNTERMINATED_QSTRING;
 				break;
@@ -101,14 +123,16 @@ const token &tokenizer::next_token()
 				next_char_fast();
 				break;
 			}
-			token_.value += current_;
+			push_value();
+			next_char();
 		}
 		break;
 
 	case '"':
 		token_.type = token::QSTRING;
+		next_char();
+		begin_value();
 		for (;;) {
-			next_char();
 			if (current_ == EOF) {
 				token_.type = token::UNTERMINATED_QSTRING;
 				break;
@@ -120,30 +144,35 @@ const token &tokenizer::next_token()
 			if (current_ == 254) {
 				skip_comment();
 				--lineno_;
+				next_char();
 				continue;
 			}
-			token_.value += current_;
+			push_value();
+			next_char();
 		}
 		break;
 
 	case '[': case ']': case '/': case '\n': case '=': case ',': case '+':
 		token_.type = token::token_type(current_);
-		token_.value = current_;
+		begin_value();
+		push_value();
 		break;
 
 	case '_':
 		if (!is_alnum(peek_char())) {
 			token_.type = token::token_type(current_);
-			token_.value = current_;
+			begin_value();
+			push_value();
 			break;
 		}
 		// no break
 
 	default:
+		begin_value();
 		if (is_alnum(current_)) {
 			token_.type = token::STRING;
 			do {
-				token_.value += current_;
+				push_value();
 				next_char_fast();
 				while (current_ == 254) {
 					skip_comment();
@@ -152,15 +181,20 @@ const token &tokenizer::next_token()
 			} while (is_alnum(current_));
 		} else {
 			token_.type = token::MISC;
-			token_.value += current_;
+			push_value();
 			next_char();
 		}
+		end_value();
 		return token_;
 	}
+	end_value();
 
 	if (current_ == '\0') {
 		if (game_config::savegame_cache) {
-			in_.read((char*)game_config::savegame_cache, game_config::savegame_cache_size).gcount();
+			// binary data follows WML, i.e. side data of network game.
+			const size_t size = std::min<size_t>(end_ - pos_, game_config::savegame_cache_size);
+			memcpy(game_config::savegame_cache, pos_, size);
+			pos_ = end_;
 		}
 	} else if (current_ != EOF) {
 		next_char();
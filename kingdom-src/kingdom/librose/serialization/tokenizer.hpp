@@ -19,7 +19,8 @@
 
 #include "util.hpp"
 
-#include <istream>
+#include <boost/utility/string_ref.hpp>
+#include <cstdio>
 #include <string>
 
 class config;
@@ -50,15 +51,23 @@ struct token
 	};
 
 	token_type type;
-	std::string value;
+	/**
+	 * points into buffer of tokenizer. If token had to be unescaped (doubled
+	 * quote, '\r', comment in it), into a copy that is valid until the token
+	 * after next one is read.
+	 */
+	boost::string_ref value;
 };
 
-/** Abstract baseclass for the tokenizer. */
+/**
+ * Tokenizer over a contiguous buffer, i.e. a mapped file, inflated gzip data or
+ * a string. Tokens are views into buffer, nothing is copied unless value has to
+ * be unescaped. Buffer must be alive while tokenizer is used.
+ */
 class tokenizer
 {
 public:
-	tokenizer(std::istream& in);
-	~tokenizer();
+	tokenizer(const char* data, size_t size);
 
 	const token &next_token();
 
@@ -105,8 +114,8 @@ private:
 	void next_char_fast()
 	{
 		do {
-			if (LIKELY(in_.good())) {
-				current_ = in_.get();
+			if (LIKELY(pos_ != end_)) {
+				current_ = (unsigned char)*pos_ ++;
 			} else {
 				current_ = EOF;
 				return;
@@ -133,9 +142,36 @@ private:
 
 	int peek_char() const
 	{
-		return in_.peek();
+		return pos_ != end_? (unsigned char)*pos_: EOF;
+	}
+
+	/** start value of token at current character. */
+	void begin_value()
+	{
+		value_begin_ = pos_ - 1;
+		value_size_ = 0;
+		copied_ = false;
+	}
+
+	/**
+	 * add current character to value. While characters are adjacent in buffer
+	 * value is a view, the first skipped character switches it to a copy.
+	 */
+	void push_value()
+	{
+		if (LIKELY(!copied_)) {
+			if (LIKELY(value_begin_ + value_size_ == pos_ - 1)) {
+				value_size_ ++;
+				return;
+			}
+			copy_value();
+		}
+		unescaped_[unescaped_at_] += (char)current_;
 	}
 
+	void copy_value();
+	void end_value();
+
 	enum
 	{
 		TOK_SPACE = 1,
@@ -177,7 +213,16 @@ private:
 #ifdef DEBUG
 	token previous_token_;
 #endif
-	std::istream &in_;
+	const char* pos_;
+	const char* end_;
+
+	const char* value_begin_;
+	size_t value_size_;
+	bool copied_;
+	// two copies, so that parser can keep previous token while it reads next one.
+	std::string unescaped_[2];
+	int unescaped_at_;
+
 	char char_types_[128];
 };
 
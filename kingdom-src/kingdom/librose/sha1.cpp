@@ -30,6 +30,7 @@
 
 #include "sha1.hpp"
 
+#include <cstring>
 #include <iomanip>
 #include <sstream>
 
@@ -56,10 +57,9 @@ sha1_hash::sha1_hash(const std::string& str)
 	int bytes_left = str.size();
 	Uint32 ssz = bytes_left * 8; // string length in bits
 
-	std::stringstream iss (str, std::stringstream::in);
 	// cut our string in 64 bytes blocks then process it
 	while (bytes_left > 0) {
-		iss.read(reinterpret_cast<char*>(block), 64);
+		memcpy(block, str.data() + str.size() - bytes_left, bytes_left < 64? bytes_left: 64);
 		if (bytes_left <= 64) { // if it's the last block, pad it
 			if (bytes_left < 64) {
 				block[bytes_left]= 0x80; // add a 1 bit right after the end of the string
@@ -20,6 +20,7 @@
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
+#include "SDL_atomic.h"
 
 template <typename T>
 struct shared_node {
@@ -48,6 +49,7 @@ public:
 
 	shared_object(const shared_object& o) : val_(o.val_) {
 		assert(valid());
+		tlock lock;
 		val_->count++;
 	}
 
@@ -69,6 +71,7 @@ public:
 		if (valid() && o == get()) return;
 		clear();
 
+		tlock lock;
 		val_ = &*index().insert(node(o)).first;
 		val_->count++;
 
@@ -104,6 +107,15 @@ protected:
 	static hash_map& map() { static hash_map* map = new hash_map; return *map; }
 	static hash_index& index() { return map().template get<0>(); }
 
+	// index and counts are shared by all threads, startup stages copy
+	// objects at the same time. It is constant initialized, no guard.
+	static SDL_SpinLock& spin() { static SDL_SpinLock spin = 0; return spin; }
+
+	struct tlock {
+		tlock() { SDL_AtomicLock(&spin()); }
+		~tlock() { SDL_AtomicUnlock(&spin()); }
+	};
+
 	const node* val_;
 
 	bool valid() const {
@@ -112,6 +124,7 @@ protected:
 
 	void clear() {
 		if (!valid()) return;
+		tlock lock;
 		val_->count--;
 
 		if (val_->count == 0) index().erase(index().find(val_->val));
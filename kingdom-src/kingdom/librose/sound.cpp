@@ -15,6 +15,7 @@
 
 #include "global.hpp"
 
+#include "asset_pack.hpp"
 #include "config.hpp"
 #include "filesystem.hpp"
 #include "preferences.hpp"
@@ -59,6 +60,7 @@ bool no_fading = false;
 bool xmit_audio = false;
 int suspend_audio_ticks = -1;
 bool persist_xmit_audio = false;
+int mute_locks = 0;
 
 // number of allocated channels,
 const size_t n_of_channels = 16;
@@ -526,7 +528,8 @@ static void play_new_music()
 	std::map<std::string,Mix_Music*>::const_iterator itor = music_cache.find(filename);
 	if (itor == music_cache.end()) {
 		LOG_AUDIO << "attempting to insert track '" << filename << "' into cache\n";
-		Mix_Music* const music = Mix_LoadMUS(filename.c_str());
+		// music is streamed, packed music is read from mapped pack while it plays.
+		Mix_Music* const music = asset_pack::find(filename)? Mix_LoadMUS_RW(asset_pack::open_rw(filename), 1): Mix_LoadMUS(filename.c_str());
 		if (music == NULL) {
 			ERR_AUDIO << "Could not load music file '" << filename << "': "
 					  << Mix_GetError() << "\n";
@@ -761,10 +764,10 @@ static Mix_Chunk* load_chunk(const std::string& file, channel_group group)
 			throw chunk_load_exception();
 		}
 		temp_chunk.group = group;
-		std::string const &filename = get_binary_file_location("sounds", file);
+		std::string const &filename = asset_pack::location("sounds", file);
 
 		if (!filename.empty()) {
-			temp_chunk.set_data(Mix_LoadWAV(filename.c_str()));
+			temp_chunk.set_data(Mix_LoadWAV_RW(asset_pack::open_rw(filename), 1));
 		} else {
 			ERR_AUDIO << "Could not load sound file '" << file << "'.\n";
 			throw chunk_load_exception();
@@ -785,7 +788,7 @@ static Mix_Chunk* load_chunk(const std::string& file, channel_group group)
 void play_sound_internal(const std::string& files, channel_group group, unsigned int repeats,
 			unsigned int distance, int id, int loop_ticks, int fadein_ticks)
 {
-	if(files.empty() || distance >= DISTANCE_SILENT || !mix_ok) {
+	if(files.empty() || distance >= DISTANCE_SILENT || !mix_ok || mute_locks) {
 		return;
 	}
 
@@ -967,4 +970,14 @@ tfrequency_lock::~tfrequency_lock()
 	}
 }
 
+tmute_lock::tmute_lock()
+{
+	mute_locks ++;
+}
+
+tmute_lock::~tmute_lock()
+{
+	mute_locks --;
+}
+
 } // end of sound namespace
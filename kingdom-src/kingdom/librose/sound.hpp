@@ -124,6 +124,14 @@ private:
 	size_t original_buffer_size_;
 };
 
+// No sound effect is played when there is any mute lock, music isn't affected.
+class tmute_lock
+{
+public:
+	tmute_lock();
+	~tmute_lock();
+};
+
 }
 
 #endif
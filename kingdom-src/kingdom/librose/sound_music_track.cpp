@@ -16,6 +16,7 @@
 
 #include "sound_music_track.hpp"
 
+#include "asset_pack.hpp"
 #include "config.hpp"
 #include "filesystem.hpp"
 #include "serialization/string_utils.hpp"
@@ -72,7 +73,7 @@ void music_track::resolve()
 #endif
 		file_path_ = id_;
 	} else {
-		file_path_ = get_binary_file_location("music", id_);
+		file_path_ = asset_pack::location("music", id_);
 	}
 
 	if (file_path_.empty()) {
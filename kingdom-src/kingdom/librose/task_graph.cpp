@@ -0,0 +1,226 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/**
+ * @file
+ * Stages that run at the same time when they don't need each other.
+ */
+
+#include "global.hpp"
+
+#include "task_graph.hpp"
+#include "config.hpp"
+#include "wml_exception.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+ttask_graph::ttask_graph()
+	: stages_()
+	, threads_(1)
+	, start_(0)
+	, ticks_(0)
+	, mutex_()
+	, done_()
+	, next_thread_(0)
+	, error_(EXCEPT_NONE)
+	, error_stage_()
+	, error_message_()
+	, error_dev_message_()
+{
+}
+
+int ttask_graph::add(const std::string& name, const task& t)
+{
+	stages_.push_back(tstage(name, t));
+	return stages_.size() - 1;
+}
+
+void ttask_graph::after(int stage, int need)
+{
+	// needs are added before, so there is no cycle.
+	VALIDATE(need >= 0 && need < stage && stage < (int)stages_.size(), "ttask_graph, stage must be added after what it needs!");
+	tstage& s = stages_[stage];
+	if (std::find(s.needs.begin(), s.needs.end(), need) == s.needs.end()) {
+		s.needs.push_back(need);
+		s.waiting ++;
+	}
+}
+
+void ttask_graph::run(int threads, std::ostream* out)
+{
+	if (threads <= 0) {
+		threads = SDL_GetCPUCount();
+	}
+	threads_ = std::max(1, std::min(threads, (int)stages_.size()));
+	start_ = SDL_GetTicks();
+	next_thread_ = 1;
+
+	{
+		std::vector<threading::thread*> pool;
+		for (int n = 1; n < threads_; n ++) {
+			pool.push_back(new threading::thread(thread_main, this));
+		}
+		work(0);
+		// destructor joins thread.
+		for (std::vector<threading::thread*>::iterator it = pool.begin(); it != pool.end(); ++ it) {
+			delete *it;
+		}
+	}
+	ticks_ = SDL_GetTicks() - start_;
+
+	// when a stage failed, timeline tells what ran and what was skipped.
+	if (out) {
+		timeline(*out);
+	}
+	rethrow();
+}
+
+int ttask_graph::thread_main(void* data)
+{
+	ttask_graph* graph = static_cast<ttask_graph*>(data);
+	int thread;
+	{
+		const threading::lock lock(graph->mutex_);
+		thread = graph->next_thread_ ++;
+	}
+	graph->work(thread);
+	return 0;
+}
+
+int ttask_graph::next_stage() const
+{
+	for (size_t n = 0; n < stages_.size(); n ++) {
+		const tstage& s = stages_[n];
+		if (s.state == PENDING && !s.waiting) {
+			return n;
+		}
+	}
+	return -1;
+}
+
+void ttask_graph::work(int thread)
+{
+	for (;;) {
+		int n;
+		{
+			const threading::lock lock(mutex_);
+			for (;;) {
+				n = next_stage();
+				if (n >= 0) {
+					break;
+				}
+				bool pending = false;
+				for (std::vector<tstage>::const_iterator it = stages_.begin(); it != stages_.end(); ++ it) {
+					if (it->state == PENDING) {
+						pending = true;
+						break;
+					}
+				}
+				if (!pending) {
+					return;
+				}
+				done_.wait(mutex_);
+			}
+			tstage& s = stages_[n];
+			s.state = RUNNING;
+			s.thread = thread;
+			s.start = SDL_GetTicks() - start_;
+		}
+
+		int error = EXCEPT_NONE;
+		std::string message, dev_message;
+		try {
+			stages_[n].t();
+		} catch (config::error& e) {
+			error = EXCEPT_CONFIG;
+			message = e.message;
+		} catch (game::error& e) {
+			error = EXCEPT_GAME;
+			message = e.message;
+		} catch (twml_exception& e) {
+			error = EXCEPT_WML;
+			message = e.user_message;
+			dev_message = e.dev_message;
+		} catch (std::exception& e) {
+			error = EXCEPT_OTHER;
+			message = e.what();
+		} catch (...) {
+			error = EXCEPT_OTHER;
+			message = "unknown exception";
+		}
+
+		{
+			const threading::lock lock(mutex_);
+			tstage& s = stages_[n];
+			s.state = DONE;
+			s.end = SDL_GetTicks() - start_;
+
+			if (error != EXCEPT_NONE) {
+				if (error_ == EXCEPT_NONE) {
+					error_ = error;
+					error_stage_ = s.name;
+					error_message_ = message;
+					error_dev_message_ = dev_message;
+				}
+				for (std::vector<tstage>::iterator it = stages_.begin(); it != stages_.end(); ++ it) {
+					if (it->state == PENDING) {
+						it->state = SKIPPED;
+					}
+				}
+			} else {
+				for (std::vector<tstage>::iterator it = stages_.begin(); it != stages_.end(); ++ it) {
+					if (std::find(it->needs.begin(), it->needs.end(), n) != it->needs.end()) {
+						it->waiting --;
+					}
+				}
+			}
+			done_.notify_all();
+		}
+	}
+}
+
+void ttask_graph::rethrow() const
+{
+	if (error_ == EXCEPT_CONFIG) {
+		throw config::error(error_message_);
+	} else if (error_ == EXCEPT_GAME) {
+		throw game::error(error_message_);
+	} else if (error_ == EXCEPT_WML) {
+		throw twml_exception(error_message_, error_dev_message_);
+	} else if (error_ == EXCEPT_OTHER) {
+		throw game::error(error_stage_ + ": " + error_message_);
+	}
+}
+
+std::ostream& ttask_graph::timeline(std::ostream& out) const
+{
+	out << stages_.size() << " stages on " << threads_ << " threads, " << ticks_ << " ms\n";
+	out << std::setw(24) << std::left << "stage" << std::right << std::setw(8) << "thread"
+		<< std::setw(8) << "start" << std::setw(8) << "ms" << "\n";
+	for (std::vector<tstage>::const_iterator it = stages_.begin(); it != stages_.end(); ++ it) {
+		out << std::setw(24) << std::left << it->name << std::right;
+		if (it->state == SKIPPED) {
+			out << std::setw(8) << "-" << std::setw(8) << "-" << std::setw(8) << "-" << "  (skipped)\n";
+			continue;
+		}
+		out << std::setw(8) << it->thread << std::setw(8) << it->start << std::setw(8) << (it->end - it->start);
+		if (error_ != EXCEPT_NONE && it->name == error_stage_) {
+			out << "  (failed)";
+		}
+		out << "\n";
+	}
+	return out;
+}
@@ -0,0 +1,115 @@
+/*
+   Copyright (C) 2013
+   Part of the Battle for Wesnoth Project http://www.wesnoth.org
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2 of the License, or
+   (at your option) any later version.
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY.
+
+   See the COPYING file for more details.
+*/
+
+/** @file */
+
+#ifndef LIBROSE_TASK_GRAPH_HPP_INCLUDED
+#define LIBROSE_TASK_GRAPH_HPP_INCLUDED
+
+#include "thread.hpp"
+
+#include <boost/function.hpp>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/**
+ * Stages that declare which stages they need, i.e. stages of loading game
+ * config. Stage starts when all stages it needs are done, stages that don't
+ * need each other run at the same time on a pool of threads. Caller's thread
+ * is one of them.
+ *
+ * Stages must not touch what other running stages change, and must not draw,
+ * loadscreen::increment_progress() is ignored on other threads.
+ *
+ * If a stage throws, stages that aren't started are skipped, and after running
+ * stages end, run() throws it again on caller's thread. config::error,
+ * game::error and twml_exception keep their type.
+ */
+class ttask_graph
+{
+public:
+	typedef boost::function<void ()> task;
+
+	ttask_graph();
+
+	/** @return id of stage, it is used by after(). */
+	int add(const std::string& name, const task& t);
+
+	/** stage doesn't start before need is done. */
+	void after(int stage, int need);
+
+	/**
+	 * run all stages, and return when they are done.
+	 * @param threads how many threads run stages, 0 is number of cpus.
+	 * @param out if it isn't NULL, timeline() is printed to it, before run() throws too.
+	 */
+	void run(int threads = 0, std::ostream* out = NULL);
+
+	/** when every stage started and how long it took, relative to start of run(). */
+	std::ostream& timeline(std::ostream& out) const;
+
+private:
+	enum {PENDING, RUNNING, DONE, SKIPPED};
+
+	struct tstage {
+		tstage(const std::string& name, const task& t)
+			: name(name)
+			, t(t)
+			, needs()
+			, waiting(0)
+			, state(PENDING)
+			, thread(0)
+			, start(0)
+			, end(0)
+		{}
+
+		std::string name;
+		task t;
+		std::vector<int> needs;
+		// needs that aren't done.
+		int waiting;
+		int state;
+		// which thread ran it, caller's thread is 0.
+		int thread;
+		uint32_t start;
+		uint32_t end;
+	};
+
+	enum {EXCEPT_NONE, EXCEPT_CONFIG, EXCEPT_GAME, EXCEPT_WML, EXCEPT_OTHER};
+
+	static int thread_main(void* data);
+	void work(int thread);
+	// pick a stage that can start, -1 if none. Must hold mutex_.
+	int next_stage() const;
+	void rethrow() const;
+
+	std::vector<tstage> stages_;
+	int threads_;
+	uint32_t start_;
+	uint32_t ticks_;
+
+	threading::mutex mutex_;
+	// notified when a stage ends.
+	threading::condition done_;
+	int next_thread_;
+
+	int error_;
+	std::string error_stage_;
+	std::string error_message_;
+	std::string error_dev_message_;
+};
+
+#endif
@@ -28,12 +28,15 @@
 #include "gettext.hpp"
 #include "log.hpp"
 #include <boost/functional/hash.hpp>
+#include "SDL_atomic.h"
 
 static lg::log_domain log_config("config");
 #define LOG_CF LOG_STREAM(info, log_config)
 #define ERR_CF LOG_STREAM(err, log_config)
 
 static unsigned language_counter = 0;
+// t_string_base is shared by equal t_strings, it can be translated by two threads at the same time.
+static SDL_SpinLock translation_spin = 0;
 
 namespace {
 	const char TRANSLATABLE_PART = 0x01;
@@ -506,22 +509,32 @@ const std::string& t_string_base::str() const
 	if(!translatable_)
 		return value_;
 
-	if (translatable_ && !translated_value_.empty() && translation_timestamp_ == language_counter)
+	// read both under lock, its acquire makes translated_value_ that other thread wrote visible.
+	SDL_AtomicLock(&translation_spin);
+	const bool cached = !translated_value_.empty() && translation_timestamp_ == language_counter;
+	SDL_AtomicUnlock(&translation_spin);
+	if (cached)
 		return translated_value_;
 
-	translated_value_.clear();
+	std::string translated;
 
 	for(walker w(*this); !w.eos(); w.next()) {
 		std::string part(w.begin(), w.end());
 
 		if(w.translatable()) {
-			translated_value_ += dsgettext(w.textdomain().c_str(), part.c_str());
+			translated += dsgettext(w.textdomain().c_str(), part.c_str());
 		} else {
-			translated_value_ += part;
+			translated += part;
 		}
 	}
 
-	translation_timestamp_ = language_counter;
+	// who has returned translated_value_ of this language may be reading it, don't write it again.
+	SDL_AtomicLock(&translation_spin);
+	if (translated_value_.empty() || translation_timestamp_ != language_counter) {
+		translated_value_ = translated;
+		translation_timestamp_ = language_counter;
+	}
+	SDL_AtomicUnlock(&translation_spin);
 	return translated_value_;
 }
 